@@ -7,9 +7,11 @@
 #include <stdio.h>
 
 #include "esp_websocket_client.h"
+#include "esp_websocket_deflate.h"
 #include "esp_transport.h"
 #include "esp_transport_tcp.h"
 #include "esp_transport_ssl.h"
+#include "esp_tls.h"
 /* using uri parser */
 #include "http_parser.h"
 #include "freertos/task.h"
@@ -20,6 +22,8 @@
 #include "esp_timer.h"
 #include "esp_tls_crypto.h"
 #include "esp_system.h"
+#include "esp_idf_version.h"
+#include "esp_random.h"
 #include <errno.h>
 #include <arpa/inet.h>
 
@@ -43,6 +47,25 @@ static const char *TAG = "websocket_client";
 #define WEBSOCKET_TX_LOCK_TIMEOUT_MS    (CONFIG_ESP_WS_CLIENT_TX_LOCK_TIMEOUT_MS)
 #endif
 
+#ifdef CONFIG_ESP_WS_CLIENT_TX_RECORD_SIZE
+#define WEBSOCKET_TX_RECORD_SIZE        (CONFIG_ESP_WS_CLIENT_TX_RECORD_SIZE)
+#else
+#define WEBSOCKET_TX_RECORD_SIZE        (1460)
+#endif
+#define WEBSOCKET_MAX_HEADER_SIZE       (14)    // 2 bytes + 8 bytes extended length + 4 bytes mask
+#define WEBSOCKET_UPGRADE_RESPONSE_SIZE (2048)
+#define WEBSOCKET_DEFAULT_USER_AGENT    "ESP32 Websocket Client"
+#define WEBSOCKET_ACCEPT_GUID           "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+// TLS session reuse reads the private context of the SSL transport, whose layout is only verified for ESP-IDF 5.3
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0) && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 4, 0)
+#define WEBSOCKET_TLS_SESSION_REUSE     1
+#include "mbedtls/ssl.h"
+#include "mbedtls/constant_time.h"
+#else
+#define WEBSOCKET_TLS_SESSION_REUSE     0
+#endif
+
 #define ESP_WS_CLIENT_MEM_CHECK(TAG, a, action) if (!(a)) {                                         \
         ESP_LOGE(TAG,"%s(%d): %s", __FUNCTION__, __LINE__, "Memory exhausted");                     \
         action;                                                                                     \
@@ -106,6 +129,7 @@ typedef struct {
     const char                  *cert_common_name;
     esp_err_t (*crt_bundle_attach)(void *conf);
     esp_transport_handle_t      ext_transport;
+    bool                        tls_session_reuse;
 } websocket_config_storage_t;
 
 typedef enum {
@@ -123,6 +147,7 @@ struct esp_websocket_client {
     esp_websocket_error_codes_t error_handle;
     esp_transport_list_handle_t transport_list;
     esp_transport_handle_t      transport;
+    esp_transport_handle_t      parent_transport;   // TCP/SSL transport under `transport`, NULL for external transport
     websocket_config_storage_t *config;
     websocket_client_state_t    state;
     uint64_t                    keepalive_tick_ms;
@@ -142,11 +167,23 @@ struct esp_websocket_client {
     char                        *errormsg_buffer;
     char                        *rx_buffer;
     char                        *tx_buffer;
+    uint8_t                     *tx_record;         // header + masked payload, written to parent_transport as one record
+    int                         tx_record_len;
     int                         buffer_size;
     bool                        last_fin;
     ws_transport_opcodes_t      last_opcode;
     int                         payload_len;
     int                         payload_offset;
+    esp_websocket_deflate_t     *deflate;           // permessage-deflate codec, NULL when not enabled
+    bool                        rx_compressed;      // RSV1 of the data message being received
+    ws_transport_opcodes_t      rx_opcode;          // opcode of the data message being received
+    int                         rx_inflated_offset; // inflated bytes of that message delivered so far
+#if WEBSOCKET_TLS_SESSION_REUSE
+    esp_tls_client_session_t    *tls_session;       // session of the last TLS connection, offered on the next connect
+#endif
+    esp_websocket_connect_stats_t connect_stats;
+    uint64_t                    connect_full_ms;    // total connect time of full handshakes
+    uint64_t                    connect_resumed_ms; // total connect time of connects the server resumed
     esp_transport_keep_alive_t  keep_alive_cfg;
     struct ifreq                *if_name;
 };
@@ -452,6 +489,15 @@ static void destroy_and_free_resources(esp_websocket_client_handle_t client)
     vSemaphoreDelete(client->tx_lock);
 #endif
     free(client->tx_buffer);
+    free(client->tx_record);
+#if WEBSOCKET_TLS_SESSION_REUSE
+    if (client->tls_session) {
+        esp_tls_free_client_session(client->tls_session);
+    }
+#endif
+    if (client->deflate) {
+        esp_websocket_deflate_destroy(client->deflate);
+    }
     free(client->rx_buffer);
     free(client->errormsg_buffer);
     if (client->status_bits) {
@@ -520,6 +566,7 @@ static esp_err_t esp_websocket_client_create_transport(esp_websocket_client_hand
             esp_transport_tcp_set_interface_name(tcp, client->if_name);
         }
 
+        client->parent_transport = tcp;
         esp_transport_handle_t ws = esp_transport_ws_init(tcp);
         ESP_WS_CLIENT_MEM_CHECK(TAG, ws, return ESP_ERR_NO_MEM);
 
@@ -584,6 +631,7 @@ static esp_err_t esp_websocket_client_create_transport(esp_websocket_client_hand
 #endif
         }
 
+        client->parent_transport = ssl;
         esp_transport_handle_t wss = esp_transport_ws_init(ssl);
         ESP_WS_CLIENT_MEM_CHECK(TAG, wss, return ESP_ERR_NO_MEM);
 
@@ -678,6 +726,251 @@ unlock_and_return:
     return ret;
 }
 
+static int esp_websocket_client_record_flush(esp_websocket_client_handle_t client, int timeout_ms)
+{
+    int widx = 0;
+    while (widx < client->tx_record_len) {
+        int wlen = esp_transport_write(client->parent_transport, (const char *)client->tx_record + widx,
+                                       client->tx_record_len - widx, timeout_ms);
+        if (wlen <= 0) {
+            return wlen < 0 ? wlen : -1;
+        }
+        widx += wlen;
+    }
+    client->tx_record_len = 0;
+    return widx;
+}
+
+/*
+ * Append one frame to the record buffer: header first, then the payload segments masked while copying,
+ * so the caller's data is never modified and never staged in the tx buffer. The record is written out
+ * whenever it fills up; whatever is left is written by the caller after the last frame.
+ */
+static int esp_websocket_client_record_frame(esp_websocket_client_handle_t client, const esp_websocket_frame_t *frame, uint8_t rsv, int timeout_ms)
+{
+    uint64_t len = 0;
+    for (int i = 0; i < frame->iovcnt; i++) {
+        len += frame->iov[i].len;
+    }
+
+    uint8_t header[WEBSOCKET_MAX_HEADER_SIZE];
+    int header_len = 0;
+    header[header_len++] = (uint8_t)(((frame->opcode | WS_TRANSPORT_OPCODES_FIN) & 0xff) | rsv);
+    if (len < 126) {
+        header[header_len++] = 0x80 | (uint8_t)len;
+    } else if (len <= 0xffff) {
+        header[header_len++] = 0x80 | 126;
+        header[header_len++] = (uint8_t)(len >> 8);
+        header[header_len++] = (uint8_t)len;
+    } else {
+        header[header_len++] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            header[header_len++] = (uint8_t)(len >> shift);
+        }
+    }
+    uint32_t mask_key = esp_random();
+    const uint8_t *mask = header + header_len;
+    memcpy(header + header_len, &mask_key, sizeof(mask_key));
+    header_len += sizeof(mask_key);
+
+    int ret;
+    if (client->tx_record_len + header_len > WEBSOCKET_TX_RECORD_SIZE &&
+            (ret = esp_websocket_client_record_flush(client, timeout_ms)) < 0) {
+        return ret;
+    }
+    memcpy(client->tx_record + client->tx_record_len, header, header_len);
+    client->tx_record_len += header_len;
+
+    size_t pos = 0;
+    for (int i = 0; i < frame->iovcnt; i++) {
+        const uint8_t *src = frame->iov[i].data;
+        size_t left = frame->iov[i].len;
+        while (left > 0) {
+            if (client->tx_record_len == WEBSOCKET_TX_RECORD_SIZE &&
+                    (ret = esp_websocket_client_record_flush(client, timeout_ms)) < 0) {
+                return ret;
+            }
+            size_t room = WEBSOCKET_TX_RECORD_SIZE - client->tx_record_len;
+            size_t n = left < room ? left : room;
+            uint8_t *dst = client->tx_record + client->tx_record_len;
+            for (size_t k = 0; k < n; k++) {
+                dst[k] = src[k] ^ mask[(pos + k) & 3];
+            }
+            pos += n;
+            src += n;
+            left -= n;
+            client->tx_record_len += n;
+        }
+    }
+    return (int)len;
+}
+
+/*
+ * External transports only expose the websocket layer, so each segment goes out as a fragment
+ * of the same message through the regular send path
+ */
+static int esp_websocket_client_send_frame_fragmented(esp_websocket_client_handle_t client, const esp_websocket_frame_t *frame, TickType_t timeout)
+{
+    int last = -1;
+    for (int i = 0; i < frame->iovcnt; i++) {
+        if (frame->iov[i].len > 0) {
+            last = i;
+        }
+    }
+    if (last < 0) {
+        return esp_websocket_client_send_with_exact_opcode(client, frame->opcode | WS_TRANSPORT_OPCODES_FIN, NULL, 0, timeout);
+    }
+    ws_transport_opcodes_t opcode = frame->opcode & ~WS_TRANSPORT_OPCODES_FIN;
+    int sent = 0;
+    for (int i = 0; i <= last; i++) {
+        if (frame->iov[i].len == 0) {
+            continue;
+        }
+        int wlen = esp_websocket_client_send_with_exact_opcode(client, i == last ? opcode | WS_TRANSPORT_OPCODES_FIN : opcode,
+                                                               frame->iov[i].data, frame->iov[i].len, timeout);
+        if (wlen < 0) {
+            return wlen;
+        }
+        sent += wlen;
+        opcode = WS_TRANSPORT_OPCODES_CONT;
+    }
+    return sent;
+}
+
+int esp_websocket_client_send_frames(esp_websocket_client_handle_t client, const esp_websocket_frame_t *frames, int count, TickType_t timeout)
+{
+    int ret = -1;
+    int sent = 0;
+
+    if (client == NULL || frames == NULL || count <= 0) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        int64_t len = 0;
+        if (frames[i].iovcnt < 0 || (frames[i].iov == NULL && frames[i].iovcnt > 0)) {
+            ESP_LOGE(TAG, "Invalid arguments");
+            return -1;
+        }
+        for (int j = 0; j < frames[i].iovcnt; j++) {
+            if (frames[i].iov[j].data == NULL && frames[i].iov[j].len > 0) {
+                ESP_LOGE(TAG, "Invalid arguments");
+                return -1;
+            }
+            len += frames[i].iov[j].len;
+        }
+        if (len > INT32_MAX) {
+            ESP_LOGE(TAG, "Frame too large");
+            return -1;
+        }
+    }
+
+    if (!esp_websocket_client_is_connected(client)) {
+        ESP_LOGE(TAG, "Websocket client is not connected");
+        return -1;
+    }
+
+    if (client->transport == NULL) {
+        ESP_LOGE(TAG, "Invalid transport");
+        return -1;
+    }
+
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    if (xSemaphoreTakeRecursive(client->tx_lock, timeout) != pdPASS) {
+        ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
+        return -1;
+    }
+#else
+    if (xSemaphoreTakeRecursive(client->lock, timeout) != pdPASS) {
+        ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
+        return -1;
+    }
+#endif
+
+    if (client->parent_transport == NULL) {
+        for (int i = 0; i < count; i++) {
+            int wlen = esp_websocket_client_send_frame_fragmented(client, &frames[i], timeout);
+            if (wlen < 0) {
+                ret = wlen;
+                goto unlock_and_return;
+            }
+            sent += wlen;
+        }
+        ret = sent;
+        goto unlock_and_return;
+    }
+
+    int timeout_ms = (timeout == portMAX_DELAY) ? -1 : timeout * portTICK_PERIOD_MS;
+    client->tx_record_len = 0;
+    for (int i = 0; i < count; i++) {
+        const esp_websocket_frame_t *frame = &frames[i];
+        esp_websocket_frame_t compressed_frame;
+        esp_websocket_iovec_t compressed_iov;
+        uint8_t rsv = 0;
+        if (client->deflate) {
+            const uint8_t *out;
+            int out_len = esp_websocket_deflate_compress(client->deflate, frame->opcode, frame->iov, frame->iovcnt, &out);
+            if (out_len >= 0) {
+                compressed_iov = (esp_websocket_iovec_t) {
+                    .data = out, .len = out_len
+                };
+                compressed_frame = (esp_websocket_frame_t) {
+                    .opcode = frame->opcode, .iov = &compressed_iov, .iovcnt = 1
+                };
+                frame = &compressed_frame;
+                rsv = 0x40; // RSV1: compressed message
+            }
+        }
+        int wlen = esp_websocket_client_record_frame(client, frame, rsv, timeout_ms);
+        if (wlen < 0) {
+            ret = wlen;
+            goto write_error;
+        }
+        // Report the payload bytes given by the caller, whether compressed or not
+        for (int j = 0; j < frames[i].iovcnt; j++) {
+            sent += frames[i].iov[j].len;
+        }
+    }
+    if (client->tx_record_len > 0) {
+        ret = esp_websocket_client_record_flush(client, timeout_ms);
+        if (ret < 0) {
+            goto write_error;
+        }
+    }
+    ret = sent;
+    goto unlock_and_return;
+
+write_error:
+    client->tx_record_len = 0;
+    esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->parent_transport);
+    if (error_handle) {
+        esp_websocket_client_error(client, "esp_transport_write() returned %d, transport_error=%s, tls_error_code=%i, tls_flags=%i, errno=%d",
+                                   ret, esp_err_to_name(error_handle->last_error), error_handle->esp_tls_error_code,
+                                   error_handle->esp_tls_flags, errno);
+    } else {
+        esp_websocket_client_error(client, "esp_transport_write() returned %d, errno=%d", ret, errno);
+    }
+    esp_websocket_client_abort_connection(client, WEBSOCKET_ERROR_TYPE_TCP_TRANSPORT);
+
+unlock_and_return:
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    xSemaphoreGiveRecursive(client->tx_lock);
+#else
+    xSemaphoreGiveRecursive(client->lock);
+#endif
+    return ret;
+}
+
+int esp_websocket_client_send_iov(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const esp_websocket_iovec_t *iov, int iovcnt, TickType_t timeout)
+{
+    esp_websocket_frame_t frame = {
+        .opcode = opcode,
+        .iov = iov,
+        .iovcnt = iovcnt,
+    };
+    return esp_websocket_client_send_frames(client, &frame, 1, timeout);
+}
+
 esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config)
 {
     esp_websocket_client_handle_t client = calloc(1, sizeof(struct esp_websocket_client));
@@ -753,6 +1046,16 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     client->config->cert_common_name = config->cert_common_name;
     client->config->crt_bundle_attach = config->crt_bundle_attach;
     client->config->ext_transport = config->ext_transport;
+    client->config->tls_session_reuse = config->tls_session_reuse;
+#if !WEBSOCKET_TLS_SESSION_REUSE
+    if (config->tls_session_reuse) {
+#if !CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        ESP_LOGW(TAG, "tls_session_reuse requires CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS");
+#else
+        ESP_LOGW(TAG, "tls_session_reuse is only supported on ESP-IDF 5.3, TLS sessions will not be reused");
+#endif
+    }
+#endif
 
     if (config->uri) {
         if (esp_websocket_client_set_uri(client, config->uri) != ESP_OK) {
@@ -793,12 +1096,28 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
         goto _websocket_init_fail;
     });
 #endif
+    client->tx_record = malloc(WEBSOCKET_TX_RECORD_SIZE);
+    ESP_WS_CLIENT_MEM_CHECK(TAG, client->tx_record, {
+        goto _websocket_init_fail;
+    });
     client->status_bits = xEventGroupCreate();
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->status_bits, {
         goto _websocket_init_fail;
     });
     xEventGroupSetBits(client->status_bits, STOPPED_BIT);
 
+    if (config->deflate.enable) {
+        if (config->ext_transport) {
+            ESP_LOGW(TAG, "permessage-deflate is not available with an external transport");
+        } else {
+            // The offer is sent by esp_websocket_client_upgrade()
+            client->deflate = esp_websocket_deflate_create(&config->deflate, buffer_size);
+            ESP_WS_CLIENT_MEM_CHECK(TAG, client->deflate, {
+                goto _websocket_init_fail;
+            });
+        }
+    }
+
     client->buffer_size = buffer_size;
     return client;
 
@@ -952,9 +1271,15 @@ esp_err_t esp_websocket_client_append_header(esp_websocket_client_handle_t clien
     return ESP_OK;
 }
 
+static esp_err_t esp_websocket_client_recv_frame(esp_websocket_client_handle_t client);
+static void esp_websocket_client_handle_control_frame(esp_websocket_client_handle_t client);
+
 static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
 {
     int rlen;
+    if (client->deflate && client->parent_transport) {
+        return esp_websocket_client_recv_frame(client);
+    }
     client->payload_offset = 0;
     if (esp_websocket_new_buf(client, false) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to setup rx buffer");
@@ -989,6 +1314,13 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
         client->payload_offset += rlen;
     } while (client->payload_offset < client->payload_len);
 
+    esp_websocket_client_handle_control_frame(client);
+    esp_websocket_free_buf(client, false);
+    return ESP_OK;
+}
+
+static void esp_websocket_client_handle_control_frame(esp_websocket_client_handle_t client)
+{
     // if a PING message received -> send out the PONG, this will not work for PING messages with payload longer than buffer len
     if (client->last_opcode == WS_TRANSPORT_OPCODES_PING) {
         const char *data = (client->payload_len == 0) ? NULL : client->rx_buffer;
@@ -996,7 +1328,7 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
 #ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
         if (xSemaphoreTakeRecursive(client->tx_lock, WEBSOCKET_TX_LOCK_TIMEOUT_MS) != pdPASS) {
             ESP_LOGE(TAG, "Could not lock ws-client within %d timeout", WEBSOCKET_TX_LOCK_TIMEOUT_MS);
-            return ESP_FAIL;
+            return;
         }
 #endif
         esp_transport_ws_send_raw(client->transport, WS_TRANSPORT_OPCODES_PONG | WS_TRANSPORT_OPCODES_FIN, data, client->payload_len,
@@ -1010,12 +1342,428 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
         ESP_LOGD(TAG, "Received close frame");
         client->state = WEBSOCKET_STATE_CLOSING;
     }
+}
+
+static int esp_websocket_client_read_exact(esp_websocket_client_handle_t client, uint8_t *buf, int len)
+{
+    int ridx = 0;
+    while (ridx < len) {
+        int rlen = esp_transport_read(client->parent_transport, (char *)buf + ridx, len - ridx, client->config->network_timeout_ms);
+        if (rlen < 0) {
+            return rlen;
+        }
+        if (rlen == 0) {
+            // Timeout: nothing pending if the frame has not started yet, otherwise the stream is stuck mid-frame
+            return ridx == 0 ? 0 : -1;
+        }
+        ridx += rlen;
+    }
+    return ridx;
+}
+
+static esp_err_t esp_websocket_client_dispatch_inflated(void *arg, const uint8_t *data, size_t len, bool last)
+{
+    esp_websocket_client_handle_t client = arg;
+    // The inflated message is delivered as one frame of the message opcode whatever its fragmentation on the wire:
+    // payload_offset/payload_len describe the data delivered so far, fin is only set on the final block
+    bool fin = client->last_fin;
+    int opcode = client->last_opcode;
+    int offset = client->payload_offset;
+    int payload_len = client->payload_len;
+    client->last_fin = fin && last;
+    client->last_opcode = client->rx_opcode;
+    client->payload_offset = client->rx_inflated_offset;
+    client->payload_len = client->rx_inflated_offset + len;
+    esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, (const char *)data, len);
+    client->rx_inflated_offset += len;
+    client->last_fin = fin;
+    client->last_opcode = opcode;
+    client->payload_offset = offset;
+    client->payload_len = payload_len;
+    return ESP_OK;
+}
+
+/*
+ * With permessage-deflate the client does the upgrade itself (see esp_websocket_client_upgrade()), so the
+ * frames are read straight from the TCP/SSL transport, which also gives the RSV1 bit that the websocket
+ * transport does not report. Events are the same as from esp_websocket_client_recv(), except that compressed
+ * messages are delivered inflated.
+ */
+static esp_err_t esp_websocket_client_recv_frame(esp_websocket_client_handle_t client)
+{
+    uint8_t header[WEBSOCKET_MAX_HEADER_SIZE];
+    int rlen = esp_websocket_client_read_exact(client, header, 2);
+    if (rlen == 0) {
+        ESP_LOGV(TAG, "esp_transport_read timeouts");
+        return ESP_OK;
+    }
+    if (rlen < 0) {
+        goto read_error;
+    }
+    bool fin = header[0] & 0x80;
+    bool rsv1 = header[0] & 0x40;
+    bool rsv23 = header[0] & 0x30;
+    ws_transport_opcodes_t opcode = header[0] & 0x0f;
+    bool masked = header[1] & 0x80;
+    uint64_t payload_len = header[1] & 0x7f;
+    int ext_len = payload_len == 126 ? 2 : payload_len == 127 ? 8 : 0;
+    if (ext_len + (masked ? 4 : 0) > 0) {
+        rlen = esp_websocket_client_read_exact(client, header + 2, ext_len + (masked ? 4 : 0));
+        if (rlen <= 0) {
+            rlen = -1;
+            goto read_error;
+        }
+        if (ext_len > 0) {
+            payload_len = 0;
+            for (int i = 0; i < ext_len; i++) {
+                payload_len = (payload_len << 8) | header[2 + i];
+            }
+        }
+    }
+    const uint8_t *mask = header + 2 + ext_len;
+    // RSV1 is only valid on the first frame of a data message, and only once the server accepted the extension
+    if (payload_len > INT32_MAX || rsv23 ||
+            (rsv1 && ((opcode & 0x08) || opcode == WS_TRANSPORT_OPCODES_CONT || !esp_websocket_deflate_active(client->deflate)))) {
+        esp_websocket_client_error(client, "Invalid frame: opcode=%d, rsv=%d, len=%" PRIu64, opcode, (header[0] >> 4) & 0x07, payload_len);
+        return ESP_FAIL;
+    }
+
+    // RSV1 is only set on the first frame of a message, continuation frames inherit it
+    if (opcode != WS_TRANSPORT_OPCODES_CONT && (opcode & 0x08) == 0) {
+        client->rx_compressed = rsv1;
+        client->rx_opcode = opcode;
+        client->rx_inflated_offset = 0;
+    }
+    bool compressed = client->rx_compressed && (opcode & 0x08) == 0;
+
+    if (esp_websocket_new_buf(client, false) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to setup rx buffer");
+        return ESP_FAIL;
+    }
+    client->payload_len = payload_len;
+    client->last_fin = fin;
+    client->last_opcode = opcode;
+    client->payload_offset = 0;
+    do {
+        int len = client->payload_len - client->payload_offset;
+        len = len < client->buffer_size ? len : client->buffer_size;
+        if (len > 0) {
+            rlen = esp_websocket_client_read_exact(client, (uint8_t *)client->rx_buffer, len);
+            if (rlen <= 0) {
+                rlen = -1;
+                esp_websocket_free_buf(client, false);
+                goto read_error;
+            }
+            if (masked) {
+                for (int i = 0; i < len; i++) {
+                    client->rx_buffer[i] ^= mask[(client->payload_offset + i) & 3];
+                }
+            }
+        }
+        if (compressed) {
+            bool msg_end = fin && client->payload_offset + len == client->payload_len;
+            if (esp_websocket_deflate_inflate(client->deflate, (const uint8_t *)client->rx_buffer, len, msg_end,
+                                              esp_websocket_client_dispatch_inflated, client) != ESP_OK) {
+                esp_websocket_free_buf(client, false);
+                esp_websocket_client_error(client, "Failed to inflate a compressed message");
+                return ESP_FAIL;
+            }
+        } else {
+            esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_DATA, client->rx_buffer, len);
+        }
+        client->payload_offset += len;
+    } while (client->payload_offset < client->payload_len);
+
+    esp_websocket_client_handle_control_frame(client);
     esp_websocket_free_buf(client, false);
     return ESP_OK;
+
+read_error:
+    {
+        esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->parent_transport);
+        if (error_handle) {
+            esp_websocket_client_error(client, "esp_transport_read() failed with %d, transport_error=%s, tls_error_code=%i, tls_flags=%i, errno=%d",
+                                       rlen, esp_err_to_name(error_handle->last_error), error_handle->esp_tls_error_code,
+                                       error_handle->esp_tls_flags, errno);
+        } else {
+            esp_websocket_client_error(client, "esp_transport_read() failed with %d, errno=%d", rlen, errno);
+        }
+    }
+    return ESP_FAIL;
+}
+
+/* Sec-WebSocket-Accept expected for `key` (RFC 6455 4.2.2) */
+static void esp_websocket_client_accept_key(const char *key, char *accept, size_t len)
+{
+    char key_guid[32 + sizeof(WEBSOCKET_ACCEPT_GUID)];
+    unsigned char sha1[20];
+    size_t olen = 0;
+    int n = snprintf(key_guid, sizeof(key_guid), "%s%s", key, WEBSOCKET_ACCEPT_GUID);
+    esp_crypto_sha1((const unsigned char *)key_guid, n, sha1);
+    esp_crypto_base64_encode((unsigned char *)accept, len - 1, &olen, sha1, sizeof(sha1));
+    accept[olen] = '\0';
+}
+
+static int esp_websocket_client_write_all(esp_websocket_client_handle_t client, const char *buf, int len)
+{
+    int widx = 0;
+    while (widx < len) {
+        int wlen = esp_transport_write(client->parent_transport, buf + widx, len - widx, client->config->network_timeout_ms);
+        if (wlen <= 0) {
+            return -1;
+        }
+        widx += wlen;
+    }
+    return widx;
+}
+
+/*
+ * Upgrade of a client with permessage-deflate. The websocket transport does not report the response headers,
+ * so the client connects the TCP/SSL transport and sends the request itself to learn whether the server
+ * accepted the extension and with which parameters. The response is read a byte at a time up to the end of
+ * its headers: frames the server sends right behind it stay in the transport for the frame reader.
+ * The websocket transport is still used to write control frames and to close the connection.
+ */
+static int esp_websocket_client_upgrade(esp_websocket_client_handle_t client)
+{
+    websocket_config_storage_t *cfg = client->config;
+    client->error_handle.esp_ws_handshake_status_code = 0;
+    if (esp_transport_connect(client->parent_transport, cfg->host, cfg->port, cfg->network_timeout_ms) < 0) {
+        return -1;
+    }
+
+    unsigned char random_key[16];
+    char key[32];
+    char accept[32];
+    char offer[128];
+    size_t key_len = 0;
+    esp_fill_random(random_key, sizeof(random_key));
+    esp_crypto_base64_encode((unsigned char *)key, sizeof(key) - 1, &key_len, random_key, sizeof(random_key));
+    key[key_len] = '\0';
+    esp_websocket_client_accept_key(key, accept, sizeof(accept));
+    if (esp_websocket_deflate_offer(client->deflate, offer, sizeof(offer)) < 0) {
+        ESP_LOGE(TAG, "Failed to write the permessage-deflate offer");
+        return -1;
+    }
+
+    char *request = NULL;
+    int len = asprintf(&request, "GET %s HTTP/1.1\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Host: %s:%d\r\n"
+                       "User-Agent: %s\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Sec-WebSocket-Version: 13\r\n"
+                       "Sec-WebSocket-Key: %s\r\n"
+                       "Sec-WebSocket-Extensions: %s\r\n"
+                       "%s%s%s"
+                       "%s%s%s"
+                       "%s"
+                       "\r\n",
+                       cfg->path ? cfg->path : "/", cfg->host, cfg->port,
+                       cfg->user_agent ? cfg->user_agent : WEBSOCKET_DEFAULT_USER_AGENT, key, offer,
+                       cfg->subprotocol ? "Sec-WebSocket-Protocol: " : "", cfg->subprotocol ? cfg->subprotocol : "", cfg->subprotocol ? "\r\n" : "",
+                       cfg->auth ? "Authorization: " : "", cfg->auth ? cfg->auth : "", cfg->auth ? "\r\n" : "",
+                       cfg->headers ? cfg->headers : "");
+    if (len < 0) {
+        ESP_LOGE(TAG, "No memory for the upgrade request");
+        return -1;
+    }
+    ESP_LOGD(TAG, "Upgrade request:\n%s", request);
+    int ret = esp_websocket_client_write_all(client, request, len);
+    free(request);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to send the upgrade request");
+        return -1;
+    }
+
+    char *response = malloc(WEBSOCKET_UPGRADE_RESPONSE_SIZE);
+    ESP_WS_CLIENT_MEM_CHECK(TAG, response, return -1);
+    ret = -1;
+    int rlen = 0;
+    while (rlen < 4 || memcmp(response + rlen - 4, "\r\n\r\n", 4) != 0) {
+        if (rlen == WEBSOCKET_UPGRADE_RESPONSE_SIZE - 1) {
+            ESP_LOGE(TAG, "Upgrade response headers exceed %d bytes", WEBSOCKET_UPGRADE_RESPONSE_SIZE);
+            goto exit;
+        }
+        if (esp_transport_read(client->parent_transport, response + rlen, 1, cfg->network_timeout_ms) <= 0) {
+            ESP_LOGE(TAG, "Failed to read the upgrade response");
+            goto exit;
+        }
+        rlen++;
+    }
+    response[rlen] = '\0';
+    ESP_LOGD(TAG, "Upgrade response:\n%s", response);
+
+    char *status = strchr(response, ' ');
+    client->error_handle.esp_ws_handshake_status_code = (strncmp(response, "HTTP/", 5) == 0 && status) ? atoi(status + 1) : -1;
+    if (client->error_handle.esp_ws_handshake_status_code != 101) {
+        ESP_LOGE(TAG, "Upgrade failed with status %d", client->error_handle.esp_ws_handshake_status_code);
+        goto exit;
+    }
+    bool accepted = false;
+    const char *extensions = NULL;
+    char *line = strstr(response, "\r\n") + 2;
+    char *end;
+    while ((end = strstr(line, "\r\n")) != line) {
+        *end = '\0';
+        char *value = strchr(line, ':');
+        if (value) {
+            *value++ = '\0';
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            for (char *tail = value + strlen(value); tail > value && (tail[-1] == ' ' || tail[-1] == '\t'); tail--) {
+                tail[-1] = '\0';
+            }
+            if (strcasecmp(line, "Sec-WebSocket-Accept") == 0) {
+                accepted = strcmp(value, accept) == 0;
+            } else if (strcasecmp(line, "Sec-WebSocket-Extensions") == 0) {
+                if (extensions) {
+                    ESP_LOGE(TAG, "Sec-WebSocket-Extensions repeated in the upgrade response");
+                    goto exit;
+                }
+                extensions = value;
+            }
+        }
+        line = end + 2;
+    }
+    if (!accepted) {
+        ESP_LOGE(TAG, "Missing or invalid Sec-WebSocket-Accept in the upgrade response");
+        goto exit;
+    }
+
+    // Senders check the state before taking the tx lock, one left over from the previous connection may still compress
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    if (xSemaphoreTakeRecursive(client->tx_lock, WEBSOCKET_TX_LOCK_TIMEOUT_MS) != pdPASS) {
+        ESP_LOGE(TAG, "Could not lock ws-client within %d timeout", WEBSOCKET_TX_LOCK_TIMEOUT_MS);
+        goto exit;
+    }
+#endif
+    if (esp_websocket_deflate_accept(client->deflate, extensions) == ESP_OK) {
+        ret = 0;
+    }
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    xSemaphoreGiveRecursive(client->tx_lock);
+#endif
+
+exit:
+    free(response);
+    return ret;
 }
 
 static int esp_websocket_client_send_close(esp_websocket_client_handle_t client, int code, const char *additional_data, int total_len, TickType_t timeout);
 
+#if WEBSOCKET_TLS_SESSION_REUSE
+/*
+ * Leading members of the SSL transport context (transport_esp_tls_t in tcp_transport/transport_ssl.c of
+ * ESP-IDF 5.3, see WEBSOCKET_TLS_SESSION_REUSE). The transport has no session API, but it passes this
+ * esp-tls config to every connect and keeps the esp-tls handle of the open connection.
+ */
+typedef struct {
+    esp_tls_t                   *tls;
+    esp_tls_cfg_t               cfg;
+} websocket_ssl_context_t;
+
+/* struct esp_tls_client_session of esp-tls/private_include/esp_tls_private.h (ESP-IDF 5.3, mbedTLS) */
+typedef struct {
+    mbedtls_ssl_session         saved_session;
+} websocket_tls_session_t;
+
+static websocket_ssl_context_t *esp_websocket_client_ssl_context(esp_websocket_client_handle_t client)
+{
+    if (!client->config->tls_session_reuse || client->parent_transport == NULL ||
+            strcasecmp(client->config->scheme, WS_OVER_TLS_SCHEME) != 0) {
+        return NULL;
+    }
+    return esp_transport_get_context_data(client->parent_transport);
+}
+#endif
+
+/* Hand the cached TLS session to the next connect, returns whether there is one */
+static bool esp_websocket_client_tls_session_offer(esp_websocket_client_handle_t client)
+{
+#if WEBSOCKET_TLS_SESSION_REUSE
+    websocket_ssl_context_t *ssl = esp_websocket_client_ssl_context(client);
+    if (ssl) {
+        ssl->cfg.client_session = client->tls_session;
+        return client->tls_session != NULL;
+    }
+#endif
+    return false;
+}
+
+/*
+ * Keep the session of the connection just made (with a fresh ticket, if the server issues them).
+ * Returns whether the server resumed the offered session: a resumed TLS 1.2 session carries over the master
+ * secret, while a full handshake derives a new one. The session ID cannot tell, since a client presenting a
+ * ticket sends a random ID (RFC 5077 3.4). mbedTLS exports a session only once per connection, so the check
+ * uses the session exported here for the next connect.
+ */
+static bool esp_websocket_client_tls_session_save(esp_websocket_client_handle_t client, bool offered)
+{
+#if WEBSOCKET_TLS_SESSION_REUSE
+    websocket_ssl_context_t *ssl = esp_websocket_client_ssl_context(client);
+    if (ssl == NULL || ssl->tls == NULL) {
+        return false;
+    }
+    esp_tls_client_session_t *session = esp_tls_get_client_session(ssl->tls);
+    if (session == NULL) {
+        ESP_LOGW(TAG, "Failed to save the TLS session");
+        return false;
+    }
+    bool resumed = false;
+    if (offered && client->tls_session) {
+        const mbedtls_ssl_session *previous = &((websocket_tls_session_t *)client->tls_session)->saved_session;
+        const mbedtls_ssl_session *current = &((websocket_tls_session_t *)session)->saved_session;
+        resumed = previous->MBEDTLS_PRIVATE(ciphersuite) == current->MBEDTLS_PRIVATE(ciphersuite) &&
+                  mbedtls_ct_memcmp(previous->MBEDTLS_PRIVATE(master), current->MBEDTLS_PRIVATE(master),
+                                    sizeof(current->MBEDTLS_PRIVATE(master))) == 0;
+    }
+    ssl->cfg.client_session = session;
+    if (client->tls_session) {
+        esp_tls_free_client_session(client->tls_session);
+    }
+    client->tls_session = session;
+    return resumed;
+#else
+    return false;
+#endif
+}
+
+/* A connect offering the session failed: the next one starts over with a full handshake */
+static void esp_websocket_client_tls_session_drop(esp_websocket_client_handle_t client)
+{
+#if WEBSOCKET_TLS_SESSION_REUSE
+    websocket_ssl_context_t *ssl = esp_websocket_client_ssl_context(client);
+    if (ssl) {
+        ssl->cfg.client_session = NULL;
+    }
+    if (client->tls_session) {
+        esp_tls_free_client_session(client->tls_session);
+        client->tls_session = NULL;
+    }
+#endif
+}
+
+static void esp_websocket_client_connect_stats_update(esp_websocket_client_handle_t client, bool offered, bool resumed,
+        uint32_t connect_ms)
+{
+    esp_websocket_connect_stats_t *stats = &client->connect_stats;
+    stats->last_connect_ms = connect_ms;
+    stats->last_offered = offered;
+    stats->last_resumed = resumed;
+    stats->offered_count += offered;
+    if (resumed) {
+        stats->resumed_count++;
+        client->connect_resumed_ms += connect_ms;
+        stats->resumed_avg_ms = client->connect_resumed_ms / stats->resumed_count;
+    } else {
+        stats->full_count++;
+        client->connect_full_ms += connect_ms;
+        stats->full_avg_ms = client->connect_full_ms / stats->full_count;
+    }
+}
+
 static void esp_websocket_client_task(void *pv)
 {
     const int lock_timeout = portMAX_DELAY;
@@ -1053,13 +1801,26 @@ static void esp_websocket_client_task(void *pv)
                 break;
             }
             esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_BEFORE_CONNECT, NULL, 0);
-            int result = esp_transport_connect(client->transport,
+            bool offered = esp_websocket_client_tls_session_offer(client);
+            uint64_t connect_start_ms = _tick_get_ms();
+            int result;
+            if (client->deflate) {
+                result = esp_websocket_client_upgrade(client);
+            } else {
+                result = esp_transport_connect(client->transport,
                                                client->config->host,
                                                client->config->port,
                                                client->config->network_timeout_ms);
+            }
             if (result < 0) {
+                if (offered) {
+                    client->connect_stats.resume_failures++;
+                    esp_websocket_client_tls_session_drop(client);
+                }
                 esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
-                client->error_handle.esp_ws_handshake_status_code  = esp_transport_ws_get_upgrade_request_status(client->transport);
+                if (client->deflate == NULL) {
+                    client->error_handle.esp_ws_handshake_status_code = esp_transport_ws_get_upgrade_request_status(client->transport);
+                }
                 if (error_handle) {
                     esp_websocket_client_error(client, "esp_transport_connect() failed with %d, "
                                                "transport_error=%s, tls_error_code=%i, tls_flags=%i, esp_ws_handshake_status_code=%d, errno=%d",
@@ -1073,9 +1834,16 @@ static void esp_websocket_client_task(void *pv)
                 break;
             }
             ESP_LOGD(TAG, "Transport connected to %s://%s:%d", client->config->scheme, client->config->host, client->config->port);
+            uint32_t connect_ms = _tick_get_ms() - connect_start_ms;
+            bool resumed = esp_websocket_client_tls_session_save(client, offered);
+            esp_websocket_client_connect_stats_update(client, offered, resumed, connect_ms);
+            if (offered && !resumed) {
+                ESP_LOGD(TAG, "Server did not resume the offered TLS session");
+            }
 
             client->state = WEBSOCKET_STATE_CONNECTED;
             client->wait_for_pong_resp = false;
+            client->rx_compressed = false;
             client->error_handle.error_type = WEBSOCKET_ERROR_TYPE_NONE;
             esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_CONNECTED, NULL, 0);
             break;
@@ -1202,8 +1970,9 @@ static void esp_websocket_client_task(void *pv)
 
     esp_websocket_client_dispatch_event(client, WEBSOCKET_EVENT_FINISH, NULL, 0);
     esp_transport_close(client->transport);
-    xEventGroupSetBits(client->status_bits, STOPPED_BIT);
+    // Reset the state before signalling, a client started again right after the stop must not see it overwritten
     client->state = WEBSOCKET_STATE_UNKNOW;
+    xEventGroupSetBits(client->status_bits, STOPPED_BIT);
     if (client->selected_for_destroying == true) {
         destroy_and_free_resources(client);
     }
@@ -1222,10 +1991,23 @@ esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client)
 
     client->transport = client->config->ext_transport;
     if (!client->transport) {
-        if (esp_websocket_client_create_transport(client) != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to create websocket transport");
+        // Keep the transports of the previous start (and the TLS session they carry) unless the scheme changed
+        if (client->transport_list) {
+            client->transport = esp_transport_list_get_transport(client->transport_list, client->config->scheme);
+        }
+        if (client->transport == NULL || client->parent_transport == NULL) {
+            client->transport = NULL;
+            client->parent_transport = NULL;
+            if (esp_websocket_client_create_transport(client) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to create websocket transport");
+                return ESP_FAIL;
+            }
+        } else if (set_websocket_transport_optional_settings(client, client->config->scheme) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to configure websocket transport");
             return ESP_FAIL;
         }
+    } else {
+        client->parent_transport = NULL;
     }
 
     if (xTaskCreate(esp_websocket_client_task, client->config->task_name ? client->config->task_name : "websocket_task",
@@ -1312,6 +2094,30 @@ esp_err_t esp_websocket_client_close_with_code(esp_websocket_client_handle_t cli
     return esp_websocket_client_close_with_optional_body(client, true, code, data, len, timeout);
 }
 
+esp_err_t esp_websocket_client_get_deflate_stats(esp_websocket_client_handle_t client, esp_websocket_deflate_stats_t *stats)
+{
+    if (client == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->deflate == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_websocket_deflate_get_stats(client->deflate, stats);
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_get_connect_stats(esp_websocket_client_handle_t client, esp_websocket_connect_stats_t *stats)
+{
+    if (client == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = client->connect_stats;
+#if WEBSOCKET_TLS_SESSION_REUSE
+    stats->session_cached = client->tls_session != NULL;
+#endif
+    return ESP_OK;
+}
+
 esp_err_t esp_websocket_client_close(esp_websocket_client_handle_t client, TickType_t timeout)
 {
     return esp_websocket_client_close_with_optional_body(client, false, 0, NULL, 0, timeout);
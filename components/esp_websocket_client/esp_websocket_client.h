@@ -91,6 +91,77 @@ typedef enum {
     WEBSOCKET_TRANSPORT_OVER_SSL,       /*!< Transport over ssl */
 } esp_websocket_transport_t;
 
+/**
+ * @brief Websocket payload segment, owned by the caller for the duration of the send call
+ */
+typedef struct {
+    const void                  *data;                      /*!< Segment data */
+    size_t                      len;                        /*!< Segment length in bytes */
+} esp_websocket_iovec_t;
+
+/**
+ * @brief Websocket frame made of one or more payload segments
+ */
+typedef struct {
+    ws_transport_opcodes_t      opcode;                     /*!< Frame opcode, the FIN bit is always set */
+    const esp_websocket_iovec_t *iov;                       /*!< Payload segments, sent back to back as one payload */
+    int                         iovcnt;                     /*!< Number of payload segments */
+} esp_websocket_frame_t;
+
+/**
+ * @brief permessage-deflate (RFC 7692) configuration
+ *
+ * The offer is sent in the handshake and messages are compressed only on connections whose server accepted it,
+ * with the window bits and context takeover parameters of its response.
+ */
+typedef struct {
+    bool                        enable;                     /*!< Offer permessage-deflate in the handshake */
+    int                         client_max_window_bits;     /*!< LZ77 window for outgoing messages, 9..15, 0 for 15. Deflate RAM is about (1 << (bits + 2)) + (1 << (mem_level + 9)) */
+    int                         server_max_window_bits;     /*!< LZ77 window requested for incoming messages, 9..15, 0 for 15. Inflate RAM is about (1 << bits) + 7 KB */
+    int                         mem_level;                  /*!< zlib memLevel for outgoing messages, 1..9, 0 for 8 */
+    int                         level;                      /*!< zlib compression level, 1..9, 0 for the zlib default */
+    bool                        client_no_context_takeover; /*!< Reset the compressor after every outgoing message */
+    bool                        server_no_context_takeover; /*!< Ask the server to reset its compressor after every message */
+    uint32_t                    compress_opcodes;           /*!< Bit mask of opcodes (1 << opcode) compressed when sent, 0 for text only */
+    int                         min_size;                   /*!< Messages shorter than this are sent uncompressed */
+} esp_websocket_deflate_config_t;
+
+/**
+ * @brief permessage-deflate statistics of a client
+ */
+typedef struct {
+    bool                        active;                     /*!< The server accepted permessage-deflate on the current connection */
+    size_t                      memory;                     /*!< Bytes currently allocated for compression state and buffers */
+    size_t                      memory_peak;                /*!< Peak of `memory` */
+    uint32_t                    tx_messages;                /*!< Messages sent compressed */
+    uint32_t                    tx_skipped;                 /*!< Messages of a compressed opcode sent uncompressed (too small or not compressible) */
+    uint32_t                    tx_raw_bytes;               /*!< Payload bytes of compressed messages before compression */
+    uint32_t                    tx_compressed_bytes;        /*!< Payload bytes of compressed messages after compression */
+    uint32_t                    rx_messages;                /*!< Compressed messages received */
+    uint32_t                    rx_compressed_bytes;        /*!< Payload bytes of received compressed messages */
+    uint32_t                    rx_inflated_bytes;          /*!< Payload bytes of received compressed messages after inflating */
+} esp_websocket_deflate_stats_t;
+
+/**
+ * @brief Connection setup statistics of a client
+ *
+ * Connect times cover the TCP connect, the TLS handshake and the websocket upgrade. A connect offering the cached
+ * TLS session counts as resumed only when the server actually resumed it (same master secret); when the server
+ * falls back to a full handshake it counts as offered and full.
+ */
+typedef struct {
+    bool                        session_cached;             /*!< A TLS session is cached and will be offered on the next connect */
+    uint32_t                    last_connect_ms;            /*!< Connect time of the last connection */
+    bool                        last_offered;               /*!< The last connection offered the cached TLS session */
+    bool                        last_resumed;               /*!< The server resumed the session on the last connection */
+    uint32_t                    offered_count;              /*!< Connections made offering the cached TLS session */
+    uint32_t                    full_count;                 /*!< Connections made with a full TLS handshake, offered or not */
+    uint32_t                    full_avg_ms;                /*!< Average connect time of those */
+    uint32_t                    resumed_count;              /*!< Connections on which the server resumed the offered session */
+    uint32_t                    resumed_avg_ms;             /*!< Average connect time of those */
+    uint32_t                    resume_failures;            /*!< Failed connects that offered the cached session, which is then dropped */
+} esp_websocket_connect_stats_t;
+
 /**
  * @brief Websocket client setup configuration
  */
@@ -136,6 +207,8 @@ typedef struct {
     size_t                      ping_interval_sec;          /*!< Websocket ping interval, defaults to 10 seconds if not set */
     struct ifreq                *if_name;                   /*!< The name of interface for data to go through. Use the default interface without setting */
     esp_transport_handle_t      ext_transport;              /*!< External WebSocket tcp_transport handle to the client; or if null, the client will create its own transport handle. */
+    esp_websocket_deflate_config_t deflate;                 /*!< permessage-deflate extension, not available with `ext_transport` */
+    bool                        tls_session_reuse;          /*!< Cache the TLS session and offer it when the client is started again (needs CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS and ESP-IDF 5.3) */
 } esp_websocket_client_config_t;
 
 /**
@@ -195,6 +268,9 @@ esp_err_t esp_websocket_client_append_header(esp_websocket_client_handle_t clien
 /**
  * @brief      Open the WebSocket connection
  *
+ * A client started again after it stopped reuses its transport, and with `tls_session_reuse`
+ * offers the TLS session of its last connection.
+ *
  * @param[in]  client  The client
  *
  * @return     esp_err_t
@@ -359,6 +435,69 @@ int esp_websocket_client_send_fin(esp_websocket_client_handle_t client, TickType
  */
 int esp_websocket_client_send_with_opcode(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const uint8_t *data, int len, TickType_t timeout);
 
+/**
+ * @brief      Write one complete frame whose payload is gathered from caller-owned segments
+ *
+ * @param[in]  client  The client
+ * @param[in]  opcode  The opcode, the FIN bit is always set
+ * @param[in]  iov     The payload segments
+ * @param[in]  iovcnt  Number of payload segments
+ * @param[in]  timeout Write data timeout in RTOS ticks
+ *
+ *  Notes:
+ *  - Frame header and masked payload are written straight to the underlying TCP/SSL transport
+ *    through a small record buffer (CONFIG_ESP_WS_CLIENT_TX_RECORD_SIZE) instead of being
+ *    staged in the tx buffer, so a small frame goes out in a single write (one TLS record)
+ *  - Segments are only read, never masked in place
+ *  - With an external transport, each segment is sent as a fragment of the same message
+ *
+ * @return
+ *     - Number of payload bytes sent
+ *     - (-1) if any errors
+ */
+int esp_websocket_client_send_iov(esp_websocket_client_handle_t client, ws_transport_opcodes_t opcode, const esp_websocket_iovec_t *iov, int iovcnt, TickType_t timeout);
+
+/**
+ * @brief      Write several complete frames, coalescing consecutive small frames into one write
+ *
+ * @param[in]  client  The client
+ * @param[in]  frames  The frames
+ * @param[in]  count   Number of frames
+ * @param[in]  timeout Write data timeout in RTOS ticks
+ *
+ *  Notes:
+ *  - Frames are packed back to back into the record buffer, which is written whenever it is full
+ *    and once after the last frame, so a burst of small frames costs a single TLS record
+ *  - Either all frames are written, or the connection is aborted
+ *
+ * @return
+ *     - Number of payload bytes sent
+ *     - (-1) if any errors
+ */
+int esp_websocket_client_send_frames(esp_websocket_client_handle_t client, const esp_websocket_frame_t *frames, int count, TickType_t timeout);
+
+/**
+ * @brief      Get permessage-deflate statistics
+ *
+ * @param[in]  client  The client
+ * @param[out] stats   The statistics
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if permessage-deflate is not enabled
+ */
+esp_err_t esp_websocket_client_get_deflate_stats(esp_websocket_client_handle_t client, esp_websocket_deflate_stats_t *stats);
+
+/**
+ * @brief      Get connection setup statistics
+ *
+ * @param[in]  client  The client
+ * @param[out] stats   The statistics
+ *
+ * @return     esp_err_t
+ */
+esp_err_t esp_websocket_client_get_connect_stats(esp_websocket_client_handle_t client, esp_websocket_connect_stats_t *stats);
+
 /**
  * @brief      Close the WebSocket connection in a clean way
  *
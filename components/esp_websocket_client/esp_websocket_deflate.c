@@ -0,0 +1,459 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "zlib.h"
+#include "esp_websocket_deflate.h"
+
+static const char *TAG = "websocket_deflate";
+
+#define WEBSOCKET_DEFLATE_WINDOW_BITS       (15)
+#define WEBSOCKET_DEFLATE_MIN_WINDOW_BITS   (9)     // zlib raw deflate does not support an 8 bit window
+#define WEBSOCKET_INFLATE_MIN_WINDOW_BITS   (8)
+#define WEBSOCKET_DEFLATE_NAME              "permessage-deflate"
+#define WEBSOCKET_DEFLATE_MEM_LEVEL         (8)
+#define WEBSOCKET_DEFLATE_ALLOC_HEADER      (8)     // keeps the accounted allocations 8-byte aligned
+
+// Every deflated message ends with an empty stored block, which is stripped on the wire (RFC 7692 7.2.1)
+static const uint8_t deflate_tail[] = {0x00, 0x00, 0xff, 0xff};
+
+struct esp_websocket_deflate {
+    esp_websocket_deflate_config_t config;
+    z_stream                    tx;
+    z_stream                    rx;
+    bool                        tx_ready;
+    bool                        rx_ready;
+    bool                        active;         // the server accepted the offer on the current connection
+    int                         tx_window_bits; // negotiated client_max_window_bits, 0 when no compression is possible
+    int                         rx_window_bits; // negotiated server_max_window_bits
+    bool                        tx_no_context;  // reset the compressor after every message
+    bool                        rx_no_context;  // reset the inflater after every message
+    uint8_t                     *tx_buf;        // compressed output of the current message
+    size_t                      tx_buf_size;
+    uint8_t                     *rx_buf;        // inflated output block
+    size_t                      rx_pending;     // bytes in rx_buf not yet passed on
+    bool                        rx_ended;       // the current message ended its deflate stream with a final block
+    size_t                      block_size;
+    esp_websocket_deflate_stats_t stats;
+};
+
+static void *deflate_mem_alloc(esp_websocket_deflate_t *codec, size_t len)
+{
+    uint8_t *block = heap_caps_malloc_prefer(len + WEBSOCKET_DEFLATE_ALLOC_HEADER, 2,
+                                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT);
+    if (block == NULL) {
+        return NULL;
+    }
+    *(size_t *)block = len;
+    codec->stats.memory += len;
+    if (codec->stats.memory > codec->stats.memory_peak) {
+        codec->stats.memory_peak = codec->stats.memory;
+    }
+    return block + WEBSOCKET_DEFLATE_ALLOC_HEADER;
+}
+
+static void deflate_mem_free(esp_websocket_deflate_t *codec, void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    uint8_t *block = (uint8_t *)ptr - WEBSOCKET_DEFLATE_ALLOC_HEADER;
+    codec->stats.memory -= *(size_t *)block;
+    heap_caps_free(block);
+}
+
+static voidpf deflate_zalloc(voidpf opaque, uInt items, uInt size)
+{
+    void *ptr = deflate_mem_alloc(opaque, (size_t)items * size);
+    return ptr ? ptr : Z_NULL;
+}
+
+static void deflate_zfree(voidpf opaque, voidpf ptr)
+{
+    deflate_mem_free(opaque, ptr);
+}
+
+static int deflate_window_bits(int bits)
+{
+    if (bits == 0) {
+        return WEBSOCKET_DEFLATE_WINDOW_BITS;
+    }
+    if (bits < WEBSOCKET_DEFLATE_MIN_WINDOW_BITS) {
+        return WEBSOCKET_DEFLATE_MIN_WINDOW_BITS;
+    }
+    return bits > WEBSOCKET_DEFLATE_WINDOW_BITS ? WEBSOCKET_DEFLATE_WINDOW_BITS : bits;
+}
+
+esp_websocket_deflate_t *esp_websocket_deflate_create(const esp_websocket_deflate_config_t *config, size_t block_size)
+{
+    esp_websocket_deflate_t *codec = calloc(1, sizeof(esp_websocket_deflate_t));
+    if (codec == NULL) {
+        return NULL;
+    }
+    codec->config = *config;
+    codec->config.client_max_window_bits = deflate_window_bits(config->client_max_window_bits);
+    codec->config.server_max_window_bits = deflate_window_bits(config->server_max_window_bits);
+    if (codec->config.mem_level <= 0 || codec->config.mem_level > MAX_MEM_LEVEL) {
+        codec->config.mem_level = WEBSOCKET_DEFLATE_MEM_LEVEL;
+    }
+    if (codec->config.level <= 0 || codec->config.level > 9) {
+        codec->config.level = Z_DEFAULT_COMPRESSION;
+    }
+    if (codec->config.compress_opcodes == 0) {
+        codec->config.compress_opcodes = 1 << WS_TRANSPORT_OPCODES_TEXT;
+    }
+    codec->block_size = block_size;
+    return codec;
+}
+
+void esp_websocket_deflate_destroy(esp_websocket_deflate_t *codec)
+{
+    if (codec == NULL) {
+        return;
+    }
+    if (codec->tx_ready) {
+        deflateEnd(&codec->tx);
+    }
+    if (codec->rx_ready) {
+        inflateEnd(&codec->rx);
+    }
+    deflate_mem_free(codec, codec->tx_buf);
+    deflate_mem_free(codec, codec->rx_buf);
+    free(codec);
+}
+
+static void deflate_trim(char **token)
+{
+    char *start = *token;
+    while (*start == ' ' || *start == '\t') {
+        start++;
+    }
+    char *end = start + strlen(start);
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    *end = '\0';
+    *token = start;
+}
+
+/* Window bits parameter of the response, which always carries a value (RFC 7692 7.1.2) */
+static bool deflate_window_param(char *value, int min, int max, int *bits)
+{
+    if (value == NULL) {
+        return false;
+    }
+    deflate_trim(&value);
+    size_t len = strlen(value);
+    if (len >= 2 && value[0] == '"' && value[len - 1] == '"') {
+        value[len - 1] = '\0';
+        value++;
+    }
+    char *end;
+    long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < min || v > max) {
+        return false;
+    }
+    *bits = v;
+    return true;
+}
+
+int esp_websocket_deflate_offer(const esp_websocket_deflate_t *codec, char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "permessage-deflate; client_max_window_bits=%d; server_max_window_bits=%d%s%s",
+                     codec->config.client_max_window_bits, codec->config.server_max_window_bits,
+                     codec->config.client_no_context_takeover ? "; client_no_context_takeover" : "",
+                     codec->config.server_no_context_takeover ? "; server_no_context_takeover" : "");
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
+
+esp_err_t esp_websocket_deflate_accept(esp_websocket_deflate_t *codec, const char *response)
+{
+    codec->active = false;
+    codec->rx_pending = 0;
+    codec->rx_ended = false;
+    if (response == NULL) {
+        ESP_LOGW(TAG, "Server declined permessage-deflate, messages are sent uncompressed");
+        return ESP_OK;
+    }
+
+    char buf[128];
+    if (strlcpy(buf, response, sizeof(buf)) >= sizeof(buf) || strchr(buf, ',') != NULL) {
+        // Only one extension was offered, so more than one in the response is invalid
+        ESP_LOGE(TAG, "Unexpected extensions in the response: %s", response);
+        return ESP_FAIL;
+    }
+    int tx_bits = codec->config.client_max_window_bits;
+    int rx_bits = codec->config.server_max_window_bits;
+    bool tx_no_context = codec->config.client_no_context_takeover;
+    bool rx_no_context = false;
+    uint32_t seen = 0;
+    char *save = NULL;
+    char *token = strtok_r(buf, ";", &save);
+    if (token == NULL) {
+        goto invalid;
+    }
+    deflate_trim(&token);
+    if (strcasecmp(token, WEBSOCKET_DEFLATE_NAME) != 0) {
+        goto invalid;
+    }
+    while ((token = strtok_r(NULL, ";", &save)) != NULL) {
+        char *value = strchr(token, '=');
+        if (value) {
+            *value++ = '\0';
+        }
+        deflate_trim(&token);
+        uint32_t param;
+        bool valid;
+        if (strcasecmp(token, "client_max_window_bits") == 0) {
+            param = 1 << 0;
+            valid = deflate_window_param(value, WEBSOCKET_INFLATE_MIN_WINDOW_BITS, codec->config.client_max_window_bits, &tx_bits);
+        } else if (strcasecmp(token, "server_max_window_bits") == 0) {
+            param = 1 << 1;
+            valid = deflate_window_param(value, WEBSOCKET_INFLATE_MIN_WINDOW_BITS, codec->config.server_max_window_bits, &rx_bits);
+        } else if (strcasecmp(token, "client_no_context_takeover") == 0) {
+            param = 1 << 2;
+            valid = value == NULL;
+            tx_no_context = true;
+        } else if (strcasecmp(token, "server_no_context_takeover") == 0) {
+            param = 1 << 3;
+            valid = value == NULL;
+            rx_no_context = true;
+        } else {
+            goto invalid;
+        }
+        if (!valid || (seen & param)) {
+            goto invalid;
+        }
+        seen |= param;
+    }
+
+    if (tx_bits < WEBSOCKET_DEFLATE_MIN_WINDOW_BITS) {
+        // Compression is optional per message: without a usable window everything is sent uncompressed
+        ESP_LOGW(TAG, "Server limits the client window to %d bits, messages are sent uncompressed", tx_bits);
+        tx_bits = 0;
+    }
+    // The streams of the previous connection are reused when the window did not change
+    if (codec->tx_ready) {
+        if (tx_bits == codec->tx_window_bits) {
+            deflateReset(&codec->tx);
+        } else {
+            deflateEnd(&codec->tx);
+            codec->tx_ready = false;
+        }
+    }
+    if (codec->rx_ready) {
+        if (rx_bits == codec->rx_window_bits) {
+            inflateReset(&codec->rx);
+        } else {
+            inflateEnd(&codec->rx);
+            deflate_mem_free(codec, codec->rx_buf);
+            codec->rx_buf = NULL;
+            codec->rx_ready = false;
+        }
+    }
+    codec->tx_window_bits = tx_bits;
+    codec->rx_window_bits = rx_bits;
+    codec->tx_no_context = tx_no_context;
+    codec->rx_no_context = rx_no_context;
+    codec->active = true;
+    ESP_LOGI(TAG, "Server accepted %s", response);
+    return ESP_OK;
+
+invalid:
+    ESP_LOGE(TAG, "Invalid permessage-deflate response: %s", response);
+    return ESP_FAIL;
+}
+
+bool esp_websocket_deflate_active(const esp_websocket_deflate_t *codec)
+{
+    return codec->active;
+}
+
+static bool deflate_tx_init(esp_websocket_deflate_t *codec)
+{
+    if (codec->tx_ready) {
+        return true;
+    }
+    memset(&codec->tx, 0, sizeof(codec->tx));
+    codec->tx.zalloc = deflate_zalloc;
+    codec->tx.zfree = deflate_zfree;
+    codec->tx.opaque = codec;
+    int ret = deflateInit2(&codec->tx, codec->config.level, Z_DEFLATED, -codec->tx_window_bits,
+                           codec->config.mem_level, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) {
+        ESP_LOGE(TAG, "deflateInit2() failed with %d", ret);
+        return false;
+    }
+    codec->tx_ready = true;
+    return true;
+}
+
+int esp_websocket_deflate_compress(esp_websocket_deflate_t *codec, ws_transport_opcodes_t opcode,
+                                   const esp_websocket_iovec_t *iov, int iovcnt, const uint8_t **out)
+{
+    if (!codec->active || codec->tx_window_bits == 0 || (codec->config.compress_opcodes & (1 << (opcode & 0x0f))) == 0) {
+        return -1;
+    }
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+    if (len == 0 || len < (size_t)codec->config.min_size || !deflate_tx_init(codec)) {
+        codec->stats.tx_skipped++;
+        return -1;
+    }
+
+    // Compressed output that does not fit in the input size is not worth sending
+    size_t cap = len + sizeof(deflate_tail);
+    if (codec->tx_buf_size < cap) {
+        deflate_mem_free(codec, codec->tx_buf);
+        codec->tx_buf = deflate_mem_alloc(codec, cap);
+        codec->tx_buf_size = codec->tx_buf ? cap : 0;
+        if (codec->tx_buf == NULL) {
+            codec->stats.tx_skipped++;
+            return -1;
+        }
+    }
+    z_stream *tx = &codec->tx;
+    tx->next_out = codec->tx_buf;
+    tx->avail_out = cap;
+    for (int i = 0; i < iovcnt; i++) {
+        tx->next_in = (Bytef *)iov[i].data;
+        tx->avail_in = iov[i].len;
+        int ret = deflate(tx, Z_NO_FLUSH);
+        if ((ret != Z_OK && ret != Z_BUF_ERROR) || tx->avail_in != 0) {
+            goto not_compressed;
+        }
+    }
+    int ret = deflate(tx, Z_SYNC_FLUSH);
+    if ((ret != Z_OK && ret != Z_BUF_ERROR) || tx->avail_out == 0) {
+        goto not_compressed;
+    }
+    size_t out_len = cap - tx->avail_out - sizeof(deflate_tail);
+    if (out_len >= len || memcmp(codec->tx_buf + out_len, deflate_tail, sizeof(deflate_tail)) != 0) {
+        goto not_compressed;
+    }
+    if (codec->tx_no_context) {
+        deflateReset(tx);
+    }
+    codec->stats.tx_messages++;
+    codec->stats.tx_raw_bytes += len;
+    codec->stats.tx_compressed_bytes += out_len;
+    *out = codec->tx_buf;
+    return out_len;
+
+not_compressed:
+    // The peer never sees this message in its window, so ours must not keep it either
+    deflateReset(tx);
+    codec->stats.tx_skipped++;
+    return -1;
+}
+
+static bool deflate_rx_init(esp_websocket_deflate_t *codec)
+{
+    if (codec->rx_ready) {
+        return true;
+    }
+    codec->rx_buf = deflate_mem_alloc(codec, codec->block_size);
+    if (codec->rx_buf == NULL) {
+        return false;
+    }
+    memset(&codec->rx, 0, sizeof(codec->rx));
+    codec->rx.zalloc = deflate_zalloc;
+    codec->rx.zfree = deflate_zfree;
+    codec->rx.opaque = codec;
+    int ret = inflateInit2(&codec->rx, -codec->rx_window_bits);
+    if (ret != Z_OK) {
+        ESP_LOGE(TAG, "inflateInit2() failed with %d", ret);
+        deflate_mem_free(codec, codec->rx_buf);
+        codec->rx_buf = NULL;
+        return false;
+    }
+    codec->rx_pending = 0;
+    codec->rx_ended = false;
+    codec->rx_ready = true;
+    return true;
+}
+
+static esp_err_t deflate_inflate_feed(esp_websocket_deflate_t *codec, const uint8_t *data, size_t len, int flush,
+                                      esp_websocket_inflate_output_t output, void *arg)
+{
+    z_stream *rx = &codec->rx;
+    rx->next_in = (Bytef *)data;
+    rx->avail_in = len;
+    do {
+        rx->next_out = codec->rx_buf + codec->rx_pending;
+        rx->avail_out = codec->block_size - codec->rx_pending;
+        int ret = inflate(rx, flush);
+        if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) {
+            ESP_LOGE(TAG, "inflate() failed with %d: %s", ret, rx->msg ? rx->msg : "");
+            return ESP_FAIL;
+        }
+        size_t produced = codec->block_size - codec->rx_pending - rx->avail_out;
+        codec->rx_pending += produced;
+        codec->stats.rx_inflated_bytes += produced;
+        if (ret == Z_STREAM_END) {
+            // The sender may finish the deflate stream with a final block, the next message starts a new one.
+            // Whatever follows in this message, the appended tail included, is not part of either stream.
+            inflateReset(rx);
+            codec->rx_ended = true;
+            rx->avail_in = 0;
+        }
+        if (codec->rx_pending == codec->block_size) {
+            esp_err_t err = output(arg, codec->rx_buf, codec->rx_pending, false);
+            codec->rx_pending = 0;
+            if (err != ESP_OK) {
+                return err;
+            }
+        } else if (ret == Z_BUF_ERROR || ret == Z_STREAM_END) {
+            break;
+        }
+    } while (rx->avail_in > 0 || rx->avail_out == 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_deflate_inflate(esp_websocket_deflate_t *codec, const uint8_t *data, size_t len, bool msg_end,
+                                        esp_websocket_inflate_output_t output, void *arg)
+{
+    if (!codec->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!deflate_rx_init(codec)) {
+        return ESP_ERR_NO_MEM;
+    }
+    codec->stats.rx_compressed_bytes += len;
+    esp_err_t err = ESP_OK;
+    if (!codec->rx_ended) {
+        err = deflate_inflate_feed(codec, data, len, Z_NO_FLUSH, output, arg);
+    }
+    if (err != ESP_OK || !msg_end) {
+        return err;
+    }
+    if (!codec->rx_ended) {
+        err = deflate_inflate_feed(codec, deflate_tail, sizeof(deflate_tail), Z_SYNC_FLUSH, output, arg);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    codec->rx_ended = false;
+    codec->stats.rx_messages++;
+    if (codec->rx_no_context) {
+        inflateReset(&codec->rx);
+    }
+    err = output(arg, codec->rx_buf, codec->rx_pending, true);
+    codec->rx_pending = 0;
+    return err;
+}
+
+void esp_websocket_deflate_get_stats(const esp_websocket_deflate_t *codec, esp_websocket_deflate_stats_t *stats)
+{
+    *stats = codec->stats;
+    stats->active = codec->active;
+}
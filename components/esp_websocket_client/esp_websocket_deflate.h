@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_websocket_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * permessage-deflate (RFC 7692) codec used by the websocket client.
+ * Not thread safe: compression runs under the client tx lock, inflation in the client task.
+ */
+typedef struct esp_websocket_deflate esp_websocket_deflate_t;
+
+/**
+ * @brief Receives inflated data; `last` is set on the final block of a message (which may be empty)
+ */
+typedef esp_err_t (*esp_websocket_inflate_output_t)(void *arg, const uint8_t *data, size_t len, bool last);
+
+/**
+ * @brief Create the codec; compression and inflate state are allocated on first use
+ *
+ * @param[in] config       Extension configuration, zero fields take their defaults
+ * @param[in] block_size   Size of the inflate output blocks
+ */
+esp_websocket_deflate_t *esp_websocket_deflate_create(const esp_websocket_deflate_config_t *config, size_t block_size);
+
+void esp_websocket_deflate_destroy(esp_websocket_deflate_t *codec);
+
+/**
+ * @brief Write the Sec-WebSocket-Extensions offer for the handshake
+ *
+ * @return Length of the offer, or -1 if it does not fit
+ */
+int esp_websocket_deflate_offer(const esp_websocket_deflate_t *codec, char *buf, size_t len);
+
+/**
+ * @brief Start of a new connection: apply the server's answer to the offer, both directions begin with an empty window
+ *
+ * Compression and inflation are only active on a connection whose server accepted the offer. The window bits
+ * and context takeover parameters of the response take the place of the offered ones.
+ *
+ * @param[in] response  Sec-WebSocket-Extensions value of the handshake response, NULL if the header is absent
+ *
+ * @return ESP_OK (also when the offer was declined), ESP_FAIL if the response is not a valid answer to the offer
+ */
+esp_err_t esp_websocket_deflate_accept(esp_websocket_deflate_t *codec, const char *response);
+
+/**
+ * @brief The server accepted the offer on the current connection
+ */
+bool esp_websocket_deflate_active(const esp_websocket_deflate_t *codec);
+
+/**
+ * @brief Compress one outgoing message gathered from `iov`
+ *
+ * @param[out] out  Compressed payload (without the trailing 0x00 0x00 0xff 0xff), valid until the next call
+ *
+ * @return Length of the compressed payload, or -1 if the message is to be sent uncompressed
+ *         (opcode not selected, too small, not compressible, or not negotiated on this connection)
+ */
+int esp_websocket_deflate_compress(esp_websocket_deflate_t *codec, ws_transport_opcodes_t opcode,
+                                   const esp_websocket_iovec_t *iov, int iovcnt, const uint8_t **out);
+
+/**
+ * @brief Inflate a chunk of a received compressed message
+ *
+ * @param[in] msg_end  The chunk ends the message
+ *
+ * @return ESP_OK, ESP_FAIL on corrupt data, ESP_ERR_INVALID_STATE if not negotiated on this connection,
+ *         or the error returned by `output`
+ */
+esp_err_t esp_websocket_deflate_inflate(esp_websocket_deflate_t *codec, const uint8_t *data, size_t len, bool msg_end,
+                                        esp_websocket_inflate_output_t output, void *arg);
+
+void esp_websocket_deflate_get_stats(const esp_websocket_deflate_t *codec, esp_websocket_deflate_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
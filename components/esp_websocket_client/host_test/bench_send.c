@@ -0,0 +1,299 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/*
+ * Loopback benchmark of the send paths (make -C components/esp_websocket_client/host_test test)
+ *
+ * A connected client is set up around a TCP connection to a server thread on 127.0.0.1, which
+ * parses and unmasks every frame and checks the payloads. For each path the benchmark reports, per
+ * message, the writes to the socket (one send() each, as with lwIP on the device), the bytes copied
+ * (headers included) or masked in place before reaching the socket, and the time until the server has
+ * checked everything.
+ */
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* Counts the bytes copied by the client, see bench_memcpy() */
+static void *bench_memcpy(void *dst, const void *src, size_t n);
+#define memcpy bench_memcpy
+#include "../esp_websocket_client.c"
+#undef memcpy
+
+#define BENCH_MESSAGES      20000
+#define BENCH_MAX_BATCH     16
+#define BENCH_MAX_PAYLOAD   4096
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                                       \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__);     \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+static struct esp_websocket_client *s_client;
+static uint64_t s_copied;           // memcpy bytes, except headers staged into the record buffer
+
+static void *bench_memcpy(void *dst, const void *src, size_t n)
+{
+    uint8_t *d = dst;
+    if (!(s_client && s_client->tx_record && d >= s_client->tx_record && d < s_client->tx_record + WEBSOCKET_TX_RECORD_SIZE)) {
+        s_copied += n;
+    }
+    return memmove(dst, src, n);
+}
+
+/*
+ * Loopback server: reassembles messages from their fragments and checks that each one carries its
+ * sequence number in the first 4 bytes followed by the byte pattern i & 0xff.
+ */
+typedef struct {
+    int fd;
+    uint32_t messages;      // complete messages checked so far
+    uint32_t errors;
+} bench_server_t;
+
+static int read_full(int fd, uint8_t *buf, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        ssize_t n = recv(fd, buf + pos, len - pos, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+static void *bench_server_task(void *arg)
+{
+    bench_server_t *server = arg;
+    static uint8_t message[BENCH_MAX_PAYLOAD];
+    size_t message_len = 0;
+    uint32_t expected_seq = 0;
+
+    for (;;) {
+        uint8_t header[14];
+        if (read_full(server->fd, header, 2) < 0) {
+            break;
+        }
+        bool fin = header[0] & 0x80;
+        uint64_t len = header[1] & 0x7f;
+        if (!(header[1] & 0x80)) {
+            server->errors++;   // client frames must be masked
+        }
+        if (len == 126) {
+            read_full(server->fd, header + 2, 2);
+            len = (header[2] << 8) | header[3];
+        } else if (len == 127) {
+            read_full(server->fd, header + 2, 8);
+            len = 0;
+            for (int i = 0; i < 8; i++) {
+                len = (len << 8) | header[2 + i];
+            }
+        }
+        uint8_t mask[4];
+        if (read_full(server->fd, mask, 4) < 0 || message_len + len > sizeof(message) ||
+                read_full(server->fd, message + message_len, len) < 0) {
+            server->errors++;
+            break;
+        }
+        for (uint64_t i = 0; i < len; i++) {
+            message[message_len + i] ^= mask[i & 3];
+        }
+        message_len += len;
+        if (!fin) {
+            continue;
+        }
+        uint32_t seq;
+        memmove(&seq, message, sizeof(seq));
+        bool ok = message_len >= sizeof(seq) && seq == expected_seq;
+        for (size_t i = sizeof(seq); ok && i < message_len; i++) {
+            ok = message[i] == (uint8_t)i;
+        }
+        if (!ok) {
+            server->errors++;
+        }
+        expected_seq = seq + 1;
+        message_len = 0;
+        __atomic_add_fetch(&server->messages, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+typedef enum {
+    BENCH_SEND_BIN,         // esp_websocket_client_send_bin(): tx buffer copy, ws transport writes
+    BENCH_SEND_IOV,         // esp_websocket_client_send_iov() with the sequence number as its own segment
+    BENCH_SEND_FRAMES,      // esp_websocket_client_send_frames() with `batch` messages per call
+} bench_path_t;
+
+typedef struct {
+    const char *name;
+    bench_path_t path;
+    int payload;
+    int batch;
+} bench_case_t;
+
+static const bench_case_t s_cases[] = {
+    { "send_bin",          BENCH_SEND_BIN,    80,   1 },
+    { "send_iov",          BENCH_SEND_IOV,    80,   1 },
+    { "send_frames x8",    BENCH_SEND_FRAMES, 80,   8 },
+    { "send_frames x16",   BENCH_SEND_FRAMES, 80,   16 },
+    { "send_bin",          BENCH_SEND_BIN,    4000, 1 },
+    { "send_iov",          BENCH_SEND_IOV,    4000, 1 },
+};
+
+static int bench_connect(int *client_fd, int *server_fd)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 1) < 0 ||
+            getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        return -1;
+    }
+    *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*client_fd < 0 || connect(*client_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return -1;
+    }
+    *server_fd = accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    // As lwIP on the device with TCP_NODELAY: every write becomes a segment
+    setsockopt(*client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return *server_fd < 0 ? -1 : 0;
+}
+
+static struct esp_websocket_client *bench_client_create(int fd)
+{
+    struct esp_websocket_client *client = calloc(1, sizeof(struct esp_websocket_client));
+    client->config = calloc(1, sizeof(websocket_config_storage_t));
+    client->lock = xSemaphoreCreateRecursiveMutex();
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    client->tx_lock = xSemaphoreCreateRecursiveMutex();
+#endif
+    client->state = WEBSOCKET_STATE_CONNECTED;
+    client->parent_transport = host_transport_create(fd, NULL);
+    client->transport = host_transport_create(fd, client->parent_transport);
+    client->buffer_size = WEBSOCKET_BUFFER_SIZE_BYTE;
+    client->tx_buffer = malloc(client->buffer_size);
+    client->tx_record = malloc(WEBSOCKET_TX_RECORD_SIZE);
+    return client;
+}
+
+static void bench_client_destroy(struct esp_websocket_client *client)
+{
+    host_transport_destroy(client->transport);
+    host_transport_destroy(client->parent_transport);
+    vSemaphoreDelete(client->lock);
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    vSemaphoreDelete(client->tx_lock);
+#endif
+    free(client->tx_buffer);
+    free(client->tx_record);
+    free(client->errormsg_buffer);
+    free(client->config);
+    free(client);
+}
+
+static void bench_run(const bench_case_t *c)
+{
+    static uint8_t payload[BENCH_MAX_BATCH][BENCH_MAX_PAYLOAD];
+    int client_fd, server_fd;
+    pthread_t server_task;
+
+    if (bench_connect(&client_fd, &server_fd) < 0) {
+        CHECK(false, "loopback connection failed");
+        return;
+    }
+    bench_server_t server = { .fd = server_fd };
+    pthread_create(&server_task, NULL, bench_server_task, &server);
+    s_client = bench_client_create(client_fd);
+    for (int b = 0; b < BENCH_MAX_BATCH; b++) {
+        for (int i = 0; i < c->payload; i++) {
+            payload[b][i] = (uint8_t)i;
+        }
+    }
+
+    host_transport_reset_stats();
+    s_copied = 0;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t seq = 0; seq < BENCH_MESSAGES; seq += c->batch) {
+        int ret = -1;
+        if (c->path == BENCH_SEND_BIN) {
+            memmove(payload[0], &seq, sizeof(seq));
+            ret = esp_websocket_client_send_bin(s_client, (const char *)payload[0], c->payload, portMAX_DELAY);
+        } else if (c->path == BENCH_SEND_IOV) {
+            esp_websocket_iovec_t iov[2] = {
+                { .data = (const uint8_t *) &seq, .len = sizeof(seq) },
+                { .data = payload[0] + sizeof(seq), .len = c->payload - sizeof(seq) },
+            };
+            ret = esp_websocket_client_send_iov(s_client, WS_TRANSPORT_OPCODES_BINARY, iov, 2, portMAX_DELAY);
+        } else {
+            esp_websocket_iovec_t iov[BENCH_MAX_BATCH];
+            esp_websocket_frame_t frames[BENCH_MAX_BATCH];
+            for (int b = 0; b < c->batch; b++) {
+                uint32_t frame_seq = seq + b;
+                memmove(payload[b], &frame_seq, sizeof(frame_seq));
+                iov[b] = (esp_websocket_iovec_t) {
+                    .data = payload[b], .len = c->payload
+                };
+                frames[b] = (esp_websocket_frame_t) {
+                    .opcode = WS_TRANSPORT_OPCODES_BINARY, .iov = &iov[b], .iovcnt = 1
+                };
+            }
+            ret = esp_websocket_client_send_frames(s_client, frames, c->batch, portMAX_DELAY);
+        }
+        CHECK(ret == c->payload * c->batch, "%s: send returned %d", c->name, ret);
+        if (ret < 0) {
+            break;
+        }
+    }
+    while (__atomic_load_n(&server.messages, __ATOMIC_ACQUIRE) < BENCH_MESSAGES && server.errors == 0) {
+        usleep(100);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    host_transport_stats_t stats;
+    host_transport_get_stats(&stats);
+    // The record path stages header and payload in the record buffer: everything it writes was copied once
+    uint64_t copied = s_copied + (c->path == BENCH_SEND_BIN ? 0 : stats.write_bytes);
+    printf("%-16s %5d B | %6.2f writes/msg | %7.1f B copied/msg | %7.1f B masked in place/msg | %6.2f us/msg\n",
+           c->name, c->payload, (double)stats.writes / BENCH_MESSAGES, (double)copied / BENCH_MESSAGES,
+           (double)stats.masked_in_place / BENCH_MESSAGES, (double)elapsed / BENCH_MESSAGES);
+    CHECK(server.errors == 0, "%s: server found %" PRIu32 " bad frames", c->name, server.errors);
+    CHECK(server.messages == BENCH_MESSAGES, "%s: %" PRIu32 " of %d messages received", c->name, server.messages, BENCH_MESSAGES);
+    if (c->path != BENCH_SEND_BIN) {
+        // One write per record: never more than the payload needs, never per frame or per segment
+        uint64_t records = (stats.write_bytes + WEBSOCKET_TX_RECORD_SIZE - 1) / WEBSOCKET_TX_RECORD_SIZE;
+        CHECK(stats.writes <= records + BENCH_MESSAGES / c->batch, "%s: %" PRIu32 " writes", c->name, stats.writes);
+        CHECK(stats.masked_in_place == 0, "%s: caller data masked in place", c->name);
+    }
+
+    shutdown(client_fd, SHUT_RDWR);
+    pthread_join(server_task, NULL);
+    close(client_fd);
+    close(server_fd);
+    bench_client_destroy(s_client);
+    s_client = NULL;
+}
+
+int main(void)
+{
+    printf("%d messages per case, record buffer %d B, tx buffer %d B\n",
+           BENCH_MESSAGES, WEBSOCKET_TX_RECORD_SIZE, WEBSOCKET_BUFFER_SIZE_BYTE);
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        bench_run(&s_cases[i]);
+    }
+    printf("%s: %d failure(s)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/*
+ * Host implementations of the ESP-IDF calls reached by the host tests. esp_transport_ws_send_raw()
+ * follows _ws_write() of the ESP-IDF 5.3 ws transport: header and payload are written separately,
+ * the payload being masked in place before the write and unmasked after it.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "idf_host.h"
+
+struct esp_transport_item_t {
+    int fd;
+    esp_transport_handle_t parent;  /* TCP transport under a ws transport, NULL for the TCP transport itself */
+};
+
+static host_transport_stats_t s_stats;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_random(void)
+{
+    static uint32_t state = 0x12345678;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    for (size_t i = 0; i < len; i++) {
+        p[i] = (uint8_t)esp_random();
+    }
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_malloc_prefer(size_t size, size_t num, ...)
+{
+    (void)num;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+    if (mutex == NULL) {
+        return NULL;
+    }
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return mutex;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)ticks;
+    return pthread_mutex_lock(sem) == 0 ? pdPASS : pdFAIL;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(sem) == 0 ? pdPASS : pdFAIL;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(sem);
+    free(sem);
+}
+
+esp_transport_handle_t host_transport_create(int fd, esp_transport_handle_t parent)
+{
+    esp_transport_handle_t t = calloc(1, sizeof(struct esp_transport_item_t));
+    if (t) {
+        t->fd = fd;
+        t->parent = parent;
+    }
+    return t;
+}
+
+void host_transport_destroy(esp_transport_handle_t t)
+{
+    free(t);
+}
+
+void host_transport_get_stats(host_transport_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void host_transport_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+esp_tls_error_handle_t esp_transport_get_error_handle(esp_transport_handle_t t)
+{
+    (void)t;
+    return NULL;
+}
+
+int esp_transport_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    (void)timeout_ms;
+    if (t->parent) {
+        return esp_transport_write(t->parent, buffer, len, timeout_ms);
+    }
+    ssize_t ret;
+    do {
+        ret = send(t->fd, buffer, len, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    s_stats.writes++;
+    s_stats.write_bytes += ret > 0 ? ret : 0;
+    return (int)ret;
+}
+
+int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms)
+{
+    uint8_t header[14];
+    int header_len = 0;
+    char *buffer = (char *)b;
+
+    header[header_len++] = (uint8_t)opcode;
+    if (len <= 125) {
+        header[header_len++] = (uint8_t)(len | 0x80);
+    } else if (len < 65536) {
+        header[header_len++] = 126 | 0x80;
+        header[header_len++] = (uint8_t)(len >> 8);
+        header[header_len++] = (uint8_t)len;
+    } else {
+        header[header_len++] = 127 | 0x80;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            header[header_len++] = (uint8_t)((uint64_t)len >> shift);
+        }
+    }
+    uint8_t *mask = header + header_len;
+    esp_fill_random(mask, 4);
+    header_len += 4;
+    for (int i = 0; i < len; i++) {
+        buffer[i] ^= mask[i % 4];
+    }
+    if (esp_transport_write(t->parent, (const char *)header, header_len, timeout_ms) != header_len) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    int ret = esp_transport_write(t->parent, buffer, len, timeout_ms);
+    for (int i = 0; i < len; i++) {
+        buffer[i] ^= mask[i % 4];
+    }
+    s_stats.masked_in_place += len;
+    return ret;
+}
@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/*
+ * Host stand-ins for the ESP-IDF APIs used by esp_websocket_client.c and esp_websocket_deflate.c.
+ * Every ESP-IDF header the component includes maps to this file. Only what the host tests call is
+ * implemented (idf_host.c); the rest is declared so the component compiles unchanged.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
+/* esp_err.h */
+typedef int esp_err_t;
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_NO_MEM                  0x101
+#define ESP_ERR_INVALID_ARG             0x102
+#define ESP_ERR_INVALID_STATE           0x103
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_NOT_FOUND               0x105
+#define ESP_ERR_NOT_SUPPORTED           0x106
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_INVALID_RESPONSE        0x108
+#define ESP_ERR_MBEDTLS_SSL_WRITE_FAILED 0x8017
+#define ESP_ERR_ESP_TLS_TCP_CLOSED_FIN  0x801a
+const char *esp_err_to_name(esp_err_t code);
+
+/* esp_idf_version.h */
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5, 3, 1)
+
+/* esp_log.h */
+#define ESP_LOG_LEVEL_HOST 2  /* 0 none, 1 error, 2 warning, 3 info, 4 debug */
+#define ESP_HOST_LOG(level, letter, tag, fmt, ...) \
+    do { if (ESP_LOG_LEVEL_HOST >= (level)) printf(letter " %s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, fmt, ...) ESP_HOST_LOG(1, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_HOST_LOG(2, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_HOST_LOG(3, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_HOST_LOG(4, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ESP_HOST_LOG(5, "V", tag, fmt, ##__VA_ARGS__)
+
+/* esp_heap_caps.h */
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps);
+void *heap_caps_malloc_prefer(size_t size, size_t num, ...);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+
+/* newlib has strlcpy, glibc only since 2.38 */
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+/* esp_timer.h, esp_random.h, esp_system.h */
+int64_t esp_timer_get_time(void);
+uint32_t esp_random(void);
+void esp_fill_random(void *buf, size_t len);
+
+/* FreeRTOS */
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *QueueHandle_t;
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+typedef struct { int opaque[8]; } StaticSemaphore_t;
+typedef int portMUX_TYPE;
+#define pdPASS                       1
+#define pdFAIL                       0
+#define pdTRUE                       1
+#define pdFALSE                      0
+#define portMAX_DELAY                0xffffffffu
+#define portTICK_PERIOD_MS           1
+#define pdMS_TO_TICKS(ms)            ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)      ((void)(mux))
+#define portEXIT_CRITICAL(mux)       ((void)(mux))
+#define BIT0 (1 << 0)
+#define BIT1 (1 << 1)
+#define BIT2 (1 << 2)
+#define BIT3 (1 << 3)
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *storage);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t ticks);
+void vEventGroupDelete(EventGroupHandle_t group);
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, int core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+
+/* esp_event.h */
+typedef const char *esp_event_base_t;
+typedef void *esp_event_loop_handle_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t id, void *data);
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+#define ESP_EVENT_ANY_ID -1
+typedef struct {
+    int32_t queue_size;
+    const char *task_name;
+    UBaseType_t task_priority;
+    uint32_t task_stack_size;
+    BaseType_t task_core_id;
+} esp_event_loop_args_t;
+esp_err_t esp_event_loop_create(const esp_event_loop_args_t *args, esp_event_loop_handle_t *loop);
+esp_err_t esp_event_loop_delete(esp_event_loop_handle_t loop);
+esp_err_t esp_event_loop_run(esp_event_loop_handle_t loop, TickType_t ticks);
+esp_err_t esp_event_post_to(esp_event_loop_handle_t loop, esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks);
+esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t loop, esp_event_base_t base, int32_t id, esp_event_handler_t handler, void *arg);
+esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t loop, esp_event_base_t base, int32_t id, esp_event_handler_t handler);
+
+/* esp_tls.h, esp_tls_crypto.h */
+typedef struct esp_tls esp_tls_t;
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+typedef struct {
+    const char *alpn_protos;
+    esp_tls_client_session_t *client_session;
+} esp_tls_cfg_t;
+typedef struct esp_tls_last_error {
+    esp_err_t last_error;
+    int esp_tls_error_code;
+    int esp_tls_flags;
+} esp_tls_last_error_t, *esp_tls_error_handle_t;
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tls_code, int *esp_tls_flags);
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
+void esp_tls_free_client_session(esp_tls_client_session_t *session);
+int esp_crypto_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]);
+int esp_crypto_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+
+/* esp_transport.h, esp_transport_tcp.h, esp_transport_ssl.h, esp_transport_ws.h */
+typedef struct esp_transport_item_t *esp_transport_handle_t;
+typedef struct esp_transport_list_t *esp_transport_list_handle_t;
+typedef struct {
+    bool keep_alive_enable;
+    int keep_alive_idle;
+    int keep_alive_interval;
+    int keep_alive_count;
+} esp_transport_keep_alive_t;
+typedef enum ws_transport_opcodes {
+    WS_TRANSPORT_OPCODES_CONT = 0x00,
+    WS_TRANSPORT_OPCODES_TEXT = 0x01,
+    WS_TRANSPORT_OPCODES_BINARY = 0x02,
+    WS_TRANSPORT_OPCODES_CLOSE = 0x08,
+    WS_TRANSPORT_OPCODES_PING = 0x09,
+    WS_TRANSPORT_OPCODES_PONG = 0x0a,
+    WS_TRANSPORT_OPCODES_FIN = 0x80,
+    WS_TRANSPORT_OPCODES_NONE = 0x100,
+} ws_transport_opcodes_t;
+typedef struct {
+    const char *ws_path;
+    const char *sub_protocol;
+    const char *user_agent;
+    const char *headers;
+    const char *auth;
+    bool propagate_control_frames;
+} esp_transport_ws_config_t;
+esp_transport_list_handle_t esp_transport_list_init(void);
+esp_err_t esp_transport_list_destroy(esp_transport_list_handle_t list);
+esp_err_t esp_transport_list_add(esp_transport_list_handle_t list, esp_transport_handle_t t, const char *scheme);
+esp_transport_handle_t esp_transport_list_get_transport(esp_transport_list_handle_t list, const char *scheme);
+int esp_transport_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms);
+int esp_transport_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms);
+int esp_transport_poll_read(esp_transport_handle_t t, int timeout_ms);
+int esp_transport_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms);
+int esp_transport_close(esp_transport_handle_t t);
+int esp_transport_get_default_port(esp_transport_handle_t t);
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port);
+void *esp_transport_get_context_data(esp_transport_handle_t t);
+esp_tls_error_handle_t esp_transport_get_error_handle(esp_transport_handle_t t);
+int esp_transport_get_errno(esp_transport_handle_t t);
+esp_transport_handle_t esp_transport_tcp_init(void);
+void esp_transport_tcp_set_keep_alive(esp_transport_handle_t t, esp_transport_keep_alive_t *cfg);
+void esp_transport_tcp_set_interface_name(esp_transport_handle_t t, struct ifreq *if_name);
+esp_transport_handle_t esp_transport_ssl_init(void);
+void esp_transport_ssl_set_cert_data(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_set_cert_data_der(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_enable_global_ca_store(esp_transport_handle_t t);
+void esp_transport_ssl_set_client_cert_data(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_set_client_cert_data_der(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_set_client_key_data(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_set_client_key_data_der(esp_transport_handle_t t, const char *data, int len);
+void esp_transport_ssl_crt_bundle_attach(esp_transport_handle_t t, esp_err_t ((*crt_bundle_attach)(void *conf)));
+void esp_transport_ssl_skip_common_name_check(esp_transport_handle_t t);
+void esp_transport_ssl_set_common_name(esp_transport_handle_t t, const char *common_name);
+void esp_transport_ssl_set_keep_alive(esp_transport_handle_t t, esp_transport_keep_alive_t *cfg);
+void esp_transport_ssl_set_interface_name(esp_transport_handle_t t, struct ifreq *if_name);
+esp_transport_handle_t esp_transport_ws_init(esp_transport_handle_t parent);
+esp_err_t esp_transport_ws_set_config(esp_transport_handle_t t, const esp_transport_ws_config_t *config);
+esp_err_t esp_transport_ws_set_headers(esp_transport_handle_t t, const char *headers);
+int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms);
+ws_transport_opcodes_t esp_transport_ws_get_read_opcode(esp_transport_handle_t t);
+bool esp_transport_ws_get_fin_flag(esp_transport_handle_t t);
+int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t);
+int esp_transport_ws_get_upgrade_request_status(esp_transport_handle_t t);
+int esp_transport_ws_poll_connection_closed(esp_transport_handle_t t, int timeout_ms);
+
+/* http_parser.h */
+enum http_parser_url_fields { UF_SCHEMA, UF_HOST, UF_PORT, UF_PATH, UF_QUERY, UF_FRAGMENT, UF_USERINFO, UF_MAX };
+struct http_parser_url {
+    uint16_t field_set;
+    uint16_t port;
+    struct {
+        uint16_t off;
+        uint16_t len;
+    } field_data[UF_MAX];
+};
+void http_parser_url_init(struct http_parser_url *u);
+int http_parser_parse_url(const char *buf, size_t buflen, int is_connect, struct http_parser_url *u);
+
+/* Host test helpers (idf_host.c): transports backed by a connected socket, with write counters */
+typedef struct {
+    uint32_t writes;            /*!< esp_transport_write calls reaching the socket, one send() each */
+    uint64_t write_bytes;       /*!< Bytes passed to those calls */
+    uint64_t masked_in_place;   /*!< Payload bytes masked and unmasked in place by the ws layer */
+} host_transport_stats_t;
+
+esp_transport_handle_t host_transport_create(int fd, esp_transport_handle_t parent);
+void host_transport_destroy(esp_transport_handle_t t);
+void host_transport_get_stats(host_transport_stats_t *stats);
+void host_transport_reset_stats(void);
@@ -0,0 +1,356 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/*
+ * permessage-deflate codec tests (make -C components/esp_websocket_client/host_test test)
+ *
+ * The codec is checked against the zlib of the host standing in for the server: messages the codec
+ * compresses must inflate with a raw inflater of the negotiated window, and messages the host deflates
+ * must come out of the codec unchanged, whatever the chunking of the input and the output block size.
+ * The handshake cases check which Sec-WebSocket-Extensions responses are accepted and what they set up.
+ */
+#include "esp_websocket_deflate.h"
+#include "zlib.h"
+
+#define TEST_MAX_MESSAGE    8192
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                                       \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__);     \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+static const uint8_t tail[] = {0x00, 0x00, 0xff, 0xff};
+
+static uint32_t seed = 0x13572468;
+
+static uint32_t test_random(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+/* JSON-like text, compressible but not trivially so */
+static size_t make_message(char *buf, size_t size, int n)
+{
+    static const char *const words[] = {"wakeup", "silence", "end_of_utterance", "offset_ms", "duration_ms",
+                                        "barge_in", "replay", "audio", "opus", "sample_rate"};
+    size_t len = 0;
+    while (len + 40 < size && len < (size_t)n) {
+        len += snprintf(buf + len, size - len, "{\"type\":\"%s\",\"%s\":%" PRIu32 "},",
+                        words[test_random() % 10], words[test_random() % 10], test_random() % 100000);
+    }
+    return len;
+}
+
+/* Collects the output of the codec's inflater */
+typedef struct {
+    uint8_t data[TEST_MAX_MESSAGE];
+    size_t len;
+    int blocks;
+    bool last;
+} test_sink_t;
+
+static esp_err_t test_sink(void *arg, const uint8_t *data, size_t len, bool last)
+{
+    test_sink_t *sink = arg;
+    if (sink->last || sink->len + len > sizeof(sink->data)) {
+        return ESP_FAIL;
+    }
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    sink->blocks++;
+    sink->last = last;
+    return ESP_OK;
+}
+
+/* The server side inflates one message of the client */
+static size_t peer_inflate(z_stream *peer, const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+    uint8_t buf[TEST_MAX_MESSAGE + sizeof(tail)];
+    memcpy(buf, in, len);
+    memcpy(buf + len, tail, sizeof(tail));
+    peer->next_in = buf;
+    peer->avail_in = len + sizeof(tail);
+    peer->next_out = out;
+    peer->avail_out = size;
+    int ret = inflate(peer, Z_SYNC_FLUSH);
+    if ((ret != Z_OK && ret != Z_BUF_ERROR) || peer->avail_in != 0) {
+        return (size_t) -1;
+    }
+    return size - peer->avail_out;
+}
+
+/* The server side deflates one message for the client, without the tail */
+static size_t peer_deflate(z_stream *peer, const uint8_t *in, size_t len, uint8_t *out, size_t size, int flush)
+{
+    peer->next_in = (Bytef *)in;
+    peer->avail_in = len;
+    peer->next_out = out;
+    peer->avail_out = size;
+    deflate(peer, flush);
+    size_t n = size - peer->avail_out;
+    if (flush == Z_SYNC_FLUSH && n >= sizeof(tail) && memcmp(out + n - sizeof(tail), tail, sizeof(tail)) == 0) {
+        n -= sizeof(tail);
+    }
+    return n;
+}
+
+/**
+ * Messages compressed by the codec, gathered from several segments, inflate with the host zlib; with
+ * client_no_context_takeover every message inflates on its own, otherwise the window carries over
+ */
+static void test_compress_round_trip(void)
+{
+    static const struct {
+        int bits;
+        bool no_context;
+    } cases[] = {{9, false}, {10, false}, {10, true}, {15, false}, {15, true}};
+    static char message[TEST_MAX_MESSAGE];
+    static uint8_t inflated[TEST_MAX_MESSAGE];
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        esp_websocket_deflate_config_t config = {
+            .enable = true,
+            .client_max_window_bits = cases[c].bits,
+            .client_no_context_takeover = cases[c].no_context,
+            .min_size = 16,
+        };
+        esp_websocket_deflate_t *codec = esp_websocket_deflate_create(&config, 1024);
+        char response[128];
+        snprintf(response, sizeof(response), "permessage-deflate; client_max_window_bits=%d%s", cases[c].bits,
+                 cases[c].no_context ? "; client_no_context_takeover" : "");
+        CHECK(esp_websocket_deflate_accept(codec, response) == ESP_OK, "%s rejected", response);
+
+        z_stream peer = {0};
+        inflateInit2(&peer, -cases[c].bits);
+        uint32_t raw = 0;
+        uint32_t compressed = 0;
+        for (int m = 0; m < 200; m++) {
+            size_t len = make_message(message, sizeof(message), 1 + test_random() % (TEST_MAX_MESSAGE - 64));
+            size_t split = len ? test_random() % len : 0;
+            esp_websocket_iovec_t iov[3] = {
+                {message, split / 2}, {message + split / 2, split - split / 2}, {message + split, len - split},
+            };
+            const uint8_t *out = NULL;
+            int n = esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_TEXT, iov, 3, &out);
+            if (n < 0) {
+                // Sent uncompressed: the peer never sees it, nothing to inflate
+                CHECK(len < 16, "bits %d: %zu byte message not compressed", cases[c].bits, len);
+                continue;
+            }
+            if (cases[c].no_context) {
+                inflateReset(&peer);
+            }
+            size_t got = peer_inflate(&peer, out, n, inflated, sizeof(inflated));
+            CHECK(got == len && memcmp(inflated, message, len) == 0,
+                  "bits %d%s: message %d (%zu bytes) inflates to %zu bytes", cases[c].bits,
+                  cases[c].no_context ? " no context" : "", m, len, got);
+            raw += len;
+            compressed += n;
+        }
+        esp_websocket_deflate_stats_t stats;
+        esp_websocket_deflate_get_stats(codec, &stats);
+        CHECK(stats.tx_raw_bytes == raw && stats.tx_compressed_bytes == compressed, "bits %d: stats %" PRIu32 "/%" PRIu32,
+              cases[c].bits, stats.tx_raw_bytes, stats.tx_compressed_bytes);
+        printf("client window %2d bits%s: %" PRIu32 " -> %" PRIu32 " bytes (%.1f%%), state %zu bytes\n", cases[c].bits,
+               cases[c].no_context ? ", no context takeover" : "", raw, compressed, 100.0 * compressed / raw,
+               stats.memory_peak);
+
+        // Binary frames are not selected, a message that does not shrink goes out uncompressed
+        esp_websocket_iovec_t iov = {message, 200};
+        const uint8_t *out = NULL;
+        CHECK(esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_BINARY, &iov, 1, &out) < 0, "binary compressed");
+        uint8_t noise[200];
+        for (size_t i = 0; i < sizeof(noise); i++) {
+            noise[i] = (uint8_t)test_random();
+        }
+        iov.data = noise;
+        iov.len = sizeof(noise);
+        CHECK(esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_TEXT, &iov, 1, &out) < 0, "noise compressed");
+        // ... and must not stay in the window the peer is unaware of
+        size_t len = make_message(message, sizeof(message), 500);
+        iov.data = message;
+        iov.len = len;
+        int n = esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_TEXT, &iov, 1, &out);
+        inflateEnd(&peer);
+        inflateInit2(&peer, -cases[c].bits);
+        CHECK(n > 0 && peer_inflate(&peer, out, n, inflated, sizeof(inflated)) == len &&
+              memcmp(inflated, message, len) == 0, "bits %d: message after an uncompressed one", cases[c].bits);
+        inflateEnd(&peer);
+        esp_websocket_deflate_destroy(codec);
+    }
+}
+
+/**
+ * Messages deflated by the host inflate in the codec for any chunking and output block size, including
+ * messages the sender ends with a final block, and with server_no_context_takeover
+ */
+static void test_inflate_round_trip(void)
+{
+    static const struct {
+        int bits;
+        bool no_context;
+        size_t block_size;
+    } cases[] = {{8, false, 64}, {10, false, 1000}, {10, true, 256}, {15, false, 4096}, {15, true, 17}};
+    static char message[TEST_MAX_MESSAGE];
+    static uint8_t compressed[TEST_MAX_MESSAGE * 2];
+    static test_sink_t sink;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        esp_websocket_deflate_config_t config = {
+            .enable = true,
+            .server_max_window_bits = cases[c].bits < 9 ? 9 : cases[c].bits,
+            .server_no_context_takeover = cases[c].no_context,
+        };
+        esp_websocket_deflate_t *codec = esp_websocket_deflate_create(&config, cases[c].block_size);
+        char response[128];
+        snprintf(response, sizeof(response), "permessage-deflate; server_max_window_bits=%d%s", cases[c].bits,
+                 cases[c].no_context ? "; server_no_context_takeover" : "");
+        CHECK(esp_websocket_deflate_accept(codec, response) == ESP_OK, "%s rejected", response);
+
+        // zlib cannot deflate with an 8 bit raw window: stored blocks fit any window
+        z_stream peer = {0};
+        deflateInit2(&peer, cases[c].bits < 9 ? 0 : 6, Z_DEFLATED, -(cases[c].bits < 9 ? 9 : cases[c].bits), 8,
+                     Z_DEFAULT_STRATEGY);
+        for (int m = 0; m < 200; m++) {
+            size_t len = make_message(message, sizeof(message), test_random() % (TEST_MAX_MESSAGE - 64));
+            // Every tenth message is finished with a final block, after which the sender starts a new stream
+            bool final = m % 10 == 9;
+            size_t n = peer_deflate(&peer, (const uint8_t *)message, len, compressed, sizeof(compressed),
+                                    final ? Z_FINISH : Z_SYNC_FLUSH);
+            if (final || cases[c].no_context) {
+                deflateReset(&peer);
+            }
+            memset(&sink, 0, sizeof(sink));
+            esp_err_t err = ESP_OK;
+            for (size_t pos = 0; err == ESP_OK && (pos < n || pos == 0);) {
+                size_t chunk = 1 + test_random() % 700;
+                chunk = chunk > n - pos ? n - pos : chunk;
+                err = esp_websocket_deflate_inflate(codec, compressed + pos, chunk, pos + chunk == n,
+                                                    test_sink, &sink);
+                pos += chunk;
+                if (n == 0) {
+                    break;
+                }
+            }
+            CHECK(err == ESP_OK && sink.last && sink.len == len && memcmp(sink.data, message, len) == 0,
+                  "bits %d block %zu: message %d (%zu bytes) inflates to %zu bytes, err %d", cases[c].bits,
+                  cases[c].block_size, m, len, sink.len, err);
+        }
+        deflateEnd(&peer);
+
+        // Corrupt data is an error, not a crash
+        uint8_t garbage[] = {0xff, 0xff, 0xff, 0xff, 0xff};
+        memset(&sink, 0, sizeof(sink));
+        CHECK(esp_websocket_deflate_inflate(codec, garbage, sizeof(garbage), true, test_sink, &sink) == ESP_FAIL,
+              "bits %d: garbage inflated", cases[c].bits);
+        esp_websocket_deflate_destroy(codec);
+    }
+}
+
+/**
+ * Sec-WebSocket-Extensions responses to the offer of the client (window bits 10 both ways)
+ */
+static void test_accept(void)
+{
+    static const struct {
+        const char *response;
+        esp_err_t result;
+        bool active;
+        bool compresses;    // messages are compressed on this connection
+    } cases[] = {
+        {NULL, ESP_OK, false, false},
+        {"permessage-deflate", ESP_OK, true, true},
+        {"Permessage-Deflate ;  client_max_window_bits=9 ; server_max_window_bits = 10 ", ESP_OK, true, true},
+        {"permessage-deflate; client_max_window_bits=\"10\"", ESP_OK, true, true},
+        {"permessage-deflate; server_no_context_takeover; client_no_context_takeover", ESP_OK, true, true},
+        {"permessage-deflate; client_max_window_bits=8", ESP_OK, true, false},
+        {"permessage-deflate; client_max_window_bits=11", ESP_FAIL, false, false},
+        {"permessage-deflate; server_max_window_bits=7", ESP_FAIL, false, false},
+        {"permessage-deflate; client_max_window_bits", ESP_FAIL, false, false},
+        {"permessage-deflate; client_max_window_bits=10x", ESP_FAIL, false, false},
+        {"permessage-deflate; server_max_window_bits=9; server_max_window_bits=9", ESP_FAIL, false, false},
+        {"permessage-deflate; server_no_context_takeover=1", ESP_FAIL, false, false},
+        {"permessage-deflate; unknown_param", ESP_FAIL, false, false},
+        {"permessage-deflate, permessage-deflate", ESP_FAIL, false, false},
+        {"x-webkit-deflate-frame", ESP_FAIL, false, false},
+        {"", ESP_FAIL, false, false},
+    };
+    static char message[1024];
+    size_t len = make_message(message, sizeof(message), 600);
+    esp_websocket_iovec_t iov = {message, len};
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        esp_websocket_deflate_config_t config = {
+            .enable = true,
+            .client_max_window_bits = 10,
+            .server_max_window_bits = 10,
+        };
+        esp_websocket_deflate_t *codec = esp_websocket_deflate_create(&config, 512);
+        esp_err_t err = esp_websocket_deflate_accept(codec, cases[c].response);
+        const uint8_t *out = NULL;
+        bool compresses = esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_TEXT, &iov, 1, &out) > 0;
+        CHECK(err == cases[c].result && esp_websocket_deflate_active(codec) == cases[c].active &&
+              compresses == cases[c].compresses, "\"%s\": result %d active %d compresses %d",
+              cases[c].response ? cases[c].response : "(absent)", err, esp_websocket_deflate_active(codec), compresses);
+        esp_websocket_deflate_destroy(codec);
+    }
+
+    char offer[128];
+    esp_websocket_deflate_config_t config = {.enable = true, .client_max_window_bits = 10, .server_no_context_takeover = true};
+    esp_websocket_deflate_t *codec = esp_websocket_deflate_create(&config, 512);
+    CHECK(esp_websocket_deflate_offer(codec, offer, sizeof(offer)) > 0 &&
+          strcmp(offer, "permessage-deflate; client_max_window_bits=10; server_max_window_bits=15; "
+                 "server_no_context_takeover") == 0, "offer: %s", offer);
+    CHECK(esp_websocket_deflate_offer(codec, offer, 20) == -1, "truncated offer accepted");
+    esp_websocket_deflate_destroy(codec);
+}
+
+/**
+ * A new connection starts with empty windows, whether or not its parameters differ from the last one
+ */
+static void test_reconnect(void)
+{
+    static char message[2048];
+    static uint8_t inflated[2048];
+    size_t len = make_message(message, sizeof(message), 1500);
+    esp_websocket_iovec_t iov = {message, len};
+    esp_websocket_deflate_config_t config = {.enable = true, .client_max_window_bits = 12};
+    esp_websocket_deflate_t *codec = esp_websocket_deflate_create(&config, 512);
+    const char *responses[] = {"permessage-deflate", "permessage-deflate", "permessage-deflate; client_max_window_bits=10"};
+    const int bits[] = {12, 12, 10};
+
+    for (int conn = 0; conn < 3; conn++) {
+        CHECK(esp_websocket_deflate_accept(codec, responses[conn]) == ESP_OK, "connection %d rejected", conn);
+        z_stream peer = {0};
+        inflateInit2(&peer, -bits[conn]);
+        for (int m = 0; m < 2; m++) {
+            const uint8_t *out = NULL;
+            int n = esp_websocket_deflate_compress(codec, WS_TRANSPORT_OPCODES_TEXT, &iov, 1, &out);
+            CHECK(n > 0 && peer_inflate(&peer, out, n, inflated, sizeof(inflated)) == len &&
+                  memcmp(inflated, message, len) == 0, "connection %d message %d", conn, m);
+        }
+        inflateEnd(&peer);
+    }
+    esp_websocket_deflate_stats_t stats;
+    esp_websocket_deflate_get_stats(codec, &stats);
+    esp_websocket_deflate_destroy(codec);
+    CHECK(stats.tx_messages == 6, "%" PRIu32 " messages compressed", stats.tx_messages);
+}
+
+int main(void)
+{
+    test_compress_round_trip();
+    test_inflate_round_trip();
+    test_accept();
+    test_reconnect();
+    printf("%s: %d failure(s)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
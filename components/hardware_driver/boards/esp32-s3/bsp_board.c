@@ -23,8 +23,8 @@ void init_i2s_read(void)
 {
     // 配置I2S输入通道
     i2s_chan_config_t rx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_MASTER);
-    rx_chan_cfg.dma_desc_num = DMA_BUF_COUNT;
-    rx_chan_cfg.dma_frame_num = DMA_BUF_LEN;
+    rx_chan_cfg.dma_desc_num = DMA_RX_BUF_COUNT;
+    rx_chan_cfg.dma_frame_num = DMA_RX_BUF_LEN;
     ESP_ERROR_CHECK(i2s_new_channel(&rx_chan_cfg, NULL, &rx_handle));
 
     // 配置I2S输入参数
@@ -65,6 +65,7 @@ i2s_chan_handle_t init_i2s_write(void)
     i2s_chan_config_t tx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_MASTER);
     tx_chan_cfg.dma_desc_num = DMA_BUF_COUNT;
     tx_chan_cfg.dma_frame_num = DMA_BUF_LEN;
+    tx_chan_cfg.auto_clear = true; // DMA无新数据时输出静音，避免欠载时重复播放旧数据
     ESP_ERROR_CHECK(i2s_new_channel(&tx_chan_cfg, &tx_handle, NULL));
 
     // 配置I2S输出参数
@@ -108,10 +109,8 @@ size_t bytes_written = 0;
 // 获取i2s设备(麦克风)数据，并将获取到的数据存入到一个数组中，(i2s通道，数组名，数组长度)
 esp_err_t bsp_i2s_read(int16_t *buffer, int buffer_len)
 {
-    ESP_ERROR_CHECK(i2s_channel_read(rx_handle, buffer,
-                                     buffer_len,
-                                     &bytes_read, portMAX_DELAY));
-    return ESP_OK;
+    // 读取失败时返回错误由调用方处理，不再直接复位芯片
+    return i2s_channel_read(rx_handle, buffer, buffer_len, &bytes_read, portMAX_DELAY);
 }
 
 
@@ -125,6 +124,47 @@ esp_err_t bsp_i2s_write(int16_t *buffer, int buffer_len)
 }
 
 
+// 注册I2S发送完成回调（每个DMA缓冲发送完毕触发一次），回调只能在通道关闭时注册
+esp_err_t bsp_i2s_register_tx_callback(i2s_isr_callback_t on_sent, void *user_ctx)
+{
+    i2s_event_callbacks_t cbs = {
+        .on_sent = on_sent,
+    };
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_disable(tx_handle));
+    esp_err_t ret = i2s_channel_register_event_callback(tx_handle, &cbs, user_ctx);
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_enable(tx_handle));
+    return ret;
+}
+
+// 注册I2S接收完成回调（每个DMA缓冲接收完毕触发一次，event->dma_buf指向该缓冲）
+esp_err_t bsp_i2s_register_rx_callback(i2s_isr_callback_t on_recv, void *user_ctx)
+{
+    i2s_event_callbacks_t cbs = {
+        .on_recv = on_recv,
+    };
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_disable(rx_handle));
+    esp_err_t ret = i2s_channel_register_event_callback(rx_handle, &cbs, user_ctx);
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_enable(rx_handle));
+    return ret;
+}
+
+// 清空I2S发送DMA队列：关闭通道后用静音预装全部DMA缓冲再重新开启，已排队的音频立即停止
+esp_err_t bsp_i2s_flush_tx(void)
+{
+    static const int16_t silence[DMA_BUF_LEN] = {0};
+    size_t loaded = 0;
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_disable(tx_handle));
+    do
+    {
+        loaded = 0;
+        if (i2s_channel_preload_data(tx_handle, silence, sizeof(silence), &loaded) != ESP_OK)
+        {
+            break;
+        }
+    } while (loaded == sizeof(silence));
+    BSP_ERROR_CHECK_RETURN_ERR(i2s_channel_enable(tx_handle));
+    return ESP_OK;
+}
 
 esp_err_t bsp_spiffs_mount(void)
 {
@@ -20,11 +20,17 @@
 #define SAMPLE_TX_RATE 24000
 #define DMA_BUF_COUNT 8
 #define DMA_BUF_LEN 1023
+// 采集DMA缓冲：每块为AFE一次feed（512个采样，32ms）的整数倍，接收完成后直接交给AFE
+#define DMA_RX_BUF_COUNT 8
+#define DMA_RX_BUF_LEN 512
 
 esp_err_t bsp_board_init();
 
 esp_err_t bsp_i2s_read(int16_t *buffer, int buffer_len);
 esp_err_t bsp_i2s_write(int16_t *buffer, int buffer_len);
+esp_err_t bsp_i2s_register_tx_callback(i2s_isr_callback_t on_sent, void *user_ctx);
+esp_err_t bsp_i2s_register_rx_callback(i2s_isr_callback_t on_recv, void *user_ctx);
+esp_err_t bsp_i2s_flush_tx(void);
 
 esp_err_t bsp_spiffs_mount(void);
 
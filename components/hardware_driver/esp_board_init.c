@@ -27,6 +27,21 @@ esp_err_t esp_i2s_write(int16_t *buffer, int buffer_len)
     return bsp_i2s_write(buffer, buffer_len);
 }
 
+esp_err_t esp_i2s_register_tx_callback(i2s_isr_callback_t on_sent, void *user_ctx)
+{
+    return bsp_i2s_register_tx_callback(on_sent, user_ctx);
+}
+
+esp_err_t esp_i2s_register_rx_callback(i2s_isr_callback_t on_recv, void *user_ctx)
+{
+    return bsp_i2s_register_rx_callback(on_recv, user_ctx);
+}
+
+esp_err_t esp_i2s_flush_tx(void)
+{
+    return bsp_i2s_flush_tx();
+}
+
 esp_err_t esp_board_init()
 {
     return bsp_board_init();
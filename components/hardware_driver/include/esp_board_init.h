@@ -8,6 +8,9 @@ esp_err_t esp_board_init();
 
 esp_err_t esp_i2s_read(int16_t *buffer, int buffer_len);
 esp_err_t esp_i2s_write(int16_t *buffer, int buffer_len);
+esp_err_t esp_i2s_register_tx_callback(i2s_isr_callback_t on_sent, void *user_ctx);
+esp_err_t esp_i2s_register_rx_callback(i2s_isr_callback_t on_recv, void *user_ctx);
+esp_err_t esp_i2s_flush_tx(void);
 
 esp_err_t esp_spiffs_mount();
 
@@ -273,6 +273,50 @@ static __inline int CLZ(int x)
 	return numZeros;
 }
 
+#elif defined(__GNUC__) && defined(__XTENSA__)
+
+/* portable C versions for ESP32 (Xtensa), compiler emits MULSH/NSAU */
+typedef long long Word64;
+
+static __inline int MULSHIFT32(int x, int y)
+{
+	return (int)(((Word64)x * y) >> 32);
+}
+
+static __inline int FASTABS(int x)
+{
+	int sign;
+
+	sign = x >> (sizeof(int) * 8 - 1);
+	x ^= sign;
+	x -= sign;
+
+	return x;
+}
+
+static __inline int CLZ(int x)
+{
+	if (!x)
+		return (sizeof(int) * 8);
+
+	return __builtin_clz((unsigned int)x);
+}
+
+static __inline Word64 MADD64(Word64 sum, int x, int y)
+{
+	return (sum + ((Word64)x * y));
+}
+
+static __inline Word64 SHL64(Word64 x, int n)
+{
+	return (n < 64) ? (Word64)((unsigned long long)x << n) : 0;
+}
+
+static __inline Word64 SAR64(Word64 x, int n)
+{
+	return (n < 64) ? (x >> n) : (x >> 63);
+}
+
 #else
 
 #error Unsupported platform in assembly.h
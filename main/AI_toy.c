@@ -19,20 +19,48 @@
 #include "app_aliyun_mqtt.h"
 #include "esp_board_init.h"
 #include "app_sr.h"
+#include "app_diag.h"
 #include "esp_spiffs.h"
 #include "audio.h"
+#include "cJSON.h"
 
 static const char *TAG = "main";
 
+/**
+ * @brief 服务器文本消息处理：回复的语音下发完毕（{"type":"tts","state":"stop"}）时结束本次流式播放，
+ * 缓冲中的包播放完即释放解码器，不必等待空闲超时
+ */
+static void ws_message_handler(const char *data, size_t len)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (root == NULL)
+    {
+        ESP_LOGW(TAG, "Invalid server message: %.*s", (int)len, data);
+        return;
+    }
+    const cJSON *type = cJSON_GetObjectItem(root, "type");
+    const cJSON *state = cJSON_GetObjectItem(root, "state");
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "tts") == 0 &&
+        cJSON_IsString(state) && strcmp(state->valuestring, "stop") == 0)
+    {
+        audio_stream_end();
+    }
+    cJSON_Delete(root);
+}
+
 void app_main(void)
 {
     ESP_ERROR_CHECK(nvs_flash_init());
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     esp_board_init();
+    app_sr_set_turn_hook(app_diag_log_turn);
     ESP_ERROR_CHECK(app_sr_start());
     wifi_init();
     app_sntp_init();
+    ESP_ERROR_CHECK(audio_stream_init());
+    ws_register_binary_stream_handler(audio_stream_push_chunk);
+    ws_register_recv_handler(ws_message_handler);
     ws_start("wss://192.168.3.72:8765");
     vTaskDelay(5000 / portTICK_PERIOD_MS);
     // audio_play("/spiffs/turn_on.opus", 70);
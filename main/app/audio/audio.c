@@ -5,6 +5,7 @@
 #include <string.h>
 #include "esp_board_init.h"
 #include "esp_log.h"
+#include "bsp_board.h"
 
 static const char *TAG = "audio";
 
@@ -13,19 +14,17 @@ static const char *TAG = "audio";
 // 配置参数：根据实际需求调整
 #define PLAYBACK_TIMEOUT_MS 5000 // 播放超时时间
 
-extern void decoder_ops_register(audio_decoder_t *decoder);
-
-// // 弱定义解码器注册函数，由具体解码器实现覆盖
-// __attribute__((weak)) void decoder_ops_register(audio_decoder_t *decoder)
-// {
-//     ESP_LOGE(TAG, "No decoder implementation registered!");
-// }
-
 /**
- * @brief 注册并初始化音频解码器
+ * @brief 构造指定编码格式的解码器并绑定其操作函数
  */
-static audio_decoder_t *audio_decoder_register(void)
+audio_decoder_t *audio_decoder_register(audio_codec_t codec)
 {
+    const audio_codec_desc_t *desc = audio_codec_find(codec);
+    if (!desc)
+    {
+        ESP_LOGE(TAG, "No decoder registered for codec %d", codec);
+        return NULL;
+    }
     audio_decoder_t *decoder = malloc(sizeof(audio_decoder_t));
     if (!decoder)
     {
@@ -34,7 +33,7 @@ static audio_decoder_t *audio_decoder_register(void)
     }
 
     memset(decoder, 0, sizeof(audio_decoder_t));
-    decoder_ops_register(decoder); // 绑定具体解码器实现
+    desc->ops_register(decoder); // 绑定具体解码器实现
 
     // 检查解码器接口完整性
     if (!decoder->init || !decoder->decode_frame || !decoder->deinit)
@@ -51,7 +50,7 @@ static audio_decoder_t *audio_decoder_register(void)
 /**
  * @brief 释放解码器资源
  */
-static void audio_decoder_deinit(audio_decoder_t *decoder)
+void audio_decoder_deinit(audio_decoder_t *decoder)
 {
     if (decoder)
     {
@@ -64,48 +63,67 @@ static void audio_decoder_deinit(audio_decoder_t *decoder)
 }
 
 /**
- * @brief 核心播放函数：读取SPiffs文件并通过I2S播放
+ * @brief 核心解码函数：读取SPiffs文件，按I2S输出格式解码并把PCM交给sink
+ * @param path: SPiffs中的文件路径
+ * @param sink: PCM接收函数（写入输出级或提示音缓存）
+ * @param arg: sink参数
  */
-static void aud_player_file(const char *path)
+esp_err_t audio_decode_file(const char *path, audio_pcm_sink_t sink, void *arg)
 {
-    if (!path)
+    if (!path || !sink)
     {
         ESP_LOGE(TAG, "Invalid parameters");
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
     audio_decoder_t *decoder = NULL;
-    FILE *file = NULL;
-    int16_t decode_buffer[960];
+    audio_source_t src = {0};
+    int16_t *decode_buffer = NULL;
     uint32_t samples_decoded = 0;
     bool playback_active = true;
-    // 1. 注册解码器
-    decoder = audio_decoder_register();
-    if (!decoder)
+    esp_err_t ret = ESP_OK;
+    audio_format_stage_t format_stage = {0};
+    const audio_codec_desc_t *desc = NULL;
+    // 1. 短文件（提示音）整体载入PSRAM，解码器直接在内存上解码；过大或内存不足时流式读取SPiffs文件
+    ret = audio_source_load_file(&src, path, AUDIO_SOURCE_LOAD_MAX_BYTES);
+    if (ret == ESP_ERR_INVALID_SIZE || ret == ESP_ERR_NO_MEM)
     {
-        ESP_LOGE(TAG, "Failed to register decoder");
-        return;
+        ret = audio_source_open_file(&src, path);
     }
-    // 2. 初始化解码器
-    if (decoder->init(decoder) != DECODER_OK)
+    if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Decoder initialization failed");
+        return ret;
+    }
+    // 2. 按文件开头的字节识别编码格式
+    desc = audio_codec_find(audio_codec_sniff(&src));
+    if (!desc)
+    {
+        ESP_LOGE(TAG, "Unsupported format: %s", path);
+        ret = ESP_ERR_NOT_SUPPORTED;
+        goto cleanup;
+    }
+    // 3. 从解码器池取出已复位的解码器，支持的格式直接解码为I2S输出格式
+    decoder = audio_decoder_acquire(desc->codec, SAMPLE_TX_RATE, 1);
+    if (!decoder)
+    {
+        ESP_LOGE(TAG, "Failed to acquire decoder");
+        ret = ESP_ERR_NO_MEM;
         goto cleanup;
     }
-    // 3. 打开SPiffs文件
-    file = fopen(path, "rb");
-    if (!file)
+    // 4. 解码缓冲按该格式单帧最大采样数一次分配
+    decode_buffer = malloc(desc->max_frame_samples * sizeof(int16_t));
+    if (!decode_buffer)
     {
-        ESP_LOGE(TAG, "Failed to open file: %s", path);
+        ret = ESP_ERR_NO_MEM;
         goto cleanup;
     }
-    ESP_LOGI(TAG, "Successfully opened file: %s", path);
+    ESP_LOGI(TAG, "Playing %s (%s)", path, desc->name);
 
     while (playback_active)
     {
         // 解码一帧音频
         decoder_result_t result = decoder->decode_frame(
             decoder,
-            file,
+            &src,
             decode_buffer,
             &samples_decoded);
 
@@ -114,14 +132,11 @@ static void aud_player_file(const char *path)
         case DECODER_OK:
             if (samples_decoded > 0)
             {
-                // 发送数据到I2S（注意：esp_i2s_write参数为字节数时需×2）
-                esp_err_t i2s_ret = esp_i2s_write(
-                    decode_buffer,
-                    samples_decoded * 2 // 此处假设函数参数为采样点数，若为字节数需×2
-                );
-                if (i2s_ret != ESP_OK)
+                // 非输出格式的数据经格式转换级混音/重采样后再交给sink
+                ret = audio_format_stage_write(&format_stage, &decoder->info, decode_buffer, samples_decoded, sink, arg);
+                if (ret != ESP_OK)
                 {
-                    ESP_LOGE(TAG, "I2S write failed: %d", i2s_ret);
+                    ESP_LOGE(TAG, "PCM sink failed: %d", ret);
                     playback_active = false;
                 }
             }
@@ -129,7 +144,7 @@ static void aud_player_file(const char *path)
 
         case DECODER_HEADER_ONLY:
             // 跳过头部信息
-            ESP_LOGI(TAG, "Skipping header data");
+            ESP_LOGD(TAG, "Skipping header data");
             break;
 
         case DECODER_EOF:
@@ -140,50 +155,76 @@ static void aud_player_file(const char *path)
         case DECODER_ERROR:
         default:
             // ESP_LOGE(TAG, "Decode error: %d", result);
+            ret = ESP_FAIL;
             playback_active = false;
             break;
         }
-        vTaskDelay(20 / portTICK_PERIOD_MS);
     }
 
 cleanup:
     // 释放资源
-    if (file != NULL)
-    {
-        fclose(file);
-    }
-    // esp_err_t i2s_ret = esp_i2s_write(
-    //     zero_buffer,
-    //     samples_decoded * 2 // 此处假设函数参数为采样点数，若为字节数需×2
-    // );
-    audio_decoder_deinit(decoder);
-    ESP_LOGI(TAG, "Playback finished");
+    audio_source_close(&src);
+    audio_format_stage_deinit(&format_stage);
+    free(decode_buffer);
+    audio_decoder_release(decoder);
+    return ret;
 }
 
 /**
- * @brief 设置音量（通过设备控制接口）
+ * @brief 设置主音量，作用于语音流与提示音的混音输出
+ * @param volume: 0~100
  */
+void audio_set_volume(uint8_t volume)
+{
+    audio_mixer_set_master(volume);
+}
 
 /**
- * @brief 启动音频播放
- * @param dev: 音频设备结构体
+ * @brief 播放提示音（提示音流，播放期间语音流自动压低）
+ * 以普通优先级提交到播放队列，打断正在播放的普通提示音，不等待播放完成
  * @param src: SPiffs中的文件路径
- * @param volume: 播放音量
+ * @param volume: 播放音量（0~100），由混音级按增益平滑过渡
  */
-void audio_task(void *pvParameters)
+void audio_play(const void *src, uint8_t volume)
 {
-    while (1)
+    if (audio_player_play((const char *)src, volume, AUDIO_PRIORITY_NORMAL) != ESP_OK)
     {
-        // 启动播放
-        aud_player_file("/spiffs/turn_on.opus");
-        vTaskDelay(pdMS_TO_TICKS(10));
+        ESP_LOGE(TAG, "Failed to queue %s", (const char *)src);
     }
 }
 
-TaskHandle_t audio_task_handle = NULL;
+/**
+ * @brief 打断播放（用户插话）：取消提示音队列与下行语音流，清空输出级和I2S DMA队列
+ * @param detect_us: 检测到插话的时刻（esp_timer），用于统计到扬声器静音的延迟
+ */
+void audio_barge_in(int64_t detect_us)
+{
+    audio_player_flush();
+    audio_player_cancel();
+    audio_stream_cancel();
+    audio_output_silence(detect_us);
+}
+
+/**
+ * @brief 扬声器是否正在播放提示音或语音
+ */
+bool audio_is_playing(void)
+{
+    return audio_output_is_active();
+}
 
 void audio_init()
 {
-    BaseType_t ret_val = xTaskCreatePinnedToCore(audio_task, "audio_task", 10 * 1024, NULL, 3, &audio_task_handle, 1);
-    // ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create audio task");
+    ESP_ERROR_CHECK(audio_output_init(AUDIO_DECODE_AHEAD_MS));
+    ESP_ERROR_CHECK(audio_decoder_pool_init());
+#if AUDIO_DECODER_POOL_BENCHMARK
+    audio_decoder_pool_benchmark();
+#endif
+#if AUDIO_RESAMPLER_BENCHMARK
+    audio_resampler_benchmark();
+#endif
+    ESP_ERROR_CHECK(audio_prompt_cache_init(AUDIO_PROMPT_CACHE_BUDGET));
+    audio_prompt_cache_warm(AUDIO_PROMPT_MANIFEST);
+    ESP_ERROR_CHECK(audio_player_init());
+    audio_player_enqueue("/spiffs/turn_on.opus", 100, AUDIO_PRIORITY_SYSTEM);
 }
\ No newline at end of file
@@ -3,12 +3,104 @@
 
 #include "stdint.h"
 #include <stdbool.h>
+#include "esp_err.h"
 #include "audio_private.h"
 
+// 播放请求优先级：高优先级请求排在低优先级之前，并打断正在播放的低优先级项
+typedef enum {
+    AUDIO_PRIORITY_NORMAL = 0, // 普通提示音
+    AUDIO_PRIORITY_SYSTEM,     // 系统提示音（开关机、网络状态等）
+} audio_priority_t;
+
+// 播放队列统计
+typedef struct {
+    uint32_t queue_depth;          // 当前排队项数
+    uint32_t queue_depth_max;      // 排队项数峰值
+    uint32_t items_played;         // 完整播放的项数
+    uint32_t items_cancelled;      // 被取消或打断的项数
+    uint32_t start_latency_us;     // 最近一项从请求到首个采样写入输出级的时长
+    uint32_t start_latency_max_us;
+    uint32_t gap_us;               // 最近一次连续衔接时输出级断流的时长（0为无缝）
+    uint32_t gap_max_us;
+    uint32_t gapless_transitions;  // 无缝衔接的次数
+} audio_player_stats_t;
+
+// 提示音缓存统计
+typedef struct {
+    uint32_t hits;         // 直接从缓存播放的次数
+    uint32_t misses;       // 需要解码文件的次数
+    uint32_t evictions;    // 按LRU淘汰的条目数
+    uint32_t uncached;     // 解码成功但未能存入缓存的次数
+    uint32_t used_bytes;   // 已缓存PCM占用的PSRAM字节数
+    uint32_t budget_bytes; // PSRAM字节预算
+} audio_prompt_cache_stats_t;
+
 // 公共函数声明
 void audio_set_volume(uint8_t volume);
 void audio_play(const void *src, uint8_t volume);
-void decoder_ops_register(audio_decoder_t *decoder);
 void audio_init(void);
 
+// 播放队列：依次播放SPiffs中的提示音文件，前一项播完时下一项已预先打开并解码，衔接无间隙
+esp_err_t audio_player_play(const char *path, uint8_t volume, audio_priority_t priority);
+esp_err_t audio_player_enqueue(const char *path, uint8_t volume, audio_priority_t priority);
+void audio_player_cancel(void);
+void audio_player_flush(void);
+void audio_player_get_stats(audio_player_stats_t *stats);
+void audio_prompt_cache_get_stats(audio_prompt_cache_stats_t *stats);
+
+// 流式播放统计
+typedef struct {
+    uint32_t packets;      // 已解码的包数
+    uint32_t lost;         // 丢失或损坏的包数
+    uint32_t late;         // 对应时段已补偿后才到达、被丢弃的包数
+    uint32_t fec_frames;   // 用后一包的带内FEC恢复的帧数
+    uint32_t plc_frames;   // 用PLC补偿的帧数
+    uint32_t dropped;      // 抖动缓冲满时丢弃的包数
+} audio_stream_stats_t;
+
+// 流式播放：WebSocket下行的Opus裸包直接进入抖动缓冲并解码播放
+esp_err_t audio_stream_init(void);
+void audio_stream_push(const uint8_t *data, size_t len);
+void audio_stream_push_chunk(const uint8_t *data, size_t len, size_t offset, bool fin);
+void audio_stream_end(void);
+void audio_stream_cancel(void);
+void audio_stream_get_stats(audio_stream_stats_t *stats);
+
+// 解码器池统计
+typedef struct {
+    uint32_t acquired;    // 取用次数
+    uint32_t matched;     // 复用格式一致的解码器的次数（免去重建编解码器实例）
+    uint32_t rewound;     // 复用同类型但格式不同的解码器的次数
+    uint32_t constructed; // 在空槽位上构造解码器的次数
+    uint32_t transient;   // 没有可用槽位、临时构造的次数
+    uint32_t in_use;      // 当前被占用的槽位数
+} audio_decoder_pool_stats_t;
+
+void audio_decoder_pool_get_stats(audio_decoder_pool_stats_t *stats);
+
+// 打断播放统计
+typedef struct {
+    uint32_t count;          // 打断次数
+    uint32_t latency_us;     // 最近一次从触发到扬声器静音的延迟
+    uint32_t latency_max_us;
+} audio_barge_in_stats_t;
+
+// 打断播放：取消提示音与下行语音流，清空输出级与I2S DMA队列
+void audio_barge_in(int64_t detect_us);
+bool audio_is_playing(void);
+void audio_barge_in_get_stats(audio_barge_in_stats_t *stats);
+
+// 回声消除参考信号统计
+typedef struct {
+    uint32_t delay_us;        // 当前补偿的回声路径延时（在播放时刻估计之外）
+    uint32_t correlation_pct; // 最近一次延时估计的归一化互相关（%）
+    uint32_t estimates;       // 延时估计次数
+    uint32_t adjustments;     // 延时补偿被修正的次数
+} audio_reference_stats_t;
+
+// 回声消除参考信号：取与麦克风采样对齐的扬声器输出（16kHz），作为AFE的参考通道
+// capture_us为这块麦克风采样中最后一个采样的采集时刻（esp_timer）
+void audio_reference_read(const int16_t *mic, int16_t *ref, uint32_t samples, int64_t capture_us);
+void audio_reference_get_stats(audio_reference_stats_t *stats);
+
 #endif /* __AUDIO_H__ */
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+
+static const char *TAG = "audio_codec";
+
+static const audio_codec_desc_t *codec_table[AUDIO_CODEC_MAX];
+static bool codecs_inited = false;
+
+/**
+ * @brief 注册一个编解码器（由各解码器端口的注册函数调用）
+ */
+esp_err_t audio_codec_register(const audio_codec_desc_t *desc)
+{
+    if (!desc || desc->codec >= AUDIO_CODEC_MAX || !desc->ops_register)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    codec_table[desc->codec] = desc;
+    ESP_LOGI(TAG, "Codec registered: %s (chunk %lu bytes, max %lu samples/frame)",
+             desc->name, desc->input_chunk, desc->max_frame_samples);
+    return ESP_OK;
+}
+
+/**
+ * @brief 注册固件中编译进来的全部解码器
+ * 各端口通过显式调用注册，而不是依赖构造函数属性：main组件以静态库链接，
+ * 只被构造函数引用的目标文件会被链接器丢弃
+ */
+void audio_codecs_init(void)
+{
+    if (codecs_inited)
+    {
+        return;
+    }
+    codecs_inited = true;
+    opus_decoder_port_register();
+#if CONFIG_USE_HELIX_MP3
+    mp3_decoder_port_register();
+#endif
+    pcm_decoder_port_register();
+}
+
+const audio_codec_desc_t *audio_codec_find(audio_codec_t codec)
+{
+    if (codec >= AUDIO_CODEC_MAX)
+    {
+        return NULL;
+    }
+    return codec_table[codec];
+}
+
+/**
+ * @brief 根据数据开头的字节（OggS、ID3/帧同步字、RIFF）识别编码格式，不消费数据
+ */
+audio_codec_t audio_codec_sniff(audio_source_t *src)
+{
+    uint8_t head[AUDIO_CODEC_PROBE_BYTES];
+    int len = src->peek(src, head, sizeof(head));
+    if (len <= 0)
+    {
+        return AUDIO_CODEC_UNKNOWN;
+    }
+    for (int i = 0; i < AUDIO_CODEC_MAX; i++)
+    {
+        if (codec_table[i] && codec_table[i]->probe && codec_table[i]->probe(head, len))
+        {
+            ESP_LOGD(TAG, "Detected %s", codec_table[i]->name);
+            return (audio_codec_t)i;
+        }
+    }
+    ESP_LOGW(TAG, "Unknown format: %02x %02x %02x %02x", head[0], len > 1 ? head[1] : 0, len > 2 ? head[2] : 0, len > 3 ? head[3] : 0);
+    return AUDIO_CODEC_UNKNOWN;
+}
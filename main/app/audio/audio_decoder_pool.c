@@ -0,0 +1,295 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "bsp_board.h"
+
+static const char *TAG = "decoder_pool";
+
+// 池中的一个解码器
+typedef struct {
+    audio_decoder_t *decoder;
+    audio_codec_t codec;
+    uint32_t sample_rate; // 上次使用时的输出格式，作为复用的匹配键
+    uint8_t channels;
+    bool in_use;
+} pool_entry_t;
+
+static pool_entry_t pool[AUDIO_DECODER_POOL_SIZE];
+static audio_decoder_pool_stats_t pool_stats; // 与槽位状态一样在pool_lock内更新
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool pool_inited = false;
+
+/**
+ * @brief 构造一个指定格式的解码器（分配上下文并按输出格式预建编解码器实例）
+ */
+static audio_decoder_t *decoder_construct(audio_codec_t codec, uint32_t sample_rate, uint8_t channels)
+{
+    audio_decoder_t *decoder = audio_decoder_register(codec);
+    if (!decoder)
+    {
+        return NULL;
+    }
+    if (decoder->init(decoder) != DECODER_OK)
+    {
+        ESP_LOGE(TAG, "Decoder initialization failed");
+        audio_decoder_deinit(decoder);
+        return NULL;
+    }
+    decoder->info.sample_rate = sample_rate;
+    decoder->info.channels = channels;
+    if (decoder->reset && decoder->reset(decoder) != DECODER_OK)
+    {
+        audio_decoder_deinit(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+/**
+ * @brief 复位池中的解码器为指定格式
+ */
+static bool decoder_rewind(audio_decoder_t *decoder, uint32_t sample_rate, uint8_t channels)
+{
+    if (!decoder->reset)
+    {
+        return false;
+    }
+    decoder->info.sample_rate = sample_rate;
+    decoder->info.channels = channels;
+    return decoder->reset(decoder) == DECODER_OK;
+}
+
+/**
+ * @brief 预先构造Opus解码器：提示音文件播放与下行流式播放各一个，其余槽位留给MP3/PCM按需入池
+ */
+esp_err_t audio_decoder_pool_init(void)
+{
+    if (pool_inited)
+    {
+        return ESP_OK;
+    }
+    audio_codecs_init();
+
+    const struct {
+        uint32_t sample_rate;
+        uint8_t channels;
+    } warm_formats[] = {
+        {SAMPLE_TX_RATE, 1}, // 提示音文件
+        {SAMPLE_TX_RATE, 1}, // 下行流
+    };
+
+    for (int i = 0; i < AUDIO_DECODER_POOL_SIZE && i < sizeof(warm_formats) / sizeof(warm_formats[0]); i++)
+    {
+        if (pool[i].decoder)
+        {
+            continue;
+        }
+        pool[i].decoder = decoder_construct(AUDIO_CODEC_OPUS, warm_formats[i].sample_rate, warm_formats[i].channels);
+        if (!pool[i].decoder)
+        {
+            ESP_LOGE(TAG, "Failed to construct pooled decoder %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+        pool[i].codec = AUDIO_CODEC_OPUS;
+        pool[i].sample_rate = warm_formats[i].sample_rate;
+        pool[i].channels = warm_formats[i].channels;
+        pool[i].in_use = false;
+    }
+    pool_inited = true;
+    ESP_LOGI(TAG, "Decoder pool ready, %d entries", AUDIO_DECODER_POOL_SIZE);
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取一个已复位的解码器
+ * 选择顺序：格式一致的同类型空闲解码器 > 同类型空闲解码器 > 尚未构造解码器的空槽位。
+ * 前两种都只调用reset：reset按decoder->info中的新格式工作，格式变化时由端口自行重建编解码器实例
+ * （如Opus按新采样率/声道数重建OpusDecoder），格式一致的槽位可免去这次重建；
+ * 空槽位由首次使用的编解码类型占用（MP3/PCM提示音按需入池），没有可用槽位时临时构造一个，release时释放
+ */
+audio_decoder_t *audio_decoder_acquire(audio_codec_t codec, uint32_t sample_rate, uint8_t channels)
+{
+    int slot = -1;
+    int best = 0;
+
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; i < AUDIO_DECODER_POOL_SIZE; i++)
+    {
+        int score = 0;
+        if (pool[i].in_use)
+        {
+            continue;
+        }
+        if (!pool[i].decoder)
+        {
+            score = 1;
+        }
+        else if (pool[i].codec == codec)
+        {
+            score = pool[i].sample_rate == sample_rate && pool[i].channels == channels ? 3 : 2;
+        }
+        if (score > best)
+        {
+            best = score;
+            slot = i;
+        }
+    }
+    pool_stats.acquired++;
+    if (slot >= 0)
+    {
+        pool[slot].in_use = true;
+        pool_stats.in_use++;
+        if (best == 3)
+        {
+            pool_stats.matched++;
+        }
+        else if (best == 2)
+        {
+            pool_stats.rewound++;
+        }
+        else
+        {
+            pool_stats.constructed++;
+        }
+    }
+    else
+    {
+        pool_stats.transient++;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+
+    if (slot < 0)
+    {
+        ESP_LOGW(TAG, "No pooled decoder for codec %d, constructing transient decoder", codec);
+        return decoder_construct(codec, sample_rate, channels);
+    }
+
+    pool_entry_t *entry = &pool[slot];
+    if (entry->decoder && !decoder_rewind(entry->decoder, sample_rate, channels))
+    {
+        audio_decoder_deinit(entry->decoder);
+        entry->decoder = NULL;
+    }
+    if (!entry->decoder)
+    {
+        entry->decoder = decoder_construct(codec, sample_rate, channels);
+    }
+    if (!entry->decoder)
+    {
+        portENTER_CRITICAL(&pool_lock);
+        entry->in_use = false;
+        pool_stats.in_use--;
+        portEXIT_CRITICAL(&pool_lock);
+        return NULL;
+    }
+    entry->codec = codec;
+    entry->sample_rate = sample_rate;
+    entry->channels = channels;
+    return entry->decoder;
+}
+
+/**
+ * @brief 归还解码器；以解码器最终的输出格式（可能被文件头修改）作为下次复用的匹配键
+ */
+void audio_decoder_release(audio_decoder_t *decoder)
+{
+    if (!decoder)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; i < AUDIO_DECODER_POOL_SIZE; i++)
+    {
+        if (pool[i].decoder == decoder)
+        {
+            pool[i].sample_rate = decoder->info.sample_rate;
+            pool[i].channels = decoder->info.channels;
+            pool[i].in_use = false;
+            pool_stats.in_use--;
+            portEXIT_CRITICAL(&pool_lock);
+            return;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    // 不属于池的临时解码器
+    audio_decoder_deinit(decoder);
+}
+
+void audio_decoder_pool_get_stats(audio_decoder_pool_stats_t *stats)
+{
+    portENTER_CRITICAL(&pool_lock);
+    *stats = pool_stats;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+/**
+ * @brief 对比冷启动（每次构造/释放）与池复用（复位）的耗时与堆占用
+ */
+void audio_decoder_pool_benchmark(void)
+{
+    const int rounds = 20;
+    const uint32_t sample_rate = SAMPLE_TX_RATE;
+    const uint8_t channels = 1;
+
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    size_t cold_min_heap = heap_before;
+    int64_t cold_max_us = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < rounds; i++)
+    {
+        int64_t t0 = esp_timer_get_time();
+        audio_decoder_t *decoder = decoder_construct(AUDIO_CODEC_OPUS, sample_rate, channels);
+        int64_t elapsed = esp_timer_get_time() - t0;
+        if (!decoder)
+        {
+            ESP_LOGE(TAG, "Benchmark construct failed");
+            return;
+        }
+        size_t free_now = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        if (free_now < cold_min_heap)
+        {
+            cold_min_heap = free_now;
+        }
+        audio_decoder_deinit(decoder);
+        if (elapsed > cold_max_us)
+        {
+            cold_max_us = elapsed;
+        }
+    }
+    int64_t cold_avg_us = (esp_timer_get_time() - start) / rounds;
+
+    size_t warm_min_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    size_t warm_heap_before = warm_min_heap;
+    int64_t warm_max_us = 0;
+    start = esp_timer_get_time();
+    for (int i = 0; i < rounds; i++)
+    {
+        int64_t t0 = esp_timer_get_time();
+        audio_decoder_t *decoder = audio_decoder_acquire(AUDIO_CODEC_OPUS, sample_rate, channels);
+        int64_t elapsed = esp_timer_get_time() - t0;
+        if (!decoder)
+        {
+            ESP_LOGE(TAG, "Benchmark acquire failed");
+            return;
+        }
+        size_t free_now = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        if (free_now < warm_min_heap)
+        {
+            warm_min_heap = free_now;
+        }
+        audio_decoder_release(decoder);
+        if (elapsed > warm_max_us)
+        {
+            warm_max_us = elapsed;
+        }
+    }
+    int64_t warm_avg_us = (esp_timer_get_time() - start) / rounds;
+
+    ESP_LOGI(TAG, "Cold start: avg %lld us, max %lld us, peak heap %d bytes",
+             cold_avg_us, cold_max_us, (int)(heap_before - cold_min_heap));
+    ESP_LOGI(TAG, "Pooled:     avg %lld us, max %lld us, peak heap %d bytes",
+             warm_avg_us, warm_max_us, (int)(warm_heap_before - warm_min_heap));
+}
@@ -0,0 +1,260 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "dsps_mulc.h"
+#include "bsp_board.h"
+
+static const char *TAG = "audio_mixer";
+
+// 满音量对应的Q15增益
+#define MIXER_UNITY_GAIN 32767
+
+// 每路输入的增益状态
+typedef struct {
+    volatile uint8_t volume; // 用户设置的音量（0~100），由其他任务写入
+    int16_t gain;            // 当前实际增益（Q15），仅输出任务访问
+} mixer_stream_t;
+
+static mixer_stream_t streams[AUDIO_MIX_STREAMS];
+static volatile uint8_t master_volume = 100;
+static bool mixer_use_dsp = false; // 自检通过后使用esp-dsp的定增益缩放
+
+// 混音中间结果（仅输出任务及初始化自检使用）
+static int32_t mix_acc[AUDIO_MIXER_MAX_BLOCK];
+static int16_t mix_scaled[AUDIO_MIXER_MAX_BLOCK];
+
+static int16_t volume_to_q15(uint8_t volume)
+{
+    if (volume >= 100)
+    {
+        return MIXER_UNITY_GAIN;
+    }
+    return (int16_t)((int32_t)volume * MIXER_UNITY_GAIN / 100);
+}
+
+static inline int16_t mixer_saturate(int32_t value)
+{
+    if (value > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+/**
+ * @brief 按线性过渡的增益把一路输入累加到acc
+ * 增益以Q16定点步进，第i个采样的增益为g0 + (g1 - g0) * i / n（向下取整）
+ */
+static void mixer_accumulate_ramp(int32_t *acc, const int16_t *in, int16_t g0, int16_t g1, uint32_t n)
+{
+    int32_t gain_q16 = (int32_t)g0 * 65536;
+    int32_t step = (int32_t)((int64_t)(g1 - g0) * 65536 / (int32_t)n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int32_t gain = gain_q16 >> 16;
+        acc[i] += ((int32_t)in[i] * gain) >> 15;
+        gain_q16 += step;
+    }
+}
+
+/**
+ * @brief 标量参考实现：逐采样乘增益、累加并饱和
+ * @param gain_start: 每路在块首的增益（Q15）
+ * @param gain_end: 每路在块尾之后的增益（Q15），与gain_start相同时为定增益
+ */
+void audio_mixer_mix_ref(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS],
+                         const int16_t *gain_start, const int16_t *gain_end, uint32_t samples)
+{
+    memset(mix_acc, 0, samples * sizeof(int32_t));
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        if (inputs[s])
+        {
+            mixer_accumulate_ramp(mix_acc, inputs[s], gain_start[s], gain_end[s], samples);
+        }
+    }
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        out[i] = mixer_saturate(mix_acc[i]);
+    }
+}
+
+/**
+ * @brief 混音实现：定增益的输入用esp-dsp向量化缩放（ESP32-S3上走PIE指令），
+ * 过渡中的输入走标量路径，结果与audio_mixer_mix_ref逐位一致
+ */
+void audio_mixer_mix(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS],
+                     const int16_t *gain_start, const int16_t *gain_end, uint32_t samples)
+{
+    memset(mix_acc, 0, samples * sizeof(int32_t));
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        if (!inputs[s])
+        {
+            continue;
+        }
+        if (gain_start[s] != gain_end[s] || !mixer_use_dsp)
+        {
+            mixer_accumulate_ramp(mix_acc, inputs[s], gain_start[s], gain_end[s], samples);
+            continue;
+        }
+        if (gain_start[s] == 0)
+        {
+            continue;
+        }
+        // (x * g) >> 15，与标量路径的截断方式相同
+        dsps_mulc_s16(inputs[s], mix_scaled, samples, gain_start[s], 1, 1);
+        for (uint32_t i = 0; i < samples; i++)
+        {
+            mix_acc[i] += mix_scaled[i];
+        }
+    }
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        out[i] = mixer_saturate(mix_acc[i]);
+    }
+}
+
+/**
+ * @brief 计算某路本块的目标增益：用户音量 × 主音量 × 闪避增益
+ */
+static int16_t mixer_target_gain(int s, bool duck)
+{
+    int32_t gain = volume_to_q15(streams[s].volume);
+    gain = (gain * volume_to_q15(master_volume)) >> 15;
+    if (duck)
+    {
+        gain = (gain * AUDIO_MIXER_DUCK_GAIN) >> 15;
+    }
+    return (int16_t)gain;
+}
+
+/**
+ * @brief 混音一个输出块并推进各路增益
+ * 增益每采样最多变化满幅的1/AUDIO_MIXER_RAMP_SAMPLES，跨块连续过渡；
+ * 提示音流有数据时语音流的目标增益乘以AUDIO_MIXER_DUCK_GAIN
+ * @param inputs: 各路本块的PCM，NULL表示该路本块无数据
+ */
+void audio_mixer_process(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS], uint32_t samples)
+{
+    int16_t gain_start[AUDIO_MIX_STREAMS];
+    int16_t gain_end[AUDIO_MIX_STREAMS];
+    int32_t max_delta = (int32_t)((int64_t)MIXER_UNITY_GAIN * samples / AUDIO_MIXER_RAMP_SAMPLES);
+    bool earcon_active = inputs[AUDIO_MIX_EARCON] != NULL;
+
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        int32_t target = mixer_target_gain(s, s == AUDIO_MIX_SPEECH && earcon_active);
+        int32_t current = streams[s].gain;
+        int32_t delta = target - current;
+        if (delta > max_delta)
+        {
+            delta = max_delta;
+        }
+        else if (delta < -max_delta)
+        {
+            delta = -max_delta;
+        }
+        gain_start[s] = (int16_t)current;
+        gain_end[s] = (int16_t)(current + delta);
+        streams[s].gain = gain_end[s];
+    }
+    audio_mixer_mix(out, inputs, gain_start, gain_end, samples);
+}
+
+/**
+ * @brief 用伪随机输入（含满幅以触发饱和）对比向量化路径与标量参考实现
+ * @return 逐位一致返回true
+ */
+bool audio_mixer_selftest(void)
+{
+    static int16_t input[AUDIO_MIX_STREAMS][AUDIO_MIXER_MAX_BLOCK];
+    static int16_t out_ref[AUDIO_MIXER_MAX_BLOCK];
+    static int16_t out_mix[AUDIO_MIXER_MAX_BLOCK];
+    const int16_t *inputs[AUDIO_MIX_STREAMS];
+    const int16_t gains[] = {0, 1, 8192, 16384, 32767, 20000};
+    const int gain_count = sizeof(gains) / sizeof(gains[0]);
+    const uint32_t lengths[] = {1, 7, 8, 64, 255, AUDIO_MIXER_MAX_BLOCK};
+    uint32_t seed = 0x12345678;
+
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        for (int i = 0; i < AUDIO_MIXER_MAX_BLOCK; i++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            input[s][i] = (i & 63) == 0 ? INT16_MIN : (i & 63) == 1 ? INT16_MAX : (int16_t)(seed >> 16);
+        }
+        inputs[s] = input[s];
+    }
+
+    bool use_dsp = mixer_use_dsp;
+    mixer_use_dsp = true;
+    bool pass = true;
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]) && pass; l++)
+    {
+        for (int g = 0; g < gain_count * gain_count && pass; g++)
+        {
+            int16_t gain_start[AUDIO_MIX_STREAMS];
+            int16_t gain_end[AUDIO_MIX_STREAMS];
+            for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+            {
+                // 第0路定增益，其余路在两档增益之间过渡
+                gain_start[s] = gains[(g + s) % gain_count];
+                gain_end[s] = s == 0 ? gain_start[s] : gains[(g / gain_count + s) % gain_count];
+            }
+            audio_mixer_mix_ref(out_ref, inputs, gain_start, gain_end, lengths[l]);
+            audio_mixer_mix(out_mix, inputs, gain_start, gain_end, lengths[l]);
+            if (memcmp(out_ref, out_mix, lengths[l] * sizeof(int16_t)) != 0)
+            {
+                ESP_LOGE(TAG, "Mismatch: %lu samples, gains %d->%d", lengths[l], gain_start[0], gain_end[0]);
+                pass = false;
+            }
+        }
+    }
+    mixer_use_dsp = use_dsp;
+    return pass;
+}
+
+/**
+ * @brief 初始化混音级：所有输入流满音量；自检通过后启用esp-dsp路径
+ */
+void audio_mixer_init(void)
+{
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        streams[s].volume = 100;
+        streams[s].gain = MIXER_UNITY_GAIN;
+    }
+#if AUDIO_MIXER_SELFTEST
+    mixer_use_dsp = audio_mixer_selftest();
+    ESP_LOGI(TAG, "Self test %s, %s path", mixer_use_dsp ? "passed" : "failed", mixer_use_dsp ? "esp-dsp" : "scalar");
+#else
+    mixer_use_dsp = true;
+#endif
+}
+
+/**
+ * @brief 设置主音量，作用于所有输入流
+ * @param volume: 0~100
+ */
+void audio_mixer_set_master(uint8_t volume)
+{
+    master_volume = volume > 100 ? 100 : volume;
+}
+
+/**
+ * @brief 设置某一路输入流的音量，在后续混音块中平滑过渡到新增益
+ * @param volume: 0~100
+ */
+void audio_mixer_set_volume(audio_mix_stream_t stream, uint8_t volume)
+{
+    if (stream >= AUDIO_MIX_STREAMS)
+    {
+        return;
+    }
+    streams[stream].volume = volume > 100 ? 100 : volume;
+}
@@ -0,0 +1,430 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "esp_board_init.h"
+#include "bsp_board.h"
+
+static const char *TAG = "audio_output";
+
+// 一个DMA缓冲对应的字节数（单声道16bit）
+#define OUTPUT_BLOCK_BYTES (DMA_BUF_LEN * sizeof(int16_t))
+// 一个DMA缓冲对应的播放时长（毫秒，向上取整）
+#define OUTPUT_BLOCK_MS ((DMA_BUF_LEN * 1000 + SAMPLE_TX_RATE - 1) / SAMPLE_TX_RATE)
+// 一个DMA缓冲对应的播放时长（微秒）
+#define OUTPUT_BLOCK_US ((int64_t)DMA_BUF_LEN * 1000000 / SAMPLE_TX_RATE)
+
+static RingbufHandle_t pcm_rings[AUDIO_MIX_STREAMS]; // 各输入流与输出级之间的PCM环形缓冲
+static uint8_t *stream_blocks[AUDIO_MIX_STREAMS];    // 输出任务从各输入流取出的一块PCM（内部RAM）
+static int16_t *mixed_block = NULL;                  // 混音结果，整块写入I2S
+static SemaphoreHandle_t dma_credit = NULL;  // 空闲DMA缓冲计数，由on_sent中断归还
+static TaskHandle_t output_task_handle = NULL;
+static uint32_t underrun_count = 0;          // 输出时PCM不足一个DMA缓冲的次数
+static volatile int64_t last_sent_us = 0;    // 最近一个DMA缓冲发送完成的时刻
+static int64_t last_active_us = 0;           // 最近一次写入非空混音块的时刻
+
+// 立即静音请求（打断播放时由其他任务发起，输出任务执行）
+static portMUX_TYPE silence_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool silence_requested = false;
+static int64_t silence_request_us = 0;
+static audio_barge_in_stats_t silence_stats;
+
+// 清空输入流请求（由其他任务发起，输出任务执行）：BYTEBUF同一时刻只能有一个未归还的读取，只能由输出任务读取
+static uint32_t flush_requested = 0;                  // 请求清空的输入流位掩码，受silence_lock保护
+static uint32_t flush_mark[AUDIO_MIX_STREAMS];        // 请求时该流累计写入的字节数，只丢弃此前写入的PCM
+static uint32_t stream_written[AUDIO_MIX_STREAMS];    // 各流累计写入字节数，受silence_lock保护
+static uint32_t stream_read[AUDIO_MIX_STREAMS];       // 各流累计取走字节数（仅输出任务访问）
+
+/**
+ * @brief I2S发送完成中断：每播完一个DMA缓冲归还一个写入额度
+ */
+static IRAM_ATTR bool audio_output_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    BaseType_t need_yield = pdFALSE;
+    last_sent_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(dma_credit, &need_yield);
+    return need_yield == pdTRUE;
+}
+
+/**
+ * @brief 从一路输入的环形缓冲取一个DMA缓冲的PCM，不足部分补零
+ * @param deadline: 已开始填充本块后最多等待到的时刻
+ * @return 实际取到的PCM字节数
+ */
+static size_t output_fill_stream(audio_mix_stream_t stream, uint8_t *block, TickType_t deadline)
+{
+    RingbufHandle_t ring = pcm_rings[stream];
+    size_t filled = 0;
+    TickType_t wait = 0; // 本块尚无数据时不等待，避免空闲的输入流拖住其他流
+    while (filled < OUTPUT_BLOCK_BYTES)
+    {
+        size_t item_size = 0;
+        uint8_t *item = xRingbufferReceiveUpTo(ring, &item_size, wait, OUTPUT_BLOCK_BYTES - filled);
+        if (!item)
+        {
+            break;
+        }
+        memcpy(block + filled, item, item_size);
+        vRingbufferReturnItem(ring, item);
+        filled += item_size;
+        stream_read[stream] += item_size;
+        // 已开始填充本块，最多等待到deadline（一个DMA缓冲的时长）
+        int32_t remaining = (int32_t)(deadline - xTaskGetTickCount());
+        wait = remaining > 0 ? (TickType_t)remaining : 0;
+    }
+    if (filled < OUTPUT_BLOCK_BYTES)
+    {
+        memset(block + filled, 0, OUTPUT_BLOCK_BYTES - filled);
+    }
+    return filled;
+}
+
+/**
+ * @brief 执行清空请求：丢弃各输入流中请求时刻之前写入、尚未取走的PCM
+ */
+static void output_handle_flush(void)
+{
+    uint32_t marks[AUDIO_MIX_STREAMS];
+    portENTER_CRITICAL(&silence_lock);
+    uint32_t requested = flush_requested;
+    flush_requested = 0;
+    memcpy(marks, flush_mark, sizeof(marks));
+    portEXIT_CRITICAL(&silence_lock);
+
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        if (!(requested & (1u << s)))
+        {
+            continue;
+        }
+        while ((int32_t)(marks[s] - stream_read[s]) > 0)
+        {
+            size_t item_size = 0;
+            void *item = xRingbufferReceiveUpTo(pcm_rings[s], &item_size, 0, marks[s] - stream_read[s]);
+            if (!item)
+            {
+                break;
+            }
+            vRingbufferReturnItem(pcm_rings[s], item);
+            stream_read[s] += item_size;
+        }
+    }
+}
+
+/**
+ * @brief 执行静音请求：丢弃各输入流中的PCM，用静音重新装满I2S DMA队列，并统计从请求到静音的延迟
+ * @return 有静音请求时返回true
+ */
+static bool output_handle_silence(void)
+{
+    portENTER_CRITICAL(&silence_lock);
+    bool requested = silence_requested;
+    int64_t request_us = silence_request_us;
+    silence_requested = false;
+    portEXIT_CRITICAL(&silence_lock);
+    if (!requested)
+    {
+        return false;
+    }
+
+    // audio_output_silence已为各输入流登记清空请求
+    output_handle_flush();
+    if (esp_i2s_flush_tx() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "I2S flush failed");
+    }
+    int64_t now = esp_timer_get_time();
+    // DMA中已排队的音频不再播放，参考信号同步截断
+    audio_reference_cut(now);
+
+    uint32_t latency = (uint32_t)(now - request_us);
+    portENTER_CRITICAL(&silence_lock);
+    silence_stats.count++;
+    silence_stats.latency_us = latency;
+    if (latency > silence_stats.latency_max_us)
+    {
+        silence_stats.latency_max_us = latency;
+    }
+    last_active_us = 0;
+    portEXIT_CRITICAL(&silence_lock);
+    ESP_LOGI(TAG, "Output silenced, %lu us after request", latency);
+    return true;
+}
+
+/**
+ * @brief 输出任务：从各输入流各取一块PCM混音，每拿到一个空闲DMA缓冲额度写入一整块
+ */
+static void audio_output_task(void *pvParameters)
+{
+    uint8_t **blocks = stream_blocks;
+    int16_t *mixed = mixed_block;
+
+    while (1)
+    {
+        const int16_t *inputs[AUDIO_MIX_STREAMS];
+        bool any_input = false;
+        if (output_handle_silence())
+        {
+            continue;
+        }
+        output_handle_flush();
+        TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(OUTPUT_BLOCK_MS);
+        for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+        {
+            size_t filled = output_fill_stream(s, blocks[s], deadline);
+            inputs[s] = filled > 0 ? (const int16_t *)blocks[s] : NULL;
+            any_input |= filled > 0;
+            if (filled > 0 && filled < OUTPUT_BLOCK_BYTES)
+            {
+                underrun_count++;
+                ESP_LOGD(TAG, "Stream %d underrun, %d/%d bytes", s, (int)filled, (int)OUTPUT_BLOCK_BYTES);
+            }
+        }
+        if (!any_input)
+        {
+            // 空闲时等待任一输入流写入，不写静音占用DMA
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        audio_mixer_process(mixed, inputs, DMA_BUF_LEN);
+        // 等待DMA队列有空闲缓冲，写入时不会阻塞
+        UBaseType_t free_blocks = uxSemaphoreGetCount(dma_credit);
+        xSemaphoreTake(dma_credit, portMAX_DELAY);
+        if (output_handle_silence())
+        {
+            // 等待期间收到静音请求，本块属于被打断的内容，丢弃
+            xSemaphoreGive(dma_credit);
+            continue;
+        }
+        if (esp_i2s_write(mixed, OUTPUT_BLOCK_BYTES) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "I2S write failed");
+        }
+        // 写入的缓冲在free_blocks - 1次发送完成之前就已空闲，要等其余缓冲依次播完后才播出
+        int64_t play_us = last_sent_us + (DMA_BUF_COUNT - (free_blocks > 0 ? free_blocks : 1)) * OUTPUT_BLOCK_US;
+        int64_t now = esp_timer_get_time();
+        audio_reference_push(mixed, DMA_BUF_LEN, play_us > now ? play_us : now);
+        portENTER_CRITICAL(&silence_lock);
+        last_active_us = now;
+        portEXIT_CRITICAL(&silence_lock);
+    }
+}
+
+/**
+ * @brief 释放输出级初始化过程中已创建的资源
+ */
+static void output_release(void)
+{
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        if (pcm_rings[s])
+        {
+            vRingbufferDeleteWithCaps(pcm_rings[s]);
+            pcm_rings[s] = NULL;
+        }
+        heap_caps_free(stream_blocks[s]);
+        stream_blocks[s] = NULL;
+    }
+    heap_caps_free(mixed_block);
+    mixed_block = NULL;
+    if (dma_credit)
+    {
+        vSemaphoreDelete(dma_credit);
+        dma_credit = NULL;
+    }
+}
+
+/**
+ * @brief 初始化输出级：为每路输入流创建PCM环形缓冲、初始化混音级、注册DMA完成回调并启动输出任务
+ * @param decode_ahead_ms: 各输入流可超前输出的时长（每路PCM环形缓冲深度）
+ */
+esp_err_t audio_output_init(uint32_t decode_ahead_ms)
+{
+    if (output_task_handle)
+    {
+        return ESP_OK;
+    }
+
+    size_t ring_size = decode_ahead_ms * SAMPLE_TX_RATE / 1000 * sizeof(int16_t);
+    if (ring_size < OUTPUT_BLOCK_BYTES * 2)
+    {
+        ring_size = OUTPUT_BLOCK_BYTES * 2;
+    }
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        pcm_rings[s] = xRingbufferCreateWithCaps(ring_size, RINGBUF_TYPE_BYTEBUF, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        stream_blocks[s] = heap_caps_malloc(OUTPUT_BLOCK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!pcm_rings[s] || !stream_blocks[s])
+        {
+            ESP_LOGE(TAG, "Failed to create pcm ring");
+            output_release();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    mixed_block = heap_caps_malloc(OUTPUT_BLOCK_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    dma_credit = xSemaphoreCreateCounting(DMA_BUF_COUNT, DMA_BUF_COUNT);
+    if (!mixed_block || !dma_credit)
+    {
+        ESP_LOGE(TAG, "Failed to allocate output block");
+        output_release();
+        return ESP_ERR_NO_MEM;
+    }
+
+    audio_mixer_init();
+    if (audio_reference_init() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Echo reference disabled");
+    }
+
+    esp_err_t ret = esp_i2s_register_tx_callback(audio_output_on_sent, NULL);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register on_sent callback: %s", esp_err_to_name(ret));
+        output_release();
+        return ret;
+    }
+
+    // 输出任务放在解码任务（核心1）之外的核心，保证DMA队列持续有数据
+    BaseType_t ret_val = xTaskCreatePinnedToCore(audio_output_task, "audio_output", 4 * 1024, NULL, 6, &output_task_handle, 0);
+    if (ret_val != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed create audio output task");
+        output_task_handle = NULL;
+        esp_i2s_register_tx_callback(NULL, NULL);
+        output_release();
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Output stage started, %d streams, decode ahead %lu ms (%d bytes each)",
+             AUDIO_MIX_STREAMS, decode_ahead_ms, (int)ring_size);
+    return ESP_OK;
+}
+
+/**
+ * @brief 向某一路输入流写入PCM：该流环形缓冲满时阻塞，由输出级的消费速度反压
+ * @param stream: 输入流
+ * @param pcm: 单声道16bit PCM
+ * @param samples: 采样点数
+ */
+esp_err_t audio_output_write(audio_mix_stream_t stream, const int16_t *pcm, uint32_t samples)
+{
+    if (stream >= AUDIO_MIX_STREAMS || !pcm_rings[stream])
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (samples == 0)
+    {
+        return ESP_OK;
+    }
+    // 按DMA块分段写入：整段提示音PCM可能大于环形缓冲
+    while (samples > 0)
+    {
+        uint32_t n = samples < DMA_BUF_LEN ? samples : DMA_BUF_LEN;
+        if (xRingbufferSend(pcm_rings[stream], pcm, n * sizeof(int16_t), portMAX_DELAY) != pdTRUE)
+        {
+            return ESP_FAIL;
+        }
+        portENTER_CRITICAL(&silence_lock);
+        stream_written[stream] += n * sizeof(int16_t);
+        portEXIT_CRITICAL(&silence_lock);
+        xTaskNotifyGive(output_task_handle);
+        pcm += n;
+        samples -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 登记清空请求：输出任务丢弃该流此前写入的PCM，之后写入的不受影响
+ */
+static void output_request_flush(audio_mix_stream_t stream)
+{
+    portENTER_CRITICAL(&silence_lock);
+    flush_mark[stream] = stream_written[stream];
+    flush_requested |= 1u << stream;
+    portEXIT_CRITICAL(&silence_lock);
+}
+
+/**
+ * @brief 丢弃某一路输入流中尚未播放的PCM（播放被取消时立即静音）
+ * 由输出任务在取下一块之前执行，最多再播出已取走的一块
+ */
+void audio_output_flush(audio_mix_stream_t stream)
+{
+    if (stream >= AUDIO_MIX_STREAMS || !output_task_handle)
+    {
+        return;
+    }
+    output_request_flush(stream);
+    xTaskNotifyGive(output_task_handle);
+}
+
+/**
+ * @brief 某一路输入流中已写入但尚未被输出级取走的采样数
+ */
+uint32_t audio_output_get_buffered(audio_mix_stream_t stream)
+{
+    if (stream >= AUDIO_MIX_STREAMS || !pcm_rings[stream])
+    {
+        return 0;
+    }
+    UBaseType_t waiting = 0;
+    vRingbufferGetInfo(pcm_rings[stream], NULL, NULL, NULL, NULL, &waiting);
+    return waiting / sizeof(int16_t);
+}
+
+/**
+ * @brief 获取输出欠载次数
+ */
+uint32_t audio_output_get_underruns(void)
+{
+    return underrun_count;
+}
+
+/**
+ * @brief 立即静音：丢弃各输入流中尚未播放的PCM，并由输出任务清空I2S DMA队列
+ * 输出任务最多在写完当前一块后响应（不超过一个DMA缓冲的时长）
+ * @param request_us: 触发时刻（esp_timer），用于统计从触发到静音的延迟
+ */
+void audio_output_silence(int64_t request_us)
+{
+    if (!output_task_handle)
+    {
+        return;
+    }
+    for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+    {
+        output_request_flush(s);
+    }
+    portENTER_CRITICAL(&silence_lock);
+    silence_requested = true;
+    silence_request_us = request_us;
+    portEXIT_CRITICAL(&silence_lock);
+    xTaskNotifyGive(output_task_handle);
+}
+
+/**
+ * @brief 扬声器是否正在播放（最近写入的非空混音块尚未播完）
+ */
+bool audio_output_is_active(void)
+{
+    portENTER_CRITICAL(&silence_lock);
+    int64_t active_us = last_active_us;
+    portEXIT_CRITICAL(&silence_lock);
+    return active_us > 0 && esp_timer_get_time() - active_us < DMA_BUF_COUNT * OUTPUT_BLOCK_US;
+}
+
+/**
+ * @brief 获取打断播放（触发到静音）的延迟统计
+ */
+void audio_barge_in_get_stats(audio_barge_in_stats_t *stats)
+{
+    portENTER_CRITICAL(&silence_lock);
+    *stats = silence_stats;
+    portEXIT_CRITICAL(&silence_lock);
+}
@@ -0,0 +1,352 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bsp_board.h"
+
+static const char *TAG = "audio_player";
+
+// 一个播放请求
+typedef struct {
+    char path[AUDIO_PROMPT_PATH_MAX];
+    uint8_t volume;
+    audio_priority_t priority;
+    int64_t request_us; // 请求时间，用于统计首音延迟
+} player_item_t;
+
+// 正在播放项的写入状态（作为PCM sink的参数）
+typedef struct {
+    const player_item_t *item;
+    bool started;       // 是否已写入首个采样
+    bool chained;       // 是否紧接上一项播放（需统计衔接间隙）
+} player_session_t;
+
+// 按优先级排序的请求队列，同优先级先进先出
+static player_item_t queue[AUDIO_PLAYER_QUEUE_LEN];
+static uint32_t queue_count = 0;
+static portMUX_TYPE player_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t player_task_handle = NULL;
+static bool playing = false;                  // 是否有正在播放的项
+static audio_priority_t playing_priority;     // 正在播放项的优先级
+static volatile bool cancel_requested = false;
+
+static audio_player_stats_t stats;
+static int64_t last_end_us = 0;     // 上一项最后一个采样写入输出级的时间
+static uint32_t last_end_buffered;  // 此时输出级中尚未播放的采样数
+
+/**
+ * @brief 插入请求：排在所有优先级不低于它的请求之后（调用时需持有player_lock）
+ */
+static bool queue_insert(const player_item_t *item)
+{
+    if (queue_count >= AUDIO_PLAYER_QUEUE_LEN)
+    {
+        return false;
+    }
+    uint32_t pos = 0;
+    while (pos < queue_count && queue[pos].priority >= item->priority)
+    {
+        pos++;
+    }
+    memmove(&queue[pos + 1], &queue[pos], (queue_count - pos) * sizeof(player_item_t));
+    queue[pos] = *item;
+    queue_count++;
+    stats.queue_depth = queue_count;
+    if (queue_count > stats.queue_depth_max)
+    {
+        stats.queue_depth_max = queue_count;
+    }
+    return true;
+}
+
+/**
+ * @brief 丢弃优先级不高于priority的排队请求（调用时需持有player_lock）
+ */
+static void queue_drop(audio_priority_t priority)
+{
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < queue_count; i++)
+    {
+        if (queue[i].priority > priority)
+        {
+            queue[kept++] = queue[i];
+        }
+        else
+        {
+            stats.items_cancelled++;
+        }
+    }
+    queue_count = kept;
+    stats.queue_depth = queue_count;
+}
+
+/**
+ * @brief 取出队首请求并标记为正在播放
+ */
+static bool queue_pop(player_item_t *item)
+{
+    bool found = false;
+    portENTER_CRITICAL(&player_lock);
+    if (queue_count > 0)
+    {
+        *item = queue[0];
+        queue_count--;
+        memmove(&queue[0], &queue[1], queue_count * sizeof(player_item_t));
+        stats.queue_depth = queue_count;
+        playing = true;
+        playing_priority = item->priority;
+        cancel_requested = false;
+        found = true;
+    }
+    else
+    {
+        playing = false;
+    }
+    portEXIT_CRITICAL(&player_lock);
+    return found;
+}
+
+static esp_err_t player_submit(const char *path, uint8_t volume, audio_priority_t priority, bool replace)
+{
+    if (!player_task_handle)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!path || strlen(path) >= AUDIO_PROMPT_PATH_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    player_item_t item = {
+        .volume = volume,
+        .priority = priority,
+        .request_us = esp_timer_get_time(),
+    };
+    strlcpy(item.path, path, sizeof(item.path));
+
+    portENTER_CRITICAL(&player_lock);
+    if (replace)
+    {
+        queue_drop(priority);
+    }
+    // 打断正在播放的低优先级项（play时同优先级也打断）
+    if (playing && (playing_priority < priority || (replace && playing_priority == priority)))
+    {
+        cancel_requested = true;
+    }
+    bool queued = queue_insert(&item);
+    portEXIT_CRITICAL(&player_lock);
+
+    if (!queued)
+    {
+        ESP_LOGW(TAG, "Queue full, %s dropped", path);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(player_task_handle);
+    return ESP_OK;
+}
+
+/**
+ * @brief 立即播放：丢弃同级及更低优先级的排队项并打断正在播放的同级项
+ * @param path: SPiffs中的文件路径
+ * @param volume: 播放音量（0~100）
+ * @param priority: 请求优先级
+ */
+esp_err_t audio_player_play(const char *path, uint8_t volume, audio_priority_t priority)
+{
+    return player_submit(path, volume, priority, true);
+}
+
+/**
+ * @brief 追加到队列，在同级及更高优先级的排队项之后播放
+ */
+esp_err_t audio_player_enqueue(const char *path, uint8_t volume, audio_priority_t priority)
+{
+    return player_submit(path, volume, priority, false);
+}
+
+/**
+ * @brief 停止当前项，已写入输出级的PCM一并丢弃，随后继续播放队列中的下一项
+ */
+void audio_player_cancel(void)
+{
+    portENTER_CRITICAL(&player_lock);
+    if (playing)
+    {
+        cancel_requested = true;
+    }
+    portEXIT_CRITICAL(&player_lock);
+    if (player_task_handle)
+    {
+        xTaskNotifyGive(player_task_handle);
+    }
+}
+
+/**
+ * @brief 清空排队的请求（不影响当前项）
+ */
+void audio_player_flush(void)
+{
+    portENTER_CRITICAL(&player_lock);
+    queue_drop(AUDIO_PRIORITY_SYSTEM);
+    portEXIT_CRITICAL(&player_lock);
+}
+
+void audio_player_get_stats(audio_player_stats_t *out)
+{
+    portENTER_CRITICAL(&player_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&player_lock);
+}
+
+/**
+ * @brief 首个采样写入前记录首音延迟，并与上一项的结束时刻比较得出衔接间隙
+ * 上一项结束时输出级中仍有last_end_buffered个采样待播放，只有超出这段时长才会断流
+ */
+static void player_mark_start(player_session_t *session)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t latency = (uint32_t)(now - session->item->request_us);
+    int64_t drained_us = (int64_t)last_end_buffered * 1000000 / SAMPLE_TX_RATE;
+    int64_t gap = now - last_end_us - drained_us;
+    session->started = true;
+
+    portENTER_CRITICAL(&player_lock);
+    stats.start_latency_us = latency;
+    if (latency > stats.start_latency_max_us)
+    {
+        stats.start_latency_max_us = latency;
+    }
+    if (session->chained)
+    {
+        stats.gap_us = gap > 0 ? (uint32_t)gap : 0;
+        if (stats.gap_us > stats.gap_max_us)
+        {
+            stats.gap_max_us = stats.gap_us;
+        }
+        if (stats.gap_us == 0)
+        {
+            stats.gapless_transitions++;
+        }
+    }
+    portEXIT_CRITICAL(&player_lock);
+    ESP_LOGD(TAG, "%s started, latency %lu us", session->item->path, latency);
+}
+
+/**
+ * @brief 播放项的PCM sink：紧接上一项的采样写入提示音输入流，被取消时中止解码
+ */
+static esp_err_t player_sink(void *arg, const int16_t *pcm, uint32_t samples)
+{
+    player_session_t *session = (player_session_t *)arg;
+    if (cancel_requested)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!session->started)
+    {
+        player_mark_start(session);
+    }
+    return audio_output_write(AUDIO_MIX_EARCON, pcm, samples);
+}
+
+/**
+ * @brief 播放一项：缓存命中时按DMA块写入PSRAM中的PCM，未命中时边解码边播放并存入缓存
+ * @return 完整播放返回true
+ */
+static bool player_play_item(const player_item_t *item, bool chained)
+{
+    player_session_t session = {
+        .item = item,
+        .chained = chained,
+    };
+    esp_err_t ret = ESP_OK;
+
+    audio_mixer_set_volume(AUDIO_MIX_EARCON, item->volume);
+    const audio_prompt_t *prompt = audio_prompt_cache_acquire(item->path);
+    if (prompt)
+    {
+        // 分块写入，以便及时响应取消
+        for (uint32_t pos = 0; pos < prompt->samples && ret == ESP_OK; pos += DMA_BUF_LEN)
+        {
+            uint32_t n = prompt->samples - pos < DMA_BUF_LEN ? prompt->samples - pos : DMA_BUF_LEN;
+            ret = player_sink(&session, prompt->pcm + pos, n);
+        }
+        audio_prompt_cache_release(prompt);
+    }
+    else
+    {
+        ret = audio_prompt_cache_decode(item->path, player_sink, &session);
+    }
+
+    if (cancel_requested)
+    {
+        // 丢弃已写入输出级但尚未播放的部分
+        audio_output_flush(AUDIO_MIX_EARCON);
+        ESP_LOGI(TAG, "Cancelled %s", item->path);
+        return false;
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Playback failed: %s", item->path);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 播放任务：一项播完（全部PCM已写入输出级）后立即打开并解码下一项，
+ * 输出级中剩余的PCM（最多AUDIO_DECODE_AHEAD_MS）播放期间下一项的首帧已接在其后，衔接无间隙
+ */
+static void audio_player_task(void *pvParameters)
+{
+    player_item_t item;
+    bool chained = false;
+
+    while (1)
+    {
+        if (!queue_pop(&item))
+        {
+            chained = false;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        bool completed = player_play_item(&item, chained);
+
+        portENTER_CRITICAL(&player_lock);
+        if (completed)
+        {
+            stats.items_played++;
+        }
+        else
+        {
+            stats.items_cancelled++;
+        }
+        portEXIT_CRITICAL(&player_lock);
+
+        last_end_us = esp_timer_get_time();
+        last_end_buffered = audio_output_get_buffered(AUDIO_MIX_EARCON);
+        // 被取消的项已清空输出级，下一项不计衔接间隙
+        chained = completed;
+    }
+}
+
+/**
+ * @brief 初始化播放队列并创建播放任务
+ */
+esp_err_t audio_player_init(void)
+{
+    if (player_task_handle)
+    {
+        return ESP_OK;
+    }
+    BaseType_t ret_val = xTaskCreatePinnedToCore(audio_player_task, "audio_player", 10 * 1024, NULL, 3, &player_task_handle, 1);
+    if (ret_val != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed create audio player task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -7,6 +7,8 @@
 #include "string.h"
 #include "stdio.h"
 #include "esp_spiffs.h"
+#include "esp_err.h"
+#include "audio_source.h"
 /*
 
 #if CONFIG_EASYLOGGER_SUPPORT
@@ -59,10 +61,209 @@ struct audio_decoder{
     audio_info_t info;
     // 初始化解码器
     decoder_result_t (*init)(struct audio_decoder *decoder);
-    // 帧解码
-    decoder_result_t (*decode_frame)(struct audio_decoder *decoder, FILE *file, int16_t *output, uint32_t *samples_decoded);
+    // 帧解码：从字节数据源取数（文件、内存、Flash映射或网络环形缓冲）
+    decoder_result_t (*decode_frame)(struct audio_decoder *decoder, audio_source_t *src, int16_t *output, uint32_t *samples_decoded);
+    // 裸包解码（流式播放，无容器封装），不支持时为NULL
+    decoder_result_t (*decode_packet)(struct audio_decoder *decoder, const uint8_t *packet, size_t len, int16_t *output, uint32_t *samples_decoded);
+    // 丢包补偿（流式播放），不支持时为NULL：fec_packet非NULL时只用其带内FEC恢复它之前丢失的一包
+    // （不含FEC时返回DECODER_ERROR），为NULL时做PLC
+    decoder_result_t (*conceal)(struct audio_decoder *decoder, const uint8_t *fec_packet, size_t len, int16_t *output, uint32_t *samples_decoded);
+    // 复位解码器以播放新的数据流（复用已分配的资源），不支持时为NULL
+    decoder_result_t (*reset)(struct audio_decoder *decoder);
     // 关闭解码器
     void (*deinit)(struct audio_decoder *decoder);
 };
 
+// 流式播放（WebSocket下行Opus包）配置
+#define AUDIO_STREAM_JITTER_SLOTS    64   // 抖动缓冲槽位数（每个槽位存放一个Opus包，位于PSRAM）
+#define AUDIO_STREAM_MAX_PACKET_SIZE 1500 // 单个Opus包最大字节数
+#define AUDIO_STREAM_PREFILL_PACKETS 1    // 缓冲到多少个包后开始播放（1表示收到首包即播放）
+#define AUDIO_STREAM_IDLE_TIMEOUT_MS 500  // 超过该时长未收到新包视为本次流结束
+#define AUDIO_STREAM_SEQ_HEADER      0    // 置1时每个下行包前带2字节大端序号，用于识别丢包与迟到包
+#define AUDIO_STREAM_PLC_MAX_FRAMES  5    // 连续补偿的最大帧数：缓冲为空时超过后由输出级补静音，序号缺口超过时其余帧跳过
+#define AUDIO_STREAM_PLC_LOW_WATER_MS 60  // 抖动缓冲已空且输出级剩余PCM低于该时长时，用PLC补帧
+#define AUDIO_STREAM_POLL_MS         10   // 流播放期间检查输出级水位的周期
+
+// PCM输出级配置：解码级最多超前输出级的时长（决定解码与I2S之间PCM环形缓冲的深度）
+#define AUDIO_DECODE_AHEAD_MS 200
+
+// 混音输入流：每路有独立的PCM环形缓冲，由输出级按DMA块混音
+typedef enum {
+    AUDIO_MIX_SPEECH = 0, // 下行语音/TTS流，提示音播放时自动压低
+    AUDIO_MIX_EARCON,     // 提示音
+    AUDIO_MIX_STREAMS,
+} audio_mix_stream_t;
+
+// 混音级配置
+#define AUDIO_MIXER_DUCK_GAIN    8192 // 提示音播放期间语音流的增益（Q15，约-12dB）
+#define AUDIO_MIXER_RAMP_SAMPLES 480  // 增益从0到满幅的线性过渡采样数（20ms），避免增益突变产生爆音
+#define AUDIO_MIXER_MAX_BLOCK    DMA_BUF_LEN // 单次混音的最大采样数
+#define AUDIO_MIXER_SELFTEST     1    // 置1时初始化时用标量参考实现逐位校验esp-dsp路径，不一致则回退标量
+
+// PCM输出级（audio_output.c）：由I2S DMA发送完成事件驱动，各输入流写入时按各自缓冲空间反压
+esp_err_t audio_output_init(uint32_t decode_ahead_ms);
+esp_err_t audio_output_write(audio_mix_stream_t stream, const int16_t *pcm, uint32_t samples);
+void audio_output_flush(audio_mix_stream_t stream);
+uint32_t audio_output_get_buffered(audio_mix_stream_t stream);
+uint32_t audio_output_get_underruns(void);
+void audio_output_silence(int64_t request_us);
+bool audio_output_is_active(void);
+
+// 回声消除参考信号配置
+#define AUDIO_REF_RING_MS         2000 // 参考信号时间线长度（需覆盖DMA队列时长 + 估计窗口 + 回声延时）
+#define AUDIO_REF_SNAP_MS         40   // 预计播放时刻与上一块末尾相差在此范围内时视为连续播放
+#define AUDIO_REF_DELAY_MS        0    // 回声路径延时的初始补偿值，运行中由互相关测量修正
+#define AUDIO_REF_MAX_DELAY_MS    200  // 回声路径延时补偿上限
+#define AUDIO_REF_ESTIMATE_MS     500  // 延时估计窗口
+#define AUDIO_REF_SEARCH_MS       32   // 延时估计的搜索范围（±）
+#define AUDIO_REF_DECIMATE        4    // 延时估计前的抽取倍数（16kHz -> 4kHz）
+#define AUDIO_REF_MIN_LEVEL       300  // 参考信号均方根低于该值时不做延时估计
+#define AUDIO_REF_MIN_CORR_PCT    30   // 归一化互相关低于该值（%）时不修正延时
+
+// 回声消除参考信号（audio_reference.c）：输出级写入I2S的PCM按播放时刻放入时间线
+esp_err_t audio_reference_init(void);
+void audio_reference_push(const int16_t *pcm, uint32_t samples, int64_t play_us);
+void audio_reference_cut(int64_t now_us);
+
+// 定点混音级（audio_mixer.c）：Q15增益，块内线性过渡，累加后饱和到int16
+void audio_mixer_init(void);
+void audio_mixer_set_master(uint8_t volume);
+void audio_mixer_set_volume(audio_mix_stream_t stream, uint8_t volume);
+void audio_mixer_process(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS], uint32_t samples);
+void audio_mixer_mix(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS],
+                     const int16_t *gain_start, const int16_t *gain_end, uint32_t samples);
+void audio_mixer_mix_ref(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS],
+                         const int16_t *gain_start, const int16_t *gain_end, uint32_t samples);
+bool audio_mixer_selftest(void);
+
+// 编解码类型
+typedef enum {
+    AUDIO_CODEC_OPUS = 0, // Ogg封装的Opus（下行流为Opus裸包）
+    AUDIO_CODEC_MP3,      // MP3（Helix定点解码）
+    AUDIO_CODEC_PCM,      // WAV或裸16bit PCM
+    AUDIO_CODEC_MAX,
+    AUDIO_CODEC_UNKNOWN = AUDIO_CODEC_MAX,
+} audio_codec_t;
+
+// 格式识别时读取的开头字节数
+#define AUDIO_CODEC_PROBE_BYTES 12
+
+// 编解码器描述：各解码器端口提供一份，注册到编解码器表
+typedef struct {
+    const char *name;
+    audio_codec_t codec;
+    // 根据数据开头的字节判断是否为本格式
+    bool (*probe)(const uint8_t *head, size_t len);
+    // 为解码器实例绑定操作函数
+    void (*ops_register)(audio_decoder_t *decoder);
+    uint32_t input_chunk;       // 推荐的单次读取字节数
+    uint32_t max_frame_samples; // 单次decode_frame最多输出的采样数（所有声道合计），用于一次性分配解码缓冲
+    bool flexible_output;       // 可按decoder->info指定的采样率/声道数直接解码，否则按码流原生格式输出
+} audio_codec_desc_t;
+
+// 编解码器表（audio_codec.c）
+esp_err_t audio_codec_register(const audio_codec_desc_t *desc);
+void audio_codecs_init(void);
+const audio_codec_desc_t *audio_codec_find(audio_codec_t codec);
+audio_codec_t audio_codec_sniff(audio_source_t *src);
+
+// 各解码器端口的注册函数
+void opus_decoder_port_register(void);
+void mp3_decoder_port_register(void);
+void pcm_decoder_port_register(void);
+
+// 解码器构造/释放（audio.c实现，供播放模块共用）
+audio_decoder_t *audio_decoder_register(audio_codec_t codec);
+void audio_decoder_deinit(audio_decoder_t *decoder);
+
+// 解码器池配置：槽位数量，其中两个预先构造Opus解码器（提示音文件播放、下行流式播放各占一个），
+// 其余槽位在首次播放MP3/PCM提示音时构造并保留
+#define AUDIO_DECODER_POOL_SIZE      4
+// 置1时在初始化后运行解码器冷启动/池复用的耗时与堆占用对比
+#define AUDIO_DECODER_POOL_BENCHMARK 0
+
+// 解码器池（audio_decoder_pool.c）：按编解码类型、采样率、声道数复用已构造的解码器
+esp_err_t audio_decoder_pool_init(void);
+audio_decoder_t *audio_decoder_acquire(audio_codec_t codec, uint32_t sample_rate, uint8_t channels);
+void audio_decoder_release(audio_decoder_t *decoder);
+void audio_decoder_pool_benchmark(void);
+
+// PCM接收函数：解码得到的单声道16bit PCM（I2S输出采样率）交给输出级或缓存
+typedef esp_err_t (*audio_pcm_sink_t)(void *arg, const int16_t *pcm, uint32_t samples);
+
+// 文件解码（audio.c实现）：按I2S输出格式解码整个文件
+esp_err_t audio_decode_file(const char *path, audio_pcm_sink_t sink, void *arg);
+
+// 重采样配置
+#define AUDIO_RESAMPLER_TAPS      16   // 多相滤波器每相抽头数
+#define AUDIO_RESAMPLER_CHUNK     1152 // 格式转换级单次重采样的输入采样数
+#define AUDIO_RESAMPLER_BENCHMARK 0    // 置1时在初始化后输出重采样开销与信噪比
+
+// 定点多相重采样器（audio_resampler.c）
+typedef struct audio_resampler audio_resampler_t;
+audio_resampler_t *audio_resampler_create(uint32_t in_rate, uint32_t out_rate, uint32_t taps, uint32_t max_input);
+void audio_resampler_destroy(audio_resampler_t *rs);
+void audio_resampler_reset(audio_resampler_t *rs);
+uint32_t audio_resampler_max_output(const audio_resampler_t *rs, uint32_t in_samples);
+uint32_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, uint32_t in_samples, int16_t *out);
+void audio_resampler_benchmark(void);
+
+// 格式转换级：解码输出与sink之间的声道混合与重采样
+typedef struct {
+    audio_resampler_t *resampler;
+    int16_t *out;
+    uint32_t out_capacity;
+    uint32_t in_rate;
+} audio_format_stage_t;
+esp_err_t audio_format_stage_write(audio_format_stage_t *stage, const audio_info_t *info, int16_t *pcm, uint32_t samples,
+                                   audio_pcm_sink_t sink, void *arg);
+void audio_format_stage_deinit(audio_format_stage_t *stage);
+
+// 播放队列配置
+#define AUDIO_PLAYER_QUEUE_LEN 8 // 最多排队的播放请求数
+
+esp_err_t audio_player_init(void);
+
+// 上行Opus编码配置（麦克风经AFE处理后为16kHz单声道）
+#define AUDIO_UPLINK_SAMPLE_RATE 16000
+#define AUDIO_UPLINK_FRAME_MS    20    // 编码帧长，20或40
+#define AUDIO_UPLINK_BITRATE     24000 // 目标码率（bit/s），原始PCM为256kbit/s
+#define AUDIO_UPLINK_COMPLEXITY  3     // 编码复杂度0~10，越高音质越好、CPU开销越大
+#define AUDIO_UPLINK_MAX_PACKET  512   // 单个Opus包最大字节数
+#define AUDIO_UPLINK_DTX         1     // 1：开启DTX，编码器判定为静音的帧只输出1~2字节的包
+#define AUDIO_ENCODER_BENCHMARK  0     // 置1时输出各复杂度/帧长下的编码开销
+
+// Opus库全局伪栈的互斥（opus_decoder_port.c），所有opus_encode/opus_decode调用需持有
+void audio_opus_lock(void);
+void audio_opus_unlock(void);
+
+// 上行编码器（opus_encoder_port.c）：把任意长度的PCM块重组为固定帧长编码，每帧一个包交给sink
+typedef struct audio_encoder audio_encoder_t;
+typedef esp_err_t (*audio_packet_sink_t)(void *arg, const uint8_t *packet, size_t len);
+audio_encoder_t *audio_encoder_create(uint32_t sample_rate, uint32_t frame_ms, uint32_t bitrate, int complexity);
+void audio_encoder_destroy(audio_encoder_t *enc);
+void audio_encoder_reset(audio_encoder_t *enc);
+esp_err_t audio_encoder_flush(audio_encoder_t *enc, audio_packet_sink_t sink, void *arg, uint32_t *padded);
+esp_err_t audio_encoder_write(audio_encoder_t *enc, const int16_t *pcm, uint32_t samples, audio_packet_sink_t sink, void *arg);
+void audio_encoder_benchmark(void);
+
+// 提示音PCM缓存配置
+#define AUDIO_PROMPT_CACHE_BUDGET  (512 * 1024)         // PSRAM中缓存PCM的总字节预算
+#define AUDIO_PROMPT_CACHE_ENTRIES 16                   // 最多缓存的提示音数量
+#define AUDIO_PROMPT_PATH_MAX      64                   // 提示音路径最大长度
+#define AUDIO_PROMPT_MANIFEST      "/spiffs/prompts.txt" // 启动时预热的提示音清单（每行一个路径）
+
+// 已解码的提示音（I2S输出格式的单声道16bit PCM，位于PSRAM）
+typedef struct {
+    const int16_t *pcm;
+    uint32_t samples;
+} audio_prompt_t;
+
+// 提示音缓存（audio_prompt_cache.c）：按LRU淘汰，使用中的条目不会被淘汰
+esp_err_t audio_prompt_cache_init(size_t budget_bytes);
+esp_err_t audio_prompt_cache_warm(const char *manifest_path);
+const audio_prompt_t *audio_prompt_cache_acquire(const char *path);
+void audio_prompt_cache_release(const audio_prompt_t *prompt);
+esp_err_t audio_prompt_cache_decode(const char *path, audio_pcm_sink_t sink, void *arg);
+
 #endif /* __AUDIO_PRIVATE_H__ */
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bsp_board.h"
+
+static const char *TAG = "prompt_cache";
+
+// 缓存条目
+typedef struct {
+    audio_prompt_t prompt;           // 必须为第一个成员，对外以audio_prompt_t指针形式交出
+    char path[AUDIO_PROMPT_PATH_MAX];
+    size_t bytes;                    // PCM占用字节数
+    uint32_t last_used;              // LRU时钟
+    uint16_t refs;                   // 正在播放的引用数，大于0时不可淘汰
+    bool valid;
+} prompt_entry_t;
+
+// 解码时累积PCM
+typedef struct {
+    audio_pcm_sink_t sink; // 同时转发给的下游（可为NULL）
+    void *sink_arg;
+    int16_t *pcm;
+    uint32_t samples;
+    uint32_t capacity;
+    uint32_t limit;        // 最大可缓存采样数（超出预算则放弃缓存）
+    bool capturing;
+} prompt_builder_t;
+
+static prompt_entry_t entries[AUDIO_PROMPT_CACHE_ENTRIES];
+static SemaphoreHandle_t cache_mutex = NULL;
+static size_t cache_budget = 0;
+static size_t cache_used = 0;
+static uint32_t use_clock = 0;
+static uint32_t hit_count = 0;
+static uint32_t miss_count = 0;
+static uint32_t evict_count = 0;
+static uint32_t uncached_count = 0; // 解码成功但未能存入缓存的次数（超出预算或没有可淘汰的条目）
+
+/**
+ * @brief 初始化提示音缓存
+ * @param budget_bytes: PSRAM中缓存PCM的总字节预算
+ */
+esp_err_t audio_prompt_cache_init(size_t budget_bytes)
+{
+    if (cache_mutex)
+    {
+        return ESP_OK;
+    }
+    cache_mutex = xSemaphoreCreateMutex();
+    if (!cache_mutex)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    cache_budget = budget_bytes;
+    cache_used = 0;
+    memset(entries, 0, sizeof(entries));
+    return ESP_OK;
+}
+
+static prompt_entry_t *cache_find(const char *path)
+{
+    for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES; i++)
+    {
+        if (entries[i].valid && strcmp(entries[i].path, path) == 0)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_evict(prompt_entry_t *entry)
+{
+    ESP_LOGI(TAG, "Evict %s (%d bytes)", entry->path, (int)entry->bytes);
+    heap_caps_free((void *)entry->prompt.pcm);
+    cache_used -= entry->bytes;
+    memset(entry, 0, sizeof(prompt_entry_t));
+    evict_count++;
+}
+
+/**
+ * @brief 找出最久未使用且未被播放引用的条目
+ */
+static prompt_entry_t *cache_lru_victim(void)
+{
+    prompt_entry_t *victim = NULL;
+    for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES; i++)
+    {
+        if (entries[i].valid && entries[i].refs == 0 && (!victim || entries[i].last_used < victim->last_used))
+        {
+            victim = &entries[i];
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief 为新条目腾出空间和槽位（调用时需持有cache_mutex）
+ * @return 可用槽位，无法腾出时返回NULL
+ */
+static prompt_entry_t *cache_make_room(size_t bytes)
+{
+    while (cache_used + bytes > cache_budget)
+    {
+        prompt_entry_t *victim = cache_lru_victim();
+        if (!victim)
+        {
+            return NULL;
+        }
+        cache_evict(victim);
+    }
+    for (int i = 0; i < AUDIO_PROMPT_CACHE_ENTRIES; i++)
+    {
+        if (!entries[i].valid)
+        {
+            return &entries[i];
+        }
+    }
+    prompt_entry_t *victim = cache_lru_victim();
+    if (victim)
+    {
+        cache_evict(victim);
+    }
+    return victim;
+}
+
+/**
+ * @brief 查找已缓存的提示音，命中时增加引用，播放完后需调用audio_prompt_cache_release
+ * @return 未命中返回NULL
+ */
+const audio_prompt_t *audio_prompt_cache_acquire(const char *path)
+{
+    if (!cache_mutex || !path)
+    {
+        return NULL;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    prompt_entry_t *entry = cache_find(path);
+    if (entry)
+    {
+        entry->refs++;
+        entry->last_used = ++use_clock;
+        hit_count++;
+    }
+    else
+    {
+        miss_count++;
+    }
+    xSemaphoreGive(cache_mutex);
+    return entry ? &entry->prompt : NULL;
+}
+
+void audio_prompt_cache_release(const audio_prompt_t *prompt)
+{
+    if (!prompt)
+    {
+        return;
+    }
+    prompt_entry_t *entry = (prompt_entry_t *)prompt;
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (entry->refs > 0)
+    {
+        entry->refs--;
+    }
+    xSemaphoreGive(cache_mutex);
+}
+
+/**
+ * @brief 解码输出：先转发给下游，再追加到PSRAM中的PCM缓冲
+ */
+static esp_err_t prompt_builder_sink(void *arg, const int16_t *pcm, uint32_t samples)
+{
+    prompt_builder_t *builder = (prompt_builder_t *)arg;
+    if (builder->sink)
+    {
+        esp_err_t ret = builder->sink(builder->sink_arg, pcm, samples);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+    if (!builder->capturing)
+    {
+        return ESP_OK;
+    }
+
+    uint32_t needed = builder->samples + samples;
+    if (needed > builder->limit)
+    {
+        // 超出缓存预算，放弃缓存但继续转发
+        builder->capturing = false;
+        return builder->sink ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    if (needed > builder->capacity)
+    {
+        uint32_t capacity = builder->capacity ? builder->capacity * 2 : SAMPLE_TX_RATE; // 初始1秒
+        if (capacity < needed)
+        {
+            capacity = needed;
+        }
+        if (capacity > builder->limit)
+        {
+            capacity = builder->limit;
+        }
+        int16_t *grown = heap_caps_realloc(builder->pcm, capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!grown)
+        {
+            builder->capturing = false;
+            return builder->sink ? ESP_OK : ESP_ERR_NO_MEM;
+        }
+        builder->pcm = grown;
+        builder->capacity = capacity;
+    }
+    memcpy(builder->pcm + builder->samples, pcm, samples * sizeof(int16_t));
+    builder->samples = needed;
+    return ESP_OK;
+}
+
+/**
+ * @brief 解码提示音文件并存入缓存
+ * @param path: 提示音路径
+ * @param sink: 解码的同时转发PCM的下游（如输出级），为NULL时只缓存
+ * @param arg: sink参数
+ * @return 有sink时为解码/转发的结果，未能缓存只记入统计；sink为NULL时未能缓存返回ESP_ERR_NO_MEM
+ */
+esp_err_t audio_prompt_cache_decode(const char *path, audio_pcm_sink_t sink, void *arg)
+{
+    if (!cache_mutex || strlen(path) >= AUDIO_PROMPT_PATH_MAX)
+    {
+        return sink ? audio_decode_file(path, sink, arg) : ESP_ERR_INVALID_ARG;
+    }
+
+    prompt_builder_t builder = {
+        .sink = sink,
+        .sink_arg = arg,
+        .limit = cache_budget / sizeof(int16_t),
+        .capturing = true,
+    };
+    esp_err_t ret = audio_decode_file(path, prompt_builder_sink, &builder);
+    if (ret != ESP_OK || !builder.capturing || builder.samples == 0)
+    {
+        if (ret == ESP_OK && !builder.capturing)
+        {
+            ESP_LOGW(TAG, "%s exceeds cache budget, not cached", path);
+            uncached_count++;
+        }
+        heap_caps_free(builder.pcm);
+        if (ret != ESP_OK || builder.capturing || sink)
+        {
+            return ret;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 收缩到实际大小
+    size_t bytes = builder.samples * sizeof(int16_t);
+    int16_t *pcm = heap_caps_realloc(builder.pcm, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (pcm)
+    {
+        builder.pcm = pcm;
+    }
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    prompt_entry_t *entry = cache_find(path);
+    if (entry)
+    {
+        // 其他任务已先一步缓存
+        xSemaphoreGive(cache_mutex);
+        heap_caps_free(builder.pcm);
+        return ESP_OK;
+    }
+    entry = cache_make_room(bytes);
+    if (!entry)
+    {
+        xSemaphoreGive(cache_mutex);
+        uncached_count++;
+        ESP_LOGW(TAG, "No room for %s, all entries in use", path);
+        heap_caps_free(builder.pcm);
+        return sink ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    entry->prompt.pcm = builder.pcm;
+    entry->prompt.samples = builder.samples;
+    strlcpy(entry->path, path, sizeof(entry->path));
+    entry->bytes = bytes;
+    entry->last_used = ++use_clock;
+    entry->refs = 0;
+    entry->valid = true;
+    cache_used += bytes;
+    xSemaphoreGive(cache_mutex);
+
+    ESP_LOGI(TAG, "Cached %s: %lu samples (%d bytes), used %d/%d bytes",
+             path, builder.samples, (int)bytes, (int)cache_used, (int)cache_budget);
+    return ESP_OK;
+}
+
+/**
+ * @brief 按清单预热缓存，清单每行一个提示音路径，#开头的行为注释
+ */
+esp_err_t audio_prompt_cache_warm(const char *manifest_path)
+{
+    FILE *file = fopen(manifest_path, "r");
+    if (!file)
+    {
+        ESP_LOGW(TAG, "No prompt manifest: %s", manifest_path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    char line[AUDIO_PROMPT_PATH_MAX + 2];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] != '\n' && !feof(file))
+        {
+            // 行长超出缓冲：截断后的路径不可用，丢弃该行剩余部分
+            ESP_LOGW(TAG, "Manifest line too long, skipped: %.32s...", line);
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n')
+            {
+            }
+            continue;
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' '))
+        {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#')
+        {
+            continue;
+        }
+        if (audio_prompt_cache_decode(line, NULL, NULL) == ESP_OK)
+        {
+            loaded++;
+        }
+    }
+    fclose(file);
+    ESP_LOGI(TAG, "Warmed %d prompts, %d/%d bytes", loaded, (int)cache_used, (int)cache_budget);
+    return ESP_OK;
+}
+
+void audio_prompt_cache_get_stats(audio_prompt_cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(audio_prompt_cache_stats_t));
+    if (!cache_mutex)
+    {
+        return;
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    stats->hits = hit_count;
+    stats->misses = miss_count;
+    stats->evictions = evict_count;
+    stats->uncached = uncached_count;
+    stats->used_bytes = cache_used;
+    stats->budget_bytes = cache_budget;
+    xSemaphoreGive(cache_mutex);
+}
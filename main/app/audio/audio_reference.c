@@ -0,0 +1,362 @@
+#include "audio.h"
+#include "audio_private.h"
+#include <math.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "bsp_board.h"
+
+static const char *TAG = "audio_ref";
+
+// 参考信号时间线：以麦克风采样率计数的绝对采样序号（由esp_timer时间换算）
+#define REF_RATE           SAMPLE_RX_RATE
+#define REF_RING_SAMPLES   (REF_RATE * AUDIO_REF_RING_MS / 1000)
+#define REF_SNAP_SAMPLES   (REF_RATE * AUDIO_REF_SNAP_MS / 1000)
+#define REF_WINDOW_SAMPLES (REF_RATE * AUDIO_REF_ESTIMATE_MS / 1000)
+#define REF_SEARCH_SAMPLES (REF_RATE * AUDIO_REF_SEARCH_MS / 1000)
+#define REF_MAX_DELAY      (REF_RATE * AUDIO_REF_MAX_DELAY_MS / 1000)
+// 延时估计在抽取后的信号上做互相关
+#define EST_WINDOW         (REF_WINDOW_SAMPLES / AUDIO_REF_DECIMATE)
+#define EST_LAGS           (REF_SEARCH_SAMPLES / AUDIO_REF_DECIMATE)
+
+static int16_t *ref_ring = NULL;             // 参考信号时间线（PSRAM），位置为采样序号对长度取模
+static int64_t written_end = -1;             // 已写入的参考信号末尾的采样序号
+static int64_t written_floor = -1;           // 有效区间的下限：正在覆盖的槽位对应的旧采样不再有效
+static portMUX_TYPE ref_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_resampler_t *ref_resampler = NULL; // 24kHz -> 16kHz（仅输出任务使用）
+static int16_t *ref_block = NULL;            // 重采样后的一个DMA块
+
+// 以下仅采集任务访问
+static int32_t delay_samples = 0;  // 补偿的回声路径延时（测量得到）
+
+// 延时估计
+static int16_t *est_mic_full = NULL; // 估计窗口内的麦克风信号
+static int16_t *est_mic = NULL;    // 抽取后的麦克风信号
+static int16_t *est_span = NULL;   // 估计窗口对应的参考信号（两侧各多出搜索范围）
+static int16_t *est_ref = NULL;    // 抽取后的参考信号
+static uint32_t est_filled = 0;
+static int64_t est_start = 0;      // 估计窗口首个麦克风采样对应的参考序号
+static int64_t est_ref_energy = 0; // 窗口内参考信号的能量
+
+static audio_reference_stats_t stats;
+
+/**
+ * @brief 把一段采样写入时间线的[start, start + n)（只有输出任务写入，不持有ref_lock）
+ */
+static void ref_ring_write(int64_t start, const int16_t *pcm, uint32_t n)
+{
+    while (n > 0)
+    {
+        uint32_t pos = (uint32_t)(start % REF_RING_SAMPLES);
+        uint32_t chunk = REF_RING_SAMPLES - pos < n ? REF_RING_SAMPLES - pos : n;
+        if (pcm)
+        {
+            memcpy(ref_ring + pos, pcm, chunk * sizeof(int16_t));
+            pcm += chunk;
+        }
+        else
+        {
+            memset(ref_ring + pos, 0, chunk * sizeof(int16_t));
+        }
+        start += chunk;
+        n -= chunk;
+    }
+}
+
+/**
+ * @brief 读取时间线的[start, start + n)，没有播放（未写入或已被覆盖）的部分为静音
+ */
+static void ref_ring_read(int64_t start, int16_t *out, uint32_t n)
+{
+    portENTER_CRITICAL(&ref_lock);
+    int64_t valid_end = written_end;
+    int64_t valid_start = written_floor;
+    portEXIT_CRITICAL(&ref_lock);
+    if (valid_start < valid_end - REF_RING_SAMPLES)
+    {
+        valid_start = valid_end - REF_RING_SAMPLES;
+    }
+
+    for (uint32_t i = 0; i < n;)
+    {
+        int64_t idx = start + i;
+        if (valid_end < 0 || idx < valid_start || idx >= valid_end)
+        {
+            out[i++] = 0;
+            continue;
+        }
+        uint32_t pos = (uint32_t)(idx % REF_RING_SAMPLES);
+        uint32_t chunk = n - i;
+        if (chunk > REF_RING_SAMPLES - pos)
+        {
+            chunk = REF_RING_SAMPLES - pos;
+        }
+        if (chunk > valid_end - idx)
+        {
+            chunk = (uint32_t)(valid_end - idx);
+        }
+        memcpy(out + i, ref_ring + pos, chunk * sizeof(int16_t));
+        i += chunk;
+    }
+}
+
+/**
+ * @brief 创建参考信号时间线与重采样器（由输出级初始化时调用）
+ */
+esp_err_t audio_reference_init(void)
+{
+    if (ref_ring)
+    {
+        return ESP_OK;
+    }
+    ref_resampler = audio_resampler_create(SAMPLE_TX_RATE, REF_RATE, 0, DMA_BUF_LEN);
+    ref_block = heap_caps_malloc(DMA_BUF_LEN * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    est_mic_full = heap_caps_malloc(REF_WINDOW_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    est_mic = heap_caps_malloc(EST_WINDOW * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    est_ref = heap_caps_malloc((EST_WINDOW + 2 * EST_LAGS) * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    est_span = heap_caps_malloc((EST_WINDOW + 2 * EST_LAGS) * AUDIO_REF_DECIMATE * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int16_t *ring = heap_caps_calloc(REF_RING_SAMPLES, sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ref_resampler || !ref_block || !est_mic_full || !est_mic || !est_ref || !est_span || !ring)
+    {
+        ESP_LOGE(TAG, "Failed to allocate reference path");
+        audio_resampler_destroy(ref_resampler);
+        ref_resampler = NULL;
+        heap_caps_free(ref_block);
+        heap_caps_free(est_mic_full);
+        heap_caps_free(est_mic);
+        heap_caps_free(est_ref);
+        heap_caps_free(est_span);
+        heap_caps_free(ring);
+        return ESP_ERR_NO_MEM;
+    }
+    delay_samples = REF_RATE * AUDIO_REF_DELAY_MS / 1000;
+    stats.delay_us = delay_samples * 1000000LL / REF_RATE;
+    ref_ring = ring;
+    ESP_LOGI(TAG, "Reference path %d -> %d Hz, %d ms timeline", SAMPLE_TX_RATE, REF_RATE, AUDIO_REF_RING_MS);
+    return ESP_OK;
+}
+
+/**
+ * @brief 输出任务写入I2S的一块PCM：重采样到麦克风采样率，按预计开始播放的时刻放入时间线
+ * 连续播放时紧接上一块写入，避免播放时刻估计的抖动造成参考信号错位；中断后重新定位并补静音
+ * @param play_us: 本块第一个采样从扬声器播出的预计时刻（esp_timer）
+ */
+void audio_reference_push(const int16_t *pcm, uint32_t samples, int64_t play_us)
+{
+    if (!ref_ring)
+    {
+        return;
+    }
+    int64_t start = play_us * REF_RATE / 1000000;
+    int64_t end = written_end; // 只有本任务写入
+    bool continuous = end >= 0 && start > end - REF_SNAP_SAMPLES && start < end + REF_SNAP_SAMPLES;
+    if (!continuous)
+    {
+        audio_resampler_reset(ref_resampler);
+    }
+    uint32_t n = audio_resampler_process(ref_resampler, pcm, samples, ref_block);
+    if (continuous)
+    {
+        start = end;
+    }
+
+    // 先让读取方不再使用将被覆盖的槽位，再在锁外填充（可能是整条时间线），最后发布新的末尾
+    int64_t new_end = start + n;
+    portENTER_CRITICAL(&ref_lock);
+    if (new_end - REF_RING_SAMPLES > written_floor)
+    {
+        written_floor = new_end - REF_RING_SAMPLES;
+    }
+    portEXIT_CRITICAL(&ref_lock);
+
+    if (!continuous && end >= 0 && start > end)
+    {
+        // 两次播放之间的空白（最多一整条时间线）
+        int64_t gap = start - end;
+        int64_t from = gap > REF_RING_SAMPLES ? start - REF_RING_SAMPLES : end;
+        ref_ring_write(from, NULL, (uint32_t)(start - from));
+    }
+    ref_ring_write(start, ref_block, n);
+
+    portENTER_CRITICAL(&ref_lock);
+    written_end = new_end;
+    portEXIT_CRITICAL(&ref_lock);
+}
+
+/**
+ * @brief 输出被打断时截断时间线：now_us之后已排入DMA队列的参考信号不会再播放
+ */
+void audio_reference_cut(int64_t now_us)
+{
+    if (!ref_ring)
+    {
+        return;
+    }
+    int64_t cut = now_us * REF_RATE / 1000000;
+    portENTER_CRITICAL(&ref_lock);
+    if (written_end > cut)
+    {
+        written_end = cut;
+    }
+    portEXIT_CRITICAL(&ref_lock);
+}
+
+/**
+ * @brief 在[lag_min, lag_max]范围内求麦克风与参考信号归一化互相关最强的偏移
+ * 偏移lag时与mic[i]对齐的参考采样为ref[margin - lag + i]，lag为正表示麦克风中的回声比当前对齐的参考信号更晚
+ * @param corr: 输出最强偏移处的归一化互相关（扬声器极性可能相反，取绝对值）
+ */
+static int reference_correlate(const int16_t *mic, const int16_t *ref, uint32_t n, int margin,
+                               int lag_min, int lag_max, double *corr)
+{
+    int64_t mic_energy = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mic_energy += (int32_t)mic[i] * mic[i];
+    }
+    const int16_t *r = ref + margin - lag_min;
+    int64_t ref_energy = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ref_energy += (int32_t)r[i] * r[i];
+    }
+
+    int best_lag = lag_min;
+    double best = -1;
+    for (int lag = lag_min; lag <= lag_max; lag++)
+    {
+        r = ref + margin - lag;
+        if (lag > lag_min)
+        {
+            // 参考信号相对上一个偏移前移一个采样，能量滑动更新
+            ref_energy += (int32_t)r[0] * r[0] - (int32_t)r[n] * r[n];
+        }
+        int64_t acc = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            acc += (int32_t)mic[i] * r[i];
+        }
+        double score = (double)acc * acc / ((double)(ref_energy + 1) * (mic_energy + 1));
+        if (score > best)
+        {
+            best = score;
+            best_lag = lag;
+        }
+    }
+    *corr = sqrt(best);
+    return best_lag;
+}
+
+/**
+ * @brief 累积一个窗口的麦克风信号，窗口满且播放中时测量剩余的回声延时并补偿
+ * 先在抽取后的信号上大范围搜索，再在原采样率下于粗估位置附近细化
+ */
+static void reference_estimate(const int16_t *mic, const int16_t *ref, uint32_t samples, int64_t ref_start)
+{
+    if (est_filled == 0)
+    {
+        est_start = ref_start;
+        est_ref_energy = 0;
+    }
+    uint32_t n = REF_WINDOW_SAMPLES - est_filled < samples ? REF_WINDOW_SAMPLES - est_filled : samples;
+    memcpy(est_mic_full + est_filled, mic, n * sizeof(int16_t));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        est_ref_energy += (int32_t)ref[i] * ref[i];
+    }
+    est_filled += n;
+    if (est_filled < REF_WINDOW_SAMPLES)
+    {
+        return;
+    }
+    est_filled = 0;
+    // 参考信号过弱（基本没有播放）时不估计
+    if (est_ref_energy / REF_WINDOW_SAMPLES < (int64_t)AUDIO_REF_MIN_LEVEL * AUDIO_REF_MIN_LEVEL)
+    {
+        return;
+    }
+
+    // 按估计窗口的对齐方式读取两侧各多出搜索范围的参考信号，并与麦克风信号一起抽取
+    ref_ring_read(est_start - REF_SEARCH_SAMPLES, est_span, REF_WINDOW_SAMPLES + 2 * REF_SEARCH_SAMPLES);
+    for (uint32_t j = 0; j < EST_WINDOW + 2 * EST_LAGS; j++)
+    {
+        int32_t sum = 0;
+        for (int k = 0; k < AUDIO_REF_DECIMATE; k++)
+        {
+            sum += est_span[j * AUDIO_REF_DECIMATE + k];
+        }
+        est_ref[j] = (int16_t)(sum / AUDIO_REF_DECIMATE);
+    }
+    for (uint32_t j = 0; j < EST_WINDOW; j++)
+    {
+        int32_t sum = 0;
+        for (int k = 0; k < AUDIO_REF_DECIMATE; k++)
+        {
+            sum += est_mic_full[j * AUDIO_REF_DECIMATE + k];
+        }
+        est_mic[j] = (int16_t)(sum / AUDIO_REF_DECIMATE);
+    }
+
+    double corr;
+    int coarse = reference_correlate(est_mic, est_ref, EST_WINDOW, EST_LAGS, -EST_LAGS, EST_LAGS, &corr);
+    int lo = coarse * AUDIO_REF_DECIMATE - (AUDIO_REF_DECIMATE - 1);
+    int hi = coarse * AUDIO_REF_DECIMATE + (AUDIO_REF_DECIMATE - 1);
+    lo = lo < -REF_SEARCH_SAMPLES ? -REF_SEARCH_SAMPLES : lo;
+    hi = hi > REF_SEARCH_SAMPLES ? REF_SEARCH_SAMPLES : hi;
+    int lag = reference_correlate(est_mic_full, est_span, REF_WINDOW_SAMPLES, REF_SEARCH_SAMPLES, lo, hi, &corr);
+
+    uint32_t corr_pct = (uint32_t)(corr * 100);
+    stats.estimates++;
+    stats.correlation_pct = corr_pct;
+    if (corr_pct < AUDIO_REF_MIN_CORR_PCT)
+    {
+        return;
+    }
+    // 偏差较大时每次只补偿一半，避免单次误判造成跳变
+    int32_t delay = delay_samples + (lag > 1 || lag < -1 ? lag / 2 : lag);
+    if (delay < 0)
+    {
+        delay = 0;
+    }
+    else if (delay > REF_MAX_DELAY)
+    {
+        delay = REF_MAX_DELAY;
+    }
+    if (delay != delay_samples)
+    {
+        delay_samples = delay;
+        stats.adjustments++;
+        ESP_LOGI(TAG, "Echo delay %ld us (corr %lu%%)", delay * 1000000L / REF_RATE, corr_pct);
+    }
+    stats.delay_us = delay_samples * 1000000LL / REF_RATE;
+}
+
+/**
+ * @brief 取与一块麦克风采样对齐的参考信号（采集任务每处理一块调用一次）
+ * 麦克风采样的采集时刻取自I2S接收完成中断，参考信号再按测量得到的回声路径延时后移
+ * @param mic: 麦克风采样（用于延时测量）
+ * @param ref: 输出的参考信号
+ * @param capture_us: 最后一个麦克风采样的采集时刻
+ */
+void audio_reference_read(const int16_t *mic, int16_t *ref, uint32_t samples, int64_t capture_us)
+{
+    if (!ref_ring)
+    {
+        memset(ref, 0, samples * sizeof(int16_t));
+        return;
+    }
+    int64_t end = capture_us * REF_RATE / 1000000 - delay_samples;
+    ref_ring_read(end - samples, ref, samples);
+    portENTER_CRITICAL(&ref_lock);
+    bool played = written_end >= 0;
+    portEXIT_CRITICAL(&ref_lock);
+    if (played)
+    {
+        reference_estimate(mic, ref, samples, end - samples);
+    }
+}
+
+void audio_reference_get_stats(audio_reference_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,344 @@
+#include "audio.h"
+#include "audio_private.h"
+#include <math.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "bsp_board.h"
+
+static const char *TAG = "resampler";
+
+#define RESAMPLER_PHASE_BITS 6
+#define RESAMPLER_PHASES     (1 << RESAMPLER_PHASE_BITS) // 多相滤波器相位数
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// 多相FIR重采样器：系数表按[相位][抽头]连续存放，内层循环为16bit乘32bit累加
+struct audio_resampler {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t taps;       // 每相抽头数（8的倍数）
+    uint64_t step;       // 每个输出采样前进的输入采样数（Q32）
+    uint64_t pos;        // 当前输出采样在buf中的位置（Q32）
+    int16_t *coeffs;     // RESAMPLER_PHASES * taps，Q15
+    int16_t *buf;        // 历史采样 + 本次输入
+    uint32_t buf_len;
+    uint32_t capacity;
+};
+
+/**
+ * @brief 生成加Blackman窗的sinc低通多相系数，截止频率取输入、输出奈奎斯特频率的较小者
+ */
+static void resampler_design(audio_resampler_t *rs)
+{
+    double cutoff = (rs->out_rate < rs->in_rate ? (double)rs->out_rate / rs->in_rate : 1.0) * 0.92;
+    double half = rs->taps / 2.0;
+
+    for (int p = 0; p < RESAMPLER_PHASES; p++)
+    {
+        double frac = (double)p / RESAMPLER_PHASES;
+        double h[rs->taps];
+        double sum = 0;
+        for (int k = 0; k < rs->taps; k++)
+        {
+            // 滤波中心位于第taps/2-1个抽头之后frac处
+            double x = k - (half - 1) - frac;
+            double sinc = (x == 0) ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+            if (fabs(x) > half)
+            {
+                w = 0;
+            }
+            h[k] = sinc * w;
+            sum += h[k];
+        }
+        // 每相归一化为单位直流增益，避免相位间的增益纹波
+        for (int k = 0; k < rs->taps; k++)
+        {
+            rs->coeffs[p * rs->taps + k] = (int16_t)lrint(h[k] / sum * 32767.0);
+        }
+    }
+}
+
+/**
+ * @brief 创建单声道流式重采样器
+ * @param in_rate: 输入采样率
+ * @param out_rate: 输出采样率
+ * @param taps: 每相抽头数（8的倍数，越大阻带越好、开销越大），0使用默认值
+ * @param max_input: 单次process的最大输入采样数
+ */
+audio_resampler_t *audio_resampler_create(uint32_t in_rate, uint32_t out_rate, uint32_t taps, uint32_t max_input)
+{
+    if (in_rate == 0 || out_rate == 0)
+    {
+        return NULL;
+    }
+    if (taps == 0)
+    {
+        taps = AUDIO_RESAMPLER_TAPS;
+    }
+    taps = (taps + 7) & ~7;
+
+    audio_resampler_t *rs = calloc(1, sizeof(audio_resampler_t));
+    if (!rs)
+    {
+        return NULL;
+    }
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->taps = taps;
+    rs->step = ((uint64_t)in_rate << 32) / out_rate;
+    rs->capacity = taps + max_input;
+    rs->coeffs = heap_caps_aligned_alloc(16, RESAMPLER_PHASES * taps * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    rs->buf = heap_caps_aligned_alloc(16, rs->capacity * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!rs->coeffs || !rs->buf)
+    {
+        audio_resampler_destroy(rs);
+        return NULL;
+    }
+    resampler_design(rs);
+    audio_resampler_reset(rs);
+    ESP_LOGI(TAG, "Resampler %lu -> %lu Hz, %lu taps", in_rate, out_rate, taps);
+    return rs;
+}
+
+void audio_resampler_destroy(audio_resampler_t *rs)
+{
+    if (!rs)
+    {
+        return;
+    }
+    heap_caps_free(rs->coeffs);
+    heap_caps_free(rs->buf);
+    free(rs);
+}
+
+/**
+ * @brief 清空历史采样（新的数据流开始时调用）
+ */
+void audio_resampler_reset(audio_resampler_t *rs)
+{
+    // 预置taps-1个零作为历史，首个输入采样即可参与输出
+    memset(rs->buf, 0, rs->capacity * sizeof(int16_t));
+    rs->buf_len = rs->taps - 1;
+    rs->pos = 0;
+}
+
+/**
+ * @brief 处理in_samples个输入采样最多能产生的输出采样数
+ */
+uint32_t audio_resampler_max_output(const audio_resampler_t *rs, uint32_t in_samples)
+{
+    return (uint32_t)(((uint64_t)in_samples * rs->out_rate + rs->in_rate - 1) / rs->in_rate) + 2;
+}
+
+static inline int32_t resampler_dot(const int16_t *x, const int16_t *h, uint32_t taps)
+{
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (uint32_t k = 0; k < taps; k += 4)
+    {
+        acc0 += x[k] * h[k];
+        acc1 += x[k + 1] * h[k + 1];
+        acc2 += x[k + 2] * h[k + 2];
+        acc3 += x[k + 3] * h[k + 3];
+    }
+    return acc0 + acc1 + acc2 + acc3;
+}
+
+/**
+ * @brief 重采样一段输入
+ * @param in: 输入PCM，in_samples不超过创建时的max_input
+ * @param out: 输出缓冲，容量不小于audio_resampler_max_output(rs, in_samples)
+ * @return 输出采样数
+ */
+uint32_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, uint32_t in_samples, int16_t *out)
+{
+    if (in_samples > rs->capacity - rs->buf_len)
+    {
+        in_samples = rs->capacity - rs->buf_len;
+    }
+    memcpy(rs->buf + rs->buf_len, in, in_samples * sizeof(int16_t));
+    rs->buf_len += in_samples;
+
+    uint32_t produced = 0;
+    const uint32_t taps = rs->taps;
+    while ((uint32_t)(rs->pos >> 32) + taps <= rs->buf_len)
+    {
+        uint32_t idx = (uint32_t)(rs->pos >> 32);
+        uint32_t phase = (uint32_t)(rs->pos >> (32 - RESAMPLER_PHASE_BITS)) & (RESAMPLER_PHASES - 1);
+        int32_t acc = resampler_dot(rs->buf + idx, rs->coeffs + phase * taps, taps);
+        acc = (acc + (1 << 14)) >> 15;
+        if (acc > INT16_MAX)
+        {
+            acc = INT16_MAX;
+        }
+        else if (acc < INT16_MIN)
+        {
+            acc = INT16_MIN;
+        }
+        out[produced++] = (int16_t)acc;
+        rs->pos += rs->step;
+    }
+
+    // 丢弃已不再需要的输入，保留滤波历史
+    uint32_t consumed = (uint32_t)(rs->pos >> 32);
+    if (consumed > rs->buf_len)
+    {
+        consumed = rs->buf_len;
+    }
+    memmove(rs->buf, rs->buf + consumed, (rs->buf_len - consumed) * sizeof(int16_t));
+    rs->buf_len -= consumed;
+    rs->pos -= (uint64_t)consumed << 32;
+    return produced;
+}
+
+/**
+ * @brief 用最小二乘拟合已知频率的正弦，求输出的信噪比（与延时无关）
+ */
+static double resampler_measure_snr(const int16_t *pcm, uint32_t samples, double freq, uint32_t rate)
+{
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, yy = 0;
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        double s = sin(2 * M_PI * freq * n / rate);
+        double c = cos(2 * M_PI * freq * n / rate);
+        double y = pcm[n];
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y * s;
+        yc += y * c;
+        yy += y * y;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double signal = a * ys + b * yc;
+    double noise = yy - signal;
+    if (noise <= 0)
+    {
+        return 120.0;
+    }
+    return 10 * log10(signal / noise);
+}
+
+/**
+ * @brief 重采样基准：对常见输入采样率和不同抽头数，输出每个输出采样的CPU周期数与1kHz正弦的信噪比
+ */
+void audio_resampler_benchmark(void)
+{
+    const uint32_t rates[] = {16000, 22050, 44100, 48000};
+    const uint32_t taps_list[] = {8, 16, 32};
+    const uint32_t chunk = 512;
+    const uint32_t total_in = 8192;
+
+    int16_t *in = heap_caps_malloc(total_in * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int16_t *out = heap_caps_malloc((total_in * 3 + 64) * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!in || !out)
+    {
+        ESP_LOGE(TAG, "Benchmark buffer allocation failed");
+        heap_caps_free(in);
+        heap_caps_free(out);
+        return;
+    }
+
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        for (uint32_t n = 0; n < total_in; n++)
+        {
+            in[n] = (int16_t)(16000 * sin(2 * M_PI * 1000.0 * n / rates[r]));
+        }
+        for (int t = 0; t < sizeof(taps_list) / sizeof(taps_list[0]); t++)
+        {
+            audio_resampler_t *rs = audio_resampler_create(rates[r], SAMPLE_TX_RATE, taps_list[t], chunk);
+            if (!rs)
+            {
+                continue;
+            }
+            uint32_t produced = 0;
+            uint32_t cycles = 0;
+            for (uint32_t off = 0; off < total_in; off += chunk)
+            {
+                uint32_t start = esp_cpu_get_cycle_count();
+                produced += audio_resampler_process(rs, in + off, chunk, out + produced);
+                cycles += esp_cpu_get_cycle_count() - start;
+            }
+            // 跳过滤波器建立阶段再测信噪比
+            uint32_t skip = rs->taps * 2;
+            double snr = resampler_measure_snr(out + skip, produced - skip, 1000.0, SAMPLE_TX_RATE);
+            ESP_LOGI(TAG, "%5lu -> %lu Hz, %2lu taps: %lu cycles/sample, SNR %.1f dB",
+                     rates[r], (uint32_t)SAMPLE_TX_RATE, taps_list[t], cycles / produced, snr);
+            audio_resampler_destroy(rs);
+        }
+    }
+    heap_caps_free(in);
+    heap_caps_free(out);
+}
+
+/**
+ * @brief 格式转换级：把解码输出（任意采样率、单/双声道交织）转换为I2S输出格式后交给sink
+ * 采样率与输出一致且为单声道时直接透传，不做拷贝
+ * @param info: 解码器当前输出格式
+ * @param pcm: 解码输出，双声道时原地混为单声道
+ * @param samples: 采样数（所有声道合计）
+ */
+esp_err_t audio_format_stage_write(audio_format_stage_t *stage, const audio_info_t *info, int16_t *pcm, uint32_t samples,
+                                   audio_pcm_sink_t sink, void *arg)
+{
+    if (info->channels == 2)
+    {
+        samples /= 2;
+        for (uint32_t i = 0; i < samples; i++)
+        {
+            pcm[i] = (int16_t)(((int32_t)pcm[i * 2] + pcm[i * 2 + 1]) >> 1);
+        }
+    }
+    if (info->sample_rate == SAMPLE_TX_RATE || info->sample_rate == 0)
+    {
+        return sink(arg, pcm, samples);
+    }
+
+    // 采样率变化（如MP3逐帧上报）时重建重采样器
+    if (!stage->resampler || stage->in_rate != info->sample_rate)
+    {
+        audio_format_stage_deinit(stage);
+        stage->resampler = audio_resampler_create(info->sample_rate, SAMPLE_TX_RATE, AUDIO_RESAMPLER_TAPS, AUDIO_RESAMPLER_CHUNK);
+        if (!stage->resampler)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        stage->out_capacity = audio_resampler_max_output(stage->resampler, AUDIO_RESAMPLER_CHUNK);
+        stage->out = malloc(stage->out_capacity * sizeof(int16_t));
+        if (!stage->out)
+        {
+            audio_format_stage_deinit(stage);
+            return ESP_ERR_NO_MEM;
+        }
+        stage->in_rate = info->sample_rate;
+    }
+
+    while (samples > 0)
+    {
+        uint32_t n = samples < AUDIO_RESAMPLER_CHUNK ? samples : AUDIO_RESAMPLER_CHUNK;
+        uint32_t produced = audio_resampler_process(stage->resampler, pcm, n, stage->out);
+        if (produced > 0)
+        {
+            esp_err_t ret = sink(arg, stage->out, produced);
+            if (ret != ESP_OK)
+            {
+                return ret;
+            }
+        }
+        pcm += n;
+        samples -= n;
+    }
+    return ESP_OK;
+}
+
+void audio_format_stage_deinit(audio_format_stage_t *stage)
+{
+    audio_resampler_destroy(stage->resampler);
+    free(stage->out);
+    memset(stage, 0, sizeof(audio_format_stage_t));
+}
@@ -0,0 +1,204 @@
+#include "audio_source.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "audio_source";
+
+/* ---------------- FILE数据源 ---------------- */
+
+static int file_read(audio_source_t *src, void *buf, size_t len)
+{
+    FILE *file = (FILE *)src->context;
+    size_t bytes_read = fread(buf, 1, len, file);
+    if (bytes_read == 0 && ferror(file))
+    {
+        return -1;
+    }
+    return (int)bytes_read;
+}
+
+static int file_peek(audio_source_t *src, void *buf, size_t len)
+{
+    FILE *file = (FILE *)src->context;
+    long pos = ftell(file);
+    int bytes_read = file_read(src, buf, len);
+    fseek(file, pos, SEEK_SET);
+    return bytes_read;
+}
+
+static int file_skip(audio_source_t *src, size_t len)
+{
+    FILE *file = (FILE *)src->context;
+    if (fseek(file, (long)len, SEEK_CUR) != 0)
+    {
+        return -1;
+    }
+    return (int)len;
+}
+
+static void file_close(audio_source_t *src)
+{
+    if (src->context)
+    {
+        fclose((FILE *)src->context);
+    }
+}
+
+esp_err_t audio_source_open_file(audio_source_t *src, const char *path)
+{
+    memset(src, 0, sizeof(audio_source_t));
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        ESP_LOGE(TAG, "Failed to open file: %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    src->context = file;
+    src->read = file_read;
+    src->peek = file_peek;
+    src->skip = file_skip;
+    src->span = NULL; // stdio无法零拷贝
+    src->close = file_close;
+    return ESP_OK;
+}
+
+/* ---------------- 内存数据源 ---------------- */
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    bool owned; // 数据由数据源分配，关闭时释放
+} memory_context_t;
+
+static int memory_read(audio_source_t *src, void *buf, size_t len)
+{
+    memory_context_t *ctx = (memory_context_t *)src->context;
+    size_t remain = ctx->len - ctx->pos;
+    if (len > remain)
+    {
+        len = remain;
+    }
+    memcpy(buf, ctx->data + ctx->pos, len);
+    ctx->pos += len;
+    return (int)len;
+}
+
+static int memory_peek(audio_source_t *src, void *buf, size_t len)
+{
+    memory_context_t *ctx = (memory_context_t *)src->context;
+    size_t remain = ctx->len - ctx->pos;
+    if (len > remain)
+    {
+        len = remain;
+    }
+    memcpy(buf, ctx->data + ctx->pos, len);
+    return (int)len;
+}
+
+static int memory_skip(audio_source_t *src, size_t len)
+{
+    memory_context_t *ctx = (memory_context_t *)src->context;
+    size_t remain = ctx->len - ctx->pos;
+    if (len > remain)
+    {
+        len = remain;
+    }
+    ctx->pos += len;
+    return (int)len;
+}
+
+static int memory_span(audio_source_t *src, const uint8_t **data)
+{
+    memory_context_t *ctx = (memory_context_t *)src->context;
+    *data = ctx->data + ctx->pos;
+    return (int)(ctx->len - ctx->pos);
+}
+
+static void memory_close(audio_source_t *src)
+{
+    memory_context_t *ctx = (memory_context_t *)src->context;
+    if (ctx)
+    {
+        if (ctx->owned)
+        {
+            free((void *)ctx->data);
+        }
+        free(ctx);
+    }
+}
+
+/**
+ * @brief 将整个文件读入PSRAM作为内存数据源，解码器通过span直接在缓冲上解码（零拷贝）
+ * @param path: 文件路径
+ * @param max_len: 允许整体载入的最大文件长度
+ * @return ESP_ERR_INVALID_SIZE表示文件超过max_len，调用方应改用audio_source_open_file流式读取
+ */
+esp_err_t audio_source_load_file(audio_source_t *src, const char *path, size_t max_len)
+{
+    memset(src, 0, sizeof(audio_source_t));
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        ESP_LOGE(TAG, "Failed to open file: %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = ESP_OK;
+    uint8_t *data = NULL;
+    memory_context_t *ctx = NULL;
+    long len = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        len = ftell(file);
+    }
+    if (len <= 0 || (size_t)len > max_len || fseek(file, 0, SEEK_SET) != 0)
+    {
+        ret = len <= 0 ? ESP_FAIL : ESP_ERR_INVALID_SIZE;
+        goto cleanup;
+    }
+    data = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctx = calloc(1, sizeof(memory_context_t));
+    if (!data || !ctx)
+    {
+        ret = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+    if (fread(data, 1, len, file) != (size_t)len)
+    {
+        ESP_LOGE(TAG, "Short read: %s", path);
+        ret = ESP_FAIL;
+        goto cleanup;
+    }
+    fclose(file);
+    ctx->data = data;
+    ctx->len = len;
+    ctx->owned = true;
+    src->context = ctx;
+    src->read = memory_read;
+    src->peek = memory_peek;
+    src->skip = memory_skip;
+    src->span = memory_span;
+    src->close = memory_close;
+    return ESP_OK;
+
+cleanup:
+    fclose(file);
+    free(data);
+    free(ctx);
+    return ret;
+}
+
+void audio_source_close(audio_source_t *src)
+{
+    if (src && src->close)
+    {
+        src->close(src);
+    }
+    if (src)
+    {
+        memset(src, 0, sizeof(audio_source_t));
+    }
+}
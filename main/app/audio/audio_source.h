@@ -0,0 +1,35 @@
+#ifndef __AUDIO_SOURCE_H__
+#define __AUDIO_SOURCE_H__
+
+#include "stdint.h"
+#include <stdbool.h>
+#include "stddef.h"
+#include "esp_err.h"
+
+// 不超过该长度的文件整体载入PSRAM解码（提示音等短音频），更大的文件流式读取
+#define AUDIO_SOURCE_LOAD_MAX_BYTES (256 * 1024)
+
+typedef struct audio_source audio_source_t;
+
+// 字节数据源抽象接口：解码器只通过该接口取数，不关心数据来自文件还是内存
+struct audio_source {
+    // 具体数据源的上下文
+    void *context;
+    // 读取最多len字节并消费，返回实际字节数，0表示数据结束，负数表示错误
+    int (*read)(audio_source_t *src, void *buf, size_t len);
+    // 查看最多len字节但不消费，返回值同read
+    int (*peek)(audio_source_t *src, void *buf, size_t len);
+    // 跳过len字节，返回实际跳过的字节数
+    int (*skip)(audio_source_t *src, size_t len);
+    // 零拷贝：获取当前可连续读取的数据区域（不消费，读完后用skip消费），
+    // 返回区域长度，0表示数据结束；不支持零拷贝的数据源为NULL
+    int (*span)(audio_source_t *src, const uint8_t **data);
+    // 关闭数据源并释放上下文
+    void (*close)(audio_source_t *src);
+};
+
+esp_err_t audio_source_open_file(audio_source_t *src, const char *path);
+esp_err_t audio_source_load_file(audio_source_t *src, const char *path, size_t max_len);
+void audio_source_close(audio_source_t *src);
+
+#endif /* __AUDIO_SOURCE_H__ */
@@ -0,0 +1,523 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bsp_board.h"
+
+static const char *TAG = "audio_stream";
+
+// 抖动缓冲中的一个Opus包
+typedef struct {
+    uint16_t len;
+    uint16_t seq; // 包序号（无序号头时按到达顺序编号）
+    uint8_t data[AUDIO_STREAM_MAX_PACKET_SIZE];
+} stream_packet_t;
+
+// 单生产者（WebSocket任务）/单消费者（解码任务）的包环形缓冲
+typedef struct {
+    stream_packet_t *slots; // 槽位数组（PSRAM）
+    uint16_t head;          // 下一个写入槽位
+    uint16_t tail;          // 下一个读取槽位
+    uint16_t count;         // 已缓存包数
+    uint16_t next_seq;      // 无序号头时分配给下一个包的序号
+    uint32_t dropped;       // 缓冲满时丢弃的包数
+    bool discarding;        // 打断后丢弃服务器仍在发送的本次回复
+    int64_t last_discard_us; // 最近一次丢弃包的时刻
+    portMUX_TYPE lock;      // 保护以上计数与丢弃状态（WebSocket任务、解码任务与识别任务共同访问）
+} jitter_buffer_t;
+
+static jitter_buffer_t jitter = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static TaskHandle_t stream_task_handle = NULL;
+static volatile bool stream_end_requested = false; // 服务器通知本次流已发送完毕
+static volatile bool stream_cancel_requested = false; // 本次流被打断，解码任务需丢弃缓冲
+static int64_t first_packet_us = 0;                // 本次流首包到达时间，用于统计首音延迟
+static audio_stream_stats_t stream_stats;          // 丢包与补偿统计（仅解码任务写入）
+
+/**
+ * @brief 当前缓存的包数
+ */
+static uint16_t jitter_count(void)
+{
+    portENTER_CRITICAL(&jitter.lock);
+    uint16_t count = jitter.count;
+    portEXIT_CRITICAL(&jitter.lock);
+    return count;
+}
+
+/**
+ * @brief 取出队首包（不拷贝，解码完成后需调用jitter_release）
+ */
+static stream_packet_t *jitter_peek(void)
+{
+    stream_packet_t *packet = NULL;
+    portENTER_CRITICAL(&jitter.lock);
+    if (jitter.count > 0)
+    {
+        packet = &jitter.slots[jitter.tail];
+    }
+    portEXIT_CRITICAL(&jitter.lock);
+    return packet;
+}
+
+/**
+ * @brief 释放队首包槽位
+ */
+static void jitter_release(void)
+{
+    portENTER_CRITICAL(&jitter.lock);
+    jitter.tail = (jitter.tail + 1) % AUDIO_STREAM_JITTER_SLOTS;
+    jitter.count--;
+    portEXIT_CRITICAL(&jitter.lock);
+}
+
+/**
+ * @brief 为一个新到达的下行包预留抖动缓冲槽位（仅WebSocket任务调用）
+ * @return 被打断的回复仍在到达或缓冲已满时返回NULL，本包应丢弃
+ */
+static stream_packet_t *jitter_reserve(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&jitter.lock);
+    if (jitter.discarding)
+    {
+        // 被打断的回复在服务器停止发送前持续到达，间隔超过空闲超时后视为新的回复
+        if (now - jitter.last_discard_us < AUDIO_STREAM_IDLE_TIMEOUT_MS * 1000LL)
+        {
+            jitter.last_discard_us = now;
+            portEXIT_CRITICAL(&jitter.lock);
+            return NULL;
+        }
+        jitter.discarding = false;
+    }
+    if (jitter.count >= AUDIO_STREAM_JITTER_SLOTS)
+    {
+        jitter.dropped++;
+        portEXIT_CRITICAL(&jitter.lock);
+        ESP_LOGW(TAG, "Jitter buffer full, packet dropped");
+        return NULL;
+    }
+    stream_packet_t *slot = &jitter.slots[jitter.head];
+    portEXIT_CRITICAL(&jitter.lock);
+    // 该槽位在count增加前不会被消费者访问，可在临界区外写入
+    return slot;
+}
+
+/**
+ * @brief 提交jitter_reserve预留的槽位，交给解码任务
+ */
+static void jitter_commit(stream_packet_t *slot, uint16_t len, uint16_t seq)
+{
+    slot->len = len;
+#if AUDIO_STREAM_SEQ_HEADER
+    slot->seq = seq;
+#else
+    slot->seq = jitter.next_seq++;
+#endif
+
+    portENTER_CRITICAL(&jitter.lock);
+    if (jitter.count == 0 && first_packet_us == 0)
+    {
+        first_packet_us = esp_timer_get_time();
+    }
+    jitter.head = (jitter.head + 1) % AUDIO_STREAM_JITTER_SLOTS;
+    jitter.count++;
+    portEXIT_CRITICAL(&jitter.lock);
+
+    if (stream_task_handle)
+    {
+        xTaskNotifyGive(stream_task_handle);
+    }
+}
+
+/**
+ * @brief 接收一个下行Opus包（在WebSocket事件回调中调用，不阻塞）
+ * @param data: Opus裸包数据（一个WebSocket二进制帧对应一个包）
+ * @param len: 包长度
+ */
+void audio_stream_push(const uint8_t *data, size_t len)
+{
+    if (!jitter.slots || !data || len == 0)
+    {
+        return;
+    }
+    uint16_t seq = 0;
+#if AUDIO_STREAM_SEQ_HEADER
+    if (len <= 2)
+    {
+        return;
+    }
+    seq = (uint16_t)(data[0] << 8 | data[1]);
+    data += 2;
+    len -= 2;
+#endif
+    if (len > AUDIO_STREAM_MAX_PACKET_SIZE)
+    {
+        ESP_LOGW(TAG, "Packet too large: %d bytes", (int)len);
+        return;
+    }
+    stream_packet_t *slot = jitter_reserve();
+    if (slot)
+    {
+        memcpy(slot->data, data, len);
+        jitter_commit(slot, len, seq);
+    }
+}
+
+// 正在按段接收的下行包（仅WebSocket任务访问），直接写入预留的槽位
+static struct {
+    stream_packet_t *slot; // 预留的槽位，NULL表示本包被丢弃
+    size_t len;            // 已写入槽位的字节数
+    uint8_t header[2];     // 序号头
+    size_t header_len;
+} chunk_packet;
+
+/**
+ * @brief 按段接收一个下行Opus包（WebSocket二进制流模式，在事件回调中调用，不阻塞）
+ * 各段直接拷贝进抖动缓冲的槽位，不经过中间缓冲；未分片的包等同于audio_stream_push
+ * @param offset: 本段在包中的偏移，为0表示新包开始
+ * @param fin: 本段是否为包的最后一段
+ */
+void audio_stream_push_chunk(const uint8_t *data, size_t len, size_t offset, bool fin)
+{
+    if (offset == 0 && fin)
+    {
+        chunk_packet.slot = NULL;
+        audio_stream_push(data, len);
+        return;
+    }
+    if (!jitter.slots)
+    {
+        return;
+    }
+    if (offset == 0)
+    {
+        chunk_packet.slot = jitter_reserve();
+        chunk_packet.len = 0;
+        chunk_packet.header_len = 0;
+    }
+    if (!chunk_packet.slot)
+    {
+        return;
+    }
+#if AUDIO_STREAM_SEQ_HEADER
+    while (chunk_packet.header_len < sizeof(chunk_packet.header) && len > 0)
+    {
+        chunk_packet.header[chunk_packet.header_len++] = *data++;
+        len--;
+    }
+#endif
+    if (chunk_packet.len + len > AUDIO_STREAM_MAX_PACKET_SIZE)
+    {
+        ESP_LOGW(TAG, "Packet too large: %d bytes", (int)(offset + len));
+        chunk_packet.slot = NULL;
+        return;
+    }
+    memcpy(chunk_packet.slot->data + chunk_packet.len, data, len);
+    chunk_packet.len += len;
+    if (fin)
+    {
+        if (chunk_packet.len > 0)
+        {
+            jitter_commit(chunk_packet.slot, chunk_packet.len,
+                          (uint16_t)(chunk_packet.header[0] << 8 | chunk_packet.header[1]));
+        }
+        chunk_packet.slot = NULL;
+    }
+}
+
+/**
+ * @brief 标记本次流已结束，缓冲中的包播放完后立即释放解码器
+ */
+void audio_stream_end(void)
+{
+    // 服务器确认被打断的回复已结束，之后的包属于新的回复
+    portENTER_CRITICAL(&jitter.lock);
+    jitter.discarding = false;
+    portEXIT_CRITICAL(&jitter.lock);
+    stream_end_requested = true;
+    if (stream_task_handle)
+    {
+        xTaskNotifyGive(stream_task_handle);
+    }
+}
+
+/**
+ * @brief 打断当前流：丢弃抖动缓冲和尚未播放的PCM，服务器停止发送前到达的包也一并丢弃
+ */
+void audio_stream_cancel(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&jitter.lock);
+    jitter.last_discard_us = now;
+    jitter.discarding = true;
+    portEXIT_CRITICAL(&jitter.lock);
+    stream_cancel_requested = true;
+    audio_output_flush(AUDIO_MIX_SPEECH);
+    if (stream_task_handle)
+    {
+        xTaskNotifyGive(stream_task_handle);
+    }
+}
+
+/**
+ * @brief 为新的一次流创建解码器，输出格式与I2S发送通道一致
+ */
+static audio_decoder_t *stream_open(void)
+{
+    // Opus可直接按任意支持的采样率解码，省去重采样
+    audio_decoder_t *decoder = audio_decoder_acquire(AUDIO_CODEC_OPUS, SAMPLE_TX_RATE, 1);
+    if (!decoder)
+    {
+        return NULL;
+    }
+    if (!decoder->decode_packet)
+    {
+        ESP_LOGE(TAG, "Decoder does not support packet streaming");
+        audio_decoder_release(decoder);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "Stream started");
+    return decoder;
+}
+
+static void stream_close(audio_decoder_t **decoder)
+{
+    audio_decoder_release(*decoder);
+    *decoder = NULL;
+    stream_end_requested = false;
+    first_packet_us = 0;
+    ESP_LOGI(TAG, "Stream finished, packets: %lu, lost: %lu, late: %lu, fec: %lu, plc: %lu, dropped: %lu",
+             stream_stats.packets, stream_stats.lost, stream_stats.late,
+             stream_stats.fec_frames, stream_stats.plc_frames, jitter.dropped);
+}
+
+/**
+ * @brief 补偿一帧：优先用next中的带内FEC恢复，不含FEC或next为NULL时做PLC
+ */
+static void stream_conceal(audio_decoder_t *decoder, const stream_packet_t *next, int16_t *pcm)
+{
+    uint32_t samples = 0;
+    if (!decoder->conceal)
+    {
+        return;
+    }
+    if (next && decoder->conceal(decoder, next->data, next->len, pcm, &samples) == DECODER_OK)
+    {
+        stream_stats.fec_frames++;
+    }
+    else if (decoder->conceal(decoder, NULL, 0, pcm, &samples) == DECODER_OK)
+    {
+        stream_stats.plc_frames++;
+    }
+    else
+    {
+        return;
+    }
+    audio_output_write(AUDIO_MIX_SPEECH, pcm, samples);
+}
+
+/**
+ * @brief 按序号处理一个包：迟到包丢弃，序号缺口先补偿，损坏的包按丢包补偿
+ * 缺口不超过AUDIO_STREAM_PLC_MAX_FRAMES时逐帧补偿，紧挨本包的那一帧尝试用本包的FEC恢复；
+ * 超过时只补偿前AUDIO_STREAM_PLC_MAX_FRAMES帧，其余缺失时段直接跳过（不插入静音，避免延迟累积）
+ * @return 输出失败时返回false
+ */
+static bool stream_process_packet(audio_decoder_t *decoder, const stream_packet_t *packet, uint16_t *expected_seq, int16_t *pcm)
+{
+    int16_t gap = (int16_t)(packet->seq - *expected_seq);
+    if (gap < 0)
+    {
+        stream_stats.late++;
+        return true;
+    }
+    if (gap > 0)
+    {
+        stream_stats.lost += gap;
+        int conceal = gap < AUDIO_STREAM_PLC_MAX_FRAMES ? gap : AUDIO_STREAM_PLC_MAX_FRAMES;
+        for (int i = 0; i < conceal; i++)
+        {
+            // 本包的FEC只携带紧挨其前的一帧，缺口被截断时最后补偿的帧与本包不相邻，只能做PLC
+            stream_conceal(decoder, i == gap - 1 ? packet : NULL, pcm);
+        }
+        ESP_LOGD(TAG, "Lost %d packets before seq %u", gap, packet->seq);
+    }
+    *expected_seq = packet->seq + 1;
+
+    uint32_t samples_decoded = 0;
+    decoder_result_t result = decoder->decode_packet(decoder, packet->data, packet->len, pcm, &samples_decoded);
+    if (result == DECODER_ERROR)
+    {
+        stream_stats.lost++;
+        stream_conceal(decoder, NULL, pcm);
+        return true;
+    }
+    if (result != DECODER_OK || samples_decoded == 0)
+    {
+        return true;
+    }
+    stream_stats.packets++;
+    return audio_output_write(AUDIO_MIX_SPEECH, pcm, samples_decoded) == ESP_OK;
+}
+
+/**
+ * @brief 流式解码任务：从抖动缓冲取包、解码并写入PCM输出级
+ */
+static void audio_stream_task(void *pvParameters)
+{
+    int16_t *pcm = heap_caps_malloc(CONFIG_OPUS_FRAME_SAMPLES_MAX * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!pcm)
+    {
+        ESP_LOGE(TAG, "Failed to allocate pcm buffer");
+        vTaskDelete(NULL);
+        return;
+    }
+    audio_decoder_t *decoder = NULL;
+    bool first_frame = true;
+    uint16_t expected_seq = 0;
+    int64_t last_packet_us = 0;
+    uint32_t plc_run = 0; // 抖动缓冲为空时连续补偿的帧数
+    const uint32_t low_water = AUDIO_STREAM_PLC_LOW_WATER_MS * SAMPLE_TX_RATE / 1000;
+
+    while (1)
+    {
+        // 播放期间按固定周期醒来检查输出级水位，以便在下一包迟到时及时补帧
+        TickType_t wait = decoder ? pdMS_TO_TICKS(AUDIO_STREAM_POLL_MS)
+                                  : (jitter_count() > 0 ? pdMS_TO_TICKS(AUDIO_STREAM_IDLE_TIMEOUT_MS) : portMAX_DELAY);
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, wait);
+
+        if (stream_cancel_requested)
+        {
+            stream_cancel_requested = false;
+            while (jitter_peek() != NULL)
+            {
+                jitter_release();
+            }
+            if (decoder)
+            {
+                stream_close(&decoder);
+            }
+            audio_output_flush(AUDIO_MIX_SPEECH);
+            continue;
+        }
+
+        if (!decoder)
+        {
+            uint16_t count = jitter_count();
+            if (count == 0)
+            {
+                stream_end_requested = false;
+                continue;
+            }
+            // 预缓冲：达到设定包数后才开始播放（流已结束或等待超时则立即播放已有数据）
+            if (count < AUDIO_STREAM_PREFILL_PACKETS && notified && !stream_end_requested)
+            {
+                continue;
+            }
+            decoder = stream_open();
+            if (!decoder)
+            {
+                continue;
+            }
+            first_frame = true;
+            expected_seq = jitter_peek()->seq;
+            last_packet_us = esp_timer_get_time();
+            plc_run = 0;
+            memset(&stream_stats, 0, sizeof(stream_stats));
+        }
+
+        stream_packet_t *packet;
+        bool output_ok = true;
+        while (output_ok && !stream_cancel_requested && (packet = jitter_peek()) != NULL)
+        {
+            output_ok = stream_process_packet(decoder, packet, &expected_seq, pcm);
+            jitter_release();
+            last_packet_us = esp_timer_get_time();
+            plc_run = 0;
+            if (!output_ok)
+            {
+                ESP_LOGE(TAG, "PCM output failed");
+            }
+            else if (first_frame)
+            {
+                first_frame = false;
+                ESP_LOGI(TAG, "Time to first audio: %lld ms", (esp_timer_get_time() - first_packet_us) / 1000);
+            }
+        }
+
+        // 下一包迟到且输出级即将断流：用PLC补帧，而不是让输出级补零
+        if (!first_frame && !stream_end_requested && plc_run < AUDIO_STREAM_PLC_MAX_FRAMES &&
+            jitter_count() == 0 && audio_output_get_buffered(AUDIO_MIX_SPEECH) < low_water)
+        {
+            stream_conceal(decoder, NULL, pcm);
+            plc_run++;
+#if AUDIO_STREAM_SEQ_HEADER
+            // 有序号时该时段视为已播放，对应的包之后到达时作为迟到包丢弃
+            expected_seq++;
+#endif
+        }
+
+        // 超时未收到新包，或服务器已通知结束且缓冲已空：结束本次流
+        if (esp_timer_get_time() - last_packet_us > AUDIO_STREAM_IDLE_TIMEOUT_MS * 1000LL ||
+            (stream_end_requested && jitter_count() == 0))
+        {
+            stream_close(&decoder);
+        }
+    }
+}
+
+/**
+ * @brief 获取当前（或上一次）流的丢包与补偿统计
+ */
+void audio_stream_get_stats(audio_stream_stats_t *stats)
+{
+    *stats = stream_stats;
+    stats->dropped = jitter.dropped;
+}
+
+/**
+ * @brief 初始化流式播放：分配PSRAM抖动缓冲并创建解码任务
+ */
+esp_err_t audio_stream_init(void)
+{
+    if (stream_task_handle)
+    {
+        return ESP_OK;
+    }
+    esp_err_t ret = audio_output_init(AUDIO_DECODE_AHEAD_MS);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = audio_decoder_pool_init();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    jitter.slots = heap_caps_calloc(AUDIO_STREAM_JITTER_SLOTS, sizeof(stream_packet_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!jitter.slots)
+    {
+        ESP_LOGE(TAG, "Failed to allocate jitter buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    jitter.head = 0;
+    jitter.tail = 0;
+    jitter.count = 0;
+    jitter.dropped = 0;
+    jitter.discarding = false;
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(audio_stream_task, "audio_stream", 10 * 1024, NULL, 4, &stream_task_handle, 1);
+    if (ret_val != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed create audio stream task");
+        free(jitter.slots);
+        jitter.slots = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,4 @@
+#pragma once
+#include <stdbool.h>
+
+typedef bool (*i2s_isr_callback_t)(void *handle, void *event, void *user_ctx);
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+// 与esp-dsp的ANSI实现（dsps_mulc_s16_ansi）相同的定点语义：(x * C) >> 15
+static inline esp_err_t dsps_mulc_s16(const int16_t *input, int16_t *output, int len, int16_t C, int step_in, int step_out)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int32_t acc = (int32_t)input[i * step_in] * (int32_t)C;
+        output[i * step_out] = (int16_t)(acc >> 15);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+// 主机上以时间戳计数器代替CPU周期计数（x86为TSC，其余平台为纳秒）
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return (uint32_t)__rdtsc();
+}
+#else
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#endif
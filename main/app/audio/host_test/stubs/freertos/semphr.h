@@ -0,0 +1,3 @@
+#pragma once
+
+typedef void *SemaphoreHandle_t;
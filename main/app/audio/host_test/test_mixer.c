@@ -0,0 +1,154 @@
+/*
+ * 混音级主机测试（make -C main/app/audio/host_test test）
+ * 混音结果与本文件中独立编写的标量参考实现逐位比较
+ */
+#include "audio.h"
+#include "audio_private.h"
+#include "bsp_board.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                          \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+            failures++;                                                \
+        }                                                              \
+    } while (0)
+
+static uint32_t seed = 0x2468ace1;
+
+static int16_t random_sample(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return (int16_t)(seed >> 16);
+}
+
+/**
+ * @brief 标量参考：第i个采样的增益为(g0 * 65536 + i * step) >> 16，step = (g1 - g0) * 65536 / n（向零取整），
+ * 加权(x * g) >> 15后各路累加，最后饱和到int16
+ */
+static void reference_mix(int16_t *out, const int16_t *const inputs[AUDIO_MIX_STREAMS],
+                          const int16_t *g0, const int16_t *g1, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int64_t acc = 0;
+        for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+        {
+            if (!inputs[s])
+            {
+                continue;
+            }
+            int64_t step = ((int64_t)g1[s] - g0[s]) * 65536 / (int64_t)n;
+            int64_t gain = ((int64_t)g0[s] * 65536 + (int64_t)i * step) >> 16;
+            acc += ((int64_t)inputs[s][i] * gain) >> 15;
+        }
+        out[i] = acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : (int16_t)acc;
+    }
+}
+
+/**
+ * @brief 随机输入（含满幅）、随机定增益与升降过渡、各种块长下与参考实现逐位一致
+ */
+static void test_bit_exact(void)
+{
+    static int16_t input[AUDIO_MIX_STREAMS][AUDIO_MIXER_MAX_BLOCK];
+    static int16_t expected[AUDIO_MIXER_MAX_BLOCK];
+    static int16_t out[AUDIO_MIXER_MAX_BLOCK];
+    const int16_t *inputs[AUDIO_MIX_STREAMS];
+    const int16_t edge_gains[] = {0, 1, 8192, 32767};
+
+    for (int round = 0; round < 2000; round++)
+    {
+        uint32_t n = round < 4 ? (uint32_t[]){1, 2, 255, AUDIO_MIXER_MAX_BLOCK}[round]
+                               : 1 + (uint32_t)(random_sample() & 0x7fff) % AUDIO_MIXER_MAX_BLOCK;
+        int16_t g0[AUDIO_MIX_STREAMS];
+        int16_t g1[AUDIO_MIX_STREAMS];
+        for (int s = 0; s < AUDIO_MIX_STREAMS; s++)
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                uint32_t pick = random_sample() & 63;
+                input[s][i] = pick == 0 ? INT16_MIN : pick == 1 ? INT16_MAX : random_sample();
+            }
+            // 轮流覆盖：该路无数据、定增益、升增益、降增益
+            inputs[s] = (round + s) % 7 == 0 ? NULL : input[s];
+            g0[s] = round & 1 ? edge_gains[(round / 2 + s) % 4] : random_sample() & 0x7fff;
+            g1[s] = (round + s) % 3 == 0 ? g0[s] : random_sample() & 0x7fff;
+        }
+        reference_mix(expected, inputs, g0, g1, n);
+        audio_mixer_mix(out, inputs, g0, g1, n);
+        CHECK(memcmp(expected, out, n * sizeof(int16_t)) == 0, "round %d: %u samples, gains %d->%d / %d->%d",
+              round, n, g0[0], g1[0], g0[1], g1[1]);
+        audio_mixer_mix_ref(out, inputs, g0, g1, n);
+        CHECK(memcmp(expected, out, n * sizeof(int16_t)) == 0, "round %d: mix_ref differs", round);
+    }
+    CHECK(audio_mixer_selftest(), "audio_mixer_selftest failed");
+}
+
+/**
+ * @brief 以直流输入观察实际增益：音量变化按斜坡过渡，提示音出现时语音流被压低到AUDIO_MIXER_DUCK_GAIN
+ */
+static void test_ramp_and_duck(void)
+{
+    static int16_t speech[AUDIO_MIXER_MAX_BLOCK];
+    static int16_t earcon[AUDIO_MIXER_MAX_BLOCK];
+    static int16_t out[AUDIO_MIXER_MAX_BLOCK];
+    const uint32_t block = 240;
+    const int16_t *inputs[AUDIO_MIX_STREAMS] = {0};
+    const int32_t unity = (32767 * 32767) >> 15;              // 用户音量 × 主音量（均为100）
+    const int32_t ducked = (unity * AUDIO_MIXER_DUCK_GAIN) >> 15;
+
+    for (uint32_t i = 0; i < block; i++)
+    {
+        speech[i] = 16384;
+    }
+    audio_mixer_init();
+    inputs[AUDIO_MIX_SPEECH] = speech;
+    audio_mixer_process(out, inputs, block);
+    CHECK(out[block - 1] == (16384 * unity) >> 15, "unity gain: %d", out[block - 1]);
+
+    // 静音：每块增益最多下降满幅的block/RAMP，跨块连续
+    audio_mixer_set_volume(AUDIO_MIX_SPEECH, 0);
+    int prev = out[block - 1];
+    uint32_t blocks = 0;
+    do
+    {
+        audio_mixer_process(out, inputs, block);
+        for (uint32_t i = 0; i < block; i++)
+        {
+            CHECK(out[i] <= prev, "ramp down not monotonic at block %u", blocks);
+            prev = out[i];
+        }
+        blocks++;
+    } while (out[block - 1] != 0 && blocks < 100);
+    // 斜坡在第RAMP/block块末尾到达0，下一块整块为0
+    CHECK(blocks == AUDIO_MIXER_RAMP_SAMPLES / block + 1, "muted after %u blocks", blocks);
+
+    // 提示音出现时语音流只降到闪避增益
+    audio_mixer_set_volume(AUDIO_MIX_SPEECH, 100);
+    inputs[AUDIO_MIX_EARCON] = earcon;
+    for (int i = 0; i < 10; i++)
+    {
+        audio_mixer_process(out, inputs, block);
+    }
+    CHECK(out[block - 1] == (16384 * ducked) >> 15, "ducked: %d", out[block - 1]);
+    inputs[AUDIO_MIX_EARCON] = NULL;
+    for (int i = 0; i < 10; i++)
+    {
+        audio_mixer_process(out, inputs, block);
+    }
+    CHECK(out[block - 1] == (16384 * unity) >> 15, "unducked: %d", out[block - 1]);
+}
+
+int main(void)
+{
+    test_bit_exact();
+    test_ramp_and_duck();
+    printf("%s: %d failure(s)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
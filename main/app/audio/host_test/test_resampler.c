@@ -0,0 +1,160 @@
+/*
+ * 重采样器主机测试与基准（make -C main/app/audio/host_test test）
+ * 直接包含被测源文件，以便复用其中的信噪比测量函数
+ */
+#include "../audio_resampler.c"
+
+static int failures = 0;
+
+#define CHECK(cond, fmt, ...)                                          \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+            failures++;                                                \
+        }                                                              \
+    } while (0)
+
+static const uint32_t test_rates[] = {8000, 16000, 22050, 44100, 48000};
+
+static void fill_sine(int16_t *pcm, uint32_t samples, double freq, uint32_t rate)
+{
+    for (uint32_t n = 0; n < samples; n++)
+    {
+        pcm[n] = (int16_t)lrint(16000 * sin(2 * M_PI * freq * n / rate));
+    }
+}
+
+/**
+ * @brief 分块方式不影响输出：一次处理与不规则分块处理的结果逐位一致，输出长度与采样率之比相符
+ */
+static void test_chunking(void)
+{
+    const uint32_t total = 9000;
+    const uint32_t max_input = 1152;
+    const uint32_t chunks[] = {1, 7, 160, 511, 1152, 33};
+    int16_t *in = malloc(total * sizeof(int16_t));
+    int16_t *out_a = malloc((total * 4 + 64) * sizeof(int16_t));
+    int16_t *out_b = malloc((total * 4 + 64) * sizeof(int16_t));
+
+    for (int r = 0; r < sizeof(test_rates) / sizeof(test_rates[0]); r++)
+    {
+        fill_sine(in, total, 440.0, test_rates[r]);
+        audio_resampler_t *a = audio_resampler_create(test_rates[r], SAMPLE_TX_RATE, 0, max_input);
+        audio_resampler_t *b = audio_resampler_create(test_rates[r], SAMPLE_TX_RATE, 0, max_input);
+        uint32_t produced_a = 0;
+        uint32_t produced_b = 0;
+        for (uint32_t off = 0; off < total; off += max_input)
+        {
+            uint32_t n = total - off < max_input ? total - off : max_input;
+            uint32_t bound = audio_resampler_max_output(a, n);
+            uint32_t produced = audio_resampler_process(a, in + off, n, out_a + produced_a);
+            CHECK(produced <= bound, "%u Hz: %u outputs exceed bound %u", test_rates[r], produced, bound);
+            produced_a += produced;
+        }
+        for (uint32_t off = 0, c = 0; off < total; c++)
+        {
+            uint32_t n = chunks[c % (sizeof(chunks) / sizeof(chunks[0]))];
+            if (n > total - off)
+            {
+                n = total - off;
+            }
+            produced_b += audio_resampler_process(b, in + off, n, out_b + produced_b);
+            off += n;
+        }
+        CHECK(produced_a == produced_b, "%u Hz: %u vs %u outputs", test_rates[r], produced_a, produced_b);
+        CHECK(memcmp(out_a, out_b, produced_a * sizeof(int16_t)) == 0, "%u Hz: chunked output differs", test_rates[r]);
+
+        // 历史中预置了taps-1个零，每个输入采样都已对应到输出
+        double expected = (double)total * SAMPLE_TX_RATE / test_rates[r];
+        CHECK(fabs(produced_a - expected) <= 2,
+              "%u Hz: %u outputs, expected about %.0f", test_rates[r], produced_a, expected);
+        audio_resampler_destroy(a);
+        audio_resampler_destroy(b);
+    }
+    free(in);
+    free(out_a);
+    free(out_b);
+}
+
+/**
+ * @brief 默认抽头数下1kHz正弦的信噪比下限，以及输出幅度（直流增益）基本不变
+ */
+static void test_quality(void)
+{
+    const uint32_t total = 16384;
+    int16_t *in = malloc(total * sizeof(int16_t));
+    int16_t *out = malloc((total * 4 + 64) * sizeof(int16_t));
+
+    for (int r = 0; r < sizeof(test_rates) / sizeof(test_rates[0]); r++)
+    {
+        fill_sine(in, total, 1000.0, test_rates[r]);
+        audio_resampler_t *rs = audio_resampler_create(test_rates[r], SAMPLE_TX_RATE, AUDIO_RESAMPLER_TAPS, total);
+        uint32_t produced = audio_resampler_process(rs, in, total, out);
+        uint32_t skip = rs->taps * 2;
+        double snr = resampler_measure_snr(out + skip, produced - skip, 1000.0, SAMPLE_TX_RATE);
+        int16_t peak = 0;
+        for (uint32_t n = skip; n < produced; n++)
+        {
+            peak = out[n] > peak ? out[n] : peak;
+        }
+        CHECK(snr >= 45.0, "%u Hz: SNR %.1f dB", test_rates[r], snr);
+        CHECK(abs(peak - 16000) < 16000 / 50, "%u Hz: peak %d, expected about 16000", test_rates[r], peak);
+        audio_resampler_destroy(rs);
+    }
+    free(in);
+    free(out);
+}
+
+typedef struct {
+    const int16_t *last_pcm;
+    uint32_t samples;
+    uint32_t calls;
+} capture_sink_t;
+
+static esp_err_t capture_sink(void *arg, const int16_t *pcm, uint32_t samples)
+{
+    capture_sink_t *sink = (capture_sink_t *)arg;
+    sink->last_pcm = pcm;
+    sink->samples += samples;
+    sink->calls++;
+    return ESP_OK;
+}
+
+/**
+ * @brief 格式转换级：输出格式的单声道直接透传（不拷贝），双声道48kHz混为单声道并降到输出采样率
+ */
+static void test_format_stage(void)
+{
+    static int16_t pcm[2 * 4800];
+    audio_format_stage_t stage = {0};
+    capture_sink_t sink = {0};
+
+    audio_info_t mono = {.sample_rate = SAMPLE_TX_RATE, .channels = 1};
+    CHECK(audio_format_stage_write(&stage, &mono, pcm, 1000, capture_sink, &sink) == ESP_OK, "passthrough failed");
+    CHECK(sink.last_pcm == pcm && sink.samples == 1000, "passthrough copied or changed the data");
+    CHECK(stage.resampler == NULL, "passthrough created a resampler");
+
+    memset(&sink, 0, sizeof(sink));
+    audio_info_t stereo = {.sample_rate = 48000, .channels = 2};
+    for (uint32_t blocks = 0; blocks < 10; blocks++)
+    {
+        CHECK(audio_format_stage_write(&stage, &stereo, pcm, 2 * 4800, capture_sink, &sink) == ESP_OK, "resample failed");
+    }
+    double expected = 10.0 * 4800 * SAMPLE_TX_RATE / 48000;
+    CHECK(fabs(sink.samples - expected) <= AUDIO_RESAMPLER_TAPS, "stereo 48 kHz: %u outputs, expected about %.0f",
+          sink.samples, expected);
+    audio_format_stage_deinit(&stage);
+}
+
+int main(void)
+{
+    test_chunking();
+    test_quality();
+    test_format_stage();
+    // 输出各输入采样率、抽头数下的每输出采样周期数与信噪比（主机上周期为时间戳计数）
+    audio_resampler_benchmark();
+    printf("%s: %d failure(s)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
@@ -1,9 +1,15 @@
-#ifdef Helix_mp3
 #include "audio.h"
 #include "audio_private.h"
+#include "esp_log.h"
 
+#if CONFIG_USE_HELIX_MP3
 #include "mp3dec.h"
 
+static const char *TAG = "mp3_decoder";
+
+// Helix使用静态缓冲（buffers.c），同一时刻只能存在一个解码器实例
+static bool mp3_instance_active = false;
+
 typedef struct {
     HMP3Decoder mp3_decoder;
     MP3FrameInfo mp3_frame_info;
@@ -16,7 +22,7 @@ typedef struct {
     bool first_read;
 } mp3_context_t;
 
-uint32_t mp3_get_id3v2_size(const uint8_t *buf)
+static uint32_t mp3_get_id3v2_size(const uint8_t *buf)
 {
     if (buf == NULL) {
         return 0;
@@ -31,6 +37,10 @@ uint32_t mp3_get_id3v2_size(const uint8_t *buf)
 
 static decoder_result_t mp3_init(audio_decoder_t *decoder)
 {
+    if (mp3_instance_active) {
+        ESP_LOGE(TAG, "[MP3] Only one decoder instance is supported");
+        return DECODER_ERROR;
+    }
     mp3_context_t *ctx = malloc(sizeof(mp3_context_t));
     if (!ctx) return DECODER_ERROR;
     
@@ -52,64 +62,119 @@ static decoder_result_t mp3_init(audio_decoder_t *decoder)
     }
     
     ctx->first_read = true;
+    ctx->read_ptr = ctx->input_buffer;
     decoder->info.sample_rate = CONFIG_MP3_AUDIO_SAMPLE_RATE;
     decoder->info.channels = CONFIG_MP3_AUDIO_CHANNELS;
+    mp3_instance_active = true;
     
-    LOG_INF("[MP3] Decoder initialized");
+    ESP_LOGI(TAG, "[MP3] Decoder initialized");
+    return DECODER_OK;
+}
+
+/**
+ * @brief 从数据源补充输入缓冲，保留未消费的数据
+ */
+static decoder_result_t mp3_fill_buffer(mp3_context_t *ctx, audio_source_t *src)
+{
+    memmove(ctx->input_buffer, ctx->read_ptr, ctx->bytes_left);
+    uint32_t fill_size = ctx->buffer_size - ctx->bytes_left;
+    int br = src->read(src, ctx->input_buffer + ctx->bytes_left, fill_size);
+
+    if (br < 0) return DECODER_ERROR;
+
+    if ((uint32_t)br < fill_size) {
+        memset(ctx->input_buffer + ctx->bytes_left + br, 0, fill_size - br);
+    }
+
+    if (br == 0 && ctx->bytes_left == 0) {
+        return DECODER_EOF;
+    }
+
+    ctx->bytes_left = ctx->bytes_left + br;
+    ctx->read_ptr = ctx->input_buffer;
     return DECODER_OK;
 }
 
-static decoder_result_t mp3_decode_frame(audio_decoder_t *decoder, spiffs_file *file, int16_t *output, uint32_t *samples_decoded)
+static decoder_result_t mp3_decode_frame(audio_decoder_t *decoder, audio_source_t *src, int16_t *output, uint32_t *samples_decoded)
 {
     mp3_context_t *ctx = (mp3_context_t *)decoder->context;
     
     if (ctx->first_read) {
-        fs_seek(file, 0, FS_SEEK_SET);
-        size_t br = fs_read(file, ctx->input_buffer, ctx->buffer_size);
+        uint8_t header[10];
+        int br = src->peek(src, header, sizeof(header));
         if (br <= 0) return DECODER_EOF;
         
-        ctx->id3v2_size = mp3_get_id3v2_size(ctx->input_buffer);
-        LOG_INF("[MP3] ID3v2 size: %d", ctx->id3v2_size);
+        if (br == sizeof(header)) {
+            ctx->id3v2_size = mp3_get_id3v2_size(header);
+        }
+        ESP_LOGI(TAG, "[MP3] ID3v2 size: %ld", ctx->id3v2_size);
         
-        fs_seek(file, ctx->id3v2_size, FS_SEEK_SET);
-        br = fs_read(file, ctx->input_buffer, ctx->buffer_size);
-        if (br <= 0) return DECODER_EOF;
+        // 标签大小不含10字节的标签头
+        if (ctx->id3v2_size > 0) {
+            src->skip(src, ctx->id3v2_size + sizeof(header));
+        }
         
-        ctx->bytes_left = br;
+        ctx->bytes_left = 0;
         ctx->read_ptr = ctx->input_buffer;
         ctx->first_read = false;
     }
     
-    if (ctx->bytes_left < CONFIG_MP3_MAX_FRAME_BYTES) {
-        memmove(ctx->input_buffer, ctx->read_ptr, ctx->bytes_left);
-        uint32_t fill_size = ctx->buffer_size - ctx->bytes_left;
-        size_t br = fs_read(file, ctx->input_buffer + ctx->bytes_left, fill_size);
-        
-        if (br < 0) return DECODER_ERROR;
-        
-        if (br < fill_size) {
-            memset(ctx->input_buffer + ctx->bytes_left + br, 0, fill_size - br);
-        }
-        
-        if (br == 0 && ctx->bytes_left == 0) {
-            return DECODER_EOF;
+    // 零拷贝：输入缓冲已取空且数据源连续区域足够一帧时，直接在数据源上解码
+    const uint8_t *span = NULL;
+    int span_len = 0;
+    if (ctx->bytes_left == 0 && src->span) {
+        span_len = src->span(src, &span);
+        if (span_len < 0) return DECODER_ERROR;
+        if (span_len == 0) return DECODER_EOF;
+    }
+    
+    uint8_t *in_ptr;
+    int in_left;
+    if (span_len >= CONFIG_MP3_MAX_FRAME_BYTES) {
+        in_ptr = (uint8_t *)span; // MP3Decode只读取输入数据
+        in_left = span_len;
+    } else {
+        if (ctx->bytes_left < CONFIG_MP3_MAX_FRAME_BYTES) {
+            decoder_result_t fill_ret = mp3_fill_buffer(ctx, src);
+            if (fill_ret != DECODER_OK) return fill_ret;
         }
-        
-        ctx->bytes_left = ctx->bytes_left + br;
-        ctx->read_ptr = ctx->input_buffer;
+        in_ptr = ctx->read_ptr;
+        in_left = ctx->bytes_left;
     }
     
-    int offset = MP3FindSyncWord(ctx->read_ptr, ctx->bytes_left);
+    int offset = MP3FindSyncWord(in_ptr, in_left);
     if (offset == -1) {
-        return DECODER_EOF;
+        // 当前数据中没有同步字：丢弃并读取更多数据，保留最后一个字节以免漏掉跨边界的同步字
+        if (span_len >= CONFIG_MP3_MAX_FRAME_BYTES) {
+            src->skip(src, span_len - 1);
+            return DECODER_HEADER_ONLY;
+        }
+        if (in_left <= 1) {
+            return DECODER_EOF; // 刚补充过缓冲仍不足两个字节，数据源已读完
+        }
+        ctx->read_ptr = in_ptr + in_left - 1;
+        ctx->bytes_left = 1;
+        return DECODER_HEADER_ONLY;
     }
     
-    ctx->read_ptr += offset;
-    ctx->bytes_left -= offset;
+    in_ptr += offset;
+    in_left -= offset;
+    
+    int ret = MP3Decode(ctx->mp3_decoder, &in_ptr, &in_left, output, 0);
+    
+    if (span_len >= CONFIG_MP3_MAX_FRAME_BYTES) {
+        src->skip(src, span_len - in_left);
+    } else {
+        ctx->read_ptr = in_ptr;
+        ctx->bytes_left = in_left;
+    }
     
-    int ret = MP3Decode(ctx->mp3_decoder, &ctx->read_ptr, &ctx->bytes_left, output, 0);
+    if (ret == ERR_MP3_MAINDATA_UNDERFLOW) {
+        // 比特池数据不足（如流开头），跳过本帧
+        return DECODER_HEADER_ONLY;
+    }
     if (ret != ERR_MP3_NONE) {
-        LOG_ERR("[MP3] Decode error: %d", ret);
+        ESP_LOGE(TAG, "[MP3] Decode error: %d", ret);
         return DECODER_ERROR;
     }
     
@@ -119,18 +184,29 @@ static decoder_result_t mp3_decode_frame(audio_decoder_t *decoder, spiffs_file *
     decoder->info.sample_rate = ctx->mp3_frame_info.samprate;
     decoder->info.channels = ctx->mp3_frame_info.nChans;
     
-    if (ctx->mp3_frame_info.nChans == 1) {
-        if (pcm_samples > 0 && pcm_samples <= 576) {
-            for (int i = pcm_samples - 1; i >= 0; i--) {
-                output[i * 2] = output[i];
-                output[i * 2 + 1] = output[i];
-            }
-            pcm_samples *= 2;
-        }
-    }
-    
+    // 按码流原生格式输出（outputSamps为所有声道合计），由格式转换级混音/重采样
     *samples_decoded = pcm_samples;
-    // LOG_DBG("[MP3] Decoded %d samples, SR=%d, CH=%d", pcm_samples, decoder->info.sample_rate, decoder->info.channels);
+    return DECODER_OK;
+}
+
+/**
+ * @brief 复位解码器以播放新的数据流：重新初始化Helix状态（静态缓冲，不涉及分配）
+ */
+static decoder_result_t mp3_reset(audio_decoder_t *decoder)
+{
+    mp3_context_t *ctx = (mp3_context_t *)decoder->context;
+    if (!ctx) {
+        return DECODER_ERROR;
+    }
+    MP3FreeDecoder(ctx->mp3_decoder);
+    ctx->mp3_decoder = MP3InitDecoder();
+    if (!ctx->mp3_decoder) {
+        return DECODER_ERROR;
+    }
+    ctx->first_read = true;
+    ctx->read_ptr = ctx->input_buffer;
+    ctx->bytes_left = 0;
+    ctx->id3v2_size = 0;
     return DECODER_OK;
 }
 
@@ -145,15 +221,42 @@ static void mp3_deinit(audio_decoder_t *decoder)
             free(ctx->input_buffer);
         }
         free(ctx);
+        mp3_instance_active = false;
     }
 }
 
-void decoder_ops_register (audio_decoder_t *decoder)
+static void mp3_ops_register(audio_decoder_t *decoder)
 {
     decoder->init = mp3_init;
     decoder->decode_frame = mp3_decode_frame;
+    decoder->reset = mp3_reset;
     decoder->deinit = mp3_deinit;
-    LOG_INF("[MP3] Decoder operations registered successfully");
 }
 
-#endif
\ No newline at end of file
+/**
+ * @brief ID3v2标签或MPEG Layer III帧同步字
+ */
+static bool mp3_probe(const uint8_t *head, size_t len)
+{
+    if (len >= 3 && memcmp(head, "ID3", 3) == 0) {
+        return true;
+    }
+    return len >= 2 && head[0] == 0xFF && (head[1] & 0xE0) == 0xE0 && ((head[1] >> 1) & 0x03) == 0x01;
+}
+
+static const audio_codec_desc_t mp3_codec = {
+    .name = "mp3",
+    .codec = AUDIO_CODEC_MP3,
+    .probe = mp3_probe,
+    .ops_register = mp3_ops_register,
+    .input_chunk = CONFIG_MP3_FILE_BUFF_SIZE,
+    .max_frame_samples = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP,
+    .flexible_output = false,
+};
+
+void mp3_decoder_port_register(void)
+{
+    audio_codec_register(&mp3_codec);
+}
+
+#endif /* CONFIG_USE_HELIX_MP3 */
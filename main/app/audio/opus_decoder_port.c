@@ -1,13 +1,19 @@
-
 #include "audio.h"
 #include "audio_private.h"
 #include "esp_log.h"
 
 #include "ogg.h"
 #include "opus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "opus_decoder";
 
+#if CONFIG_NONTHREADSAFE_PSEUDOSTACK
+static SemaphoreHandle_t opus_mutex = NULL;
+static portMUX_TYPE opus_mutex_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
 typedef struct {
     ogg_sync_state ogsync;
     ogg_stream_state ogstream;
@@ -18,8 +24,66 @@ typedef struct {
     bool has_found_opus_header;
     bool has_pending_packet;
     uint8_t read_page_cnt;
+    uint32_t decoder_rate;     // opus_decoder当前的输出采样率
+    uint8_t decoder_channels;  // opus_decoder当前的输出声道数
 } opus_context_t;
 
+/**
+ * @brief 进入Opus编解码临界区
+ * 伪栈模式下所有编解码器实例共用一块全局临时内存，不同任务的opus_decode/opus_encode
+ * 交错执行会互相破坏，因此需串行化；VAR_ARRAYS/alloca模式下为空操作
+ */
+void audio_opus_lock(void)
+{
+#if CONFIG_NONTHREADSAFE_PSEUDOSTACK
+    if (!opus_mutex) {
+        SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&opus_mutex_lock);
+        if (!opus_mutex) {
+            opus_mutex = mutex;
+            mutex = NULL;
+        }
+        portEXIT_CRITICAL(&opus_mutex_lock);
+        if (mutex) {
+            vSemaphoreDelete(mutex);
+        }
+    }
+    xSemaphoreTake(opus_mutex, portMAX_DELAY);
+#endif
+}
+
+void audio_opus_unlock(void)
+{
+#if CONFIG_NONTHREADSAFE_PSEUDOSTACK
+    xSemaphoreGive(opus_mutex);
+#endif
+}
+
+/**
+ * @brief 按指定输出格式准备Opus解码器：格式一致时复用已有实例，否则重新创建
+ */
+static decoder_result_t opus_prepare_decoder(opus_context_t *ctx, uint32_t sample_rate, uint8_t channels)
+{
+    int err;
+    if (ctx->opus_decoder && ctx->decoder_rate == sample_rate && ctx->decoder_channels == channels) {
+        return DECODER_OK;
+    }
+    if (ctx->opus_decoder) {
+        opus_decoder_destroy(ctx->opus_decoder);
+        ctx->opus_decoder = NULL;
+    }
+    ctx->opus_decoder = opus_decoder_create(sample_rate, channels, &err);
+    if (err != OPUS_OK || !ctx->opus_decoder) {
+        ESP_LOGE(TAG, "[OPUS] Decoder create failed: %s", opus_strerror(err));
+        ctx->opus_decoder = NULL;
+        return DECODER_ERROR;
+    }
+    ctx->decoder_rate = sample_rate;
+    ctx->decoder_channels = channels;
+    ESP_LOGI(TAG, "[OPUS] Decoder created: %ld Hz, %d ch", sample_rate, channels);
+    return DECODER_OK;
+}
+
 static decoder_result_t opus_init(audio_decoder_t *decoder)
 {
     ESP_LOGI(TAG, "[OPUS] Decoder intialization started");
@@ -43,10 +107,49 @@ static decoder_result_t opus_init(audio_decoder_t *decoder)
     return DECODER_OK;
 }
 
-static decoder_result_t opus_decode_frame(audio_decoder_t *decoder, FILE *file, int16_t *output, uint32_t *samples_decoded)
+/**
+ * @brief 从数据源向ogg同步缓冲补充数据
+ * 支持零拷贝的数据源（整体载入内存的文件）直接从其连续区域拷入同步缓冲，
+ * 省去stdio缓冲和中间缓冲的两次拷贝
+ * @return 写入字节数，0表示数据结束，负数表示错误
+ */
+static int opus_fill_sync(opus_context_t *ctx, audio_source_t *src)
+{
+    int bytes_read;
+    if (src->span) {
+        const uint8_t *data = NULL;
+        bytes_read = src->span(src, &data);
+        if (bytes_read <= 0) {
+            return bytes_read;
+        }
+        if (bytes_read > CONFIG_OPUS_FILE_BUFF_SIZE) {
+            bytes_read = CONFIG_OPUS_FILE_BUFF_SIZE;
+        }
+        char *buffer = ogg_sync_buffer(&ctx->ogsync, bytes_read);
+        if (!buffer) {
+            return -1;
+        }
+        memcpy(buffer, data, bytes_read);
+        src->skip(src, bytes_read);
+    } else {
+        char *buffer = ogg_sync_buffer(&ctx->ogsync, CONFIG_OPUS_FILE_BUFF_SIZE);
+        if (!buffer) {
+            return -1;
+        }
+        bytes_read = src->read(src, buffer, CONFIG_OPUS_FILE_BUFF_SIZE);
+        if (bytes_read <= 0) {
+            return bytes_read;
+        }
+    }
+    if (ogg_sync_wrote(&ctx->ogsync, bytes_read) < 0) {
+        return -1;
+    }
+    return bytes_read;
+}
+
+static decoder_result_t opus_decode_frame(audio_decoder_t *decoder, audio_source_t *src, int16_t *output, uint32_t *samples_decoded)
 {
     opus_context_t *ctx = (opus_context_t *)decoder->context;
-    int err;
     
     while (1) {
         if (ctx->has_pending_packet) {
@@ -74,6 +177,9 @@ static decoder_result_t opus_decode_frame(audio_decoder_t *decoder, FILE *file,
                 }
                 ctx->stream_inited = true;
                 ESP_LOGI(TAG, "[OPUS] Stream initialized, serial: %d", ogg_page_serialno(&ctx->current_page));
+            } else if (ogg_page_bos(&ctx->current_page) && ogg_page_serialno(&ctx->current_page) != ctx->ogstream.serialno) {
+                // 复用的解码器播放新文件：沿用已分配的流状态，只切换序列号
+                ogg_stream_reset_serialno(&ctx->ogstream, ogg_page_serialno(&ctx->current_page));
             }
             
             if (ogg_stream_pagein(&ctx->ogstream, &ctx->current_page) < 0) {
@@ -82,29 +188,16 @@ static decoder_result_t opus_decode_frame(audio_decoder_t *decoder, FILE *file,
             }
             continue;
         } else if (page_ret == 0) {
-            char *buffer = ogg_sync_buffer(&ctx->ogsync, CONFIG_OPUS_FILE_BUFF_SIZE);
-            if (!buffer) {
-                ESP_LOGE(TAG, "[OPUS] Sync buffer failed");
-                return DECODER_ERROR;
-            }
-            
-            size_t bytes_read = fread(buffer, 1, CONFIG_OPUS_FILE_BUFF_SIZE, file);
+            int bytes_read = opus_fill_sync(ctx, src);
             if (bytes_read < 0) {
-                ESP_LOGE(TAG, "[OPUS] File read error");
+                ESP_LOGE(TAG, "[OPUS] Source read error");
                 return DECODER_ERROR;
             }
-            ESP_LOGI(TAG, "[OPUS] Read %d bytes from file", (int)bytes_read);
             if (bytes_read == 0) {
-                ESP_LOGI(TAG, "[OPUS] End of file");
+                ESP_LOGI(TAG, "[OPUS] End of stream");
                 return DECODER_EOF;
             }
-            
-            if (ogg_sync_wrote(&ctx->ogsync, bytes_read) < 0) {
-                ESP_LOGE(TAG, "[OPUS] Sync wrote failed");
-                return DECODER_ERROR;
-            }
-            ESP_LOGI(TAG, "[OPUS] Sync wrote %d bytes", (int)bytes_read);
-            // LOG_DBG("[OPUS] Read %d bytes from file", (int)bytes_read);
+            ESP_LOGD(TAG, "[OPUS] Sync wrote %d bytes", bytes_read);
             continue;
         } else {
             // ESP_LOGE(TAG, "[OPUS] Page sync error: %d", page_ret);
@@ -119,32 +212,20 @@ decode_packet:
         if (ctx->current_packet.bytes >= 8 && memcmp(ctx->current_packet.packet, "OpusHead", 8) == 0) {
             ESP_LOGI(TAG, "[OPUS] Found OpusHead header");
             
-            if (ctx->current_packet.bytes >= 10) {
-                decoder->info.channels = ctx->current_packet.packet[9];
-                ESP_LOGI(TAG, "[OPUS] Channels: %d", decoder->info.channels);
-            }
-            
+            // OpusHead中的采样率只是原始输入采样率，Opus可按任意支持的采样率/声道数解码，
+            // 因此输出格式沿用decoder->info（由调用方按I2S输出格式指定），省去重采样
             if (ctx->current_packet.bytes >= 16) {
                 uint8_t *sr_bytes = ctx->current_packet.packet + 12;
-                decoder->info.sample_rate = (uint32_t)sr_bytes[0] | 
-                                          (uint32_t)sr_bytes[1] << 8 |
-                                          (uint32_t)sr_bytes[2] << 16 | 
-                                          (uint32_t)sr_bytes[3] << 24;
-                
-                ESP_LOGI(TAG, "[OPUS] Sample rate: %ld Hz", decoder->info.sample_rate);
-                
-                if (decoder->info.sample_rate < 8000 || decoder->info.sample_rate > 48000) {
-                    ESP_LOGE(TAG, "[OPUS] Invalid sample rate: %ld", decoder->info.sample_rate);
-                    return DECODER_ERROR;
-                }
-                
-                ctx->opus_decoder = opus_decoder_create(decoder->info.sample_rate, decoder->info.channels, &err);
-                if (err != OPUS_OK || !ctx->opus_decoder) {
-                    ESP_LOGE(TAG, "[OPUS] Decoder create failed: %s", opus_strerror(err));
-                    return DECODER_ERROR;
-                }
-                
-                ESP_LOGI(TAG, "[OPUS] Decoder created successfully");
+                uint32_t input_rate = (uint32_t)sr_bytes[0] |
+                                      (uint32_t)sr_bytes[1] << 8 |
+                                      (uint32_t)sr_bytes[2] << 16 |
+                                      (uint32_t)sr_bytes[3] << 24;
+                ESP_LOGI(TAG, "[OPUS] Channels: %d, input rate: %ld Hz, output: %ld Hz %d ch",
+                         ctx->current_packet.packet[9], input_rate, decoder->info.sample_rate, decoder->info.channels);
+            }
+            
+            if (opus_prepare_decoder(ctx, decoder->info.sample_rate, decoder->info.channels) != DECODER_OK) {
+                return DECODER_ERROR;
             }
             return DECODER_HEADER_ONLY;
         }
@@ -164,7 +245,9 @@ decode_packet:
         return DECODER_HEADER_ONLY;
     }
     
-    opus_int32 output_samples = opus_decode(ctx->opus_decoder, ctx->current_packet.packet, ctx->current_packet.bytes,output, CONFIG_OPUS_FRAME_SAMPLES_MAX, 0);
+    audio_opus_lock();
+    opus_int32 output_samples = opus_decode(ctx->opus_decoder, ctx->current_packet.packet, ctx->current_packet.bytes,output, CONFIG_OPUS_FRAME_SAMPLES_MAX / decoder->info.channels, 0);
+    audio_opus_unlock();
     
     if (output_samples < 0) {
         ESP_LOGE(TAG, "[OPUS] Decode warning: %s", opus_strerror(output_samples));
@@ -186,11 +269,102 @@ decode_packet:
     //     output_samples *= 2;
     // }
     
-    *samples_decoded = output_samples;
+    *samples_decoded = output_samples * decoder->info.channels; // 所有声道合计
     // LOG_DBG("[OPUS] Decoded %d samples", output_samples);
     return DECODER_OK;
 }
 
+static decoder_result_t opus_decode_packet(audio_decoder_t *decoder, const uint8_t *packet, size_t len, int16_t *output, uint32_t *samples_decoded)
+{
+    opus_context_t *ctx = (opus_context_t *)decoder->context;
+
+    // 裸包流没有OpusHead，按decoder->info中的输出格式准备解码器
+    if (opus_prepare_decoder(ctx, decoder->info.sample_rate, decoder->info.channels) != DECODER_OK) {
+        return DECODER_ERROR;
+    }
+
+    if (!packet || len == 0) {
+        ESP_LOGE(TAG, "[OPUS] Empty packet");
+        return DECODER_HEADER_ONLY;
+    }
+
+    audio_opus_lock();
+    opus_int32 output_samples = opus_decode(ctx->opus_decoder, packet, len, output, CONFIG_OPUS_FRAME_SAMPLES_MAX / decoder->info.channels, 0);
+    audio_opus_unlock();
+    if (output_samples < 0) {
+        // 损坏的包交由调用方按丢包补偿
+        ESP_LOGW(TAG, "[OPUS] Corrupt packet: %s", opus_strerror(output_samples));
+        return DECODER_ERROR;
+    } else if (output_samples == 0) {
+        ESP_LOGE(TAG, "[OPUS] Zero samples decoded");
+        return DECODER_HEADER_ONLY;
+    }
+
+    *samples_decoded = output_samples * decoder->info.channels; // 所有声道合计
+    return DECODER_OK;
+}
+
+/**
+ * @brief 丢包补偿：fec_packet含带内FEC（LBRR）时从中恢复丢失的前一包，fec_packet为NULL时做PLC
+ * 补偿帧长沿用上一包的时长（FEC要求与丢失包等长）
+ */
+static decoder_result_t opus_conceal(audio_decoder_t *decoder, const uint8_t *fec_packet, size_t len, int16_t *output, uint32_t *samples_decoded)
+{
+    opus_context_t *ctx = (opus_context_t *)decoder->context;
+
+    if (opus_prepare_decoder(ctx, decoder->info.sample_rate, decoder->info.channels) != DECODER_OK) {
+        return DECODER_ERROR;
+    }
+    if (fec_packet && (len == 0 || opus_packet_has_lbrr(fec_packet, len) <= 0)) {
+        return DECODER_ERROR;
+    }
+
+    opus_int32 frame_size = 0;
+    opus_decoder_ctl(ctx->opus_decoder, OPUS_GET_LAST_PACKET_DURATION(&frame_size));
+    if (frame_size <= 0) {
+        frame_size = decoder->info.sample_rate / 50; // 尚未解码过任何包时按20ms
+    }
+    if (frame_size > CONFIG_OPUS_FRAME_SAMPLES_MAX / decoder->info.channels) {
+        frame_size = CONFIG_OPUS_FRAME_SAMPLES_MAX / decoder->info.channels;
+    }
+
+    audio_opus_lock();
+    opus_int32 output_samples = opus_decode(ctx->opus_decoder, fec_packet, fec_packet ? len : 0, output, frame_size, fec_packet ? 1 : 0);
+    audio_opus_unlock();
+    if (output_samples <= 0) {
+        ESP_LOGW(TAG, "[OPUS] Conceal failed: %s", opus_strerror(output_samples));
+        return DECODER_ERROR;
+    }
+    *samples_decoded = output_samples * decoder->info.channels;
+    return DECODER_OK;
+}
+
+/**
+ * @brief 复位解码器以播放新的数据流，保留已分配的ogg缓冲和Opus解码器
+ * 输出格式取decoder->info，与当前Opus解码器不一致时才重新创建
+ */
+static decoder_result_t opus_reset(audio_decoder_t *decoder)
+{
+    opus_context_t *ctx = (opus_context_t *)decoder->context;
+    if (!ctx) {
+        return DECODER_ERROR;
+    }
+
+    ogg_sync_reset(&ctx->ogsync);
+    if (ctx->stream_inited) {
+        ogg_stream_reset(&ctx->ogstream);
+    }
+    ctx->has_found_opus_header = false;
+    ctx->has_pending_packet = false;
+    ctx->read_page_cnt = 0;
+
+    if (ctx->opus_decoder && ctx->decoder_rate == decoder->info.sample_rate && ctx->decoder_channels == decoder->info.channels) {
+        opus_decoder_ctl(ctx->opus_decoder, OPUS_RESET_STATE);
+        return DECODER_OK;
+    }
+    return opus_prepare_decoder(ctx, decoder->info.sample_rate, decoder->info.channels);
+}
+
 static void opus_deinit(audio_decoder_t *decoder)
 {
     if (decoder->context) {
@@ -206,10 +380,32 @@ static void opus_deinit(audio_decoder_t *decoder)
     }
 }
 
-void decoder_ops_register(audio_decoder_t *decoder)
+static void opus_ops_register(audio_decoder_t *decoder)
 {
     decoder->init = opus_init;
     decoder->decode_frame = opus_decode_frame;
+    decoder->decode_packet = opus_decode_packet;
+    decoder->conceal = opus_conceal;
+    decoder->reset = opus_reset;
     decoder->deinit = opus_deinit;
-    // ESP_LOGI(TAG, "[OPUS] Decoder operations registered successfully");
+}
+
+static bool opus_probe(const uint8_t *head, size_t len)
+{
+    return len >= 4 && memcmp(head, "OggS", 4) == 0;
+}
+
+static const audio_codec_desc_t opus_codec = {
+    .name = "opus",
+    .codec = AUDIO_CODEC_OPUS,
+    .probe = opus_probe,
+    .ops_register = opus_ops_register,
+    .input_chunk = CONFIG_OPUS_FILE_BUFF_SIZE,
+    .max_frame_samples = CONFIG_OPUS_FRAME_SAMPLES_MAX,
+    .flexible_output = true,
+};
+
+void opus_decoder_port_register(void)
+{
+    audio_codec_register(&opus_codec);
 }
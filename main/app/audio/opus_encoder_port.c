@@ -0,0 +1,226 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+
+#if CONFIG_OPUS_ENCODER
+
+#include <math.h>
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "opus.h"
+
+static const char *TAG = "opus_encoder";
+
+struct audio_encoder {
+    OpusEncoder *opus_encoder;
+    int16_t *frame;            // 重组中的一帧PCM
+    uint32_t frame_samples;    // 每帧采样数
+    uint32_t filled;           // 当前帧已有的采样数
+    uint8_t packet[AUDIO_UPLINK_MAX_PACKET];
+};
+
+/**
+ * @brief 创建上行编码器：VOIP模式、语音信号、可变码率
+ * @param sample_rate: 输入采样率（8/12/16/24/48kHz）
+ * @param frame_ms: 编码帧长（10/20/40/60ms）
+ * @param bitrate: 目标码率（bit/s）
+ * @param complexity: 编码复杂度0~10
+ */
+audio_encoder_t *audio_encoder_create(uint32_t sample_rate, uint32_t frame_ms, uint32_t bitrate, int complexity)
+{
+    int err;
+    audio_encoder_t *enc = calloc(1, sizeof(audio_encoder_t));
+    if (!enc) {
+        return NULL;
+    }
+    enc->frame_samples = sample_rate * frame_ms / 1000;
+    enc->frame = heap_caps_malloc(enc->frame_samples * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    enc->opus_encoder = opus_encoder_create(sample_rate, 1, OPUS_APPLICATION_VOIP, &err);
+    if (!enc->frame || err != OPUS_OK || !enc->opus_encoder) {
+        ESP_LOGE(TAG, "[OPUS] Encoder create failed: %s", opus_strerror(err));
+        audio_encoder_destroy(enc);
+        return NULL;
+    }
+    opus_encoder_ctl(enc->opus_encoder, OPUS_SET_BITRATE(bitrate));
+    opus_encoder_ctl(enc->opus_encoder, OPUS_SET_COMPLEXITY(complexity));
+    opus_encoder_ctl(enc->opus_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    opus_encoder_ctl(enc->opus_encoder, OPUS_SET_VBR(1));
+    opus_encoder_ctl(enc->opus_encoder, OPUS_SET_DTX(AUDIO_UPLINK_DTX));
+    ESP_LOGI(TAG, "[OPUS] Encoder created: %ld Hz, %ld ms frames, %ld bit/s, complexity %d, DTX %d",
+             sample_rate, frame_ms, bitrate, complexity, AUDIO_UPLINK_DTX);
+    return enc;
+}
+
+void audio_encoder_destroy(audio_encoder_t *enc)
+{
+    if (!enc) {
+        return;
+    }
+    if (enc->opus_encoder) {
+        opus_encoder_destroy(enc->opus_encoder);
+    }
+    heap_caps_free(enc->frame);
+    free(enc);
+}
+
+/**
+ * @brief 开始新的一段语音：丢弃未凑满的帧并复位编码器状态
+ */
+void audio_encoder_reset(audio_encoder_t *enc)
+{
+    enc->filled = 0;
+    opus_encoder_ctl(enc->opus_encoder, OPUS_RESET_STATE);
+}
+
+// 编码已凑满的一帧并把包交给sink
+static esp_err_t encoder_emit(audio_encoder_t *enc, audio_packet_sink_t sink, void *arg)
+{
+    audio_opus_lock();
+    opus_int32 len = opus_encode(enc->opus_encoder, enc->frame, enc->frame_samples, enc->packet, sizeof(enc->packet));
+    audio_opus_unlock();
+    if (len < 0) {
+        ESP_LOGE(TAG, "[OPUS] Encode failed: %s", opus_strerror(len));
+        return ESP_FAIL;
+    }
+    return sink(arg, enc->packet, len);
+}
+
+/**
+ * @brief 写入PCM，每凑满一帧编码一次并把包交给sink（不足一帧的部分留到下次）
+ * @param pcm: 单声道16bit PCM，长度任意（如AFE每次输出的512个采样）
+ * @param sink: 接收Opus包的函数，每帧调用一次
+ */
+esp_err_t audio_encoder_write(audio_encoder_t *enc, const int16_t *pcm, uint32_t samples, audio_packet_sink_t sink, void *arg)
+{
+    while (samples > 0) {
+        uint32_t n = enc->frame_samples - enc->filled;
+        if (n > samples) {
+            n = samples;
+        }
+        memcpy(enc->frame + enc->filled, pcm, n * sizeof(int16_t));
+        enc->filled += n;
+        pcm += n;
+        samples -= n;
+        if (enc->filled < enc->frame_samples) {
+            break;
+        }
+        enc->filled = 0;
+
+        esp_err_t ret = encoder_emit(enc, sink, arg);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 把不足一帧的剩余采样补静音后编码发出（一段音频结束时调用）
+ * @param padded: 输出补入的静音采样数，没有剩余采样时为0
+ */
+esp_err_t audio_encoder_flush(audio_encoder_t *enc, audio_packet_sink_t sink, void *arg, uint32_t *padded)
+{
+    *padded = 0;
+    if (enc->filled == 0) {
+        return ESP_OK;
+    }
+    *padded = enc->frame_samples - enc->filled;
+    memset(enc->frame + enc->filled, 0, *padded * sizeof(int16_t));
+    enc->filled = 0;
+    return encoder_emit(enc, sink, arg);
+}
+
+static esp_err_t benchmark_sink(void *arg, const uint8_t *packet, size_t len)
+{
+    *(uint32_t *)arg += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief 编码开销测试：对合成的类语音信号（带谐波的滑音加噪声）按不同帧长和复杂度编码，
+ * 输出每帧周期数、占单核的百分比和实际码率
+ */
+void audio_encoder_benchmark(void)
+{
+    const uint32_t seconds = 2;
+    const uint32_t total = AUDIO_UPLINK_SAMPLE_RATE * seconds;
+    const uint32_t chunk = 512; // 与AFE每次输出的采样数一致
+    const int complexities[] = {0, 3, 5, 8};
+    const uint32_t frame_ms_list[] = {20, 40};
+
+    int16_t *signal = heap_caps_malloc(total * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!signal) {
+        return;
+    }
+    uint32_t seed = 1;
+    double phase = 0;
+    for (uint32_t i = 0; i < total; i++) {
+        double t = (double)i / AUDIO_UPLINK_SAMPLE_RATE;
+        double f0 = 140 + 60 * sin(2 * M_PI * 1.5 * t);
+        phase += 2 * M_PI * f0 / AUDIO_UPLINK_SAMPLE_RATE;
+        double v = 0;
+        for (int h = 1; h <= 8; h++) {
+            v += sin(phase * h) / h;
+        }
+        seed = seed * 1664525 + 1013904223;
+        v = v * 4000 * (0.6 + 0.4 * sin(2 * M_PI * 3 * t)) + (int16_t)(seed >> 16) / 64;
+        signal[i] = (int16_t)v;
+    }
+
+    for (int f = 0; f < sizeof(frame_ms_list) / sizeof(frame_ms_list[0]); f++) {
+        for (int c = 0; c < sizeof(complexities) / sizeof(complexities[0]); c++) {
+            audio_encoder_t *enc = audio_encoder_create(AUDIO_UPLINK_SAMPLE_RATE, frame_ms_list[f], AUDIO_UPLINK_BITRATE, complexities[c]);
+            if (!enc) {
+                continue;
+            }
+            uint32_t bytes = 0;
+            uint64_t cycles = 0;
+            for (uint32_t pos = 0; pos + chunk <= total; pos += chunk) {
+                uint32_t start = esp_cpu_get_cycle_count();
+                audio_encoder_write(enc, signal + pos, chunk, benchmark_sink, &bytes);
+                cycles += esp_cpu_get_cycle_count() - start;
+            }
+            uint32_t frames = total / enc->frame_samples;
+            uint64_t cpu_hz = (uint64_t)CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000;
+            ESP_LOGI(TAG, "%2lu ms, complexity %d: %llu cycles/frame, %.1f%% CPU, %lu bit/s",
+                     frame_ms_list[f], complexities[c], cycles / frames,
+                     (double)cycles * 100 / (cpu_hz * seconds), bytes * 8 / seconds);
+            audio_encoder_destroy(enc);
+        }
+    }
+    heap_caps_free(signal);
+}
+
+#else
+
+// 未启用CONFIG_OPUS_ENCODER时创建失败，调用方回退为发送原始PCM
+audio_encoder_t *audio_encoder_create(uint32_t sample_rate, uint32_t frame_ms, uint32_t bitrate, int complexity)
+{
+    ESP_LOGW("opus_encoder", "Opus encoder disabled (CONFIG_OPUS_ENCODER)");
+    return NULL;
+}
+
+void audio_encoder_destroy(audio_encoder_t *enc)
+{
+}
+
+void audio_encoder_reset(audio_encoder_t *enc)
+{
+}
+
+esp_err_t audio_encoder_flush(audio_encoder_t *enc, audio_packet_sink_t sink, void *arg, uint32_t *padded)
+{
+    *padded = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t audio_encoder_write(audio_encoder_t *enc, const int16_t *pcm, uint32_t samples, audio_packet_sink_t sink, void *arg)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void audio_encoder_benchmark(void)
+{
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "audio.h"
+#include "audio_private.h"
+#include "esp_log.h"
+#include "bsp_board.h"
+
+static const char *TAG = "pcm_decoder";
+
+#define PCM_CHUNK_SAMPLES 1024 // 单次decode_frame输出的采样数（所有声道合计）
+
+typedef struct {
+    bool header_parsed;
+    uint32_t bytes_remaining; // data块剩余字节数，裸PCM为UINT32_MAX
+    bool has_carry;
+    uint8_t carry;            // 上次读到的半个采样（低字节），拼到下一块开头
+} pcm_context_t;
+
+static uint32_t pcm_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t pcm_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static decoder_result_t pcm_init(audio_decoder_t *decoder)
+{
+    pcm_context_t *ctx = calloc(1, sizeof(pcm_context_t));
+    if (!ctx) {
+        return DECODER_ERROR;
+    }
+    decoder->context = ctx;
+    decoder->info.sample_rate = SAMPLE_TX_RATE;
+    decoder->info.channels = 1;
+    return DECODER_OK;
+}
+
+/**
+ * @brief 解析RIFF/WAVE头，定位到data块；没有RIFF头时按decoder->info指定的格式作为裸PCM
+ */
+static decoder_result_t pcm_parse_header(audio_decoder_t *decoder, audio_source_t *src)
+{
+    pcm_context_t *ctx = (pcm_context_t *)decoder->context;
+    uint8_t head[12];
+
+    ctx->header_parsed = true;
+    if (src->peek(src, head, sizeof(head)) != sizeof(head) ||
+        memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0) {
+        ctx->bytes_remaining = UINT32_MAX;
+        return DECODER_OK;
+    }
+    src->skip(src, sizeof(head));
+
+    while (1) {
+        uint8_t chunk[8];
+        if (src->read(src, chunk, sizeof(chunk)) != sizeof(chunk)) {
+            ESP_LOGE(TAG, "[PCM] No data chunk");
+            return DECODER_ERROR;
+        }
+        uint32_t size = pcm_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || src->read(src, fmt, sizeof(fmt)) != sizeof(fmt)) {
+                return DECODER_ERROR;
+            }
+            uint16_t format = pcm_le16(fmt);
+            uint16_t channels = pcm_le16(fmt + 2);
+            uint32_t sample_rate = pcm_le32(fmt + 4);
+            uint16_t bits = pcm_le16(fmt + 14);
+            if (format != 1 || bits != 16 || channels == 0 || channels > 2) {
+                ESP_LOGE(TAG, "[PCM] Unsupported format: tag %d, %d bits, %d ch", format, bits, channels);
+                return DECODER_ERROR;
+            }
+            decoder->info.sample_rate = sample_rate;
+            decoder->info.channels = channels;
+            src->skip(src, size - sizeof(fmt) + (size & 1));
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            ctx->bytes_remaining = size;
+            ESP_LOGI(TAG, "[PCM] WAV %ld Hz, %d ch, %ld bytes", decoder->info.sample_rate, decoder->info.channels, size);
+            return DECODER_OK;
+        } else {
+            src->skip(src, size + (size & 1));
+        }
+    }
+}
+
+static decoder_result_t pcm_decode_frame(audio_decoder_t *decoder, audio_source_t *src, int16_t *output, uint32_t *samples_decoded)
+{
+    pcm_context_t *ctx = (pcm_context_t *)decoder->context;
+
+    if (!ctx->header_parsed) {
+        decoder_result_t ret = pcm_parse_header(decoder, src);
+        if (ret != DECODER_OK) {
+            return ret;
+        }
+        return DECODER_HEADER_ONLY;
+    }
+
+    // 16bit小端PCM与本机字节序一致，直接读入输出缓冲
+    uint8_t *out = (uint8_t *)output;
+    uint32_t have = 0;
+    if (ctx->has_carry) {
+        out[have++] = ctx->carry;
+        ctx->has_carry = false;
+    }
+    uint32_t want = PCM_CHUNK_SAMPLES * sizeof(int16_t) - have;
+    if (want > ctx->bytes_remaining) {
+        want = ctx->bytes_remaining;
+    }
+    int bytes_read = want > 0 ? src->read(src, out + have, want) : 0;
+    if (bytes_read < 0) {
+        return DECODER_ERROR;
+    }
+    if (bytes_read == 0) {
+        return DECODER_EOF; // 结尾不足一个采样的字节丢弃
+    }
+    ctx->bytes_remaining -= bytes_read;
+    have += bytes_read;
+    // 数据源可能返回奇数个字节：半个采样留到下一块，否则此后所有采样高低字节错位
+    if (have & 1) {
+        ctx->carry = out[--have];
+        ctx->has_carry = true;
+    }
+    if (have == 0) {
+        return DECODER_HEADER_ONLY;
+    }
+    *samples_decoded = have / sizeof(int16_t);
+    return DECODER_OK;
+}
+
+static decoder_result_t pcm_reset(audio_decoder_t *decoder)
+{
+    pcm_context_t *ctx = (pcm_context_t *)decoder->context;
+    if (!ctx) {
+        return DECODER_ERROR;
+    }
+    ctx->header_parsed = false;
+    ctx->bytes_remaining = 0;
+    ctx->has_carry = false;
+    return DECODER_OK;
+}
+
+static void pcm_deinit(audio_decoder_t *decoder)
+{
+    free(decoder->context);
+    decoder->context = NULL;
+}
+
+static void pcm_ops_register(audio_decoder_t *decoder)
+{
+    decoder->init = pcm_init;
+    decoder->decode_frame = pcm_decode_frame;
+    decoder->reset = pcm_reset;
+    decoder->deinit = pcm_deinit;
+}
+
+static bool pcm_probe(const uint8_t *head, size_t len)
+{
+    return len >= 12 && memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "WAVE", 4) == 0;
+}
+
+static const audio_codec_desc_t pcm_codec = {
+    .name = "pcm",
+    .codec = AUDIO_CODEC_PCM,
+    .probe = pcm_probe,
+    .ops_register = pcm_ops_register,
+    .input_chunk = PCM_CHUNK_SAMPLES * sizeof(int16_t),
+    .max_frame_samples = PCM_CHUNK_SAMPLES,
+    .flexible_output = false,
+};
+
+void pcm_decoder_port_register(void)
+{
+    audio_codec_register(&pcm_codec);
+}
@@ -0,0 +1,107 @@
+#include "esp_log.h"
+#include "app_diag.h"
+#include "audio.h"
+#include "sr_uplink.h"
+#include "sr_capture.h"
+#include "websocket.h"
+
+static const char *TAG = "app_diag";
+
+static void log_uplink(void)
+{
+    sr_uplink_stats_t uplink_stats;
+    sr_uplink_get_stats(&uplink_stats);
+    ESP_LOGI(TAG, "上行: 入队%lu 已发送%lu 丢弃%lu(断线缓存满%lu) 丢弃控制消息%lu 发送失败%lu 队列峰值%lu",
+             uplink_stats.enqueued, uplink_stats.sent, uplink_stats.dropped, uplink_stats.spool_dropped,
+             uplink_stats.ctrl_dropped, uplink_stats.send_failed, uplink_stats.depth_max);
+    ESP_LOGI(TAG, "上行消息%lu条: 负载%lu字节 开销约%lu字节, 批量%lu, 发送耗时%lu us, 入队到发出%lu us (最大%lu us)",
+             uplink_stats.messages, uplink_stats.payload_bytes, uplink_stats.overhead_bytes, uplink_stats.batch,
+             uplink_stats.send_us, uplink_stats.latency_us, uplink_stats.latency_max_us);
+
+    sr_spool_stats_t spool_stats;
+    sr_uplink_get_spool_stats(&spool_stats);
+    if (spool_stats.spooled > 0) {
+        ESP_LOGI(TAG, "断线缓存: 现有%lu条(%lu字节, 最早%lu ms前), 累计缓存%lu 重发%lu 丢弃音频%lu 丢弃控制消息%lu",
+                 spool_stats.messages, spool_stats.bytes, spool_stats.age_ms,
+                 spool_stats.spooled, spool_stats.replayed, spool_stats.dropped, spool_stats.ctrl_dropped);
+    }
+}
+
+static void log_websocket(void)
+{
+    ws_send_stats_t ws_stats;
+    ws_get_send_stats(&ws_stats);
+    ESP_LOGI(TAG, "WebSocket发送队列: 排队%lu条(%lu字节), 已发送%lu(写入%lu次) 丢弃%lu 过期%lu 失败%lu, 排队时延%lu us (最大%lu us)",
+             ws_stats.queued, ws_stats.queued_bytes, ws_stats.sent, ws_stats.writes, ws_stats.dropped,
+             ws_stats.expired, ws_stats.failed, ws_stats.delay_us, ws_stats.delay_max_us);
+
+    esp_websocket_deflate_stats_t deflate_stats;
+    if (ws_get_deflate_stats(&deflate_stats) == ESP_OK && deflate_stats.tx_raw_bytes > 0) {
+        ESP_LOGI(TAG, "WebSocket压缩: 内存%u字节(峰值%u), 发送%lu条 %lu->%lu字节(%lu%%), 未压缩%lu条, 接收%lu条 %lu->%lu字节",
+                 deflate_stats.memory, deflate_stats.memory_peak, deflate_stats.tx_messages,
+                 deflate_stats.tx_raw_bytes, deflate_stats.tx_compressed_bytes,
+                 (uint32_t)((uint64_t)deflate_stats.tx_compressed_bytes * 100 / deflate_stats.tx_raw_bytes), deflate_stats.tx_skipped,
+                 deflate_stats.rx_messages, deflate_stats.rx_compressed_bytes, deflate_stats.rx_inflated_bytes);
+    }
+
+    esp_websocket_connect_stats_t connect_stats;
+    if (ws_get_connect_stats(&connect_stats) == ESP_OK && connect_stats.full_count + connect_stats.resumed_count > 0) {
+        ESP_LOGI(TAG, "TLS连接: 完整握手%lu次 平均%lu ms, 提供会话%lu次 其中恢复%lu次 平均%lu ms, 恢复失败%lu次, 会话%s缓存",
+                 connect_stats.full_count, connect_stats.full_avg_ms, connect_stats.offered_count,
+                 connect_stats.resumed_count, connect_stats.resumed_avg_ms, connect_stats.resume_failures,
+                 connect_stats.session_cached ? "已" : "未");
+    }
+}
+
+static void log_audio(void)
+{
+    audio_stream_stats_t stream_stats;
+    audio_stream_get_stats(&stream_stats);
+    if (stream_stats.packets + stream_stats.lost > 0) {
+        ESP_LOGI(TAG, "下行流: 解码%lu包, 丢失%lu 迟到%lu 缓冲满丢弃%lu, FEC恢复%lu帧 PLC补偿%lu帧",
+                 stream_stats.packets, stream_stats.lost, stream_stats.late, stream_stats.dropped,
+                 stream_stats.fec_frames, stream_stats.plc_frames);
+    }
+
+    audio_decoder_pool_stats_t pool_stats;
+    audio_decoder_pool_get_stats(&pool_stats);
+    ESP_LOGI(TAG, "解码器池: 取用%lu次, 格式一致%lu 同类型复位%lu 新构造%lu 临时构造%lu, 占用%lu",
+             pool_stats.acquired, pool_stats.matched, pool_stats.rewound, pool_stats.constructed,
+             pool_stats.transient, pool_stats.in_use);
+
+    audio_prompt_cache_stats_t prompt_stats;
+    audio_prompt_cache_get_stats(&prompt_stats);
+    if (prompt_stats.hits + prompt_stats.misses > 0) {
+        ESP_LOGI(TAG, "提示音缓存: 命中%lu 未命中%lu 淘汰%lu 未缓存%lu, 占用%lu/%lu字节",
+                 prompt_stats.hits, prompt_stats.misses, prompt_stats.evictions, prompt_stats.uncached,
+                 prompt_stats.used_bytes, prompt_stats.budget_bytes);
+    }
+
+    sr_capture_stats_t capture_stats;
+    sr_capture_get_stats(&capture_stats);
+    if (capture_stats.overruns > 0) {
+        ESP_LOGW(TAG, "采集: %lu块中%lu块处理不及时被丢弃", capture_stats.buffers, capture_stats.overruns);
+    }
+
+    audio_reference_stats_t ref_stats;
+    audio_reference_get_stats(&ref_stats);
+    ESP_LOGI(TAG, "AEC参考: 回声延时补偿%lu us, 相关%lu%%, 估计%lu次",
+             ref_stats.delay_us, ref_stats.correlation_pct, ref_stats.estimates);
+
+    audio_barge_in_stats_t barge_in_stats;
+    audio_barge_in_get_stats(&barge_in_stats);
+    if (barge_in_stats.count > 0) {
+        ESP_LOGI(TAG, "插话打断%lu次: 检测到静音%lu us (最大%lu us)",
+                 barge_in_stats.count, barge_in_stats.latency_us, barge_in_stats.latency_max_us);
+    }
+}
+
+void app_diag_log_turn(const sr_turn_stats_t *turn)
+{
+    ESP_LOGI(TAG, "第%lu轮(%s): 上行%lu ms 语音%lu ms, 累计上行%llu ms, 静音抑制累计节省%llu字节",
+             turn->turns, app_sr_turn_end_name(turn->last_end), turn->last_streamed_ms, turn->last_speech_ms,
+             turn->total_streamed_ms, turn->total_saved_bytes);
+    log_uplink();
+    log_websocket();
+    log_audio();
+}
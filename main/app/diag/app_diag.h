@@ -0,0 +1,14 @@
+#ifndef APP_DIAG_H
+#define APP_DIAG_H
+
+#include "app_sr.h"
+
+/**
+ * @brief 输出各模块的运行统计：上行队列、断线缓存、WebSocket发送队列/压缩/TLS连接、下行流、解码器池、
+ * 提示音缓存、采集、AEC参考与插话打断
+ * 注册为app_sr的轮次结束钩子，每轮结束时在检测任务中调用
+ * @param turn: 刚结束这一轮之后的对话统计
+ */
+void app_diag_log_turn(const sr_turn_stats_t *turn);
+
+#endif // APP_DIAG_H
@@ -6,6 +6,7 @@
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "app_sr.h"
 #include "esp_afe_sr_models.h"
 #include "esp_mn_models.h"
@@ -17,17 +18,16 @@
 #include "esp_process_sdkconfig.h"
 #include <esp_board_init.h>
 #include "websocket.h" // 添加WebSocket头文件
+#include "audio.h"
+#include "sr_uplink.h"
+#include "sr_preroll.h"
+#include "sr_capture.h"
+#include "bsp_board.h"
 
-// 修改全局常量，调整WebSocket传输大小为1024字节
-#define WS_TRANSFER_SIZE (1024)
-#define SAMPLES_PER_BUFFER (WS_TRANSFER_SIZE / sizeof(int16_t))  // 每个缓冲区的样本数
+// 上行格式：1为Opus编码（每个WebSocket二进制帧一个Opus包），0为AFE输出的原始16kHz PCM
+#define SR_UPLINK_OPUS 1
 
-// 全局变量声明
-static int16_t *audio_buffer_A = NULL;  // 缓冲区A
-static int16_t *audio_buffer_B = NULL;  // 缓冲区B
-static int16_t *current_buffer = NULL;  // 当前正在填充的缓冲区
-static bool buffer_ready_to_send = false;  // 标记是否有缓冲区准备好发送
-static int16_t *buffer_to_send = NULL;    // 准备发送的缓冲区
+static audio_encoder_t *uplink_encoder = NULL; // 上行Opus编码器，创建失败时回退为原始PCM
 
 static const char *TAG = "app_sr";
 static const esp_afe_sr_iface_t *afe_handle = NULL;
@@ -35,16 +35,287 @@ static const esp_afe_sr_iface_t *afe_handle = NULL;
 TaskHandle_t audio_feed_task_handle = NULL;
 TaskHandle_t audio_detect_task_handle = NULL;
 
-static bool is_recording = false;           // 是否正在采集音频
-static int recording_duration_ms = 30000;   // 采集时长（30秒，可自定义）
-static TickType_t recording_start_tick = 0; // 采集开始时间戳
+static bool is_recording = false; // 是否正在采集音频
 
-// 重置缓冲区状态
-static void reset_buffer_state(void)
+// 端点检测状态（仅检测任务访问），时长按唤醒后的实时帧累计（不含预录音频）
+typedef struct {
+    bool speech_started;  // 是否已检测到用户开始说话
+    uint32_t streamed_ms; // 本轮唤醒后经过的实时音频时长
+    uint32_t speech_ms;   // 本轮语音帧累计时长
+    uint32_t run_ms;      // 当前连续语音（说话前）或连续静音（说话后）的时长
+} sr_endpoint_t;
+
+static const char *const turn_end_names[] = {"speech_end", "no_speech", "max_duration", "rewake"};
+
+// 上行每次发出的最大采样数（与AFE输出一帧相同，原始PCM时正好一个队列帧）
+#define UPLINK_CHUNK_SAMPLES (SR_UPLINK_FRAME_MAX / sizeof(int16_t))
+
+static bool preroll_enabled = false;               // 预录缓冲区是否可用
+static int16_t uplink_chunk[UPLINK_CHUNK_SAMPLES]; // 从预录缓冲区取出待上行的PCM
+
+static uint32_t barge_in_vad_ms = 0; // 播放期间连续检测到语音的时长
+
+// 静音抑制状态（仅检测任务访问），位置为本轮上行时间线上的采样序号
+typedef struct {
+    uint32_t pos;          // 下一个待上行采样的位置
+    uint32_t audio_end;    // 已作为音频发出的末尾位置（含编码器补齐的静音）
+    uint32_t silence_run;  // 连续非语音的采样数
+    bool suppressing;      // 正在省略静音
+    uint32_t suppressed;   // 本轮省略的采样数
+    uint32_t audio_bytes;  // 本轮作为音频入队的字节数
+    uint32_t marker_bytes; // 本轮静音标记的字节数
+} sr_silence_t;
+
+static sr_silence_t silence;
+
+static sr_endpoint_t endpoint;
+static sr_turn_stats_t turn_stats;
+static portMUX_TYPE turn_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static app_sr_turn_hook_t turn_hook = NULL; // 每轮结束时调用（输出各模块统计）
+
+// 上行编码器输出：每个Opus包放入上行队列，由发送任务按当前批量合并为WebSocket二进制帧发送
+static esp_err_t uplink_send_packet(void *arg, const uint8_t *packet, size_t len)
+{
+    silence.audio_bytes += len;
+    return sr_uplink_send_packet(packet, len);
+}
+
+// 上行一段PCM：编码为Opus包，或在编码器不可用时直接作为原始PCM入队
+static esp_err_t uplink_send_pcm(const int16_t *pcm, uint32_t samples)
+{
+    if (uplink_encoder) {
+        return audio_encoder_write(uplink_encoder, pcm, samples, uplink_send_packet, NULL);
+    }
+    silence.audio_bytes += samples * sizeof(int16_t);
+    return sr_uplink_send_binary(pcm, samples * sizeof(int16_t));
+}
+
+/**
+ * @brief 结束一段被省略的静音：告知服务器这段静音在本轮时间线上的位置和时长
+ */
+static void uplink_send_silence_marker(void)
+{
+    char marker[96];
+    // 省略的静音比编码器补齐的部分还短时，补齐的静音已覆盖这段时间
+    uint32_t duration = silence.pos > silence.audio_end ? silence.pos - silence.audio_end : 0;
+    int len = snprintf(marker, sizeof(marker), "{\"type\":\"silence\",\"offset_ms\":%lu,\"duration_ms\":%lu}",
+                       silence.audio_end * 1000 / AUDIO_UPLINK_SAMPLE_RATE,
+                       duration * 1000 / AUDIO_UPLINK_SAMPLE_RATE);
+    silence.marker_bytes += len;
+    sr_uplink_send_json(marker);
+    silence.audio_end = silence.pos;
+    silence.suppressing = false;
+}
+
+/**
+ * @brief 上行一段属于同一AFE帧的PCM
+ * 非语音持续超过SR_SILENCE_HANG_MS后不再上行，直到再次出现语音时补发一条静音标记；
+ * 编码上行时先把编码器中不足一帧的采样补齐发出，服务器按标记即可还原各段音频的时间
+ */
+static void uplink_frame(const int16_t *pcm, uint32_t samples, bool speech)
+{
+#if SR_SILENCE_SUPPRESS
+    silence.silence_run = speech ? 0 : silence.silence_run + samples;
+    if (silence.silence_run > AUDIO_UPLINK_SAMPLE_RATE * SR_SILENCE_HANG_MS / 1000) {
+        if (!silence.suppressing) {
+            silence.suppressing = true;
+            if (uplink_encoder) {
+                uint32_t padded = 0;
+                audio_encoder_flush(uplink_encoder, uplink_send_packet, NULL, &padded);
+                silence.audio_end += padded;
+            }
+        }
+        silence.pos += samples;
+        silence.suppressed += samples;
+        return;
+    }
+    if (silence.suppressing) {
+        uplink_send_silence_marker();
+        // 新的一段音频从静音后重新开始编码
+        if (uplink_encoder) {
+            audio_encoder_reset(uplink_encoder);
+        }
+    }
+#endif
+    esp_err_t ret = uplink_send_pcm(pcm, samples);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "音频数据入队失败: %s", esp_err_to_name(ret));
+    }
+    silence.pos += samples;
+    silence.audio_end += samples;
+}
+
+/**
+ * @brief 按先后顺序上行预录缓冲区中最多max_samples个采样
+ * 录音期间实时帧也写入预录缓冲区，排在尚未补发的预录音频之后，保证上行顺序
+ */
+static void uplink_drain(uint32_t max_samples)
+{
+    while (max_samples > 0) {
+        bool speech;
+        uint32_t n = sr_preroll_read(uplink_chunk, max_samples < UPLINK_CHUNK_SAMPLES ? max_samples : UPLINK_CHUNK_SAMPLES, &speech);
+        if (n == 0) {
+            break;
+        }
+        uplink_frame(uplink_chunk, n, speech);
+        max_samples -= n;
+    }
+}
+
+/**
+ * @brief 唤醒时确定首段上行的预录音频
+ * wake_word_length为唤醒词起点到触发点的采样数；去掉唤醒词时只保留触发前约SR_PREROLL_TRIGGER_DELAY_MS
+ * （唤醒词结束后、触发之前说出的内容），且不超过唤醒词起点
+ */
+static void preroll_start(int wake_word_length)
+{
+    uint32_t keep = AUDIO_UPLINK_SAMPLE_RATE * SR_PREROLL_MS / 1000;
+#if SR_PREROLL_TRIM_WAKEWORD
+    uint32_t tail = AUDIO_UPLINK_SAMPLE_RATE * SR_PREROLL_TRIGGER_DELAY_MS / 1000;
+    keep = wake_word_length > 0 && tail >= (uint32_t)wake_word_length ? 0 : tail;
+#else
+    if ((uint32_t)wake_word_length > keep) {
+        ESP_LOGW(TAG, "预录时长不足以覆盖唤醒词 (%d个采样)", wake_word_length);
+    }
+#endif
+    sr_preroll_keep(keep);
+    ESP_LOGI(TAG, "预录首段: %lu ms", sr_preroll_available() * 1000 / AUDIO_UPLINK_SAMPLE_RATE);
+}
+
+// 通知服务器已检测到唤醒词，并说明随后上行音频的格式
+static void send_wakeup_message(void)
+{
+    char wakeup_msg[192];
+    if (uplink_encoder) {
+        // 多个Opus包合并为一条消息时，每个包前有2字节大端长度
+        const char *framing = sr_uplink_packet_framing();
+        snprintf(wakeup_msg, sizeof(wakeup_msg),
+                 "{\"type\":\"wakeup\",\"audio\":{\"codec\":\"opus\",\"sample_rate\":%d,\"channels\":1,\"frame_ms\":%d,\"framing\":\"%s\",\"dtx\":%s,\"silence_markers\":%s}}",
+                 AUDIO_UPLINK_SAMPLE_RATE, AUDIO_UPLINK_FRAME_MS, framing ? framing : "none",
+                 AUDIO_UPLINK_DTX ? "true" : "false", SR_SILENCE_SUPPRESS ? "true" : "false");
+    } else {
+        snprintf(wakeup_msg, sizeof(wakeup_msg),
+                 "{\"type\":\"wakeup\",\"audio\":{\"codec\":\"pcm\",\"sample_rate\":%d,\"channels\":1,\"silence_markers\":%s}}",
+                 AUDIO_UPLINK_SAMPLE_RATE, SR_SILENCE_SUPPRESS ? "true" : "false");
+    }
+    sr_uplink_send_json(wakeup_msg);
+}
+
+/**
+ * @brief 按一帧VAD结果推进端点检测
+ * 说话前连续语音达到SR_EP_ONSET_MS视为开始说话，之后连续静音达到SR_EP_HANGOVER_MS视为说完
+ * @param frame_ms: 本帧时长
+ * @param end: 本轮结束时输出结束原因
+ * @return 本轮是否结束
+ */
+static bool endpoint_update(vad_state_t vad_state, uint32_t frame_ms, sr_turn_end_t *end)
+{
+    bool speech = vad_state == VAD_SPEECH;
+    endpoint.streamed_ms += frame_ms;
+    if (speech) {
+        endpoint.speech_ms += frame_ms;
+    }
+
+    if (!endpoint.speech_started) {
+        endpoint.run_ms = speech ? endpoint.run_ms + frame_ms : 0;
+        if (endpoint.run_ms >= SR_EP_ONSET_MS) {
+            endpoint.speech_started = true;
+            endpoint.run_ms = 0;
+            ESP_LOGI(TAG, "检测到说话 (%lu ms)", endpoint.streamed_ms);
+        } else if (endpoint.streamed_ms >= SR_EP_NO_SPEECH_MS) {
+            *end = SR_TURN_END_NO_SPEECH;
+            return true;
+        }
+    } else {
+        endpoint.run_ms = speech ? 0 : endpoint.run_ms + frame_ms;
+        if (endpoint.run_ms >= SR_EP_HANGOVER_MS) {
+            *end = SR_TURN_END_SPEECH;
+            return true;
+        }
+    }
+    if (endpoint.streamed_ms >= SR_EP_MAX_MS) {
+        *end = SR_TURN_END_MAX;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 结束本轮上行：通知服务器语音结束、记录统计并恢复唤醒词检测
+ * @param hold_samples: 预录缓冲区末尾留给下一轮的采样数（再次唤醒时为触发帧），其余都归入本轮
+ */
+static void end_turn(esp_afe_sr_data_t *afe_data, sr_turn_end_t end, uint32_t hold_samples)
+{
+    char eou_msg[128];
+    // 发出尚未补发完的预录音频，保证结束消息排在全部音频之后
+    uint32_t pending = sr_preroll_available();
+    uplink_drain(pending > hold_samples ? pending - hold_samples : 0);
+    if (silence.suppressing) {
+        // 结尾的静音同样用标记补齐，使各段时长之和等于duration_ms（编码器中的尾部在开始省略时已补齐发出）
+        uplink_send_silence_marker();
+    } else if (uplink_encoder) {
+        // 编码器中不足一帧的尾部补齐静音后发出，否则最后一段语音会丢失
+        uint32_t padded = 0;
+        esp_err_t ret = audio_encoder_flush(uplink_encoder, uplink_send_packet, NULL, &padded);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "音频数据入队失败: %s", esp_err_to_name(ret));
+        }
+        silence.audio_end += padded;
+    }
+    // 时长与静音标记的offset_ms同在本轮上行时间线上（从首个预录采样起算，含省略的静音）
+    uint32_t duration_ms = silence.pos * 1000 / AUDIO_UPLINK_SAMPLE_RATE;
+    snprintf(eou_msg, sizeof(eou_msg),
+             "{\"type\":\"end_of_utterance\",\"reason\":\"%s\",\"duration_ms\":%lu}",
+             turn_end_names[end], duration_ms);
+    sr_uplink_send_json(eou_msg);
+    is_recording = false;
+    afe_handle->enable_wakenet(afe_data); // 恢复唤醒词检测
+
+    // 省略的静音按本轮音频的平均码率估计节省的字节数
+    uint32_t audio_samples = silence.pos - silence.suppressed;
+    uint64_t skipped_bytes = audio_samples > 0 ? (uint64_t)silence.suppressed * silence.audio_bytes / audio_samples : 0;
+    uint32_t saved_bytes = skipped_bytes > silence.marker_bytes ? (uint32_t)(skipped_bytes - silence.marker_bytes) : 0;
+
+    portENTER_CRITICAL(&turn_stats_lock);
+    turn_stats.turns++;
+    turn_stats.last_streamed_ms = duration_ms;
+    turn_stats.last_speech_ms = endpoint.speech_ms;
+    turn_stats.last_end = end;
+    turn_stats.total_streamed_ms += duration_ms;
+    turn_stats.ended[end]++;
+    turn_stats.last_suppressed_ms = silence.suppressed * 1000 / AUDIO_UPLINK_SAMPLE_RATE;
+    turn_stats.last_saved_bytes = saved_bytes;
+    turn_stats.total_saved_bytes += saved_bytes;
+    portEXIT_CRITICAL(&turn_stats_lock);
+
+    ESP_LOGI(TAG, "停止采集(%s): 上行%lu ms(唤醒后%lu ms), 语音%lu ms", turn_end_names[end], duration_ms,
+             endpoint.streamed_ms, endpoint.speech_ms);
+#if SR_SILENCE_SUPPRESS
+    ESP_LOGI(TAG, "静音抑制: 省略%lu ms, 音频%lu字节, 静音标记%lu字节, 约节省%lu字节",
+             silence.suppressed * 1000 / AUDIO_UPLINK_SAMPLE_RATE, silence.audio_bytes, silence.marker_bytes, saved_bytes);
+#endif
+    if (turn_hook) {
+        sr_turn_stats_t stats;
+        app_sr_get_turn_stats(&stats);
+        turn_hook(&stats);
+    }
+}
+
+void app_sr_set_turn_hook(app_sr_turn_hook_t hook)
 {
-    current_buffer = audio_buffer_A;
-    buffer_ready_to_send = false;
-    buffer_to_send = NULL;
+    turn_hook = hook;
+}
+
+const char *app_sr_turn_end_name(sr_turn_end_t end)
+{
+    return end < sizeof(turn_end_names) / sizeof(turn_end_names[0]) ? turn_end_names[end] : "unknown";
+}
+
+void app_sr_get_turn_stats(sr_turn_stats_t *stats)
+{
+    portENTER_CRITICAL(&turn_stats_lock);
+    *stats = turn_stats;
+    portEXIT_CRITICAL(&turn_stats_lock);
 }
 
 static void audio_feed_task(void *pvParam)
@@ -52,28 +323,54 @@ static void audio_feed_task(void *pvParam)
     esp_afe_sr_data_t *afe_data = (esp_afe_sr_data_t *)pvParam;
     // audio_chunksize：音频时间 512->32ms 256->16ms
     int audio_chunksize = afe_handle->get_feed_chunksize(afe_data);
-    ESP_LOGI(TAG, "audio_chunksize=%d, feed_channel=%d", audio_chunksize, 1);
+    int feed_channel = afe_handle->get_feed_channel_num(afe_data);
+    ESP_LOGI(TAG, "audio_chunksize=%d, feed_channel=%d", audio_chunksize, feed_channel);
 
     /* Allocate audio buffer and check for result */
-    int16_t *audio_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (NULL == audio_buffer)
+    // 麦克风采样直接取自DMA缓冲；"MR"格式下与回声参考交织到feed_buffer，这是送入AFE前唯一的一次拷贝
+    int16_t *ref_buffer = NULL;
+    int16_t *feed_buffer = NULL;
+    if (feed_channel > 1)
     {
-        esp_system_abort("No mem for audio buffer");
+        ref_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t), SR_CAPTURE_BUF_CAPS);
+        feed_buffer = heap_caps_malloc(audio_chunksize * feed_channel * sizeof(int16_t), SR_CAPTURE_BUF_CAPS);
+        if (NULL == ref_buffer || NULL == feed_buffer)
+        {
+            esp_system_abort("No mem for audio buffer");
+        }
+    }
+    if (sr_capture_start(audio_chunksize) != ESP_OK)
+    {
+        esp_system_abort("Failed to start audio capture");
     }
 
+    const int64_t chunk_us = (int64_t)audio_chunksize * 1000000 / SAMPLE_RX_RATE;
+    sr_capture_buf_t buf;
     while (true)
     {
-        /* Read audio data from I2S bus */
-        esp_err_t read_result = esp_i2s_read(audio_buffer, audio_chunksize * sizeof(int16_t));
-        if (read_result != ESP_OK)
+        /* Wait for a completed I2S DMA buffer */
+        sr_capture_read(&buf);
+        for (uint32_t pos = 0; pos + audio_chunksize <= buf.samples; pos += audio_chunksize)
         {
-            ESP_LOGE(TAG, "======== bsp_extra_i2s_read failed ==========");
+            const int16_t *mic = buf.pcm + pos;
+            if (feed_channel == 1)
+            {
+                /* Feed samples of an audio stream to the AFE_SR */
+                afe_handle->feed(afe_data, mic);
+                continue;
+            }
+            // 取与这块麦克风采样对齐的扬声器输出作为AEC参考，采集时刻由DMA接收完成中断的时间推算
+            int64_t capture_us = buf.capture_us - (buf.samples - pos - audio_chunksize) / audio_chunksize * chunk_us;
+            audio_reference_read(mic, ref_buffer, audio_chunksize, capture_us);
+            for (int i = 0; i < audio_chunksize; i++)
+            {
+                feed_buffer[i * feed_channel] = mic[i];
+                feed_buffer[i * feed_channel + 1] = ref_buffer[i];
+            }
+            /* Feed samples of an audio stream to the AFE_SR */
+            afe_handle->feed(afe_data, feed_buffer);
         }
-        /* Feed samples of an audio stream to the AFE_SR */
-        afe_handle->feed(afe_data, audio_buffer);
-
-        // 添加小延时，减少CPU占用并给其他任务执行机会
-        vTaskDelay(pdMS_TO_TICKS(1));
+        sr_capture_release(&buf);
     }
 
     /* Clean up if audio feed ends */
@@ -87,20 +384,26 @@ static void audio_detect_task(void *pvParam)
     esp_afe_sr_data_t *afe_data = (esp_afe_sr_data_t *)pvParam;
     ESP_LOGI(TAG, "------------detect start------------\n");
 
-    // 为WebSocket发送准备两个音频缓冲区（乒乓缓冲区）
-    audio_buffer_A = heap_caps_malloc(WS_TRANSFER_SIZE, 
-                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    audio_buffer_B = heap_caps_malloc(WS_TRANSFER_SIZE, 
-                                     MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (audio_buffer_A == NULL || audio_buffer_B == NULL) {
-        ESP_LOGE(TAG, "无法分配音频缓冲区");
-        if (audio_buffer_A) free(audio_buffer_A);
-        if (audio_buffer_B) free(audio_buffer_B);
-        vTaskDelete(NULL);
-        return;
+    // 网络发送移到独立任务，采集循环只入队不等待网络
+    if (sr_uplink_init(SR_UPLINK_DEPTH, SR_UPLINK_OVERFLOW) != ESP_OK) {
+        ESP_LOGE(TAG, "上行队列初始化失败");
+    }
+
+#if SR_UPLINK_OPUS
+    // AFE每次输出512个采样（32ms），由编码器重组为固定帧长的Opus帧
+    uplink_encoder = audio_encoder_create(AUDIO_UPLINK_SAMPLE_RATE, AUDIO_UPLINK_FRAME_MS,
+                                          AUDIO_UPLINK_BITRATE, AUDIO_UPLINK_COMPLEXITY);
+    if (uplink_encoder == NULL) {
+        ESP_LOGW(TAG, "Opus编码器创建失败，上行使用原始PCM");
     }
-    // 初始化缓冲区状态
-    reset_buffer_state();
+#if AUDIO_ENCODER_BENCHMARK
+    audio_encoder_benchmark();
+#endif
+#endif
+
+    // 预录缓冲区：始终保存最近SR_PREROLL_MS的AFE输出，唤醒时作为首段上行
+    preroll_enabled = sr_preroll_init(SR_PREROLL_MS, AUDIO_UPLINK_SAMPLE_RATE,
+                                      afe_handle->get_fetch_chunksize(afe_data)) == ESP_OK;
 
     while (true)
     {
@@ -117,58 +420,83 @@ static void audio_detect_task(void *pvParam)
             continue;
         }
 
-        if (res->wakeup_state == WAKENET_DETECTED)
+        // 所有AFE输出先写入预录缓冲区（包括触发唤醒的这一帧）
+        if (preroll_enabled && res->data && res->data_size > 0) {
+            sr_preroll_write(res->data, res->data_size / sizeof(int16_t), res->vad_state == VAD_SPEECH);
+        }
+
+        bool barge_in_vad = false;
+#if SR_BARGE_IN && SR_BARGE_IN_VAD
+        // 播放期间（未在采集）用户持续说话也视为插话
+        if (!is_recording && res->vad_state == VAD_SPEECH && audio_is_playing()) {
+            barge_in_vad_ms += res->data_size / sizeof(int16_t) * 1000 / AUDIO_UPLINK_SAMPLE_RATE;
+            barge_in_vad = barge_in_vad_ms >= SR_BARGE_IN_VAD_MS;
+        } else {
+            barge_in_vad_ms = 0;
+        }
+#endif
+
+        if (res->wakeup_state == WAKENET_DETECTED || barge_in_vad)
         {
-            ESP_LOGI(TAG, LOG_BOLD(LOG_COLOR_GREEN) "Wakeword detected");
-            // 进入录音状态，记录开始时间
-            is_recording = true;
-            recording_start_tick = xTaskGetTickCount();
+            int64_t detect_us = esp_timer_get_time();
+            struct timeval detect_time;
+            gettimeofday(&detect_time, NULL);
+            ESP_LOGI(TAG, LOG_BOLD(LOG_COLOR_GREEN) "%s detected", barge_in_vad ? "Barge-in speech" : "Wakeword");
+            barge_in_vad_ms = 0;
+#if SR_BARGE_IN
+            if (audio_is_playing()) {
+                // 通知服务器停止下行：排在尚未发出的音频（包括被打断的这一轮）之前，带检测到插话时的时间；
+                // 随后停止本地播放并开始新一轮采集
+                char barge_in_msg[64];
+                snprintf(barge_in_msg, sizeof(barge_in_msg), "{\"type\":\"barge_in\",\"detect_ms\":%lld}",
+                         (long long)detect_time.tv_sec * 1000 + detect_time.tv_usec / 1000);
+                sr_uplink_send_json_urgent(barge_in_msg);
+                audio_barge_in(detect_us);
+            }
+#endif
+            if (is_recording) {
+                // 采集中再次唤醒：先结束当前一轮，服务器不会收到重叠的两轮；触发帧留给新一轮的预录
+                end_turn(afe_data, SR_TURN_END_REWAKE, res->data_size / sizeof(int16_t));
+            }
+#if !SR_BARGE_IN
             afe_handle->disable_wakenet(afe_data);
+#endif
+            // 进入录音状态，开始新一轮端点检测（插话模式下采集中再次唤醒也重新开始）
+            is_recording = true;
+            memset(&endpoint, 0, sizeof(endpoint));
+            memset(&silence, 0, sizeof(silence));
 
             // 通知服务器已检测到唤醒词
-            const char *wakeup_msg = "{\"type\":\"wakeup\"}";
-            ws_send_json(wakeup_msg, strlen(wakeup_msg));
-            // 重置缓冲区状态
-            reset_buffer_state();
+            send_wakeup_message();
+            // 新的一段语音：丢弃上次未凑满的帧
+            if (uplink_encoder) {
+                audio_encoder_reset(uplink_encoder);
+            }
+            if (preroll_enabled) {
+                preroll_start(barge_in_vad ? 0 : res->wake_word_length);
+            }
             continue;
         }
 
         // 2. 音频采集逻辑
         if (is_recording)
         {
-            // 检查是否超时（超过设定的采集时长）
-            TickType_t current_tick = xTaskGetTickCount();
-            if (pdMS_TO_TICKS(recording_duration_ms) < (current_tick - recording_start_tick))
-            {
-                ESP_LOGI(TAG, "采集超时，停止采集");
-                is_recording = false;
-                afe_handle->enable_wakenet(afe_data); // 恢复唤醒词检测
-                continue;
-            }
-
-            // 检查是否有缓冲区准备好发送，如果有则尝试发送
-            if (buffer_ready_to_send && is_ws_connected()) {
-                esp_err_t send_ret = ws_send_binary(buffer_to_send, WS_TRANSFER_SIZE);
-                if (send_ret == ESP_OK) {
-                    ESP_LOGD(TAG, "WebSocket成功发送音频数据");
-                    buffer_ready_to_send = false;
-                    buffer_to_send = NULL;
+            // 使用AFE处理后的音频数据（16kHz单声道，每次512个采样）
+            if (res->data && res->data_size > 0) {
+                uint32_t frame_samples = res->data_size / sizeof(int16_t);
+                if (preroll_enabled) {
+                    // 本帧已排在预录音频之后；每帧最多额外补发SR_PREROLL_FLUSH_MS，不拖慢实时帧
+                    uplink_drain(frame_samples + AUDIO_UPLINK_SAMPLE_RATE * SR_PREROLL_FLUSH_MS / 1000);
                 } else {
-                    ESP_LOGE(TAG, "WebSocket发送音频数据失败: %s", esp_err_to_name(send_ret));
+                    uplink_frame(res->data, frame_samples, res->vad_state == VAD_SPEECH);
                 }
-            }
 
-            // 使用AFE处理后的音频数据，res->data_size = 1024字节
-            if (res->data && res->data_size > 0 && res->data_size == WS_TRANSFER_SIZE) {
-                // 由于res->data_size正好等于WS_TRANSFER_SIZE，我们可以直接复制整个数据块
-                memcpy(current_buffer, res->data, WS_TRANSFER_SIZE);
-                
-                // 交换缓冲区：当前缓冲区变为待发送缓冲区，下一个缓冲区变为当前缓冲区
-                buffer_to_send = current_buffer;
-                buffer_ready_to_send = true;
-                
-                // 切换当前缓冲区（乒乓机制）
-                current_buffer = (current_buffer == audio_buffer_A) ? audio_buffer_B : audio_buffer_A;
+                // 本帧已上行，按VAD结果判断是否说完（或达到时长上限）
+                sr_turn_end_t end;
+                uint32_t frame_ms = frame_samples * 1000 / AUDIO_UPLINK_SAMPLE_RATE;
+                if (endpoint_update(res->vad_state, frame_ms, &end)) {
+                    end_turn(afe_data, end, 0);
+                }
             }
         }
     }
@@ -192,7 +520,7 @@ esp_err_t app_sr_start(void)
 
     // 2. 初始化afe_config（通过库函数确保基础配置正确）
     afe_config_t *afe_config = afe_config_init(
-        "MR",             // 输入格式（单麦克风）
+        "MR",             // 输入格式（麦克风 + 回声参考）
         models,           // 模型列表
         AFE_TYPE_SR,      // 语音识别场景
         AFE_MODE_LOW_COST // 低功耗模式
@@ -211,6 +539,9 @@ esp_err_t app_sr_start(void)
     afe_config->wakenet_init = true; // 启用唤醒词引擎
 
     afe_config->vad_mode = VAD_MODE_3; // VAD模式（中等灵敏度）
+    // VAD内部只做短时平滑，起止判定（含拖尾静音）由端点检测按SR_EP_*完成
+    afe_config->vad_min_speech_ms = 64;
+    afe_config->vad_min_noise_ms = 128;
 
     // 唤醒词模型名称（从模型列表中过滤获取）
     afe_config->wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL);
@@ -227,10 +558,10 @@ esp_err_t app_sr_start(void)
     afe_config->agc_init = true;                   // 显式启用AGC
     afe_config->agc_mode = AFE_MN_PEAK_AGC_MODE_2; // AGC模式
 
-    // PCM配置（单麦克风，无参考音，16kHz采样率）
-    afe_config->pcm_config.total_ch_num = 1;
+    // PCM配置（单麦克风 + 扬声器输出回采的参考通道，16kHz采样率）
+    afe_config->pcm_config.total_ch_num = 2;
     afe_config->pcm_config.mic_num = 1;
-    afe_config->pcm_config.ref_num = 0;
+    afe_config->pcm_config.ref_num = 1;
     afe_config->pcm_config.sample_rate = 16000;
 
     afe_config->debug_init = false;               // 禁用调试
@@ -264,8 +595,8 @@ esp_err_t app_sr_start(void)
     BaseType_t ret_val = xTaskCreatePinnedToCore(audio_feed_task, "Feed Task", 8 * 1024, afe_data, 3, &audio_feed_task_handle, 1);
     ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create audio feed task");
 
-    // audio_detect_task保持较高优先级
-    ret_val = xTaskCreatePinnedToCore(audio_detect_task, "Detect Task", 6 * 1024, afe_data, 5, &audio_detect_task_handle, 0);
+    // audio_detect_task保持较高优先级；Opus编码（SILK）需要约12KB栈
+    ret_val = xTaskCreatePinnedToCore(audio_detect_task, "Detect Task", 16 * 1024, afe_data, 5, &audio_detect_task_handle, 0);
     ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create audio detect task");
 
     return ESP_OK;
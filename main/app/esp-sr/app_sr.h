@@ -17,6 +17,47 @@ extern "C"
 
 #define SR_CONTINUE_DET 1
 
+// 端点检测：唤醒后按VAD结果判断一轮对话的结束
+#define SR_EP_ONSET_MS      96    // 连续语音超过该时长才认为用户开始说话
+#define SR_EP_HANGOVER_MS   800   // 说话后连续静音超过该时长判定为说完
+#define SR_EP_NO_SPEECH_MS  5000  // 唤醒后一直没有说话的等待上限
+#define SR_EP_MAX_MS        30000 // 单轮上行时长上限（兜底）
+
+// 插话打断：播放期间保持唤醒词检测，检测到时立即停止播放并开始新一轮采集
+#define SR_BARGE_IN        1   // 0：唤醒后关闭唤醒词检测直到本轮结束
+#define SR_BARGE_IN_VAD    0   // 1：播放期间（AEC后的信号）持续检测到语音也视为插话
+#define SR_BARGE_IN_VAD_MS 300 // 播放期间连续语音超过该时长视为插话
+
+// 静音抑制：本轮上行中VAD判定为非语音的帧不发送，改发带时间位置的静音标记
+#define SR_SILENCE_SUPPRESS 1   // 0：静音帧照常上行
+#define SR_SILENCE_HANG_MS  200 // 语音结束后仍照常上行的时长，避免截断词尾
+
+    // 一轮对话的结束原因
+    typedef enum
+    {
+        SR_TURN_END_SPEECH = 0, // 检测到说话结束
+        SR_TURN_END_NO_SPEECH,  // 唤醒后未说话
+        SR_TURN_END_MAX,        // 达到时长上限
+        SR_TURN_END_REWAKE,     // 采集中再次唤醒，开始了新一轮
+    } sr_turn_end_t;
+
+    // 上行对话统计
+    typedef struct
+    {
+        uint32_t turns;              // 对话轮数
+        uint32_t last_streamed_ms;   // 上一轮上行音频时长（含预录音频，即end_of_utterance的duration_ms）
+        uint32_t last_speech_ms;     // 上一轮检测到的语音时长
+        sr_turn_end_t last_end;      // 上一轮的结束原因
+        uint64_t total_streamed_ms;  // 累计上行音频时长
+        uint32_t ended[4];           // 按结束原因（sr_turn_end_t）统计的轮数
+        uint32_t last_suppressed_ms; // 上一轮省略的静音时长
+        uint32_t last_saved_bytes;   // 上一轮静音抑制节省的上行字节数（估计）
+        uint64_t total_saved_bytes;  // 累计节省的上行字节数
+    } sr_turn_stats_t;
+
+    // 每轮结束时调用的钩子，在检测任务中执行，参数为包含刚结束这一轮的对话统计
+    typedef void (*app_sr_turn_hook_t)(const sr_turn_stats_t *stats);
+
     /**
      * @brief Start speech recognition task
      *
@@ -28,6 +69,21 @@ extern "C"
      */
     esp_err_t app_sr_start(void);
 
+    /**
+     * @brief 获取上行对话统计（每轮上行时长等）
+     */
+    void app_sr_get_turn_stats(sr_turn_stats_t *stats);
+
+    /**
+     * @brief 设置每轮结束时调用的钩子（如输出各模块统计），NULL为不调用
+     */
+    void app_sr_set_turn_hook(app_sr_turn_hook_t hook);
+
+    /**
+     * @brief 结束原因的名称（与end_of_utterance消息中的reason相同）
+     */
+    const char *app_sr_turn_end_name(sr_turn_end_t end);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <esp_board_init.h>
+#include "bsp_board.h"
+#include "sr_capture.h"
+
+static const char *TAG = "sr_capture";
+
+static QueueHandle_t capture_queue = NULL;
+static volatile uint32_t recv_seq = 0;      // 接收完成的DMA缓冲数（仅中断写入）
+static volatile uint32_t queue_overruns = 0; // 队列满被丢弃的缓冲数（仅中断写入）
+static uint32_t stale_overruns = 0;          // 处理前后已被DMA覆盖的缓冲数（仅采集任务写入）
+static uint32_t buffers = 0;
+
+/**
+ * @brief I2S接收完成中断：只传递DMA缓冲的地址，不拷贝数据
+ */
+static IRAM_ATTR bool sr_capture_on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    sr_capture_buf_t buf = {
+        .pcm = (const int16_t *)event->dma_buf,
+        .samples = event->size / sizeof(int16_t),
+        .seq = recv_seq++,
+        .capture_us = esp_timer_get_time(),
+    };
+    BaseType_t need_yield = pdFALSE;
+    if (xQueueSendFromISR(capture_queue, &buf, &need_yield) != pdTRUE)
+    {
+        queue_overruns++;
+    }
+    return need_yield == pdTRUE;
+}
+
+/**
+ * @brief DMA按DMA_RX_BUF_COUNT个缓冲循环写入，落后接近一整圈时该缓冲可能已被覆盖
+ */
+static bool sr_capture_is_stale(const sr_capture_buf_t *buf)
+{
+    return recv_seq - buf->seq >= DMA_RX_BUF_COUNT - 1;
+}
+
+esp_err_t sr_capture_start(uint32_t chunk_samples)
+{
+    if (capture_queue)
+    {
+        return ESP_OK;
+    }
+    if (chunk_samples == 0 || DMA_RX_BUF_LEN % chunk_samples != 0)
+    {
+        ESP_LOGE(TAG, "DMA缓冲长度%d不是AFE输入块%lu的整数倍", DMA_RX_BUF_LEN, chunk_samples);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    capture_queue = xQueueCreate(SR_CAPTURE_QUEUE_LEN, sizeof(sr_capture_buf_t));
+    if (!capture_queue)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = esp_i2s_register_rx_callback(sr_capture_on_recv, NULL);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "注册接收回调失败: %s", esp_err_to_name(ret));
+        vQueueDelete(capture_queue);
+        capture_queue = NULL;
+        return ret;
+    }
+    ESP_LOGI(TAG, "DMA采集: %d x %d个采样", DMA_RX_BUF_COUNT, DMA_RX_BUF_LEN);
+    return ESP_OK;
+}
+
+void sr_capture_read(sr_capture_buf_t *buf)
+{
+    while (1)
+    {
+        xQueueReceive(capture_queue, buf, portMAX_DELAY);
+        if (!sr_capture_is_stale(buf))
+        {
+            return;
+        }
+        stale_overruns++;
+    }
+}
+
+bool sr_capture_release(const sr_capture_buf_t *buf)
+{
+    buffers++;
+    if (sr_capture_is_stale(buf))
+    {
+        stale_overruns++;
+        return false;
+    }
+    return true;
+}
+
+void sr_capture_get_stats(sr_capture_stats_t *out)
+{
+    out->buffers = buffers;
+    out->overruns = queue_overruns + stale_overruns;
+}
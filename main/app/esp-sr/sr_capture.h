@@ -0,0 +1,50 @@
+#ifndef SR_CAPTURE_H
+#define SR_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+// 麦克风采集配置
+#define SR_CAPTURE_QUEUE_LEN 6 // 待处理DMA缓冲数上限（需小于DMA_RX_BUF_COUNT，留出DMA正在写入的缓冲）
+// 采集任务自有缓冲（参考信号、交织后的AFE输入）的位置：内部RAM更快，PSRAM节省内部内存
+#define SR_CAPTURE_BUF_CAPS  (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+// 一块接收完成的DMA缓冲
+typedef struct {
+    const int16_t *pcm;   // 指向DMA缓冲本身（只读，下一轮DMA循环前有效）
+    uint32_t samples;     // 采样数
+    uint32_t seq;         // 接收序号
+    int64_t capture_us;   // 最后一个采样的采集时刻（接收完成中断的esp_timer时间）
+} sr_capture_buf_t;
+
+// 采集统计
+typedef struct {
+    uint32_t buffers;  // 已处理的DMA缓冲数
+    uint32_t overruns; // 处理不及时被丢弃（或处理期间被DMA覆盖）的缓冲数
+} sr_capture_stats_t;
+
+/**
+ * @brief 注册I2S接收完成回调，此后由回调把DMA缓冲直接交给采集任务
+ * @param chunk_samples: AFE每次feed的采样数，DMA缓冲长度须为其整数倍
+ */
+esp_err_t sr_capture_start(uint32_t chunk_samples);
+
+/**
+ * @brief 等待下一块接收完成的DMA缓冲（不拷贝）
+ */
+void sr_capture_read(sr_capture_buf_t *buf);
+
+/**
+ * @brief 处理完一块缓冲后调用，检查处理期间该缓冲是否已被DMA覆盖
+ * @return 缓冲内容在处理期间保持有效返回true
+ */
+bool sr_capture_release(const sr_capture_buf_t *buf);
+
+/**
+ * @brief 获取采集统计
+ */
+void sr_capture_get_stats(sr_capture_stats_t *stats);
+
+#endif // SR_CAPTURE_H
@@ -0,0 +1,108 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "sr_preroll.h"
+
+static const char *TAG = "sr_preroll";
+
+// 预录环形缓冲区，仅检测任务访问；位置为自初始化起的绝对采样序号
+static int16_t *ring = NULL;
+static uint32_t capacity = 0; // 容量（采样数）
+static uint64_t start = 0;    // 最早采样的序号
+static uint32_t count = 0;    // 现有采样数
+
+// 每个AFE帧的VAD结果，按帧序号（采样序号 / frame_len）对长度取模
+static uint8_t *speech_flags = NULL;
+static uint32_t flag_count = 0;
+static uint32_t frame_len = 0;
+
+esp_err_t sr_preroll_init(uint32_t ms, uint32_t sample_rate, uint32_t frame_samples)
+{
+    if (ring)
+    {
+        return ESP_OK;
+    }
+    // 录音期间实时帧也先写入这里再按顺序发出，留出两帧余量避免补发期间覆盖未发出的采样
+    capacity = sample_rate * ms / 1000 + 2 * frame_samples;
+    frame_len = frame_samples;
+    flag_count = capacity / frame_samples + 2;
+    ring = heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    speech_flags = heap_caps_calloc(flag_count, sizeof(uint8_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring || !speech_flags)
+    {
+        ESP_LOGE(TAG, "无法分配预录缓冲区");
+        heap_caps_free(ring);
+        heap_caps_free(speech_flags);
+        ring = NULL;
+        speech_flags = NULL;
+        capacity = 0;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "预录%lu ms (%lu个采样)", ms, capacity);
+    return ESP_OK;
+}
+
+void sr_preroll_write(const int16_t *pcm, uint32_t samples, bool speech)
+{
+    if (!ring)
+    {
+        return;
+    }
+    if (samples > capacity)
+    {
+        pcm += samples - capacity;
+        samples = capacity;
+    }
+    // 空间不足时丢弃最早的采样
+    if (count + samples > capacity)
+    {
+        uint32_t drop = count + samples - capacity;
+        start += drop;
+        count -= drop;
+    }
+    uint64_t end = start + count;
+    for (uint64_t frame = end / frame_len; frame * frame_len < end + samples; frame++)
+    {
+        speech_flags[frame % flag_count] = speech;
+    }
+    uint32_t pos = (uint32_t)(end % capacity);
+    uint32_t first = capacity - pos < samples ? capacity - pos : samples;
+    memcpy(ring + pos, pcm, first * sizeof(int16_t));
+    memcpy(ring, pcm + first, (samples - first) * sizeof(int16_t));
+    count += samples;
+}
+
+void sr_preroll_keep(uint32_t samples)
+{
+    if (samples < count)
+    {
+        start += count - samples;
+        count = samples;
+    }
+}
+
+uint32_t sr_preroll_read(int16_t *pcm, uint32_t max_samples, bool *speech)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    // 一次只读到当前帧末尾，使取出的采样对应同一个VAD结果
+    uint32_t frame_left = frame_len - (uint32_t)(start % frame_len);
+    uint32_t n = count < max_samples ? count : max_samples;
+    n = n < frame_left ? n : frame_left;
+    *speech = speech_flags[(start / frame_len) % flag_count];
+
+    uint32_t pos = (uint32_t)(start % capacity);
+    uint32_t first = capacity - pos < n ? capacity - pos : n;
+    memcpy(pcm, ring + pos, first * sizeof(int16_t));
+    memcpy(pcm + first, ring, (n - first) * sizeof(int16_t));
+    start += n;
+    count -= n;
+    return n;
+}
+
+uint32_t sr_preroll_available(void)
+{
+    return count;
+}
@@ -0,0 +1,44 @@
+#ifndef SR_PREROLL_H
+#define SR_PREROLL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// 唤醒前预录配置
+#define SR_PREROLL_MS               500 // 预录时长（建议300~1000ms），唤醒时作为首段上行
+#define SR_PREROLL_TRIM_WAKEWORD    0   // 1：从首段上行中去掉唤醒词本身
+#define SR_PREROLL_TRIGGER_DELAY_MS 200 // 唤醒词结束到唤醒触发之间的大致时长，去掉唤醒词时保留这一段
+#define SR_PREROLL_FLUSH_MS         64  // 每处理一帧实时音频时额外补发的预录时长上限
+
+/**
+ * @brief 分配预录环形缓冲区（PSRAM），保存最近ms毫秒的AFE输出
+ * @param ms: 预录时长
+ * @param sample_rate: AFE输出采样率
+ * @param frame_samples: AFE每次输出的采样数，额外留出的余量，也是记录VAD结果的粒度
+ */
+esp_err_t sr_preroll_init(uint32_t ms, uint32_t sample_rate, uint32_t frame_samples);
+
+/**
+ * @brief 追加一帧PCM及其VAD结果，超出容量时覆盖最早的采样
+ */
+void sr_preroll_write(const int16_t *pcm, uint32_t samples, bool speech);
+
+/**
+ * @brief 只保留最近的samples个采样，其余丢弃
+ */
+void sr_preroll_keep(uint32_t samples);
+
+/**
+ * @brief 按先后顺序取出最多max_samples个采样，一次不跨越帧边界
+ * @param speech: 输出这些采样所在帧的VAD结果
+ * @return 实际取出的采样数
+ */
+uint32_t sr_preroll_read(int16_t *pcm, uint32_t max_samples, bool *speech);
+
+/**
+ * @brief 缓冲区中的采样数
+ */
+uint32_t sr_preroll_available(void);
+
+#endif // SR_PREROLL_H
@@ -0,0 +1,204 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sr_spool.h"
+
+static const char *TAG = "sr_spool";
+
+// 字节环形缓冲区，每条消息为记录头加负载，仅上行发送任务访问
+static uint8_t *ring = NULL;
+static uint32_t capacity = 0;
+static uint32_t start = 0; // 最早一条消息的位置
+static uint32_t used = 0;  // 已占用字节数
+static int64_t oldest_us = 0;
+static sr_spool_stats_t stats; // 由发送任务更新，其他任务读取统计，更新和读取都在stats_lock内
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void ring_copy_in(uint32_t pos, const void *data, uint32_t len)
+{
+    pos %= capacity;
+    uint32_t first = capacity - pos < len ? capacity - pos : len;
+    memcpy(ring + pos, data, first);
+    memcpy(ring, (const uint8_t *)data + first, len - first);
+}
+
+static void ring_copy_out(uint32_t pos, void *data, uint32_t len)
+{
+    pos %= capacity;
+    uint32_t first = capacity - pos < len ? capacity - pos : len;
+    memcpy(data, ring + pos, first);
+    memcpy((uint8_t *)data + first, ring, len - first);
+}
+
+esp_err_t sr_spool_init(size_t size)
+{
+    if (ring)
+    {
+        return ESP_OK;
+    }
+    ring = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring)
+    {
+        ESP_LOGE(TAG, "无法分配断线缓存");
+        return ESP_ERR_NO_MEM;
+    }
+    capacity = size;
+    ESP_LOGI(TAG, "断线缓存%u KB", size / 1024);
+    return ESP_OK;
+}
+
+// 移除最早的一条消息
+static void spool_remove(void)
+{
+    sr_spool_record_t record;
+    ring_copy_out(start, &record, sizeof(record));
+    uint32_t size = sizeof(record) + record.len;
+    start = (start + size) % capacity;
+    used -= size;
+    uint32_t messages = stats.messages - 1;
+    if (messages > 0)
+    {
+        ring_copy_out(start, &record, sizeof(record));
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.messages = messages;
+    if (messages > 0)
+    {
+        oldest_us = record.oldest_us;
+    }
+    stats.bytes = used;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+// 在环内把[src, src+len)搬到[dst, dst+len)，dst在src之后，从尾部开始逐字节搬运以允许重叠
+static void ring_move_forward(uint32_t dst, uint32_t src, uint32_t len)
+{
+    for (uint32_t i = len; i-- > 0;)
+    {
+        ring[(dst + i) % capacity] = ring[(src + i) % capacity];
+    }
+}
+
+/**
+ * @brief 丢弃最早的一条音频消息，排在它前面的控制消息整体后移填补空位，顺序不变
+ * @return 缓存中只剩控制消息时返回false
+ */
+static bool spool_evict_audio(void)
+{
+    sr_spool_record_t record;
+    uint32_t skipped = 0; // 排在最早音频消息前面的控制消息字节数
+    uint32_t i = 0;
+    for (; i < stats.messages; i++)
+    {
+        ring_copy_out(start + skipped, &record, sizeof(record));
+        if (!record.control)
+        {
+            break;
+        }
+        skipped += sizeof(record) + record.len;
+    }
+    if (i == stats.messages)
+    {
+        return false;
+    }
+    uint32_t size = sizeof(record) + record.len;
+    ring_move_forward(start + size, start, skipped);
+    start = (start + size) % capacity;
+    used -= size;
+    uint32_t messages = stats.messages - 1;
+    if (messages > 0)
+    {
+        ring_copy_out(start, &record, sizeof(record));
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.messages = messages;
+    if (messages > 0)
+    {
+        oldest_us = record.oldest_us;
+    }
+    stats.bytes = used;
+    stats.dropped++;
+    portEXIT_CRITICAL(&stats_lock);
+    return true;
+}
+
+esp_err_t sr_spool_put(const sr_spool_record_t *record, const void *data)
+{
+    uint32_t size = sizeof(*record) + record->len;
+    if (!ring || size > capacity)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // 空间不足时先丢音频；只剩控制消息时宁可丢弃新的音频，只有新消息也是控制消息才丢最早的控制消息
+    while (used + size > capacity)
+    {
+        if (spool_evict_audio())
+        {
+            continue;
+        }
+        if (!record->control)
+        {
+            portENTER_CRITICAL(&stats_lock);
+            stats.dropped++;
+            portEXIT_CRITICAL(&stats_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        spool_remove();
+        portENTER_CRITICAL(&stats_lock);
+        stats.ctrl_dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    ring_copy_in(start + used, record, sizeof(*record));
+    ring_copy_in(start + used + sizeof(*record), data, record->len);
+    used += size;
+    portENTER_CRITICAL(&stats_lock);
+    if (stats.messages == 0)
+    {
+        oldest_us = record->oldest_us;
+    }
+    stats.messages++;
+    stats.bytes = used;
+    stats.spooled++;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void sr_spool_pop(void)
+{
+    if (stats.messages == 0)
+    {
+        return;
+    }
+    spool_remove();
+    portENTER_CRITICAL(&stats_lock);
+    stats.replayed++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+bool sr_spool_peek(sr_spool_record_t *record, void *data, size_t max)
+{
+    if (stats.messages == 0)
+    {
+        return false;
+    }
+    ring_copy_out(start, record, sizeof(*record));
+    ring_copy_out(start + sizeof(*record), data, record->len < max ? record->len : max);
+    return true;
+}
+
+uint32_t sr_spool_count(void)
+{
+    return stats.messages;
+}
+
+void sr_spool_get_stats(sr_spool_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    int64_t oldest = oldest_us;
+    portEXIT_CRITICAL(&stats_lock);
+    out->age_ms = out->messages > 0 ? (uint32_t)((now - oldest) / 1000) : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SR_SPOOL_H
+#define SR_SPOOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// 断线缓存配置
+#define SR_SPOOL_SIZE (128 * 1024) // 断线期间缓存上行消息的字节数（PSRAM，24kbit/s的Opus约40秒）
+
+// 缓存中的一条上行消息的描述
+typedef struct {
+    uint16_t len;       // 负载字节数
+    uint8_t type;       // 消息类型（由上行模块定义）
+    uint8_t frames;     // 合并的帧数
+    uint8_t control;    // 非0为控制消息（唤醒、结束等），空间不足时先丢弃音频
+    int64_t oldest_us;  // 最早一帧的入队时刻
+} sr_spool_record_t;
+
+// 断线缓存统计
+typedef struct {
+    uint32_t messages; // 当前缓存的消息数
+    uint32_t bytes;    // 当前占用的字节数（含记录头）
+    uint32_t age_ms;   // 最早一条消息已缓存的时长
+    uint32_t spooled;  // 累计写入的消息数
+    uint32_t replayed; // 累计重新发出的消息数
+    uint32_t dropped;  // 缓存满被丢弃的音频消息数
+    uint32_t ctrl_dropped; // 缓存满且只剩控制消息时被丢弃的控制消息数
+} sr_spool_stats_t;
+
+/**
+ * @brief 分配断线缓存（PSRAM），仅由上行发送任务使用（统计可在任意任务读取）
+ * @param size: 缓存字节数
+ */
+esp_err_t sr_spool_init(size_t size);
+
+/**
+ * @brief 追加一条消息，空间不足时丢弃最早的音频消息，控制消息保留
+ * @return 消息比整个缓存还大时返回ESP_ERR_INVALID_SIZE，只剩控制消息而新消息是音频时返回ESP_ERR_NO_MEM
+ */
+esp_err_t sr_spool_put(const sr_spool_record_t *record, const void *data);
+
+/**
+ * @brief 读取最早的一条消息（不移除），data至少能容纳max字节
+ * @return 缓存为空时返回false
+ */
+bool sr_spool_peek(sr_spool_record_t *record, void *data, size_t max);
+
+/**
+ * @brief 移除最早的一条消息（已成功重新发出）
+ */
+void sr_spool_pop(void);
+
+/**
+ * @brief 当前缓存的消息数
+ */
+uint32_t sr_spool_count(void);
+
+/**
+ * @brief 获取断线缓存统计
+ */
+void sr_spool_get_stats(sr_spool_stats_t *stats);
+
+#endif // SR_SPOOL_H
@@ -0,0 +1,530 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "websocket.h"
+#include "sr_uplink.h"
+#include "sr_spool.h"
+
+static const char *TAG = "sr_uplink";
+
+#define SR_UPLINK_RETRY_MS 100 // 未连接服务器时发送任务的重试间隔
+
+// 帧类型
+typedef enum {
+    UPLINK_FRAME_BINARY = 0, // 连续音频，合并时直接拼接
+    UPLINK_FRAME_JSON,       // 控制消息，总是单独发送
+    UPLINK_FRAME_PACKET,     // 独立数据包，合并时加长度前缀
+} uplink_frame_type_t;
+
+// 队列中的一帧（PSRAM）
+typedef struct {
+    int64_t enqueue_us; // 入队时刻
+    uint32_t seq;       // 控制消息：入队时音频队列的head，之前的音频帧发出（或丢弃）后才发送
+    uint16_t len;
+    uint8_t type;
+    uint8_t data[SR_UPLINK_FRAME_MAX];
+} uplink_frame_t;
+
+#define PACKET_PREFIX_LEN 2
+#define BATCH_BUF_SIZE    (SR_UPLINK_COALESCE_MAX * (SR_UPLINK_FRAME_MAX + PACKET_PREFIX_LEN))
+
+// 正在凑批的消息（仅发送任务访问）
+typedef struct {
+    uint8_t *buf;        // 消息缓冲（PSRAM）
+    size_t len;
+    uint32_t frames;
+    uint8_t type;
+    int64_t oldest_us;   // 最早一帧的入队时刻
+    uint32_t target;     // 目标帧数，随发送耗时和积压调整
+    int64_t send_avg_us; // 发送耗时的滑动平均
+} uplink_batch_t;
+
+// 单生产者（采集任务）/单消费者（发送任务）的无锁帧队列
+// head只由生产者推进；tail通常由消费者推进，丢弃最早帧时生产者用CAS推进，
+// 消费者先拷出帧再用CAS提交，提交失败说明该帧已被丢弃（内容可能已被覆盖）
+// 音频帧和控制消息分两个队列：控制消息（唤醒、静音标记、结束等）决定轮次边界，只在链路长时间阻塞时丢弃，
+// 按入队时记录的音频位置与音频帧归并，保持原有先后顺序
+typedef struct {
+    uplink_frame_t *slots;
+    uint32_t depth;             // 槽位数，2的幂
+    atomic_uint head;           // 累计入队帧数
+    atomic_uint tail;           // 累计出队（含丢弃）帧数
+    sr_uplink_overflow_t policy;
+    TickType_t block_ticks;      // 阻塞策略下最长等待时长，超时后丢弃最早的帧
+    SemaphoreHandle_t space_sem; // 阻塞策略下唤醒等待空间的生产者
+} uplink_ring_t;
+
+static uplink_ring_t ring; // 音频帧，满时按策略丢弃最早的帧或阻塞
+static uplink_ring_t ctrl; // JSON控制消息，满时最多等待SR_UPLINK_CTRL_WAIT_MS，之后丢弃最早的一条
+static TaskHandle_t sender_task_handle = NULL;
+static sr_uplink_stats_t stats;      // 生产者和发送任务共同更新，读写都在stats_lock内
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool sender_stalled = false; // 未连接且没有断线缓存，发送任务不取帧
+static uplink_frame_t sending_frame; // 发送任务私有的出队拷贝（内部RAM）
+static uplink_batch_t batch;
+static bool spool_enabled = false; // 断线缓存是否可用
+static bool replaying = false;     // 正在重新发出断线缓存
+
+/**
+ * @brief 生产者等待空闲槽位：按策略丢弃最早的帧或阻塞
+ * 阻塞最多block_ticks，发送任务不取帧时不等待，超时后同样丢弃最早的帧，保证采集循环不会无限阻塞
+ * @return 当前head
+ */
+static unsigned int ring_reserve(uplink_ring_t *r)
+{
+    unsigned int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    while (1)
+    {
+        unsigned int tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head - tail < r->depth)
+        {
+            return head;
+        }
+        if (r->policy == SR_UPLINK_BLOCK && !sender_stalled &&
+            xSemaphoreTake(r->space_sem, r->block_ticks) == pdTRUE)
+        {
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&r->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_relaxed))
+        {
+            portENTER_CRITICAL(&stats_lock);
+            if (r == &ctrl)
+            {
+                stats.ctrl_dropped++;
+            }
+            else
+            {
+                stats.dropped++;
+            }
+            portEXIT_CRITICAL(&stats_lock);
+        }
+    }
+}
+
+/**
+ * @param urgent: 控制消息排在已入队的音频帧之前（仍在先入队的控制消息之后）
+ */
+static esp_err_t ring_push(uplink_frame_type_t type, const void *data, size_t len, bool urgent)
+{
+    if (!sender_task_handle)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!data || len == 0 || len > SR_UPLINK_FRAME_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uplink_ring_t *r = type == UPLINK_FRAME_JSON ? &ctrl : &ring;
+    unsigned int head = ring_reserve(r);
+    uplink_frame_t *slot = &r->slots[head & (r->depth - 1)];
+    memcpy(slot->data, data, len);
+    slot->enqueue_us = esp_timer_get_time();
+    slot->seq = atomic_load_explicit(urgent ? &ring.tail : &ring.head, memory_order_relaxed);
+    slot->len = len;
+    slot->type = type;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+    unsigned int used = head + 1 - atomic_load_explicit(&r->tail, memory_order_relaxed);
+    portENTER_CRITICAL(&stats_lock);
+    stats.enqueued++;
+    if (r == &ring && used > stats.depth_max)
+    {
+        stats.depth_max = used;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    xTaskNotifyGive(sender_task_handle);
+    return ESP_OK;
+}
+
+/**
+ * @brief 消费者取出队首帧到frame
+ * @param limit: 只取序号小于limit的帧（limited为true时）
+ * @return 队列为空（或队首已到limit）返回false
+ */
+static bool ring_pop(uplink_ring_t *r, uplink_frame_t *frame, bool limited, unsigned int limit)
+{
+    while (1)
+    {
+        unsigned int tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (tail == atomic_load_explicit(&r->head, memory_order_acquire) ||
+            (limited && (int)(tail - limit) >= 0))
+        {
+            return false;
+        }
+        const uplink_frame_t *slot = &r->slots[tail & (r->depth - 1)];
+        frame->enqueue_us = slot->enqueue_us;
+        frame->seq = slot->seq;
+        frame->type = slot->type;
+        frame->len = slot->len > SR_UPLINK_FRAME_MAX ? SR_UPLINK_FRAME_MAX : slot->len;
+        memcpy(frame->data, slot->data, frame->len);
+        if (atomic_compare_exchange_strong_explicit(&r->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_relaxed))
+        {
+            xSemaphoreGive(r->space_sem);
+            return true;
+        }
+        // 拷贝期间该帧被生产者丢弃，重新读取新的队首
+    }
+}
+
+/**
+ * @brief 按入队顺序取出下一帧：控制消息之前入队的音频帧都已取出（或被丢弃）时先取控制消息
+ */
+static bool uplink_pop(uplink_frame_t *frame)
+{
+    unsigned int ctrl_tail = atomic_load_explicit(&ctrl.tail, memory_order_relaxed);
+    if (ctrl_tail == atomic_load_explicit(&ctrl.head, memory_order_acquire))
+    {
+        return ring_pop(&ring, frame, false, 0);
+    }
+    unsigned int seq = ctrl.slots[ctrl_tail & (ctrl.depth - 1)].seq;
+    if (ring_pop(&ring, frame, true, seq))
+    {
+        return true;
+    }
+    return ring_pop(&ctrl, frame, false, 0);
+}
+
+static unsigned int ring_backlog(void)
+{
+    return atomic_load_explicit(&ring.head, memory_order_acquire) - atomic_load_explicit(&ring.tail, memory_order_relaxed) +
+           atomic_load_explicit(&ctrl.head, memory_order_acquire) - atomic_load_explicit(&ctrl.tail, memory_order_relaxed);
+}
+
+static void batch_append(const uplink_frame_t *frame)
+{
+    if (batch.frames == 0)
+    {
+        batch.len = 0;
+        batch.type = frame->type;
+        batch.oldest_us = frame->enqueue_us;
+    }
+    if (frame->type == UPLINK_FRAME_PACKET && SR_UPLINK_COALESCE_MAX > 1)
+    {
+        batch.buf[batch.len++] = frame->len >> 8;
+        batch.buf[batch.len++] = frame->len & 0xff;
+    }
+    memcpy(batch.buf + batch.len, frame->data, frame->len);
+    batch.len += frame->len;
+    batch.frames++;
+}
+
+/**
+ * @brief 把凑好的消息放入断线缓存，重连后按原顺序发出
+ */
+static void batch_spool(void)
+{
+    sr_spool_record_t record = {
+        .len = batch.len,
+        .type = batch.type,
+        .frames = batch.frames,
+        .control = batch.type == UPLINK_FRAME_JSON,
+        .oldest_us = batch.oldest_us,
+    };
+    if (sr_spool_put(&record, batch.buf) != ESP_OK)
+    {
+        portENTER_CRITICAL(&stats_lock);
+        stats.spool_dropped += batch.frames;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    batch.frames = 0;
+}
+
+/**
+ * @brief 发送一条消息并按发送耗时和积压调整下一批的目标帧数
+ * 发送变慢或积压超过当前批量时批量加倍，链路空闲时逐帧减小，直到SR_UPLINK_COALESCE_MIN；
+ * 发送失败（连接断开）的消息放入断线缓存
+ */
+static void batch_send(void)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = batch.type == UPLINK_FRAME_JSON
+                        ? ws_send_json((const char *)batch.buf, batch.len)
+                        : ws_send_binary(batch.buf, batch.len);
+    int64_t end = esp_timer_get_time();
+
+    if (ret == ESP_OK)
+    {
+        portENTER_CRITICAL(&stats_lock);
+        stats.sent += batch.frames;
+        stats.messages++;
+        stats.payload_bytes += batch.len;
+        stats.overhead_bytes += SR_UPLINK_MSG_OVERHEAD;
+        if (batch.type != UPLINK_FRAME_JSON)
+        {
+            stats.latency_us = (uint32_t)(end - batch.oldest_us);
+            if (stats.latency_us > stats.latency_max_us)
+            {
+                stats.latency_max_us = stats.latency_us;
+            }
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    else
+    {
+        portENTER_CRITICAL(&stats_lock);
+        stats.send_failed += batch.frames;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGW(TAG, "发送失败: %s", esp_err_to_name(ret));
+        if (spool_enabled)
+        {
+            batch_spool();
+        }
+    }
+    batch.frames = 0;
+
+    batch.send_avg_us = batch.send_avg_us == 0 ? end - start : (batch.send_avg_us * 7 + (end - start)) / 8;
+    unsigned int backlog = ring_backlog();
+    if (batch.send_avg_us > SR_UPLINK_SLOW_MS * 1000LL || backlog >= batch.target)
+    {
+        batch.target = batch.target * 2 > SR_UPLINK_COALESCE_MAX ? SR_UPLINK_COALESCE_MAX : batch.target * 2;
+    }
+    else if (backlog == 0 && batch.send_avg_us < SR_UPLINK_SLOW_MS * 1000LL / 2 && batch.target > SR_UPLINK_COALESCE_MIN)
+    {
+        batch.target--;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    stats.send_us = (uint32_t)batch.send_avg_us;
+    stats.batch = batch.target;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * @brief 重连后发出断线缓存中最早的一条消息
+ * 首条之前发送replay消息说明缓存的消息数和最早一条的采集时长，全部发出后发送replay_end，
+ * 服务器据此把这段音频按原时间归位；轮内各段音频的时间由音频本身和静音标记保留
+ */
+static void spool_replay_one(void)
+{
+    char msg[96];
+    if (!replaying)
+    {
+        sr_spool_stats_t spool_stats;
+        sr_spool_get_stats(&spool_stats);
+        int len = snprintf(msg, sizeof(msg), "{\"type\":\"replay\",\"messages\":%lu,\"age_ms\":%lu}",
+                           spool_stats.messages, spool_stats.age_ms);
+        if (ws_send_json(msg, len) != ESP_OK)
+        {
+            vTaskDelay(pdMS_TO_TICKS(SR_UPLINK_RETRY_MS));
+            return;
+        }
+        replaying = true;
+        ESP_LOGI(TAG, "重新发出断线缓存: %lu条消息, 最早%lu ms前", spool_stats.messages, spool_stats.age_ms);
+    }
+
+    sr_spool_record_t record;
+    if (sr_spool_peek(&record, batch.buf, BATCH_BUF_SIZE))
+    {
+        esp_err_t ret = record.type == UPLINK_FRAME_JSON
+                            ? ws_send_json((const char *)batch.buf, record.len)
+                            : ws_send_binary(batch.buf, record.len);
+        if (ret != ESP_OK)
+        {
+            // 留在缓存中，下次连接后重新发送replay消息再继续
+            portENTER_CRITICAL(&stats_lock);
+            stats.send_failed += record.frames;
+            portEXIT_CRITICAL(&stats_lock);
+            replaying = false;
+            vTaskDelay(pdMS_TO_TICKS(SR_UPLINK_RETRY_MS));
+            return;
+        }
+        sr_spool_pop();
+        portENTER_CRITICAL(&stats_lock);
+        stats.sent += record.frames;
+        stats.messages++;
+        stats.payload_bytes += record.len;
+        stats.overhead_bytes += SR_UPLINK_MSG_OVERHEAD;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    if (sr_spool_count() == 0)
+    {
+        int len = snprintf(msg, sizeof(msg), "{\"type\":\"replay_end\"}");
+        if (ws_send_json(msg, len) != ESP_OK)
+        {
+            // 保持replaying，下一轮重发replay_end
+            vTaskDelay(pdMS_TO_TICKS(SR_UPLINK_RETRY_MS));
+            return;
+        }
+        replaying = false;
+    }
+}
+
+/**
+ * @brief 发送任务：取出帧并按当前批量合并发送，网络阻塞只影响本任务，不影响采集循环
+ * 断线期间（以及重连后断线缓存尚未发完时）凑好的消息进入断线缓存，保证先后顺序
+ */
+static void sr_uplink_task(void *pvParameters)
+{
+    bool pending = false; // sending_frame中有一帧不能并入上一批，留到下一轮处理
+    while (1)
+    {
+        bool connected = is_ws_connected();
+        if (!connected)
+        {
+            // 未发完的重发属于断开的连接，重连后从replay消息重新开始
+            replaying = false;
+        }
+        bool spooling = spool_enabled && (!connected || sr_spool_count() > 0 || replaying);
+        sender_stalled = !connected && !spool_enabled;
+        if (!pending)
+        {
+            if (ring_backlog() == 0)
+            {
+                if (connected && (sr_spool_count() > 0 || replaying))
+                {
+                    spool_replay_one();
+                    continue;
+                }
+                ulTaskNotifyTake(pdTRUE, sr_spool_count() > 0 ? pdMS_TO_TICKS(SR_UPLINK_RETRY_MS) : portMAX_DELAY);
+                continue;
+            }
+            if (!connected && !spool_enabled)
+            {
+                // 没有断线缓存时帧留在队列中，队列满时按溢出策略处理
+                vTaskDelay(pdMS_TO_TICKS(SR_UPLINK_RETRY_MS));
+                continue;
+            }
+            if (!uplink_pop(&sending_frame))
+            {
+                continue;
+            }
+        }
+        pending = false;
+        batch_append(&sending_frame);
+
+        // 凑批：取已入队的同类音频帧，不足目标批量时最多等到首帧入队后SR_UPLINK_COALESCE_HOLD_MS
+        // 写入断线缓存时不等待，按上限合并已入队的帧
+        uint32_t target = spooling ? SR_UPLINK_COALESCE_MAX : batch.target;
+        int64_t deadline = batch.oldest_us + SR_UPLINK_COALESCE_HOLD_MS * 1000LL;
+        while (batch.type != UPLINK_FRAME_JSON && batch.frames < target)
+        {
+            if (!uplink_pop(&sending_frame))
+            {
+                int64_t wait_ms = (deadline - esp_timer_get_time()) / 1000;
+                if (spooling || wait_ms <= 0 || ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms) + 1) == 0)
+                {
+                    break;
+                }
+                continue;
+            }
+            if (sending_frame.type != batch.type)
+            {
+                pending = true;
+                break;
+            }
+            batch_append(&sending_frame);
+        }
+        if (spooling)
+        {
+            batch_spool();
+        }
+        else
+        {
+            batch_send();
+        }
+    }
+}
+
+esp_err_t sr_uplink_init(uint32_t depth, sr_uplink_overflow_t policy)
+{
+    if (sender_task_handle)
+    {
+        return ESP_OK;
+    }
+    uint32_t capacity = 1;
+    while (capacity < depth)
+    {
+        capacity <<= 1;
+    }
+    ring.slots = heap_caps_calloc(capacity, sizeof(uplink_frame_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctrl.slots = heap_caps_calloc(SR_UPLINK_CTRL_DEPTH, sizeof(uplink_frame_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    batch.buf = heap_caps_malloc(BATCH_BUF_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ring.space_sem = xSemaphoreCreateBinary();
+    ctrl.space_sem = xSemaphoreCreateBinary();
+    if (!ring.slots || !ctrl.slots || !batch.buf || !ring.space_sem || !ctrl.space_sem)
+    {
+        ESP_LOGE(TAG, "无法分配上行队列");
+        free(ring.slots);
+        ring.slots = NULL;
+        free(ctrl.slots);
+        ctrl.slots = NULL;
+        free(batch.buf);
+        batch.buf = NULL;
+        if (ring.space_sem)
+        {
+            vSemaphoreDelete(ring.space_sem);
+            ring.space_sem = NULL;
+        }
+        if (ctrl.space_sem)
+        {
+            vSemaphoreDelete(ctrl.space_sem);
+            ctrl.space_sem = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    ring.depth = capacity;
+    ring.policy = policy;
+    ring.block_ticks = portMAX_DELAY;
+    atomic_init(&ring.head, 0);
+    atomic_init(&ring.tail, 0);
+    ctrl.depth = SR_UPLINK_CTRL_DEPTH;
+    ctrl.policy = SR_UPLINK_BLOCK;
+    ctrl.block_ticks = pdMS_TO_TICKS(SR_UPLINK_CTRL_WAIT_MS);
+    atomic_init(&ctrl.head, 0);
+    atomic_init(&ctrl.tail, 0);
+    batch.target = SR_UPLINK_COALESCE_MIN;
+    stats.batch = batch.target;
+    spool_enabled = sr_spool_init(SR_SPOOL_SIZE) == ESP_OK;
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(sr_uplink_task, "SR Uplink", 4 * 1024, NULL, 4, &sender_task_handle, 0);
+    if (ret_val != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed create uplink sender task");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "上行队列: %lu帧, 溢出策略: %s, 每条消息%d~%d帧", capacity,
+             policy == SR_UPLINK_BLOCK ? "阻塞" : "丢弃最早", SR_UPLINK_COALESCE_MIN, SR_UPLINK_COALESCE_MAX);
+    return ESP_OK;
+}
+
+esp_err_t sr_uplink_send_binary(const void *data, size_t len)
+{
+    return ring_push(UPLINK_FRAME_BINARY, data, len, false);
+}
+
+esp_err_t sr_uplink_send_packet(const void *data, size_t len)
+{
+    return ring_push(UPLINK_FRAME_PACKET, data, len, false);
+}
+
+const char *sr_uplink_packet_framing(void)
+{
+    return SR_UPLINK_COALESCE_MAX > 1 ? "len16" : NULL;
+}
+
+esp_err_t sr_uplink_send_json(const char *json)
+{
+    return ring_push(UPLINK_FRAME_JSON, json, json ? strlen(json) : 0, false);
+}
+
+esp_err_t sr_uplink_send_json_urgent(const char *json)
+{
+    return ring_push(UPLINK_FRAME_JSON, json, json ? strlen(json) : 0, true);
+}
+
+void sr_uplink_get_stats(sr_uplink_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void sr_uplink_get_spool_stats(sr_spool_stats_t *out)
+{
+    sr_spool_get_stats(out);
+}
@@ -0,0 +1,95 @@
+#ifndef SR_UPLINK_H
+#define SR_UPLINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sr_spool.h"
+
+// 上行发送队列配置
+#define SR_UPLINK_DEPTH     64   // 队列可缓存的帧数（20ms Opus帧约1.3秒）
+#define SR_UPLINK_FRAME_MAX 1024 // 单帧最大字节数（可容纳一块原始PCM）
+#define SR_UPLINK_OVERFLOW  SR_UPLINK_DROP_OLDEST
+#define SR_UPLINK_CTRL_DEPTH 16  // JSON控制消息队列的条数（2的幂）
+#define SR_UPLINK_CTRL_WAIT_MS 20 // 控制消息队列满时生产者最多等待的时长，超时丢弃最早的一条
+
+// 上行合并：把连续的音频帧合并为一条WebSocket消息，减少每条消息的WebSocket/TLS开销
+// 链路空闲时每条消息一帧（延迟最低），发送变慢或积压时增大批量
+#define SR_UPLINK_COALESCE_MIN     1  // 每条消息的最少帧数
+#define SR_UPLINK_COALESCE_MAX     8  // 每条消息的最多帧数，1为不合并
+#define SR_UPLINK_COALESCE_HOLD_MS 60 // 凑批时首帧最多等待的时长
+#define SR_UPLINK_SLOW_MS          20 // 平均发送耗时超过该值视为链路拥塞
+#define SR_UPLINK_MSG_OVERHEAD     33 // 每条消息的估计开销（WebSocket帧头+掩码约8字节，TLS记录头和认证标签约25字节）
+
+// 队列满时的处理策略
+typedef enum {
+    SR_UPLINK_DROP_OLDEST = 0, // 丢弃最早未发送的音频帧，采集循环不因音频阻塞
+    SR_UPLINK_BLOCK,           // 阻塞生产者直到发送任务腾出空间（未连接且没有断线缓存时不阻塞，丢弃最早的帧）
+} sr_uplink_overflow_t;
+
+// 上行发送统计
+typedef struct {
+    uint32_t enqueued;       // 入队帧数
+    uint32_t sent;           // 发送成功帧数
+    uint32_t dropped;        // 队列满被丢弃的音频帧数（由生产者计数）
+    uint32_t ctrl_dropped;   // 控制消息队列满且等待超时被丢弃的控制消息数
+    uint32_t spool_dropped;  // 断线缓存满被丢弃的帧数（由发送任务计数）
+    uint32_t send_failed;    // 发送失败（连接断开等）的帧数，失败的消息进入断线缓存
+    uint32_t depth_max;      // 队列深度峰值
+    uint32_t messages;       // 发送成功的WebSocket消息数
+    uint32_t payload_bytes;  // 消息负载字节数
+    uint32_t overhead_bytes; // 估计的消息开销字节数（messages * SR_UPLINK_MSG_OVERHEAD）
+    uint32_t batch;          // 当前每条消息的目标帧数
+    uint32_t send_us;        // 平均每条消息的发送耗时
+    uint32_t latency_us;     // 最近一条消息中最早一帧从入队到发送完成的时长
+    uint32_t latency_max_us; // 上述时长的峰值
+} sr_uplink_stats_t;
+
+/**
+ * @brief 创建上行帧队列、断线缓存（PSRAM）和网络发送任务
+ * @param depth: 队列帧数，向上取整为2的幂
+ * @param policy: 队列满时的处理策略
+ */
+esp_err_t sr_uplink_init(uint32_t depth, sr_uplink_overflow_t policy);
+
+/**
+ * @brief 将一块连续的二进制音频（原始PCM）放入发送队列，不等待网络
+ * 合并发送时直接拼接
+ */
+esp_err_t sr_uplink_send_binary(const void *data, size_t len);
+
+/**
+ * @brief 将一个独立的数据包（Opus包）放入发送队列
+ * 合并发送时每个包前加2字节大端长度，服务器据此拆分；不合并（SR_UPLINK_COALESCE_MAX为1）时原样发送
+ */
+esp_err_t sr_uplink_send_packet(const void *data, size_t len);
+
+/**
+ * @brief 数据包合并时的封装格式，用于在唤醒消息中告知服务器
+ * @return "len16"，不合并时返回NULL
+ */
+const char *sr_uplink_packet_framing(void);
+
+/**
+ * @brief 将一条JSON控制消息放入发送队列，与音频帧保持先后顺序
+ * 控制消息单独排队；队列满时最多等待SR_UPLINK_CTRL_WAIT_MS，超时（或未连接且没有断线缓存）时丢弃最早的一条
+ */
+esp_err_t sr_uplink_send_json(const char *json);
+
+/**
+ * @brief 将一条紧急的JSON控制消息（如插话打断）放入控制消息队列，排在已入队但尚未发出的音频帧之前
+ * 与先入队的控制消息之间仍保持先后顺序
+ */
+esp_err_t sr_uplink_send_json_urgent(const char *json);
+
+/**
+ * @brief 获取上行发送统计
+ */
+void sr_uplink_get_stats(sr_uplink_stats_t *stats);
+
+/**
+ * @brief 获取断线缓存统计（缓存的消息数、字节数和最早一条的时长）
+ */
+void sr_uplink_get_spool_stats(sr_spool_stats_t *stats);
+
+#endif // SR_UPLINK_H
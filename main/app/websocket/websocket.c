@@ -2,10 +2,13 @@
 // 在文件顶部添加重连相关的全局变量
 #include <stdlib.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_websocket_client.h"
 #include "esp_tls.h"
 #include "websocket.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <esp_wifi.h>
 #include <time.h>
 #include <sys/time.h>
@@ -16,8 +19,10 @@ static const char *TAG = "WS_CLIENT";
 // WebSocket客户端句柄
 static esp_websocket_client_handle_t client = NULL;
 
-// 接收数据处理函数指针（留给用户实现具体逻辑）
+// 接收数据处理函数指针（留给用户实现具体逻辑），由接收层重组后调用
 static void (*ws_recv_handler)(const char *data, size_t len) = NULL;
+// 二进制消息处理函数指针（如下行Opus音频包），未分片时直接传递接收缓冲区，不做拷贝
+static void (*ws_binary_handler)(const uint8_t *data, size_t len) = NULL;
 
 // 重连相关全局变量
 static const char *current_ws_uri = NULL;                  // 保存当前连接的URI
@@ -26,11 +31,58 @@ static int reconnect_count = 0;                            // 当前重连次数
 static const int MAX_RECONNECT_ATTEMPTS = 15;              // 最大重连次数
 static const int INITIAL_RECONNECT_INTERVAL_MS = 3000;     // 初始重连间隔(毫秒)
 static const int MAX_RECONNECT_INTERVAL_MS = 30000;        // 最大重连间隔(毫秒)
+static const int WS_CONNECT_WAIT_MS = 15000;               // 等待一次连接结果的最长时间（含完整TLS握手）
 static bool is_manually_disconnected = false;              // 标记是否手动断开连接
 static portMUX_TYPE ws_mux = portMUX_INITIALIZER_UNLOCKED; // 互斥锁，保护共享资源
+static int client_refs = 0;                                // 正在使用client的调用数（ws_mux保护），ws_stop等其归零后才销毁
+
+// 发送队列相关
+static const uint32_t WS_SEND_QUEUE_LEN = 64;              // 最多排队的消息数
+static const size_t WS_SEND_QUEUE_BYTES = 64 * 1024;       // 排队消息的总字节预算（PSRAM）
+static const int WS_SEND_TIMEOUT_MS = 5000;                // 单次写入传输层的最长阻塞时间
+#define WS_SEND_BATCH_MAX 8                                // 合并为一次写入的最多消息数
+static const size_t WS_SEND_BATCH_BYTES = 1200;            // 合并写入的负载上限，连同帧头不超过一个TLS记录缓冲区
+static TaskHandle_t send_task_handle = NULL;               // 发送任务句柄，首次启动时创建
 
 // 在文件顶部的函数声明区域添加 forward declaration
 static void reconnect_task(void *pvParameters);
+static void ws_send_task(void *pvParameters);
+
+/**
+ * @brief 在ws_mux内取得客户端的引用，之后即使ws_stop并发执行，客户端也要等ws_client_release后才销毁
+ * @return 客户端未创建时返回NULL（无需释放）
+ */
+static esp_websocket_client_handle_t ws_client_acquire(void)
+{
+    portENTER_CRITICAL(&ws_mux);
+    esp_websocket_client_handle_t handle = client;
+    if (handle != NULL)
+    {
+        client_refs++;
+    }
+    portEXIT_CRITICAL(&ws_mux);
+    return handle;
+}
+
+static void ws_client_release(void)
+{
+    portENTER_CRITICAL(&ws_mux);
+    client_refs--;
+    portEXIT_CRITICAL(&ws_mux);
+}
+
+/**
+ * @brief 通知重连任务本次连接已有结果（连接成功或断开）
+ */
+static void notify_reconnect_task(void)
+{
+    portENTER_CRITICAL(&ws_mux);
+    if (reconnect_task_handle != NULL)
+    {
+        xTaskNotifyGive(reconnect_task_handle);
+    }
+    portEXIT_CRITICAL(&ws_mux);
+}
 
 /**
  * @brief WebSocket事件回调函数（增强版，添加所有事件处理和重连优化）
@@ -48,6 +100,18 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
         portENTER_CRITICAL(&ws_mux);
         reconnect_count = 0; // 重置重连计数
         portEXIT_CRITICAL(&ws_mux);
+        notify_reconnect_task();
+
+        // 连接耗时（TCP+TLS握手+WebSocket升级），区分完整握手与TLS会话恢复（提供了缓存的会话但服务器未接受时仍为完整握手）
+        esp_websocket_connect_stats_t connect_stats;
+        if (esp_websocket_client_get_connect_stats(data->client, &connect_stats) == ESP_OK)
+        {
+            ESP_LOGI(TAG, "连接耗时%lu ms（%s）; 完整握手%lu次 平均%lu ms, 提供会话%lu次 其中恢复%lu次 平均%lu ms, 恢复失败%lu次",
+                     connect_stats.last_connect_ms,
+                     connect_stats.last_resumed ? "TLS会话恢复" : connect_stats.last_offered ? "会话未被接受，完整TLS握手" : "完整TLS握手",
+                     connect_stats.full_count, connect_stats.full_avg_ms, connect_stats.offered_count,
+                     connect_stats.resumed_count, connect_stats.resumed_avg_ms, connect_stats.resume_failures);
+        }
 
         // 获取MAC地址和时间戳并发送给服务器
         uint8_t mac_addr[6];
@@ -73,13 +137,14 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
         sprintf(device_info_json, "{\"type\":\"device_info\",\"mac\":\"%s\",\"timestamp\":%s}",
                 mac_str, timestamp_str);
 
-        // 发送设备信息到服务器
-        ws_send_json(device_info_json, strlen(device_info_json));
+        // 发送设备信息到服务器（事件回调在客户端任务中执行，只入队不等待）
+        ws_send_async(WS_TRANSPORT_OPCODES_TEXT, device_info_json, strlen(device_info_json), NULL);
 
         break;
 
     case WEBSOCKET_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "与服务器断开连接，准备重连");
+        ws_rx_reset();
         // 检查是否是手动断开的连接
         portENTER_CRITICAL(&ws_mux);
         bool manual_disconnect = is_manually_disconnected;
@@ -91,21 +156,15 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
             xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
                         (void *)current_ws_uri, 4, &reconnect_task_handle);
         }
+        else
+        {
+            notify_reconnect_task(); // 重连任务正在进行的连接失败
+        }
         break;
 
     case WEBSOCKET_EVENT_DATA:
-        // 接收到服务器数据，调用用户注册的处理函数
-        if (ws_recv_handler && data->data_len > 0)
-        {
-            char *recv_data = malloc(data->data_len + 1);
-            if (recv_data != NULL)
-            {
-                memcpy(recv_data, data->data_ptr, data->data_len);
-                recv_data[data->data_len] = '\0'; // 字符串结束符
-                ws_recv_handler(recv_data, data->data_len);
-                free(recv_data); // 释放内存
-            }
-        }
+        // 分片重组后按文本/二进制分别交给处理函数，不再逐段malloc
+        ws_rx_feed(data);
         break;
 
     case WEBSOCKET_EVENT_ERROR:
@@ -128,16 +187,8 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
             {
                 ESP_LOGE(TAG, "检测到SSL连接错误，需要重新建立连接");
 
-                // 停止现有客户端并尝试重连
-                if (client != NULL)
-                {
-                    portENTER_CRITICAL(&ws_mux);
-                    esp_websocket_client_stop(client);
-                    esp_websocket_client_destroy(client);
-                    client = NULL;
-                    portEXIT_CRITICAL(&ws_mux);
-                }
-
+                // 回调运行在客户端任务中，不能在这里停止或销毁客户端；
+                // 由重连任务重新启动，保留传输层和缓存的TLS会话
                 if (reconnect_task_handle == NULL && current_ws_uri != NULL)
                 {
                     ESP_LOGI(TAG, "启动重连任务以恢复SSL连接");
@@ -150,6 +201,7 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
 
     case WEBSOCKET_EVENT_CLOSED:
         ESP_LOGI(TAG, "WebSocket连接已干净关闭");
+        ws_rx_reset();
         // 连接关闭也触发重连
         portENTER_CRITICAL(&ws_mux);
         bool manual_close = is_manually_disconnected;
@@ -161,6 +213,10 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
             xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
                         (void *)current_ws_uri, 4, &reconnect_task_handle);
         }
+        else
+        {
+            notify_reconnect_task();
+        }
         break;
 
     case WEBSOCKET_EVENT_BEFORE_CONNECT:
@@ -182,7 +238,40 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
 }
 
 /**
- * @brief 重连任务函数（实现指数退避重连策略，修复版）
+ * @brief 在重连任务中等待本次连接的结果
+ * @return true: 已连接; false: 连接失败或超时
+ */
+static bool ws_wait_connected(void)
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WS_CONNECT_WAIT_MS));
+    return is_ws_connected();
+}
+
+/**
+ * @brief 在重连任务中发起一次重连，结果由ws_wait_connected等待
+ * 已有客户端时原地重启：复用传输层，并提供上次连接缓存的TLS会话，
+ * 服务器接受会话恢复时省去证书校验和密钥交换（S3上完整握手的RSA运算需数秒）
+ */
+static esp_err_t ws_reconnect_once(const char *ws_uri)
+{
+    portENTER_CRITICAL(&ws_mux);
+    esp_websocket_client_handle_t current_client = client;
+    portEXIT_CRITICAL(&ws_mux);
+    if (current_client == NULL)
+    {
+        ulTaskNotifyTake(pdTRUE, 0);
+        return ws_start(ws_uri);
+    }
+
+    // 客户端任务在断线后已自行退出时，这里只会打印一条警告
+    esp_websocket_client_stop(current_client);
+    // 丢弃停止过程中旧连接的通知，之后收到的通知才是本次连接的结果
+    ulTaskNotifyTake(pdTRUE, 0);
+    return esp_websocket_client_start(current_client);
+}
+
+/**
+ * @brief 重连任务函数：先立即用缓存的TLS会话恢复连接，失败后改用指数退避重连
  */
 static void reconnect_task(void *pvParameters)
 {
@@ -190,83 +279,52 @@ static void reconnect_task(void *pvParameters)
     int current_interval = INITIAL_RECONNECT_INTERVAL_MS;
     bool reconnected = false;
     int local_reconnect_count = reconnect_count; // 使用本地变量跟踪重连次数
-    bool client_needs_destroy = false;
+
+    // Wi-Fi短暂中断后服务器通常还保留着会话，不等待直接恢复
+    esp_websocket_connect_stats_t connect_stats;
+    portENTER_CRITICAL(&ws_mux);
+    esp_websocket_client_handle_t current_client = client;
+    portEXIT_CRITICAL(&ws_mux);
+    if (current_client != NULL &&
+        esp_websocket_client_get_connect_stats(current_client, &connect_stats) == ESP_OK &&
+        connect_stats.session_cached)
+    {
+        ESP_LOGI(TAG, "立即尝试以TLS会话恢复重连");
+        if (ws_reconnect_once(ws_uri) == ESP_OK && ws_wait_connected())
+        {
+            ESP_LOGI(TAG, "会话恢复重连成功");
+            reconnected = true;
+        }
+        else
+        {
+            // 失败的会话已被客户端丢弃，之后按完整握手重连
+            ESP_LOGW(TAG, "会话恢复重连失败，改用指数退避重连");
+        }
+    }
 
     while (local_reconnect_count < MAX_RECONNECT_ATTEMPTS && !reconnected)
     {
         ESP_LOGI(TAG, "尝试重连服务器 (第 %d/%d 次)，间隔: %d ms",
                  local_reconnect_count + 1, MAX_RECONNECT_ATTEMPTS, current_interval);
 
-        // 1. 先在临界区检查客户端状态并标记
-        portENTER_CRITICAL(&ws_mux);
-        client_needs_destroy = (client != NULL);
-        portEXIT_CRITICAL(&ws_mux);
+        // 复用现有客户端（传输层与TLS会话缓存随之保留）
+        esp_err_t ret = ws_reconnect_once(ws_uri);
 
-        // 2. 在临界区外停止和销毁客户端（避免死锁）
-        if (client_needs_destroy)
+        if (ret == ESP_OK && ws_wait_connected())
         {
-            // 再次检查，因为可能已经被其他任务修改
-            portENTER_CRITICAL(&ws_mux);
-            if (client != NULL)
-            {
-                // 先设置为NULL，防止其他任务访问
-                esp_websocket_client_handle_t temp_client = client;
-                client = NULL;
-                portEXIT_CRITICAL(&ws_mux);
-
-                // 在临界区外执行阻塞操作
-                esp_websocket_client_stop(temp_client);
-                esp_websocket_client_destroy(temp_client);
-            }
-            else
-            {
-                portEXIT_CRITICAL(&ws_mux);
-            }
+            ESP_LOGI(TAG, "重连成功");
+            reconnected = true;
         }
-
-        // 重新初始化并启动客户端
-        esp_err_t ret = ws_start(ws_uri);
-
-        if (ret == ESP_OK)
+        else
         {
-            // 等待短暂时间验证连接是否稳定
-            vTaskDelay(pdMS_TO_TICKS(1000));
-
-            portENTER_CRITICAL(&ws_mux);
-            bool is_stable = (client != NULL && esp_websocket_client_is_connected(client));
-            portEXIT_CRITICAL(&ws_mux);
-
-            if (is_stable)
+            if (ret == ESP_OK)
             {
-                ESP_LOGI(TAG, "重连成功且连接稳定");
-                portENTER_CRITICAL(&ws_mux);
-                reconnect_count = 0; // 立即重置全局重连计数
-                portEXIT_CRITICAL(&ws_mux);
-                reconnected = true;
+                ESP_LOGW(TAG, "重连未能建立连接，准备重试");
             }
             else
             {
-                ESP_LOGW(TAG, "重连成功但连接不稳定，准备重试");
-                local_reconnect_count++;
-                portENTER_CRITICAL(&ws_mux);
-                reconnect_count = local_reconnect_count;
-                portEXIT_CRITICAL(&ws_mux);
-
-                // 添加随机抖动，避免多个设备同时重连导致服务器压力
-                int jitter = rand() % 1000 - 500; // -500ms到+500ms的随机值
-                vTaskDelay(pdMS_TO_TICKS(current_interval + jitter));
-
-                // 指数退避：下一次重连间隔增加50%，但不超过最大值
-                current_interval = current_interval * 3 / 2;
-                if (current_interval > MAX_RECONNECT_INTERVAL_MS)
-                {
-                    current_interval = MAX_RECONNECT_INTERVAL_MS;
-                }
+                ESP_LOGE(TAG, "重连失败: %s", esp_err_to_name(ret));
             }
-        }
-        else
-        {
-            ESP_LOGE(TAG, "重连失败: %s", esp_err_to_name(ret));
 
             // 重连失败，增加计数并等待，实现指数退避
             local_reconnect_count++;
@@ -274,8 +332,8 @@ static void reconnect_task(void *pvParameters)
             reconnect_count = local_reconnect_count;
             portEXIT_CRITICAL(&ws_mux);
 
-            // 添加随机抖动
-            int jitter = rand() % 1000 - 500;
+            // 添加随机抖动，避免多个设备同时重连导致服务器压力
+            int jitter = rand() % 1000 - 500; // -500ms到+500ms的随机值
             vTaskDelay(pdMS_TO_TICKS(current_interval + jitter));
 
             // 指数退避：下一次重连间隔增加50%，但不超过最大值
@@ -287,7 +345,13 @@ static void reconnect_task(void *pvParameters)
         }
     }
 
-    if (!reconnected)
+    if (reconnected)
+    {
+        portENTER_CRITICAL(&ws_mux);
+        reconnect_count = 0; // 立即重置全局重连计数
+        portEXIT_CRITICAL(&ws_mux);
+    }
+    else
     {
         ESP_LOGE(TAG, "达到最大重连次数 (%d次)，停止重连尝试", MAX_RECONNECT_ATTEMPTS);
     }
@@ -323,6 +387,21 @@ esp_err_t ws_start(const char *ws_uri)
     // 保存当前URI用于重连
     current_ws_uri = ws_uri;
 
+    esp_err_t rx_ret = ws_rx_init();
+    if (rx_ret != ESP_OK)
+    {
+        return rx_ret;
+    }
+
+    // 所有消息经发送队列由同一个任务写出，重连时保留
+    if (send_task_handle == NULL &&
+        xTaskCreate(ws_send_task, "websocket_send", 4096, NULL, 4, &send_task_handle) != pdPASS)
+    {
+        ESP_LOGE(TAG, "创建发送任务失败");
+        send_task_handle = NULL;
+        return ESP_FAIL;
+    }
+
     // 基于结构体定义的正确wss配置（优化配置）
     esp_websocket_client_config_t ws_cfg = {
         .uri = ws_uri,                             // 使用传入的参数作为WSS地址
@@ -335,6 +414,16 @@ esp_err_t ws_start(const char *ws_uri)
         .ping_interval_sec = 5,                    // 进一步缩短PING间隔到5秒
         .reconnect_timeout_ms = 5000,              // 增加重连间隔到5秒
         .network_timeout_ms = 20000,               // 增加网络超时到20秒
+        .tls_session_reuse = true,                 // 缓存TLS会话，重连时恢复会话而不做完整握手
+        // JSON控制消息压缩（permessage-deflate），Opus音频帧本身已压缩，不参与
+        .deflate = {
+            .enable = true,
+            .client_max_window_bits = 10,                   // 1KB窗口，压缩状态约12KB
+            .server_max_window_bits = 10,                   // 解压状态约8KB
+            .mem_level = 4,
+            .compress_opcodes = 1 << WS_TRANSPORT_OPCODES_TEXT, // 只压缩文本帧
+            .min_size = 64,                                 // 太短的消息压缩无收益
+        },
     };
 
     // 创建客户端实例
@@ -374,222 +463,353 @@ esp_err_t ws_start(const char *ws_uri)
     return ESP_OK;
 }
 
-/**
- * @brief 向服务器发送二进制数据（增强版，添加重连支持）
- */
-esp_err_t ws_send_binary(const void *binary_data, size_t len)
+// 队列中的一条待发送消息（PSRAM），负载紧跟在结构体之后
+typedef struct ws_msg
 {
-    // 1. 基础校验：客户端状态和数据合法性
-    portENTER_CRITICAL(&ws_mux);
-    bool is_client_null = (client == NULL);
-    portEXIT_CRITICAL(&ws_mux);
-
-    if (is_client_null)
-    {
-        ESP_LOGE(TAG, "二进制发送失败：客户端未初始化");
-        return ESP_FAIL;
-    }
+    struct ws_msg *next;
+    ws_transport_opcodes_t opcode;
+    ws_send_prio_t prio;
+    size_t len;
+    int64_t enqueue_us;  // 入队时刻
+    int64_t deadline_us; // 截止时刻，0为不过期
+    ws_send_done_cb_t done;
+    void *arg;
+    uint8_t data[];
+} ws_msg_t;
+
+// 每个优先级一个先进先出链表
+typedef struct
+{
+    ws_msg_t *head;
+    ws_msg_t *tail;
+} ws_msg_list_t;
 
-    // 2. 检查连接状态，如果未连接则尝试重新连接
-    portENTER_CRITICAL(&ws_mux);
-    bool is_connected = esp_websocket_client_is_connected(client);
-    portEXIT_CRITICAL(&ws_mux);
+static ws_msg_list_t send_lists[WS_PRIO_COUNT];
+static portMUX_TYPE send_mux = portMUX_INITIALIZER_UNLOCKED; // 保护发送队列和统计
+static ws_send_stats_t send_stats;
 
-    if (!is_connected)
+static ws_msg_t *send_list_pop(ws_msg_list_t *list)
+{
+    ws_msg_t *msg = list->head;
+    if (msg)
     {
-        ESP_LOGE(TAG, "二进制发送失败：客户端未连接服务器，尝试重连...");
-
-        // 如果重连任务未运行，则启动它
-        portENTER_CRITICAL(&ws_mux);
-        bool need_reconnect = (reconnect_task_handle == NULL && current_ws_uri != NULL);
-        portEXIT_CRITICAL(&ws_mux);
-
-        if (need_reconnect)
+        list->head = msg->next;
+        if (list->head == NULL)
         {
-            ESP_LOGI(TAG, "启动重连任务");
-            xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
-                        (void *)current_ws_uri, 4, &reconnect_task_handle);
+            list->tail = NULL;
         }
-
-        return ESP_FAIL;
+        send_stats.queued--;
+        send_stats.queued_bytes -= msg->len;
     }
+    return msg;
+}
 
-    // 3. 数据校验
-    if (binary_data == NULL || len == 0 || len > INT_MAX)
+/**
+ * @brief 结束一条消息：调用完成回调并释放
+ */
+static void send_msg_complete(ws_msg_t *msg, esp_err_t result)
+{
+    if (msg->done)
     {
-        ESP_LOGE(TAG, "二进制发送失败：数据为空/长度为0/长度超出int范围");
-        return ESP_ERR_INVALID_ARG;
+        msg->done(result, msg->arg);
     }
+    heap_caps_free(msg);
+}
 
-    // 4. 调用底层二进制发送函数，添加重试机制
-    int send_len = -1;
-    int retry_count = 0;
-    const int MAX_RETRY = 2;
-
-    while (retry_count < MAX_RETRY && send_len <= 0)
+/**
+ * @brief 按优先级取出一批待发送的消息：首条总是取出，之后的小消息在不超过WS_SEND_BATCH_BYTES时一并取出
+ * @return 取出的消息数
+ */
+static int send_batch_pop(ws_msg_t **batch)
+{
+    int count = 0;
+    size_t bytes = 0;
+    portENTER_CRITICAL(&send_mux);
+    for (int prio = 0; prio < WS_PRIO_COUNT && count < WS_SEND_BATCH_MAX; prio++)
     {
-        send_len = esp_websocket_client_send_bin(
-            client,
-            (const char *)binary_data,
-            (int)len,
-            portMAX_DELAY);
-
-        if (send_len <= 0)
+        ws_msg_t *head = NULL;
+        while (count < WS_SEND_BATCH_MAX && (head = send_lists[prio].head) != NULL &&
+               (count == 0 || bytes + head->len <= WS_SEND_BATCH_BYTES))
         {
-            ESP_LOGE(TAG, "二进制发送失败：错误码=%d，原因：%s，正在重试(%d/%d)",
-                     send_len, esp_err_to_name(-send_len), retry_count + 1, MAX_RETRY);
-            retry_count++;
-
-            // 短暂延迟后重试
-            vTaskDelay(pdMS_TO_TICKS(10));
-
-            // 检查连接状态，如果已断开则不再重试
-            portENTER_CRITICAL(&ws_mux);
-            bool still_connected = esp_websocket_client_is_connected(client);
-            portEXIT_CRITICAL(&ws_mux);
-
-            if (!still_connected)
-            {
-                ESP_LOGE(TAG, "连接已断开，停止重试");
-                break;
-            }
+            batch[count++] = send_list_pop(&send_lists[prio]);
+            bytes += head->len;
+        }
+        if (head != NULL && count > 0)
+        {
+            break; // 保持先后顺序，不越过放不下的消息
         }
     }
+    send_stats.in_flight_bytes = bytes;
+    portEXIT_CRITICAL(&send_mux);
+    return count;
+}
 
-    // 5. 解析返回值
-    if (send_len > 0)
-    {
-        return ESP_OK;
-    }
-    else
+/**
+ * @brief 发送任务：唯一调用esp_websocket_client_send_*的任务，控制消息优先于音频，过期的消息直接丢弃
+ * 连续的小消息合并为一次写入（一个TLS记录），负载直接从队列中的消息掩码写出，不再拷贝到客户端发送缓冲区
+ * 每次写入最多阻塞WS_SEND_TIMEOUT_MS，失败不重试，由调用方（完成回调）决定如何处理
+ */
+static void ws_send_task(void *pvParameters)
+{
+    ws_msg_t *batch[WS_SEND_BATCH_MAX];
+    esp_websocket_iovec_t iov[WS_SEND_BATCH_MAX];
+    esp_websocket_frame_t frames[WS_SEND_BATCH_MAX];
+    while (1)
     {
-        // 失败：send_len为负数，尝试重连
-        ESP_LOGE(TAG, "二进制发送失败：达到最大重试次数，错误码=%d，原因：%s",
-                 send_len, esp_err_to_name(-send_len));
+        int count = send_batch_pop(batch);
+        if (count == 0)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
 
-        // 如果是连接问题，尝试重连
-        portENTER_CRITICAL(&ws_mux);
-        bool need_reconnect = (reconnect_task_handle == NULL && current_ws_uri != NULL);
-        portEXIT_CRITICAL(&ws_mux);
+        // 丢弃过期的消息，其余的组成一次写入
+        int64_t now = esp_timer_get_time();
+        int frame_count = 0;
+        int send_bytes = 0;
+        uint32_t expired = 0;
+        uint32_t delay_max_us = 0;
+        for (int i = 0; i < count; i++)
+        {
+            ws_msg_t *msg = batch[i];
+            if (msg->deadline_us != 0 && now > msg->deadline_us)
+            {
+                expired++;
+                send_msg_complete(msg, ESP_ERR_TIMEOUT);
+                continue;
+            }
+            uint32_t delay_us = (uint32_t)(now - msg->enqueue_us);
+            delay_max_us = delay_us > delay_max_us ? delay_us : delay_max_us;
+            iov[frame_count].data = msg->data;
+            iov[frame_count].len = msg->len;
+            frames[frame_count].opcode = msg->opcode;
+            frames[frame_count].iov = &iov[frame_count];
+            frames[frame_count].iovcnt = 1;
+            batch[frame_count++] = msg;
+            send_bytes += (int)msg->len;
+        }
+        portENTER_CRITICAL(&send_mux);
+        send_stats.expired += expired;
+        if (frame_count > 0)
+        {
+            send_stats.delay_us = delay_max_us;
+            if (delay_max_us > send_stats.delay_max_us)
+            {
+                send_stats.delay_max_us = delay_max_us;
+            }
+        }
+        portEXIT_CRITICAL(&send_mux);
 
-        if (need_reconnect)
+        // 写入期间持有客户端的引用，ws_stop等本次写入结束后才销毁客户端
+        int send_len = -1;
+        esp_websocket_client_handle_t ws = frame_count > 0 ? ws_client_acquire() : NULL;
+        if (ws != NULL)
         {
-            ESP_LOGI(TAG, "发送失败可能是连接问题，启动重连任务");
-            xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
-                        (void *)current_ws_uri, 4, &reconnect_task_handle);
+            if (esp_websocket_client_is_connected(ws))
+            {
+                send_len = esp_websocket_client_send_frames(ws, frames, frame_count, pdMS_TO_TICKS(WS_SEND_TIMEOUT_MS));
+            }
+            ws_client_release();
+        }
+        esp_err_t result = send_len == send_bytes ? ESP_OK : ESP_FAIL;
+        if (frame_count > 0 && result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "发送失败：%d条消息，长度=%d，返回=%d", frame_count, send_bytes, send_len);
         }
 
-        return ESP_FAIL;
+        portENTER_CRITICAL(&send_mux);
+        send_stats.in_flight_bytes = 0;
+        if (result == ESP_OK)
+        {
+            send_stats.sent += frame_count;
+            send_stats.writes += frame_count > 0;
+        }
+        else
+        {
+            send_stats.failed += frame_count;
+        }
+        portEXIT_CRITICAL(&send_mux);
+        for (int i = 0; i < frame_count; i++)
+        {
+            send_msg_complete(batch[i], result);
+        }
     }
 }
 
 /**
- * @brief 向服务器发送JSON文本数据（增强版，添加重连支持）
+ * @brief 腾出空间：依次丢弃优先级低于prio的最早的消息（调用时需持有send_mux）
+ * @return 丢弃的消息链表，需在临界区外逐条结束
  */
-esp_err_t ws_send_json(const char *json_data, size_t len)
+static ws_msg_t *send_make_room(ws_send_prio_t prio, size_t len)
 {
-    // 1. 基础校验：客户端状态和数据合法性
-    portENTER_CRITICAL(&ws_mux);
-    bool is_client_null = (client == NULL);
-    portEXIT_CRITICAL(&ws_mux);
-
-    if (is_client_null)
+    ws_msg_t *evicted = NULL;
+    for (int p = WS_PRIO_COUNT - 1; p > (int)prio; p--)
     {
-        ESP_LOGE(TAG, "JSON发送失败：客户端未初始化");
-        return ESP_FAIL;
+        while ((send_stats.queued >= WS_SEND_QUEUE_LEN || send_stats.queued_bytes + len > WS_SEND_QUEUE_BYTES) &&
+               send_lists[p].head)
+        {
+            ws_msg_t *msg = send_list_pop(&send_lists[p]);
+            msg->next = evicted;
+            evicted = msg;
+            send_stats.dropped++;
+        }
     }
+    return evicted;
+}
 
-    // 2. 检查连接状态，如果未连接则尝试重新连接
-    portENTER_CRITICAL(&ws_mux);
-    bool is_connected = esp_websocket_client_is_connected(client);
-    portEXIT_CRITICAL(&ws_mux);
-
-    if (!is_connected)
+esp_err_t ws_send_async(ws_transport_opcodes_t opcode, const void *data, size_t len, const ws_send_opts_t *opts)
+{
+    static const ws_send_opts_t default_opts = {
+        .prio = WS_PRIO_CONTROL,
+    };
+    if (opts == NULL)
     {
-        ESP_LOGE(TAG, "JSON发送失败：客户端未连接服务器，尝试重连...");
-
-        // 如果重连任务未运行，则启动它
-        portENTER_CRITICAL(&ws_mux);
-        bool need_reconnect = (reconnect_task_handle == NULL && current_ws_uri != NULL);
-        portEXIT_CRITICAL(&ws_mux);
+        opts = &default_opts;
+    }
+    if (data == NULL || len == 0 || len > WS_SEND_QUEUE_BYTES || opts->prio >= WS_PRIO_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (send_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-        if (need_reconnect)
+    ws_msg_t *msg = heap_caps_malloc(sizeof(ws_msg_t) + len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (msg == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(msg->data, data, len);
+    msg->next = NULL;
+    msg->opcode = opcode;
+    msg->prio = opts->prio;
+    msg->len = len;
+    msg->enqueue_us = esp_timer_get_time();
+    msg->deadline_us = opts->deadline_ms ? msg->enqueue_us + opts->deadline_ms * 1000LL : 0;
+    msg->done = opts->done;
+    msg->arg = opts->arg;
+
+    portENTER_CRITICAL(&send_mux);
+    // 队列满时先丢弃优先级更低的消息，仍然放不下则拒绝本条
+    ws_msg_t *evicted = send_make_room(opts->prio, len);
+    bool full = send_stats.queued >= WS_SEND_QUEUE_LEN || send_stats.queued_bytes + len > WS_SEND_QUEUE_BYTES;
+    if (full)
+    {
+        send_stats.dropped++;
+    }
+    else
+    {
+        ws_msg_list_t *list = &send_lists[opts->prio];
+        if (list->tail)
         {
-            ESP_LOGI(TAG, "启动重连任务");
-            xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
-                        (void *)current_ws_uri, 4, &reconnect_task_handle);
+            list->tail->next = msg;
         }
-
-        return ESP_FAIL;
+        else
+        {
+            list->head = msg;
+        }
+        list->tail = msg;
+        send_stats.queued++;
+        send_stats.queued_bytes += len;
     }
+    portEXIT_CRITICAL(&send_mux);
 
-    // 3. 数据校验
-    if (json_data == NULL || len == 0 || len > INT_MAX)
+    while (evicted)
     {
-        ESP_LOGE(TAG, "JSON发送失败：数据为空/长度为0/长度超出int范围");
-        return ESP_ERR_INVALID_ARG;
+        ws_msg_t *next = evicted->next;
+        send_msg_complete(evicted, ESP_ERR_NO_MEM);
+        evicted = next;
     }
+    if (full)
+    {
+        heap_caps_free(msg);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(send_task_handle);
+    return ESP_OK;
+}
 
-    // 4. 调用底层文本发送函数，添加重试机制
-    int send_len = -1;
-    int retry_count = 0;
-    const int MAX_RETRY = 2;
+// 同步发送：入队后等待发送任务的完成回调
+typedef struct
+{
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} ws_sync_send_t;
 
-    while (retry_count < MAX_RETRY && send_len <= 0)
-    {
-        send_len = esp_websocket_client_send_text(
-            client,
-            json_data,
-            (int)len,
-            portMAX_DELAY);
+static void ws_sync_send_done(esp_err_t result, void *arg)
+{
+    ws_sync_send_t *sync = arg;
+    sync->result = result;
+    xSemaphoreGive(sync->done);
+}
 
-        if (send_len <= 0)
-        {
-            ESP_LOGE(TAG, "JSON发送失败：错误码=%d，原因：%s，正在重试(%d/%d)",
-                     send_len, esp_err_to_name(-send_len), retry_count + 1, MAX_RETRY);
-            retry_count++;
+static esp_err_t ws_send_sync(ws_transport_opcodes_t opcode, const void *data, size_t len, ws_send_prio_t prio)
+{
+    StaticSemaphore_t sem_buffer;
+    ws_sync_send_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&sem_buffer),
+        .result = ESP_FAIL,
+    };
+    ws_send_opts_t opts = {
+        .prio = prio,
+        .done = ws_sync_send_done,
+        .arg = &sync,
+    };
+    esp_err_t ret = ws_send_async(opcode, data, len, &opts);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    xSemaphoreTake(sync.done, portMAX_DELAY);
+    return sync.result;
+}
 
-            // 短暂延迟后重试
-            vTaskDelay(pdMS_TO_TICKS(10));
+/**
+ * @brief 向服务器发送二进制数据（经发送队列，等待发送完成）
+ */
+esp_err_t ws_send_binary(const void *binary_data, size_t len)
+{
+    return ws_send_sync(WS_TRANSPORT_OPCODES_BINARY, binary_data, len, WS_PRIO_AUDIO);
+}
 
-            // 检查连接状态，如果已断开则不再重试
-            portENTER_CRITICAL(&ws_mux);
-            bool still_connected = esp_websocket_client_is_connected(client);
-            portEXIT_CRITICAL(&ws_mux);
+/**
+ * @brief 向服务器发送JSON文本数据（经发送队列，等待发送完成）
+ */
+esp_err_t ws_send_json(const char *json_data, size_t len)
+{
+    return ws_send_sync(WS_TRANSPORT_OPCODES_TEXT, json_data, len, WS_PRIO_CONTROL);
+}
 
-            if (!still_connected)
-            {
-                ESP_LOGE(TAG, "连接已断开，停止重试");
-                break;
-            }
-        }
-    }
+void ws_get_send_stats(ws_send_stats_t *stats)
+{
+    portENTER_CRITICAL(&send_mux);
+    *stats = send_stats;
+    portEXIT_CRITICAL(&send_mux);
+}
 
-    // 5. 解析返回值
-    if (send_len > 0)
+esp_err_t ws_get_deflate_stats(esp_websocket_deflate_stats_t *stats)
+{
+    esp_websocket_client_handle_t ws = ws_client_acquire();
+    if (ws == NULL)
     {
-        return ESP_OK;
+        return ESP_ERR_INVALID_STATE;
     }
-    else
-    {
-        // 失败：send_len为负数，尝试重连
-        ESP_LOGE(TAG, "JSON发送失败：达到最大重试次数，错误码=%d，原因：%s",
-                 send_len, esp_err_to_name(-send_len));
-
-        // 如果是连接问题，尝试重连
-        portENTER_CRITICAL(&ws_mux);
-        bool need_reconnect = (reconnect_task_handle == NULL && current_ws_uri != NULL);
-        portEXIT_CRITICAL(&ws_mux);
-
-        if (need_reconnect)
-        {
-            ESP_LOGI(TAG, "发送失败可能是连接问题，启动重连任务");
-            xTaskCreate(reconnect_task, "websocket_reconnect", 4096,
-                        (void *)current_ws_uri, 4, &reconnect_task_handle);
-        }
+    esp_err_t ret = esp_websocket_client_get_deflate_stats(ws, stats);
+    ws_client_release();
+    return ret;
+}
 
-        return ESP_FAIL;
+esp_err_t ws_get_connect_stats(esp_websocket_connect_stats_t *stats)
+{
+    esp_websocket_client_handle_t ws = ws_client_acquire();
+    if (ws == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
     }
+    esp_err_t ret = esp_websocket_client_get_connect_stats(ws, stats);
+    ws_client_release();
+    return ret;
 }
 
 /**
@@ -609,16 +829,29 @@ void ws_stop(void)
         reconnect_task_handle = NULL;
     }
 
-    // 停止客户端
+    // 先摘下客户端，新的调用不再取得引用；等已取得引用的调用（如正在写入的发送任务）结束后，
+    // 在临界区外停止并销毁（停止会阻塞等待客户端任务退出）
     portENTER_CRITICAL(&ws_mux);
-    if (client != NULL)
+    esp_websocket_client_handle_t stopping = client;
+    client = NULL;
+    portEXIT_CRITICAL(&ws_mux);
+    if (stopping != NULL)
     {
-        esp_websocket_client_stop(client);
-        esp_websocket_client_destroy(client);
-        client = NULL;
+        while (1)
+        {
+            portENTER_CRITICAL(&ws_mux);
+            int refs = client_refs;
+            portEXIT_CRITICAL(&ws_mux);
+            if (refs == 0)
+            {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        esp_websocket_client_stop(stopping);
+        esp_websocket_client_destroy(stopping);
         ESP_LOGI(TAG, "WebSocket客户端已停止");
     }
-    portEXIT_CRITICAL(&ws_mux);
 
     // 重置重连计数
     portENTER_CRITICAL(&ws_mux);
@@ -628,25 +861,66 @@ void ws_stop(void)
     portEXIT_CRITICAL(&ws_mux);
 }
 
-esp_err_t is_ws_connected(void)
+bool is_ws_connected(void)
 {
-    if (client == NULL)
+    esp_websocket_client_handle_t ws = ws_client_acquire();
+    if (ws == NULL)
     {
         return false;
     }
-    return esp_websocket_client_is_connected(client);
+    bool connected = esp_websocket_client_is_connected(ws);
+    ws_client_release();
+    return connected;
+}
+
+// 接收层回调转为原有的处理函数形式
+static void ws_text_msg_handler(const ws_rx_msg_t *msg)
+{
+    if (ws_recv_handler)
+    {
+        ws_recv_handler((const char *)msg->data, msg->len);
+    }
+}
+
+static void ws_binary_msg_handler(const ws_rx_msg_t *msg)
+{
+    if (ws_binary_handler)
+    {
+        ws_binary_handler(msg->data, msg->len);
+    }
 }
 
 /**
  * @brief 注册接收数据处理函数
- * @param handler: 自定义处理函数（收到数据时回调）
+ * @param handler: 自定义处理函数（收到完整的文本消息时回调）
  */
 void ws_register_recv_handler(void (*handler)(const char *data, size_t len))
 {
     ws_recv_handler = handler;
+    ws_rx_set_text_handler(handler ? ws_text_msg_handler : NULL);
     ESP_LOGI(TAG, "接收数据处理函数注册成功");
 }
 
+/**
+ * @brief 注册二进制帧处理函数
+ * @param handler: 自定义处理函数（收到完整的二进制消息时回调，data仅在回调期间有效）
+ */
+void ws_register_binary_handler(void (*handler)(const uint8_t *data, size_t len))
+{
+    ws_binary_handler = handler;
+    ws_rx_set_binary_handler(handler ? ws_binary_msg_handler : NULL);
+    ESP_LOGI(TAG, "二进制帧处理函数注册成功");
+}
+
+/**
+ * @brief 注册二进制流处理函数（不重组，逐段传递）
+ */
+void ws_register_binary_stream_handler(ws_rx_stream_handler_t handler)
+{
+    ws_rx_set_binary_stream_handler(handler);
+    ESP_LOGI(TAG, "二进制流处理函数注册成功");
+}
+
 /**
  * @brief 立即尝试重连服务器
  * @return ESP_OK: 成功; 其他: 失败
@@ -666,8 +940,13 @@ esp_err_t ws_reconnect_now(void)
         reconnect_task_handle = NULL;
     }
 
-    // 重置重连计数并立即重连
+    // 重置重连计数并立即重连（已有客户端时原地重启，可恢复TLS会话）
     reconnect_count = 0;
+    if (client != NULL)
+    {
+        esp_websocket_client_stop(client);
+        return esp_websocket_client_start(client);
+    }
     return ws_start(current_ws_uri);
 }
 
@@ -5,11 +5,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include <stdbool.h>
+
 // 第二步：包含ESP-IDF相关头文件
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_websocket_client.h"
 #include "esp_tls.h"
+#include "ws_rx.h"
 
 // 自签名服务器证书（直接复制你的证书内容，格式化后可用）
 static const char *server_cert_pem = "-----BEGIN CERTIFICATE-----\n"
@@ -34,6 +37,42 @@ static const char *server_cert_pem = "-----BEGIN CERTIFICATE-----\n"
 "NR2sXGCvfl4h2ZEvhhsc\n"
 "-----END CERTIFICATE-----\n";
 
+// 发送优先级：数值越小越先发送，队列满时优先丢弃低优先级的消息
+typedef enum {
+    WS_PRIO_CONTROL = 0, // 控制消息（JSON）
+    WS_PRIO_AUDIO,       // 音频数据
+    WS_PRIO_COUNT,
+} ws_send_prio_t;
+
+/**
+ * @brief 发送完成回调，在发送任务中调用，不可阻塞
+ * @param result: ESP_OK: 已写入连接; ESP_ERR_TIMEOUT: 超过截止时间未发送;
+ *                ESP_ERR_NO_MEM: 队列满被丢弃; ESP_FAIL: 写入失败或未连接
+ */
+typedef void (*ws_send_done_cb_t)(esp_err_t result, void *arg);
+
+// 异步发送选项
+typedef struct {
+    ws_send_prio_t prio;     // 发送优先级
+    uint32_t deadline_ms;    // 入队后超过该时长仍未发送则丢弃，0为不过期
+    ws_send_done_cb_t done;  // 完成回调，可为NULL
+    void *arg;               // 回调参数
+} ws_send_opts_t;
+
+// 发送队列统计
+typedef struct {
+    uint32_t queued;          // 当前排队的消息数
+    uint32_t queued_bytes;    // 当前排队的字节数
+    uint32_t in_flight_bytes; // 正在写入的消息字节数
+    uint32_t sent;            // 累计发送成功的消息数
+    uint32_t writes;          // 累计写入次数（多条小消息合并为一次写入）
+    uint32_t dropped;         // 累计因队列满丢弃的消息数
+    uint32_t expired;         // 累计超过截止时间丢弃的消息数
+    uint32_t failed;          // 累计写入失败的消息数
+    uint32_t delay_us;        // 最近一条消息的排队时延
+    uint32_t delay_max_us;    // 最大排队时延
+} ws_send_stats_t;
+
 /**
  * @brief 启动WebSocket客户端并连接服务器
  * @return ESP_OK: 成功; 其他: 失败
@@ -41,7 +80,32 @@ static const char *server_cert_pem = "-----BEGIN CERTIFICATE-----\n"
 esp_err_t ws_start(const char *ws_uri);
 
 /**
- * @brief 向服务器发送JSON文本数据（WebSocket文本帧）
+ * @brief 把消息拷贝进发送队列后立即返回，由发送任务按优先级写出
+ * @param opcode: WS_TRANSPORT_OPCODES_TEXT或WS_TRANSPORT_OPCODES_BINARY
+ * @param opts: 发送选项，NULL为控制优先级、不过期、无回调
+ * @return ESP_OK: 已入队; ESP_ERR_NO_MEM: 队列满; 其他: 失败（均不会再调用回调）
+ */
+esp_err_t ws_send_async(ws_transport_opcodes_t opcode, const void *data, size_t len, const ws_send_opts_t *opts);
+
+/**
+ * @brief 获取发送队列统计
+ */
+void ws_get_send_stats(ws_send_stats_t *stats);
+
+/**
+ * @brief 获取消息压缩（permessage-deflate）统计：压缩状态占用的内存与压缩前后字节数
+ * @return ESP_OK: 成功; ESP_ERR_INVALID_STATE: 客户端未创建或未启用压缩
+ */
+esp_err_t ws_get_deflate_stats(esp_websocket_deflate_stats_t *stats);
+
+/**
+ * @brief 获取连接建立统计：TLS会话恢复与完整握手的次数和平均连接耗时
+ * @return ESP_OK: 成功; ESP_ERR_INVALID_STATE: 客户端未创建
+ */
+esp_err_t ws_get_connect_stats(esp_websocket_connect_stats_t *stats);
+
+/**
+ * @brief 向服务器发送JSON文本数据（WebSocket文本帧），经发送队列以控制优先级发送并等待完成
  * @param json_data: 待发送的JSON字符串（如 "{\"type\":\"audio\"}"）
  * @param len: JSON数据长度（建议用strlen(json_data)，不含结束符）
  * @return ESP_OK: 成功; 其他: 失败
@@ -49,7 +113,7 @@ esp_err_t ws_start(const char *ws_uri);
 esp_err_t ws_send_json(const char *json_data, size_t len);
 
 /**
- * @brief 向服务器发送二进制数据（WebSocket二进制帧）
+ * @brief 向服务器发送二进制数据（WebSocket二进制帧），经发送队列以音频优先级发送并等待完成
  * @param binary_data: 二进制数据缓冲区（如PCM音频、二进制文件内容）
  * @param len: 二进制数据长度（字节数）
  * @return ESP_OK: 成功; 其他: 失败
@@ -59,15 +123,30 @@ esp_err_t ws_send_binary(const void *binary_data, size_t len);
 /**
  * @brief 注册接收数据处理函数
  * @param handler: 自定义处理函数指针，格式：void func(const char *data, size_t len)
- * 说明：收到服务器数据时，会自动调用此函数，data为接收的字符串，len为数据长度
+ * 说明：收到服务器的完整文本消息（分片已重组）时调用，data以'\0'结尾，仅在回调期间有效
  */
 void ws_register_recv_handler(void (*handler)(const char *data, size_t len));
 
+/**
+ * @brief 注册二进制帧处理函数
+ * @param handler: 自定义处理函数指针，格式：void func(const uint8_t *data, size_t len)
+ * 说明：收到服务器的完整二进制消息（如TTS的Opus音频包）时调用，仅在回调期间有效；
+ *       未分片的消息直接指向WebSocket接收缓冲区，分片的消息在接收缓冲池中重组
+ */
+void ws_register_binary_handler(void (*handler)(const uint8_t *data, size_t len));
+
+/**
+ * @brief 注册二进制流处理函数（如直接写入抖动缓冲）
+ * 说明：注册后二进制消息不再重组，每一段数据到达即调用，不拷贝也不占用接收缓冲池，
+ *       ws_register_binary_handler注册的函数不再被调用
+ */
+void ws_register_binary_stream_handler(ws_rx_stream_handler_t handler);
+
 /**
  * @brief 获取连接状态
- * @return ESP_OK: 已连接; ESP_FAIL: 未连接或其他错误
+ * @return true: 已连接; false: 未连接或客户端未创建
  */
-esp_err_t is_ws_connected(void);
+bool is_ws_connected(void);
 
 /**
  * @brief 停止WebSocket客户端并释放资源
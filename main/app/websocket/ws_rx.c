@@ -0,0 +1,289 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "ws_rx.h"
+
+static const char *TAG = "ws_rx";
+
+// 缓冲池中的一个消息缓冲，msg为首个成员，持有者拿到的ws_rx_msg_t指针即指向这里
+typedef struct {
+    ws_rx_msg_t msg;
+    uint8_t *buf;  // WS_RX_BUF_SIZE + 1字节（PSRAM）
+    uint8_t refs;  // 引用数，0为空闲
+} ws_rx_buf_t;
+
+static ws_rx_buf_t pool[WS_RX_POOL_COUNT];
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED; // 保护引用数（释放可能来自其他任务）
+static uint32_t pool_in_use = 0;
+
+// 正在接收的消息（仅客户端任务访问）
+static struct {
+    bool active;      // 已收到消息开头，尚未收完
+    bool dropping;    // 本条消息已决定丢弃，忽略剩余分段
+    bool streaming;   // 本条消息交给流处理函数
+    bool fragmented;  // 本条消息由多段组成
+    uint8_t opcode;   // 消息首帧的opcode
+    size_t len;       // 已收到的字节数
+    ws_rx_buf_t *buf; // 重组用的缓冲
+} rx;
+
+static ws_rx_msg_handler_t text_handler = NULL;
+static ws_rx_msg_handler_t binary_handler = NULL;
+static ws_rx_stream_handler_t binary_stream_handler = NULL;
+static ws_rx_stats_t stats;
+
+esp_err_t ws_rx_init(void)
+{
+    if (pool[0].buf)
+    {
+        return ESP_OK;
+    }
+    for (int i = 0; i < WS_RX_POOL_COUNT; i++)
+    {
+        pool[i].buf = heap_caps_malloc(WS_RX_BUF_SIZE + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!pool[i].buf)
+        {
+            ESP_LOGE(TAG, "无法分配接收缓冲池");
+            for (int j = 0; j < i; j++)
+            {
+                heap_caps_free(pool[j].buf);
+                pool[j].buf = NULL;
+            }
+            return ESP_ERR_NO_MEM;
+        }
+        pool[i].msg.data = pool[i].buf;
+    }
+    ESP_LOGI(TAG, "接收缓冲池: %d x %d字节", WS_RX_POOL_COUNT, WS_RX_BUF_SIZE);
+    return ESP_OK;
+}
+
+static ws_rx_buf_t *pool_acquire(void)
+{
+    ws_rx_buf_t *buf = NULL;
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; i < WS_RX_POOL_COUNT; i++)
+    {
+        if (pool[i].buf && pool[i].refs == 0)
+        {
+            buf = &pool[i];
+            buf->refs = 1;
+            pool_in_use++;
+            if (pool_in_use > stats.in_use_max)
+            {
+                stats.in_use_max = pool_in_use;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    return buf;
+}
+
+static void pool_put(ws_rx_buf_t *buf)
+{
+    portENTER_CRITICAL(&pool_lock);
+    if (buf->refs > 0 && --buf->refs == 0)
+    {
+        pool_in_use--;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+static ws_rx_buf_t *pool_find(const ws_rx_msg_t *msg)
+{
+    for (int i = 0; i < WS_RX_POOL_COUNT; i++)
+    {
+        if (msg == &pool[i].msg)
+        {
+            return &pool[i];
+        }
+    }
+    return NULL;
+}
+
+void ws_rx_set_text_handler(ws_rx_msg_handler_t handler)
+{
+    text_handler = handler;
+}
+
+void ws_rx_set_binary_handler(ws_rx_msg_handler_t handler)
+{
+    binary_handler = handler;
+}
+
+void ws_rx_set_binary_stream_handler(ws_rx_stream_handler_t handler)
+{
+    binary_stream_handler = handler;
+}
+
+/**
+ * @brief 把一条完整的消息交给对应的处理函数
+ */
+static void rx_dispatch(const ws_rx_msg_t *msg)
+{
+    if (msg->opcode == WS_TRANSPORT_OPCODES_TEXT)
+    {
+        stats.text++;
+        if (text_handler)
+        {
+            text_handler(msg);
+        }
+    }
+    else
+    {
+        stats.binary++;
+        if (binary_handler)
+        {
+            binary_handler(msg);
+        }
+    }
+}
+
+/**
+ * @brief 结束当前消息，归还重组缓冲（处理函数持有时由其释放）
+ */
+static void rx_finish(void)
+{
+    if (rx.buf)
+    {
+        pool_put(rx.buf);
+    }
+    memset(&rx, 0, sizeof(rx));
+}
+
+void ws_rx_feed(const esp_websocket_event_data_t *event)
+{
+    // PING/PONG/CLOSE由客户端处理
+    if (event->op_code >= WS_TRANSPORT_OPCODES_CLOSE || event->data_len < 0)
+    {
+        return;
+    }
+    const uint8_t *chunk = (const uint8_t *)event->data_ptr;
+    size_t chunk_len = event->data_len;
+    // 一帧超过客户端接收缓冲区时分多次事件到达，payload_offset为本段在帧内的偏移
+    bool frame_start = event->payload_offset == 0;
+    bool msg_end = event->fin && event->payload_offset + event->data_len >= event->payload_len;
+
+    if (event->op_code != WS_TRANSPORT_OPCODES_CONT && frame_start)
+    {
+        if (rx.active)
+        {
+            stats.aborted++;
+            rx_finish();
+        }
+        rx.active = true;
+        rx.opcode = event->op_code;
+        rx.streaming = rx.opcode == WS_TRANSPORT_OPCODES_BINARY && binary_stream_handler != NULL;
+        // 未分片的二进制消息直接交给处理函数，不经过缓冲池
+        if (msg_end && !rx.streaming && rx.opcode == WS_TRANSPORT_OPCODES_BINARY)
+        {
+            ws_rx_msg_t msg = {
+                .opcode = rx.opcode,
+                .data = chunk,
+                .len = chunk_len,
+            };
+            rx_dispatch(&msg);
+            rx_finish();
+            return;
+        }
+    }
+    else if (!rx.active)
+    {
+        return; // 开头已被丢弃（如断线重连后）的消息的剩余分段
+    }
+    else
+    {
+        rx.fragmented = true;
+    }
+
+    if (rx.streaming)
+    {
+        binary_stream_handler(chunk, chunk_len, rx.len, msg_end);
+        rx.len += chunk_len;
+        if (msg_end)
+        {
+            stats.binary++;
+            stats.reassembled += rx.fragmented;
+            rx_finish();
+        }
+        return;
+    }
+
+    if (!rx.dropping && rx.buf == NULL && (rx.buf = pool_acquire()) == NULL)
+    {
+        stats.pool_empty++;
+        rx.dropping = true;
+        ESP_LOGW(TAG, "接收缓冲池耗尽，丢弃消息");
+    }
+    if (!rx.dropping && rx.len + chunk_len > WS_RX_BUF_SIZE)
+    {
+        stats.oversize++;
+        rx.dropping = true;
+        ESP_LOGW(TAG, "消息超过%d字节，丢弃", WS_RX_BUF_SIZE);
+    }
+    if (!rx.dropping)
+    {
+        memcpy(rx.buf->buf + rx.len, chunk, chunk_len);
+    }
+    rx.len += chunk_len;
+
+    if (msg_end)
+    {
+        if (!rx.dropping)
+        {
+            rx.buf->buf[rx.len] = '\0';
+            rx.buf->msg.opcode = rx.opcode;
+            rx.buf->msg.len = rx.len;
+            stats.reassembled += rx.fragmented;
+            rx_dispatch(&rx.buf->msg);
+        }
+        rx_finish();
+    }
+}
+
+void ws_rx_reset(void)
+{
+    if (rx.active)
+    {
+        stats.aborted++;
+        rx_finish();
+    }
+}
+
+const ws_rx_msg_t *ws_rx_hold(const ws_rx_msg_t *msg)
+{
+    ws_rx_buf_t *buf = pool_find(msg);
+    if (buf)
+    {
+        portENTER_CRITICAL(&pool_lock);
+        buf->refs++;
+        portEXIT_CRITICAL(&pool_lock);
+        return &buf->msg;
+    }
+    if (msg->len > WS_RX_BUF_SIZE || (buf = pool_acquire()) == NULL)
+    {
+        return NULL;
+    }
+    memcpy(buf->buf, msg->data, msg->len);
+    buf->buf[msg->len] = '\0';
+    buf->msg.opcode = msg->opcode;
+    buf->msg.len = msg->len;
+    return &buf->msg;
+}
+
+void ws_rx_release(const ws_rx_msg_t *msg)
+{
+    ws_rx_buf_t *buf = pool_find(msg);
+    if (buf)
+    {
+        pool_put(buf);
+    }
+}
+
+void ws_rx_get_stats(ws_rx_stats_t *out)
+{
+    portENTER_CRITICAL(&pool_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&pool_lock);
+}
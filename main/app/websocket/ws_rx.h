@@ -0,0 +1,91 @@
+#ifndef WS_RX_H
+#define WS_RX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_websocket_client.h"
+
+// 接收消息缓冲池配置
+#define WS_RX_POOL_COUNT 4          // 消息缓冲个数（PSRAM），同时被持有的消息数上限
+#define WS_RX_BUF_SIZE   (8 * 1024) // 单条消息的最大字节数（不含文本结尾'\0'），超过的消息被丢弃
+
+// 一条完整的接收消息（分片已重组）
+typedef struct {
+    uint8_t opcode;      // WS_TRANSPORT_OPCODES_TEXT或WS_TRANSPORT_OPCODES_BINARY
+    const uint8_t *data; // 消息数据，文本消息以'\0'结尾
+    size_t len;          // 消息字节数
+} ws_rx_msg_t;
+
+/**
+ * @brief 消息处理函数，在WebSocket客户端任务中调用，msg仅在回调期间有效（需保留时调用ws_rx_hold）
+ */
+typedef void (*ws_rx_msg_handler_t)(const ws_rx_msg_t *msg);
+
+/**
+ * @brief 二进制流处理函数：不重组，按到达顺序直接传递每一段数据（指向客户端接收缓冲区，不拷贝）
+ * @param offset: 本段在消息中的偏移，为0表示新消息开始（之前未结束的消息应丢弃）
+ * @param fin: 本段是否为消息的最后一段
+ */
+typedef void (*ws_rx_stream_handler_t)(const uint8_t *chunk, size_t len, size_t offset, bool fin);
+
+// 接收统计
+typedef struct {
+    uint32_t text;        // 收到的文本消息数
+    uint32_t binary;      // 收到的二进制消息数
+    uint32_t reassembled; // 由多段重组的消息数
+    uint32_t oversize;    // 超过WS_RX_BUF_SIZE被丢弃的消息数
+    uint32_t pool_empty;  // 缓冲池耗尽被丢弃的消息数
+    uint32_t aborted;     // 未收完就被新消息或断线打断的消息数
+    uint32_t in_use_max;  // 同时占用的缓冲数峰值
+} ws_rx_stats_t;
+
+/**
+ * @brief 分配消息缓冲池
+ */
+esp_err_t ws_rx_init(void);
+
+/**
+ * @brief 注册文本消息处理函数
+ */
+void ws_rx_set_text_handler(ws_rx_msg_handler_t handler);
+
+/**
+ * @brief 注册二进制消息处理函数（整条消息），未分片的消息直接指向客户端接收缓冲区，不拷贝
+ */
+void ws_rx_set_binary_handler(ws_rx_msg_handler_t handler);
+
+/**
+ * @brief 注册二进制流处理函数，注册后二进制消息不再重组，也不再传给二进制消息处理函数
+ */
+void ws_rx_set_binary_stream_handler(ws_rx_stream_handler_t handler);
+
+/**
+ * @brief 处理一个WEBSOCKET_EVENT_DATA事件（仅在WebSocket客户端任务中调用）
+ */
+void ws_rx_feed(const esp_websocket_event_data_t *event);
+
+/**
+ * @brief 连接断开时丢弃未收完的消息
+ */
+void ws_rx_reset(void);
+
+/**
+ * @brief 在回调之外继续持有一条消息（可交给其他任务处理），用完后调用ws_rx_release
+ * 消息不在缓冲池中（未分片的二进制消息）时拷贝进缓冲池
+ * @return 缓冲池耗尽时返回NULL
+ */
+const ws_rx_msg_t *ws_rx_hold(const ws_rx_msg_t *msg);
+
+/**
+ * @brief 释放ws_rx_hold持有的消息，可在任意任务中调用
+ */
+void ws_rx_release(const ws_rx_msg_t *msg);
+
+/**
+ * @brief 获取接收统计
+ */
+void ws_rx_get_stats(ws_rx_stats_t *stats);
+
+#endif // WS_RX_H
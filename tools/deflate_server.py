@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Stand-in server for the permessage-deflate negotiation of the device.
+
+Answers the client's offer as told: --mode accept (optionally lowering the window bits with
+--server-bits / --client-bits, or forcing no_context_takeover), reject (the response leaves the
+extension out, the device must keep sending uncompressed) or invalid (the response carries a parameter
+the client never offered, the device must fail the connect). Every message of the device is logged
+with whether it arrived compressed, and text messages are echoed back compressed when negotiated;
+--final-block ends each echo with a final deflate block, as some servers do, so the next one starts a
+new stream.
+
+    python3 tools/deflate_server.py --cert cert.pem --key key.pem --server-bits 9 --client-bits 10
+    python3 tools/deflate_server.py --mode reject
+"""
+
+import argparse
+import asyncio
+import zlib
+
+import ws_stand_in
+
+
+async def send_final_block(conn, payload):
+    """Send a text message compressed as a complete deflate stream (ending with BFINAL set)."""
+    session = conn.deflate
+    compressor = zlib.compressobj(6, zlib.DEFLATED, -max(session.server_bits, 9))
+    data = compressor.compress(payload.encode()) + compressor.flush(zlib.Z_FINISH)
+    await conn.send_frame(ws_stand_in.OP_TEXT, data, rsv1=True)
+
+
+async def handle(conn, args):
+    print("device connected from %s" % (conn.peer,))
+    print("  offer:      %s" % conn.headers.get("sec-websocket-extensions", "(none)"))
+    session = conn.deflate
+    if args.mode == "invalid":
+        print("  negotiated: invalid answer sent, the device should have failed the connect")
+    elif session is None:
+        print("  negotiated: none, messages must arrive uncompressed")
+    else:
+        print("  negotiated: server window %d bits%s, client window %d bits%s"
+              % (session.server_bits, ", no context takeover" if session.server_nct else "",
+                 session.client_bits, ", no context takeover" if session.client_nct else ""))
+    messages = compressed = 0
+    while True:
+        message = await conn.recv()
+        if message is None:
+            break
+        opcode, payload, was_compressed = message
+        messages += 1
+        compressed += was_compressed
+        kind = "text" if opcode == ws_stand_in.OP_TEXT else "binary"
+        print("device: %s %d bytes%s" % (kind, len(payload), ", compressed" if was_compressed else ""))
+        if opcode != ws_stand_in.OP_TEXT or not args.echo:
+            continue
+        text = payload.decode(errors="replace")
+        if args.final_block and session is not None and session.server_bits >= 9:
+            await send_final_block(conn, text)
+        else:
+            await conn.send(text)
+    if session is not None and session.rx_messages:
+        print("device closed: %d messages, %d compressed (%d -> %d bytes, %.1f%%)"
+              % (messages, compressed, session.rx_inflated, session.rx_compressed,
+                 100.0 * session.rx_compressed / max(session.rx_inflated, 1)))
+    else:
+        print("device closed: %d messages, %d compressed" % (messages, compressed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ws_stand_in.add_server_arguments(parser)
+    parser.add_argument("--mode", choices=("accept", "reject", "invalid"), default="accept",
+                        help="how to answer the permessage-deflate offer")
+    parser.add_argument("--server-bits", type=int, choices=range(8, 16), help="server_max_window_bits to answer")
+    parser.add_argument("--client-bits", type=int, choices=range(8, 16), help="lower client_max_window_bits to this")
+    parser.add_argument("--server-no-context-takeover", action="store_true")
+    parser.add_argument("--client-no-context-takeover", action="store_true")
+    parser.add_argument("--no-echo", dest="echo", action="store_false", help="do not echo text messages back")
+    parser.add_argument("--final-block", action="store_true", help="end each compressed echo with a final block")
+    args = parser.parse_args()
+    deflate = ws_stand_in.Deflate(args.mode, args.server_bits, args.client_bits,
+                                  args.server_no_context_takeover, args.client_no_context_takeover)
+    asyncio.run(ws_stand_in.serve(lambda conn: handle(conn, args), args.host, args.port, args.cert, args.key,
+                                  deflate=deflate))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Stand-in server for streaming Opus playback (downlink).
+
+Answers each turn of the device with the Opus packets of an Ogg Opus file (spiffs/turn_on.opus by
+default), one packet per binary message at real-time pace, framed by {"type":"tts","state":"start"}
+and {"type":"tts","state":"stop"} as the real backend does. Loss, jitter and reordering can be
+simulated to exercise the jitter buffer, FEC and PLC; with --seq every packet carries the 2 byte
+big endian sequence number expected when AUDIO_STREAM_SEQ_HEADER is 1.
+
+    python3 tools/stream_server.py --cert cert.pem --key key.pem --loss 0.05 --jitter 40 --seq
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import random
+import struct
+
+import ws_stand_in
+
+DEFAULT_FILE = os.path.join(os.path.dirname(__file__), "..", "spiffs", "turn_on.opus")
+
+
+def ogg_packets(path):
+    """Opus packets of an Ogg Opus file, without the OpusHead and OpusTags header packets."""
+    with open(path, "rb") as f:
+        data = f.read()
+    packets = []
+    partial = b""
+    pos = 0
+    while pos < len(data):
+        if data[pos:pos + 4] != b"OggS":
+            raise ValueError("lost Ogg page sync at offset %d" % pos)
+        nsegs = data[pos + 26]
+        lacing = data[pos + 27:pos + 27 + nsegs]
+        pos += 27 + nsegs
+        for size in lacing:
+            partial += data[pos:pos + size]
+            pos += size
+            if size < 255:
+                packets.append(partial)
+                partial = b""
+    if len(packets) < 2 or not packets[0].startswith(b"OpusHead"):
+        raise ValueError("%s is not an Ogg Opus file" % path)
+    return packets[2:]
+
+
+def opus_packet_ms(packet):
+    """Duration of an Opus packet from its TOC byte (RFC 6716 3.1)."""
+    config = packet[0] >> 3
+    if config < 12:
+        frame_ms = (10, 20, 40, 60)[config % 4]
+    elif config < 16:
+        frame_ms = (10, 20)[config % 2]
+    else:
+        frame_ms = (2.5, 5, 10, 20)[config % 4]
+    code = packet[0] & 3
+    frames = 1 if code == 0 else 2 if code in (1, 2) else packet[1] & 0x3F
+    return frame_ms * frames
+
+
+async def stream_reply(conn, packets, args):
+    await conn.send(json.dumps({"type": "tts", "state": "start"}, separators=(",", ":")))
+    start = asyncio.get_running_loop().time()
+    t = 0.0
+    sent = lost = 0
+    held = None
+    for seq, packet in enumerate(packets):
+        t += opus_packet_ms(packet) / 1000
+        delay = start + t - asyncio.get_running_loop().time()
+        if args.jitter:
+            delay += random.uniform(0, args.jitter / 1000)
+        if delay > 0:
+            await asyncio.sleep(delay)
+        if random.random() < args.loss:
+            lost += 1
+            continue
+        message = (struct.pack("!H", seq & 0xFFFF) if args.seq else b"") + packet
+        if args.reorder and held is None and random.random() < args.reorder:
+            held = message
+            continue
+        await conn.send(message)
+        sent += 1
+        if held is not None:
+            await conn.send(held)
+            sent += 1
+            held = None
+    if held is not None:
+        await conn.send(held)
+        sent += 1
+    await conn.send(json.dumps({"type": "tts", "state": "stop"}, separators=(",", ":")))
+    print("reply sent: %d packets, %d dropped" % (sent, lost))
+
+
+async def handle(conn, packets, args):
+    print("device connected from %s" % (conn.peer,))
+    if args.on_connect:
+        await stream_reply(conn, packets, args)
+    while True:
+        message = await conn.recv()
+        if message is None:
+            print("device closed the connection")
+            return
+        opcode, payload, _ = message
+        if opcode != ws_stand_in.OP_TEXT:
+            continue
+        print("device: %s" % payload.decode(errors="replace"))
+        try:
+            kind = json.loads(payload).get("type")
+        except ValueError:
+            continue
+        if kind == "end_of_utterance":
+            await stream_reply(conn, packets, args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ws_stand_in.add_server_arguments(parser)
+    parser.add_argument("--file", default=DEFAULT_FILE, help="Ogg Opus file streamed as the reply")
+    parser.add_argument("--on-connect", action="store_true", help="also stream a reply as soon as the device connects")
+    parser.add_argument("--seq", action="store_true", help="prefix each packet with a 2 byte sequence number")
+    parser.add_argument("--loss", type=float, default=0.0, help="probability of dropping a packet")
+    parser.add_argument("--jitter", type=float, default=0.0, help="maximum extra send delay in ms")
+    parser.add_argument("--reorder", type=float, default=0.0, help="probability of swapping a packet with the next")
+    args = parser.parse_args()
+    packets = ogg_packets(args.file)
+    print("%s: %d packets, %.1f s" % (args.file, len(packets), sum(map(opus_packet_ms, packets)) / 1000))
+    asyncio.run(ws_stand_in.serve(lambda conn: handle(conn, packets, args), args.host, args.port, args.cert, args.key))
+
+
+if __name__ == "__main__":
+    main()
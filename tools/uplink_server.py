@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Stand-in server for the uplink disconnect spool and its replay.
+
+Logs the control messages of the device (wakeup, silence, end_of_utterance, barge_in) and counts
+the audio messages of each turn. To exercise the spool it drops the TCP connection without a close
+handshake --drop-after seconds into a turn (or every --drop-every seconds), then refuses new
+connections for --down seconds, so the device keeps recording into the spool. After reconnecting
+the device announces {"type":"replay","messages":N,"age_ms":M}, sends the spooled messages and ends
+with {"type":"replay_end"}; the server checks the count against N and lists the control messages
+that survived, so evicted control records (the spool should only drop audio) show up at once.
+
+    python3 tools/uplink_server.py --cert cert.pem --key key.pem --drop-after 2 --down 5
+"""
+
+import argparse
+import asyncio
+import json
+
+import ws_stand_in
+
+
+class Link:
+    """Link state shared across connections: when the server accepts the device again."""
+
+    def __init__(self):
+        self.down_until = 0.0
+
+
+class Replay:
+    def __init__(self, announced, age_ms):
+        self.announced = announced
+        self.age_ms = age_ms
+        self.audio = 0
+        self.audio_bytes = 0
+        self.control = []
+
+    def report(self):
+        received = self.audio + len(self.control)
+        verdict = "OK" if received == self.announced else "MISMATCH"
+        print("replay %s: announced %d messages (oldest %d ms), received %d: %d audio (%d bytes), %d control %s"
+              % (verdict, self.announced, self.age_ms, received, self.audio, self.audio_bytes,
+                 len(self.control), self.control))
+
+
+async def drop_later(conn, delay, link, args):
+    await asyncio.sleep(delay)
+    if conn.closed:
+        return
+    link.down_until = asyncio.get_running_loop().time() + args.down
+    print("dropping the connection, refusing the device for %.1f s" % args.down)
+    conn.abort()
+
+
+async def handle(conn, link, args):
+    loop = asyncio.get_running_loop()
+    if loop.time() < link.down_until:
+        print("link down, dropping %s" % (conn.peer,))
+        conn.abort()
+        return
+    print("device connected from %s" % (conn.peer,))
+    if args.drop_every:
+        asyncio.ensure_future(drop_later(conn, args.drop_every, link, args))
+    replay = None
+    audio = audio_bytes = 0
+    while True:
+        message = await conn.recv()
+        if message is None:
+            print("device closed the connection")
+            return
+        opcode, payload, _ = message
+        if opcode == ws_stand_in.OP_BINARY:
+            if replay is not None:
+                replay.audio += 1
+                replay.audio_bytes += len(payload)
+            else:
+                audio += 1
+                audio_bytes += len(payload)
+            continue
+        if opcode != ws_stand_in.OP_TEXT:
+            continue
+        try:
+            body = json.loads(payload)
+            kind = body.get("type")
+        except ValueError:
+            print("device: unparsable %r" % payload[:80])
+            continue
+        if kind == "replay":
+            if replay is not None:
+                print("replay started again before replay_end")
+            replay = Replay(body.get("messages", 0), body.get("age_ms", 0))
+            print("device: %s" % payload.decode(errors="replace"))
+            continue
+        if kind == "replay_end":
+            if replay is None:
+                print("replay_end without replay")
+            else:
+                replay.report()
+            replay = None
+            continue
+        if replay is not None:
+            replay.control.append(kind)
+            continue
+        print("device: %s" % payload.decode(errors="replace"))
+        if kind == "wakeup":
+            audio = audio_bytes = 0
+            if args.drop_after:
+                asyncio.ensure_future(drop_later(conn, args.drop_after, link, args))
+        elif kind == "end_of_utterance":
+            print("turn audio: %d messages, %d bytes" % (audio, audio_bytes))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ws_stand_in.add_server_arguments(parser)
+    parser.add_argument("--drop-after", type=float, default=0.0, help="drop the connection this many s after a wakeup")
+    parser.add_argument("--drop-every", type=float, default=0.0, help="drop each connection after this many s")
+    parser.add_argument("--down", type=float, default=5.0, help="s to refuse reconnects after a drop")
+    args = parser.parse_args()
+    link = Link()
+    asyncio.run(ws_stand_in.serve(lambda conn: handle(conn, link, args), args.host, args.port, args.cert, args.key))
+
+
+if __name__ == "__main__":
+    main()
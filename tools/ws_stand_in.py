@@ -0,0 +1,291 @@
+"""Minimal WebSocket server used by the local stand-in servers (standard library only).
+
+Implements just what the device talks to: the RFC 6455 handshake, masked client frames,
+fragmented messages, ping/pong/close, and permessage-deflate (RFC 7692) with the negotiation
+outcome chosen by the caller, so the device side of each feature can be exercised without the
+real backend.
+"""
+
+import asyncio
+import base64
+import hashlib
+import ssl
+import struct
+import zlib
+
+GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+OP_CONT = 0x0
+OP_TEXT = 0x1
+OP_BINARY = 0x2
+OP_CLOSE = 0x8
+OP_PING = 0x9
+OP_PONG = 0xA
+
+DEFLATE_TAIL = b"\x00\x00\xff\xff"
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def parse_extensions(value):
+    """Parse a Sec-WebSocket-Extensions value into [(name, {param: value or None})]."""
+    offers = []
+    for element in value.split(","):
+        parts = [p.strip() for p in element.split(";")]
+        if not parts[0]:
+            continue
+        params = {}
+        for p in parts[1:]:
+            if not p:
+                continue
+            key, _, val = p.partition("=")
+            params[key.strip().lower()] = val.strip().strip('"') if val else None
+        offers.append((parts[0].lower(), params))
+    return offers
+
+
+class Deflate:
+    """permessage-deflate in the server role.
+
+    mode: "accept" answers the client's offer, "reject" leaves the extension out of the response,
+    "invalid" answers with a parameter the client never offered (the client must fail the connect).
+    server_bits / client_bits: window bits the server puts in its response (None keeps the offer).
+    """
+
+    def __init__(self, mode="accept", server_bits=None, client_bits=None,
+                 server_no_context_takeover=False, client_no_context_takeover=False):
+        self.mode = mode
+        self.server_bits = server_bits
+        self.client_bits = client_bits
+        self.server_no_context_takeover = server_no_context_takeover
+        self.client_no_context_takeover = client_no_context_takeover
+
+    def negotiate(self, offer_value):
+        """Return (response header value or None, session or None)."""
+        if self.mode == "reject" or not offer_value:
+            return None, None
+        for name, params in parse_extensions(offer_value):
+            if name != "permessage-deflate":
+                continue
+            if self.mode == "invalid":
+                return "permessage-deflate; unknown_param", None
+            offered_server = int(params.get("server_max_window_bits") or 15)
+            offered_client = params.get("client_max_window_bits", "absent")
+            server_bits = min(self.server_bits or offered_server, offered_server)
+            response = ["permessage-deflate", "server_max_window_bits=%d" % server_bits]
+            client_bits = 15
+            if offered_client != "absent":
+                client_bits = int(offered_client or 15)
+                if self.client_bits:
+                    client_bits = min(client_bits, self.client_bits)
+                response.append("client_max_window_bits=%d" % client_bits)
+            server_nct = self.server_no_context_takeover or "server_no_context_takeover" in params
+            client_nct = self.client_no_context_takeover or "client_no_context_takeover" in params
+            if server_nct:
+                response.append("server_no_context_takeover")
+            if client_nct:
+                response.append("client_no_context_takeover")
+            return "; ".join(response), DeflateSession(server_bits, client_bits, server_nct, client_nct)
+        return None, None
+
+
+class DeflateSession:
+    def __init__(self, server_bits, client_bits, server_nct, client_nct):
+        self.server_bits = server_bits
+        self.client_bits = client_bits
+        self.server_nct = server_nct
+        self.client_nct = client_nct
+        # zlib cannot deflate with an 8 bit raw window: messages then go out uncompressed
+        self.compressor = self._compressor()
+        self.decompressor = zlib.decompressobj(-client_bits)
+        self.rx_messages = 0
+        self.rx_compressed = 0
+        self.rx_inflated = 0
+
+    def _compressor(self):
+        return zlib.compressobj(6, zlib.DEFLATED, -self.server_bits) if self.server_bits >= 9 else None
+
+    def compress(self, data):
+        """Compressed payload, or None when the message has to go out uncompressed."""
+        if self.compressor is None:
+            return None
+        out = self.compressor.compress(data) + self.compressor.flush(zlib.Z_SYNC_FLUSH)
+        if self.server_nct:
+            self.compressor = self._compressor()
+        assert out.endswith(DEFLATE_TAIL)
+        return out[:-len(DEFLATE_TAIL)]
+
+    def inflate(self, data):
+        out = self.decompressor.decompress(data + DEFLATE_TAIL)
+        if self.client_nct:
+            self.decompressor = zlib.decompressobj(-self.client_bits)
+        self.rx_messages += 1
+        self.rx_compressed += len(data)
+        self.rx_inflated += len(out)
+        return out
+
+
+class Connection:
+    def __init__(self, reader, writer, path, headers, deflate):
+        self.reader = reader
+        self.writer = writer
+        self.path = path
+        self.headers = headers
+        self.deflate = deflate
+        self.closed = False
+        self.peer = writer.get_extra_info("peername")
+
+    async def _read_frame(self):
+        head = await self.reader.readexactly(2)
+        fin = head[0] & 0x80
+        rsv1 = head[0] & 0x40
+        if head[0] & 0x30:
+            raise ProtocolError("RSV2/RSV3 set")
+        opcode = head[0] & 0x0F
+        masked = head[1] & 0x80
+        length = head[1] & 0x7F
+        if length == 126:
+            length = struct.unpack("!H", await self.reader.readexactly(2))[0]
+        elif length == 127:
+            length = struct.unpack("!Q", await self.reader.readexactly(8))[0]
+        if not masked:
+            raise ProtocolError("unmasked client frame")
+        mask = await self.reader.readexactly(4)
+        payload = bytearray(await self.reader.readexactly(length))
+        for i in range(length):
+            payload[i] ^= mask[i & 3]
+        return bool(fin), bool(rsv1), opcode, bytes(payload)
+
+    async def recv(self):
+        """Return (opcode, payload, compressed) of the next data message, None once the peer closed."""
+        message = None
+        while True:
+            fin, rsv1, opcode, payload = await self._read_frame()
+            if opcode == OP_PING:
+                await self.send_frame(OP_PONG, payload)
+                continue
+            if opcode == OP_PONG:
+                continue
+            if opcode == OP_CLOSE:
+                if not self.closed:
+                    await self.send_frame(OP_CLOSE, payload[:2])
+                self.closed = True
+                return None
+            if opcode != OP_CONT:
+                if message is not None:
+                    raise ProtocolError("new message inside a fragmented one")
+                if rsv1 and self.deflate is None:
+                    raise ProtocolError("RSV1 without negotiated permessage-deflate")
+                message = [opcode, rsv1, [payload]]
+            else:
+                if message is None or rsv1:
+                    raise ProtocolError("unexpected continuation frame")
+                message[2].append(payload)
+            if fin:
+                data = b"".join(message[2])
+                if message[1]:
+                    data = self.deflate.inflate(data)
+                return message[0], data, message[1]
+
+    async def send_frame(self, opcode, payload, fin=True, rsv1=False):
+        head = bytearray([(0x80 if fin else 0) | (0x40 if rsv1 else 0) | opcode])
+        n = len(payload)
+        if n < 126:
+            head.append(n)
+        elif n < 65536:
+            head.append(126)
+            head += struct.pack("!H", n)
+        else:
+            head.append(127)
+            head += struct.pack("!Q", n)
+        self.writer.write(bytes(head) + payload)
+        await self.writer.drain()
+
+    async def send(self, data, compress=None):
+        """Send a text (str) or binary (bytes) message, compressed when negotiated (text by default)."""
+        opcode = OP_TEXT if isinstance(data, str) else OP_BINARY
+        payload = data.encode() if isinstance(data, str) else data
+        if compress is None:
+            compress = opcode == OP_TEXT
+        compressed = self.deflate.compress(payload) if compress and self.deflate is not None else None
+        if compressed is not None:
+            await self.send_frame(opcode, compressed, rsv1=True)
+        else:
+            await self.send_frame(opcode, payload)
+
+    async def close(self, code=1000):
+        if not self.closed:
+            self.closed = True
+            try:
+                await self.send_frame(OP_CLOSE, struct.pack("!H", code))
+            except ConnectionError:
+                pass
+        self.abort()
+
+    def abort(self):
+        """Drop the TCP connection without a close handshake (link loss as seen by the device)."""
+        self.closed = True
+        self.writer.close()
+
+
+async def handshake(reader, writer, deflate=None):
+    request = await reader.readuntil(b"\r\n\r\n")
+    lines = request.decode("latin-1").split("\r\n")
+    method, path, _ = lines[0].split(" ", 2)
+    headers = {}
+    for line in lines[1:]:
+        if ":" in line:
+            key, _, value = line.partition(":")
+            key = key.strip().lower()
+            headers[key] = headers[key] + ", " + value.strip() if key in headers else value.strip()
+    key = headers.get("sec-websocket-key")
+    if method != "GET" or key is None or headers.get("upgrade", "").lower() != "websocket":
+        writer.write(b"HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n")
+        await writer.drain()
+        writer.close()
+        return None
+    accept = base64.b64encode(hashlib.sha1((key + GUID).encode()).digest()).decode()
+    response = ["HTTP/1.1 101 Switching Protocols", "Upgrade: websocket", "Connection: Upgrade",
+                "Sec-WebSocket-Accept: " + accept]
+    session = None
+    if deflate is not None:
+        value, session = deflate.negotiate(headers.get("sec-websocket-extensions"))
+        if value:
+            response.append("Sec-WebSocket-Extensions: " + value)
+    if "sec-websocket-protocol" in headers:
+        response.append("Sec-WebSocket-Protocol: " + headers["sec-websocket-protocol"].split(",")[0].strip())
+    writer.write(("\r\n".join(response) + "\r\n\r\n").encode())
+    await writer.drain()
+    return Connection(reader, writer, path, headers, session)
+
+
+async def serve(handler, host, port, certfile=None, keyfile=None, deflate=None):
+    """Accept connections forever, calling `await handler(conn)` for each upgraded connection."""
+    context = None
+    if certfile:
+        context = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+        context.load_cert_chain(certfile, keyfile)
+
+    async def on_client(reader, writer):
+        try:
+            conn = await handshake(reader, writer, deflate)
+            if conn is not None:
+                await handler(conn)
+        except (asyncio.IncompleteReadError, ConnectionError, ProtocolError) as e:
+            print("connection ended: %r" % e)
+        finally:
+            writer.close()
+
+    server = await asyncio.start_server(on_client, host, port, ssl=context)
+    print("listening on %s://%s:%d" % ("wss" if context else "ws", host, port))
+    async with server:
+        await server.serve_forever()
+
+
+def add_server_arguments(parser, port=8765):
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=port)
+    parser.add_argument("--cert", help="PEM certificate, serves wss:// when given (the device pins server_cert_pem)")
+    parser.add_argument("--key", help="PEM private key of --cert")